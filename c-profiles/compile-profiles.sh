@@ -0,0 +1,50 @@
+#!/bin/sh
+# Compiles every c-profile into a profile file for load_profile.
+# Usage: compile-profiles.sh <output directory> [compiler flags]
+# Flags must let the compiler find ximc.h and libximc, for example
+#   compile-profiles.sh profiles -I../libximc/include -L../libximc/src/.libs
+# Profiles are written as <output directory>/<vendor>/<stage>.xiprof
+# and collected into <output directory>/profiles.xipd for open_profile_database
+
+set -e
+
+if [ -z "$1" ] ; then
+	echo "Usage: $0 <output directory> [compiler flags]"
+	exit 2
+fi
+
+SRCDIR=$(cd "$(dirname "$0")" && pwd)
+OUTDIR=$1
+shift
+CC=${CC:-cc}
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+count=0
+skipped=0
+for header in "$SRCDIR"/*/*.h ; do
+	vendor=$(basename "$(dirname "$header")")
+	stage=$(basename "$header" .h)
+	function=$(sed -n 's/.*result_t \(set_profile_[A-Za-z0-9_]*\)(device_t id).*/\1/p' "$header")
+	if [ -z "$function" ] ; then
+		echo "No profile function in $header, skipped"
+		continue
+	fi
+	mkdir -p "$OUTDIR/$vendor"
+	# version macros of stages starting with a digit are not valid C, only the function is needed
+	sed '/^#define [0-9]/d' "$header" > "$WORKDIR/profile.h"
+	if ! $CC -o "$WORKDIR/profile-compiler" "$SRCDIR/profile-compiler.c" \
+			-DPROFILE_HEADER="\"$WORKDIR/profile.h\"" -DPROFILE_FUNCTION="$function" "$@" -lximc 2> "$WORKDIR/cc.log" ; then
+		echo "Can't compile $header, skipped"
+		skipped=$((skipped + 1))
+		continue
+	fi
+	rm -f "$WORKDIR/device.bin"
+	"$WORKDIR/profile-compiler" "xi-emu://$WORKDIR/device.bin" "$OUTDIR/$vendor/$stage.xiprof"
+	count=$((count + 1))
+done
+echo "$count profiles compiled into $OUTDIR, $skipped skipped"
+
+$CC -o "$WORKDIR/profile-database" "$SRCDIR/profile-database.c" "$@" -lximc
+"$WORKDIR/profile-database" "$OUTDIR/profiles.xipd" "$OUTDIR"/*/*.xiprof
+echo "Profile database written to $OUTDIR/profiles.xipd"
@@ -0,0 +1,70 @@
+/*
+ * Compiles one c-profile into a profile file for load_profile.
+ * The set_profile_* function is run against a virtual device while the library records
+ * the settings it writes. Build it with PROFILE_HEADER and PROFILE_FUNCTION defined,
+ * compile-profiles.sh does it for the whole tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__APPLE__) && !defined(NOFRAMEWORK)
+#include <libximc/ximc.h>
+#else
+#include <ximc.h>
+#endif
+
+#include PROFILE_HEADER
+
+/* The virtual device rejects structures it does not emulate, those messages are not interesting */
+static void XIMC_CALLCONV quiet_logging_callback (int loglevel, const wchar_t* message, void* user_data)
+{
+	(void)loglevel;
+	(void)message;
+	(void)user_data;
+}
+
+int main (int argc, char* argv[])
+{
+	device_t device;
+	uint8_t* profile;
+	unsigned int size;
+	FILE* file;
+	int ok;
+
+	if (argc != 3)
+	{
+		fprintf( stderr, "Usage: %s <virtual device uri> <profile file>\n", argv[0] );
+		return 2;
+	}
+	set_logging_callback( quiet_logging_callback, NULL );
+	if ((device = open_device( argv[1] )) == device_undefined)
+	{
+		fprintf( stderr, "Can't open %s\n", argv[1] );
+		return 1;
+	}
+	if (start_profile_recording( device ) != result_ok)
+	{
+		close_device( &device );
+		return 1;
+	}
+	/* the virtual device may reject some structures, they are recorded anyway */
+	PROFILE_FUNCTION( device );
+	ok = stop_profile_recording( device, NULL, 0, &size ) == result_ok &&
+		(profile = (uint8_t*)malloc( size )) != NULL &&
+		stop_profile_recording( device, profile, size, &size ) == result_ok;
+	close_device( &device );
+	if (!ok)
+	{
+		fprintf( stderr, "Can't record the profile\n" );
+		return 1;
+	}
+	if ((file = fopen( argv[2], "wb" )) == NULL || fwrite( profile, 1, size, file ) != size)
+	{
+		fprintf( stderr, "Can't write %s\n", argv[2] );
+		return 1;
+	}
+	fclose( file );
+	free( profile );
+	return 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Collects compiled profile files into one profile database for open_profile_database.
+ * Profile paths must look like <vendor>/<stage>.xiprof, compile-profiles.sh writes them so.
+ */
+
+#include <stdio.h>
+#include <wchar.h>
+
+#if defined(__APPLE__) && !defined(NOFRAMEWORK)
+#include <libximc/ximc.h>
+#else
+#include <ximc.h>
+#endif
+
+int main (int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf( stderr, "Usage: %s <database file> <profile files>\n", argv[0] );
+		return 2;
+	}
+	if (create_profile_database( argv[1], (const char* const*)(argv + 2), argc - 2 ) != result_ok)
+	{
+		fprintf( stderr, "Can't create %s\n", argv[1] );
+		return 1;
+	}
+	return 0;
+}
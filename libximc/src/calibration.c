@@ -0,0 +1,235 @@
+#include "common.h"
+
+#include "ximc.h"
+#include "util.h"
+#include "metadata.h"
+#include "platform.h"
+#include "protosup.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CALB_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CALB_SSE2
+#endif
+
+/*
+ * Batch conversion between (steps, microsteps) and calibrated units.
+ *
+ * Results are bit-exact with XI_normal_to_calibrate* and XI_calibrate_to_normal* macros:
+ * the microstep part is added in float, scaling by A is done in double and conversion
+ * back to steps truncates like the C cast. The vector paths only widen the same operations.
+ */
+
+/* Values are corrected in blocks of this size before conversion to steps */
+#define CALB_BLOCK_SIZE 256
+
+static void steps_to_units(const int* steps, const int* usteps, float* values, int count, double A, float rdiv)
+{
+	int i = 0;
+#if defined(CALB_AVX2)
+	const __m256 vrdiv = _mm256_set1_ps(rdiv);
+	const __m256d vA = _mm256_set1_pd(A);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 f = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(steps + i)));
+		if (usteps != NULL)
+			f = _mm256_add_ps(f, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(usteps + i))), vrdiv));
+		__m128 lo = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(f)), vA));
+		__m128 hi = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)), vA));
+		_mm_storeu_ps(values + i, lo);
+		_mm_storeu_ps(values + i + 4, hi);
+	}
+#elif defined(CALB_SSE2)
+	const __m128 vrdiv = _mm_set1_ps(rdiv);
+	const __m128d vA = _mm_set1_pd(A);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 f = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(steps + i)));
+		if (usteps != NULL)
+			f = _mm_add_ps(f, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(usteps + i))), vrdiv));
+		__m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(f), vA));
+		__m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)), vA));
+		_mm_storeu_ps(values + i, _mm_movelh_ps(lo, hi));
+	}
+#endif
+	for (; i < count; ++i)
+		values[i] = (float)(A * ((float)steps[i] + (usteps != NULL ? (float)usteps[i] * rdiv : 0.0f)));
+}
+
+static void units_to_steps(const float* values, int* steps, int* usteps, int count, double A, int div)
+{
+	int i = 0;
+	double d;
+#if defined(CALB_AVX2)
+	const __m256d vA = _mm256_set1_pd(A), vdiv = _mm256_set1_pd(div);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d q = _mm256_div_pd(_mm256_cvtps_pd(_mm_loadu_ps(values + i)), vA);
+		__m128i s = _mm256_cvttpd_epi32(q);
+		_mm_storeu_si128((__m128i*)(steps + i), s);
+		if (usteps != NULL)
+			_mm_storeu_si128((__m128i*)(usteps + i),
+				_mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_sub_pd(q, _mm256_cvtepi32_pd(s)), vdiv)));
+	}
+#elif defined(CALB_SSE2)
+	const __m128d vA = _mm_set1_pd(A), vdiv = _mm_set1_pd(div);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 f = _mm_loadu_ps(values + i);
+		__m128d qlo = _mm_div_pd(_mm_cvtps_pd(f), vA);
+		__m128d qhi = _mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)), vA);
+		__m128i slo = _mm_cvttpd_epi32(qlo), shi = _mm_cvttpd_epi32(qhi);
+		_mm_storeu_si128((__m128i*)(steps + i), _mm_unpacklo_epi64(slo, shi));
+		if (usteps != NULL)
+			_mm_storeu_si128((__m128i*)(usteps + i), _mm_unpacklo_epi64(
+				_mm_cvttpd_epi32(_mm_mul_pd(_mm_sub_pd(qlo, _mm_cvtepi32_pd(slo)), vdiv)),
+				_mm_cvttpd_epi32(_mm_mul_pd(_mm_sub_pd(qhi, _mm_cvtepi32_pd(shi)), vdiv))));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		d = values[i] / A;
+		steps[i] = (int)d;
+		if (usteps != NULL)
+			usteps[i] = (int)((d - steps[i]) * div);
+	}
+}
+
+/* Validates calibration and fills context with it and the device correction table */
+static result_t calibration_context_init(device_t id, const calibration_t* calibration, calibration_context_t* context, int retain)
+{
+	device_metadata_t* dm;
+
+	if (calibration == NULL)
+		return result_value_error;
+	if (calibration->MicrostepMode == 0 || calibration->MicrostepMode > MAX_ENUM_MICROSTEP_MODE)
+		return result_value_error;
+	context->A = calibration->A;
+	context->microstep_divisor = 1 << (calibration->MicrostepMode - 1);
+	context->microstep_scale = 1.0f / context->microstep_divisor; /* exact, the divisor is a power of two */
+	context->table = NULL;
+	if (id == device_undefined)
+		return result_ok;
+	if ((dm = get_metadata(id)) == NULL)
+	{
+		log_error(L"could not extract metadata for device");
+		return result_error;
+	}
+	if (retain)
+		context->table = correction_table_retain_device(dm);
+	else
+		context->table = dm->table;
+	return result_ok;
+}
+
+/* Checks a context passed to a _calb_ctx function, it must be made by create_calibration_context */
+int calibration_context_valid(const calibration_context_t* context)
+{
+	return context != NULL && context->microstep_divisor > 0 &&
+		context->microstep_divisor <= 1 << (MAX_ENUM_MICROSTEP_MODE - 1);
+}
+
+/*The transformation of coordinates from the user to the controller with the table of a context.*/
+result_t normal_correction_ctx(const calibration_context_t* context, float* newPosition)
+{
+	if (!calibration_context_valid(context))
+		return 0;
+	if (context->table != NULL)
+		*newPosition = (float)correction_forward(context->table, *newPosition);
+	return 1;
+}
+
+/*The transformation of coordinates from the controller to the user with the table of a context.*/
+result_t rewers_correction_ctx(const calibration_context_t* context, float* newPosition)
+{
+	if (!calibration_context_valid(context))
+		return 0;
+	if (context->table != NULL)
+		*newPosition = (float)correction_inverse(context->table, *newPosition);
+	return 1;
+}
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+result_t XIMC_API normal_to_calb_array(device_t id, const int* steps, const int* usteps, float* values, int count,
+		const calibration_t* calibration)
+{
+	calibration_context_t context;
+	result_t result;
+	int i;
+
+	if (steps == NULL || values == NULL || count < 0)
+		return result_value_error;
+	if ((result = calibration_context_init(id, calibration, &context, 0)) != result_ok)
+		return result;
+
+	steps_to_units(steps, usteps, values, count, context.A, context.microstep_scale);
+	if (context.table != NULL)
+		for (i = 0; i < count; ++i)
+			values[i] = (float)correction_inverse(context.table, values[i]);
+	return result_ok;
+}
+
+result_t XIMC_API calb_to_normal_array(device_t id, const float* values, int* steps, int* usteps, int count,
+		const calibration_t* calibration)
+{
+	calibration_context_t context;
+	float corrected[CALB_BLOCK_SIZE];
+	result_t result;
+	int i, j, block;
+
+	if (steps == NULL || values == NULL || count < 0)
+		return result_value_error;
+	if ((result = calibration_context_init(id, calibration, &context, 0)) != result_ok)
+		return result;
+
+	if (context.table == NULL)
+	{
+		units_to_steps(values, steps, usteps, count, context.A, context.microstep_divisor);
+		return result_ok;
+	}
+	for (i = 0; i < count; i += block)
+	{
+		block = count - i < CALB_BLOCK_SIZE ? count - i : CALB_BLOCK_SIZE;
+		for (j = 0; j < block; ++j)
+			corrected[j] = (float)correction_forward(context.table, values[i + j]);
+		units_to_steps(corrected, steps + i, usteps != NULL ? usteps + i : NULL, block,
+				context.A, context.microstep_divisor);
+	}
+	return result_ok;
+}
+
+result_t XIMC_API create_calibration_context(device_t id, const calibration_t* calibration, calibration_context_t** context)
+{
+	result_t result;
+
+	if (context == NULL)
+		return result_value_error;
+	if ((*context = (calibration_context_t*)malloc(sizeof(calibration_context_t))) == NULL)
+		return result_error;
+	if ((result = calibration_context_init(id, calibration, *context, 1)) != result_ok)
+	{
+		free(*context);
+		*context = NULL;
+	}
+	return result;
+}
+
+result_t XIMC_API free_calibration_context(calibration_context_t* context)
+{
+	if (context == NULL)
+		return result_ok;
+	correction_table_release(context->table);
+	free(context);
+	return result_ok;
+}
+
+#if defined(__cplusplus)
+};
+#endif
+
+// vim: syntax=c tabstop=4 shiftwidth=4
@@ -0,0 +1,788 @@
+#include "common.h"
+
+#include "ximc.h"
+#include "util.h"
+#include "metadata.h"
+#include "platform.h"
+#include "protosup.h"
+
+#include <locale.h>
+
+/*
+ * Position correction tables.
+ *
+ * A table maps user coordinate X to controller coordinate Y = X + dX with piecewise linear
+ * dX between the grid points and constant dX beyond the ends. Both X and Y are strictly
+ * increasing, so the mapping is invertible.
+ *
+ * Cubic tables interpolate Y with a monotone cubic Hermite spline: spline slopes limited to
+ * the Fritsch-Carlson monotonicity region, so Y stays increasing between the points and the
+ * inverse is found by safeguarded Newton iterations inside one segment.
+ *
+ * At build time every segment gets its slope in both directions and every axis gets a
+ * uniform bucket index: bucket b holds the segment which contains the bucket start, so the
+ * segments of bucket b lie between index[b] and index[b + 1]. Buckets are not wider than the
+ * narrowest segment unless that takes more than CORRECTION_INDEX_RATIO buckets per point.
+ * A lookup is one multiplication and a binary search among the segments of one bucket: one
+ * step on a near-uniform grid, a logarithm of the points of a bucket on a clustered one.
+ */
+
+/* Upper bound of index buckets per table point */
+#define CORRECTION_INDEX_RATIO 8
+
+/* Newton steps fall back to bisection, so this also bounds the bisection depth */
+#define CORRECTION_INVERSE_ITERATIONS 64
+
+/*
+ * Binary table file is the header followed by the table arrays exactly as they are laid
+ * out in memory, so a loaded file is used in place once it is copied to memory.
+ * Numbers are stored in native byte order, a file with foreign byte order fails the version check.
+ */
+#define CORRECTION_FILE_MAGIC "XICT"
+#define CORRECTION_FILE_VERSION 1
+
+typedef struct correction_file_header_t
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t length;
+	uint32_t forward_buckets;
+	uint32_t inverse_buckets;
+	uint32_t interpolation;
+	double forward_origin;
+	double forward_scale;
+	double inverse_origin;
+	double inverse_scale;
+} correction_file_header_t;
+
+/* Tables loaded from files, linked through next_shared and guarded by the metadata lock */
+static correction_table_t* shared_tables = NULL;
+
+/* Size of X, dX, Y, both slopes, cubic coefficients and both indexes */
+static size_t correction_arrays_size(uint32_t length, uint32_t x_buckets, uint32_t y_buckets,
+		correction_interpolation_t interpolation)
+{
+	size_t doubles = interpolation == correction_interpolation_cubic ? 8 : 5;
+	return doubles * length * sizeof(double) + ((size_t)x_buckets + y_buckets) * sizeof(uint32_t);
+}
+
+/* Points table arrays to the block of correction_arrays_size bytes */
+static void correction_attach_arrays(correction_table_t* table, void* arrays)
+{
+	double* end;
+
+	table->X = (double*)arrays;
+	table->dX = table->X + table->length;
+	table->Y = table->dX + table->length;
+	table->forward_slope = table->Y + table->length;
+	table->inverse_slope = table->forward_slope + table->length;
+	end = table->inverse_slope + table->length;
+	table->cubic = NULL;
+	if (table->interpolation == correction_interpolation_cubic)
+	{
+		table->cubic = end;
+		end += 3 * (size_t)table->length;
+	}
+	table->forward.index = (uint32_t*)end;
+	table->inverse.index = table->forward.index + table->forward.buckets;
+}
+
+static void correction_init_shared(correction_table_t* table)
+{
+	table->refcount = 1;
+	table->source = NULL;
+	table->source_size = 0;
+	table->source_hash = 0;
+	table->next_shared = NULL;
+}
+
+/* Slope at x0 of the polynomial through (x0, y0)...(x3, y3) given by secants d01, d12, d23, x3 may be absent */
+static double correction_end_slope(const double* x, double d01, double d12, double d23, int points)
+{
+	double f012 = (d12 - d01) / (x[2] - x[0]), f123;
+	double slope = d01 + f012 * (x[0] - x[1]);
+
+	if (points > 3)
+	{
+		f123 = (d23 - d12) / (x[3] - x[1]);
+		slope += (f123 - f012) / (x[3] - x[0]) * (x[0] - x[1]) * (x[0] - x[2]);
+	}
+	return slope;
+}
+
+/*
+ * Fills cubic coefficients of every segment: Y = Y[i] + t * (c[0] + t * (c[1] + t * c[2])), t = x - X[i].
+ * Slopes at the points are those of the C2 cubic spline with end slopes of the end cubics,
+ * then every slope is limited to [0, 3 * adjacent secant] (Fritsch-Carlson monotonicity region).
+ * Secants are positive because Y is increasing, so the limits do not change smooth data.
+ */
+static void correction_build_cubic(correction_table_t* table)
+{
+	const double *X = table->X, *Y = table->Y;
+	double* c = table->cubic;
+	double h0, h1, d0, d1, m0, m1, denominator, ends[4];
+	uint32_t i, n = table->length;
+
+#define SECANT(i) ((Y[(i) + 1] - Y[i]) / (X[(i) + 1] - X[i]))
+	/* slopes go to c[3 * i], elimination factors of the tridiagonal system to c[3 * i + 1] and c[3 * i + 2] */
+	if (n == 2)
+		c[0] = c[3] = SECANT(0);
+	else
+	{
+		c[0] = correction_end_slope(X, SECANT(0), SECANT(1), n > 3 ? SECANT(2) : 0, n > 3 ? 4 : 3);
+		for (i = 0; i < 4 && i < n; ++i)
+			ends[i] = X[n - 1 - i];
+		c[3 * (n - 1)] = correction_end_slope(ends, SECANT(n - 2), SECANT(n - 3), n > 3 ? SECANT(n - 4) : 0, n > 3 ? 4 : 3);
+
+		/* h1 m[i-1] + 2 (h0 + h1) m[i] + h0 m[i+1] = 3 (h1 d0 + h0 d1) for interior points */
+		c[1] = c[2] = 0;
+		for (i = 1; i + 1 < n; ++i)
+		{
+			h0 = X[i] - X[i - 1];
+			h1 = X[i + 1] - X[i];
+			d0 = SECANT(i - 1);
+			d1 = SECANT(i);
+			m0 = 3 * (h1 * d0 + h0 * d1) - (i == 1 ? h1 * c[0] : 0);
+			denominator = 2 * (h0 + h1) - (i == 1 ? 0 : h1 * c[3 * (i - 1) + 1]);
+			c[3 * i + 1] = h0 / denominator;
+			c[3 * i + 2] = (m0 - (i == 1 ? 0 : h1 * c[3 * (i - 1) + 2])) / denominator;
+		}
+		for (i = n - 2; i > 0; --i)
+			c[3 * i] = c[3 * i + 2] - c[3 * i + 1] * c[3 * (i + 1)];
+	}
+
+	for (i = 0; i < n; ++i)
+	{
+		d0 = i > 0 ? SECANT(i - 1) : SECANT(i);
+		d1 = i + 1 < n ? SECANT(i) : d0;
+		m1 = 3 * (d0 < d1 ? d0 : d1);
+		if (c[3 * i] < 0)
+			c[3 * i] = 0;
+		else if (c[3 * i] > m1)
+			c[3 * i] = m1;
+	}
+
+	for (i = 0; i + 1 < n; ++i)
+	{
+		h0 = X[i + 1] - X[i];
+		d0 = SECANT(i);
+		m0 = c[3 * i];
+		m1 = c[3 * (i + 1)];
+		c[3 * i + 1] = (3 * d0 - 2 * m0 - m1) / h0;
+		c[3 * i + 2] = (m0 + m1 - 2 * d0) / (h0 * h0);
+	}
+	c[3 * (n - 1) + 1] = c[3 * (n - 1) + 2] = 0;
+#undef SECANT
+}
+
+static void correction_build_index(correction_axis_t* axis, const double* values, uint32_t length)
+{
+	uint32_t b, i = 0;
+	double start;
+
+	for (b = 0; b < axis->buckets; ++b)
+	{
+		start = axis->origin + b / axis->scale;
+		while (i < length - 2 && values[i + 1] <= start)
+			++i;
+		axis->index[b] = i;
+	}
+}
+
+/* Counts index buckets for the axis X + dX, dX may be NULL */
+static uint32_t correction_bucket_count(const double* X, const double* dX, uint32_t length)
+{
+	double span, step, min_step, buckets;
+	uint32_t i;
+
+#define AXIS_VALUE(i) (X[i] + (dX ? dX[i] : 0))
+	span = min_step = AXIS_VALUE(length - 1) - AXIS_VALUE(0);
+	for (i = 0; i + 1 < length; ++i)
+	{
+		step = AXIS_VALUE(i + 1) - AXIS_VALUE(i);
+		if (step < min_step)
+			min_step = step;
+	}
+#undef AXIS_VALUE
+	buckets = span / min_step + 1;
+	if (buckets > (double)(length - 1) * CORRECTION_INDEX_RATIO)
+		buckets = (double)(length - 1) * CORRECTION_INDEX_RATIO;
+	if (buckets < length - 1)
+		buckets = length - 1;
+	return (uint32_t)buckets;
+}
+
+static void correction_init_axis(correction_axis_t* axis, const double* values, uint32_t length, uint32_t buckets)
+{
+	axis->origin = values[0];
+	axis->buckets = buckets;
+	axis->scale = buckets / (values[length - 1] - values[0]);
+}
+
+correction_table_t* correction_table_create(const double* X, const double* dX, uint32_t length,
+		correction_interpolation_t interpolation)
+{
+	correction_table_t* table;
+	uint32_t i, x_buckets, y_buckets;
+
+	if (length < 2)
+	{
+		log_error(L"error little data");
+		return NULL;
+	}
+	for (i = 1; i < length; ++i)
+	{
+		if (X[i] - X[i - 1] <= 0 || (X[i] + dX[i]) - (X[i - 1] + dX[i - 1]) <= 0)
+		{
+			log_error(L"error the data in the table is not monotonous.");
+			return NULL;
+		}
+	}
+
+	/* table header, five double arrays and both indexes in one block */
+	x_buckets = correction_bucket_count(X, NULL, length);
+	y_buckets = correction_bucket_count(X, dX, length);
+	if ((table = (correction_table_t*)malloc(sizeof(correction_table_t) + correction_arrays_size(length, x_buckets, y_buckets, interpolation))) == NULL)
+	{
+		log_error(L"can't allocate correction table of %u points", length);
+		return NULL;
+	}
+	correction_init_shared(table);
+	table->length = length;
+	table->interpolation = interpolation;
+	table->forward.buckets = x_buckets;
+	correction_attach_arrays(table, table + 1);
+	for (i = 0; i < length; ++i)
+	{
+		table->X[i] = X[i];
+		table->dX[i] = dX[i];
+		table->Y[i] = X[i] + dX[i];
+	}
+
+	for (i = 0; i + 1 < length; ++i)
+	{
+		table->forward_slope[i] = (table->dX[i + 1] - table->dX[i]) / (table->X[i + 1] - table->X[i]);
+		table->inverse_slope[i] = (table->X[i + 1] - table->X[i]) / (table->Y[i + 1] - table->Y[i]);
+	}
+	table->forward_slope[length - 1] = 0;
+	table->inverse_slope[length - 1] = 1;
+	if (table->cubic != NULL)
+		correction_build_cubic(table);
+
+	correction_init_axis(&table->forward, table->X, length, x_buckets);
+	correction_init_axis(&table->inverse, table->Y, length, y_buckets);
+	correction_build_index(&table->forward, table->X, length);
+	correction_build_index(&table->inverse, table->Y, length);
+	return table;
+}
+
+correction_table_t* correction_table_retain(correction_table_t* table)
+{
+	if (table != NULL)
+	{
+		lock_metadata();
+		++table->refcount;
+		unlock_metadata();
+	}
+	return table;
+}
+
+correction_table_t* correction_table_retain_device(device_metadata_t* dm)
+{
+	correction_table_t* table;
+
+	/* the device may replace its table concurrently */
+	lock_metadata();
+	if ((table = dm->table) != NULL)
+		++table->refcount;
+	unlock_metadata();
+	return table;
+}
+
+void correction_table_release(correction_table_t* table)
+{
+	correction_table_t** link;
+	int refcount;
+
+	if (table == NULL)
+		return;
+	lock_metadata();
+	if ((refcount = --table->refcount) == 0)
+	{
+		for (link = &shared_tables; *link != NULL; link = &(*link)->next_shared)
+		{
+			if (*link == table)
+			{
+				*link = table->next_shared;
+				break;
+			}
+		}
+	}
+	unlock_metadata();
+	if (refcount == 0)
+	{
+		free(table->source);
+		free(table);
+	}
+}
+
+/* Returns a segment which contains value, value must be inside the axis range */
+static uint32_t correction_find_segment(const correction_axis_t* axis, const double* values, uint32_t length, double value)
+{
+	double pos = (value - axis->origin) * axis->scale;
+	uint32_t b = pos <= 0 ? 0 : (pos >= axis->buckets ? axis->buckets - 1 : (uint32_t)pos);
+	uint32_t lo = axis->index[b], hi = b + 1 < axis->buckets ? axis->index[b + 1] : length - 2, mid;
+
+	/* rounding of the bucket position may miss the bucket by one segment */
+	if (lo > 0 && values[lo] > value)
+		--lo;
+	if (hi < length - 2 && values[hi + 1] <= value)
+		++hi;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo + 1) / 2;
+		if (values[mid] <= value)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+double correction_forward(const correction_table_t* table, double x)
+{
+	uint32_t i;
+
+	if (x <= table->X[0])
+		return x + table->dX[0];
+	if (x >= table->X[table->length - 1])
+		return x + table->dX[table->length - 1];
+	i = correction_find_segment(&table->forward, table->X, table->length, x);
+	if (table->cubic != NULL)
+	{
+		const double* c = table->cubic + 3 * (size_t)i;
+		double t = x - table->X[i];
+		return table->Y[i] + t * (c[0] + t * (c[1] + t * c[2]));
+	}
+	return x + table->dX[i] + table->forward_slope[i] * (x - table->X[i]);
+}
+
+/* Solves cubic Y(x) = y in segment i, Newton steps which leave the bracket are replaced by bisection */
+static double correction_cubic_inverse(const correction_table_t* table, uint32_t i, double y)
+{
+	const double* c = table->cubic + 3 * (size_t)i;
+	double lo = 0, hi = table->X[i + 1] - table->X[i];
+	double target = y - table->Y[i], tolerance = hi * 1e-15;
+	double t, f, df, step;
+	int n;
+
+	/* the linear inverse is a close first guess */
+	t = target * table->inverse_slope[i];
+	for (n = 0; n < CORRECTION_INVERSE_ITERATIONS && hi - lo > tolerance; ++n)
+	{
+		f = t * (c[0] + t * (c[1] + t * c[2])) - target;
+		if (f == 0)
+			break;
+		if (f < 0)
+			lo = t;
+		else
+			hi = t;
+		df = c[0] + t * (2 * c[1] + 3 * t * c[2]);
+		step = df > 0 ? f / df : 0;
+		if (df > 0 && t - step > lo && t - step < hi)
+		{
+			t -= step;
+			if (step < tolerance && -step < tolerance)
+				break;
+		}
+		else
+			t = lo + (hi - lo) / 2;
+	}
+	return table->X[i] + t;
+}
+
+double correction_inverse(const correction_table_t* table, double y)
+{
+	uint32_t i;
+
+	if (y <= table->Y[0])
+		return y - table->dX[0];
+	if (y >= table->Y[table->length - 1])
+		return y - table->dX[table->length - 1];
+	i = correction_find_segment(&table->inverse, table->Y, table->length, y);
+	if (table->cubic != NULL)
+		return correction_cubic_inverse(table, i, y);
+	return table->X[i] + table->inverse_slope[i] * (y - table->Y[i]);
+}
+
+/*
+ * Text table loader
+ */
+
+static const double correction_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+ * Parses a decimal number with '.' separator regardless of the current locale.
+ * Returns the end of the number or NULL if there is no number at p.
+ * Numbers with up to 19 significant digits and decimal exponent within 22 are converted
+ * exactly with one operation, others fall back to strtod with the locale decimal point.
+ */
+static const char* parse_double(const char* p, const char* end, double* value)
+{
+	const char* start = p;
+	char buffer[128];
+	uint64_t mantissa = 0;
+	int digits = 0, significant = 0, exponent = 0, truncated = 0;
+	int exp_value = 0, exp_negative = 0, negative = 0;
+	size_t i;
+
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+	{
+		if (significant < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0)
+				++significant;
+		}
+		else
+		{
+			++exponent;
+			truncated |= *p != '0';
+		}
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+		{
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				--exponent;
+				if (mantissa != 0)
+					++significant;
+			}
+			else
+				truncated |= *p != '0';
+		}
+	}
+	if (digits == 0)
+		return NULL;
+	if (p + 1 < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		if (*e == '-' || *e == '+')
+			exp_negative = *e++ == '-';
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			for (p = e; p < end && *p >= '0' && *p <= '9'; ++p)
+				if (exp_value < 10000)
+					exp_value = exp_value * 10 + (*p - '0');
+			exponent += exp_negative ? -exp_value : exp_value;
+		}
+	}
+
+	if (!truncated && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
+	{
+		*value = exponent < 0 ? (double)mantissa / correction_pow10[-exponent] : (double)mantissa * correction_pow10[exponent];
+		if (negative)
+			*value = -*value;
+		return p;
+	}
+
+	/* rare long numbers, setlocale is process-wide so adapt the text to the locale instead */
+	if ((size_t)(p - start) >= sizeof(buffer))
+		return NULL;
+	for (i = 0; i < (size_t)(p - start); ++i)
+		buffer[i] = start[i] == '.' ? *localeconv()->decimal_point : start[i];
+	buffer[i] = 0;
+	*value = strtod(buffer, NULL);
+	return p;
+}
+
+/* Skips whitespace and then one token, returns NULL if there is no token */
+static const char* skip_token(const char* p, const char* end)
+{
+	while (p < end && is_space(*p))
+		++p;
+	if (p == end)
+		return NULL;
+	while (p < end && !is_space(*p))
+		++p;
+	return p;
+}
+
+static correction_table_t* correction_table_parse_text(const char* p, const char* end)
+{
+	correction_table_t* table = NULL;
+	double *X = NULL, *dX = NULL, *grown;
+	double values[2];
+	uint32_t count = 0, capacity = 0;
+	int column = 0;
+	correction_interpolation_t interpolation = correction_interpolation_linear;
+	const char* word;
+
+	/* column names */
+	if ((p = skip_token(p, end)) == NULL || (p = skip_token(p, end)) == NULL)
+	{
+		log_error(L"data error in calibration table file");
+		return NULL;
+	}
+	/* optional interpolation name after the column names, numbers never start with a letter */
+	for (word = p; word < end && is_space(*word); ++word)
+		;
+	if (word < end && ((*word >= 'a' && *word <= 'z') || (*word >= 'A' && *word <= 'Z')))
+	{
+		p = skip_token(word, end);
+		if (p - word == 6 && memcmp(word, "linear", 6) == 0)
+			interpolation = correction_interpolation_linear;
+		else if (p - word == 5 && memcmp(word, "cubic", 5) == 0)
+			interpolation = correction_interpolation_cubic;
+		else
+		{
+			log_error(L"unknown interpolation in calibration table file");
+			return NULL;
+		}
+	}
+
+	for (;;)
+	{
+		while (p < end && is_space(*p))
+			++p;
+		if (p == end)
+			break;
+		if ((p = parse_double(p, end, &values[column])) == NULL || (p < end && !is_space(*p)))
+		{
+			log_error(L"data error in calibration table file at row %u", count + 1);
+			goto cleanup;
+		}
+		if (++column < 2)
+			continue;
+		column = 0;
+		if (count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 128;
+			if ((grown = (double*)realloc(X, capacity * sizeof(double))) == NULL)
+				goto cleanup;
+			X = grown;
+			if ((grown = (double*)realloc(dX, capacity * sizeof(double))) == NULL)
+				goto cleanup;
+			dX = grown;
+		}
+		X[count] = values[0];
+		dX[count] = values[1];
+		++count;
+	}
+
+	if (column != 0)
+		log_error(L"data error in calibration table file at row %u", count + 1);
+	else
+		table = correction_table_create(X, dX, count, interpolation);
+cleanup:
+	free(X);
+	free(dX);
+	return table;
+}
+
+/*
+ * Binary table loader
+ */
+
+/* Lookups rely on monotonous axes and in-range non-decreasing index */
+static int correction_table_is_valid(const correction_table_t* table)
+{
+	uint32_t i;
+
+	for (i = 1; i < table->length; ++i)
+		if (!(table->X[i] > table->X[i - 1]) || !(table->Y[i] > table->Y[i - 1]))
+			return 0;
+	for (i = 0; i < table->forward.buckets; ++i)
+		if (table->forward.index[i] >= table->length - 1 || (i > 0 && table->forward.index[i] < table->forward.index[i - 1]))
+			return 0;
+	for (i = 0; i < table->inverse.buckets; ++i)
+		if (table->inverse.index[i] >= table->length - 1 || (i > 0 && table->inverse.index[i] < table->inverse.index[i - 1]))
+			return 0;
+	return 1;
+}
+
+/* Returns table using the file data in place, the caller passes ownership of data to the table */
+static correction_table_t* correction_table_from_binary(const void* data, size_t size)
+{
+	const correction_file_header_t* header = (const correction_file_header_t*)data;
+	correction_table_t* table;
+
+	if (size < sizeof(correction_file_header_t) ||
+		header->version != CORRECTION_FILE_VERSION ||
+		(header->interpolation != correction_interpolation_linear && header->interpolation != correction_interpolation_cubic) ||
+		header->length < 2 || header->forward_buckets == 0 || header->inverse_buckets == 0 ||
+		header->length > size / (5 * sizeof(double)) ||
+		header->forward_buckets > size / sizeof(uint32_t) || header->inverse_buckets > size / sizeof(uint32_t) ||
+		size - sizeof(correction_file_header_t) != correction_arrays_size(header->length, header->forward_buckets,
+			header->inverse_buckets, (correction_interpolation_t)header->interpolation) ||
+		!(header->forward_scale > 0) || !(header->inverse_scale > 0))
+	{
+		log_error(L"broken binary calibration table file");
+		return NULL;
+	}
+	if ((table = (correction_table_t*)malloc(sizeof(correction_table_t))) == NULL)
+		return NULL;
+	correction_init_shared(table);
+	table->length = header->length;
+	table->interpolation = (correction_interpolation_t)header->interpolation;
+	table->forward.origin = header->forward_origin;
+	table->forward.scale = header->forward_scale;
+	table->forward.buckets = header->forward_buckets;
+	table->inverse.origin = header->inverse_origin;
+	table->inverse.scale = header->inverse_scale;
+	table->inverse.buckets = header->inverse_buckets;
+	/* tables are never modified after they are built */
+	correction_attach_arrays(table, (void*)(header + 1));
+
+	if (!correction_table_is_valid(table))
+	{
+		log_error(L"broken binary calibration table file");
+		free(table);
+		return NULL;
+	}
+	return table;
+}
+
+result_t correction_table_save(const correction_table_t* table, const char* namefile)
+{
+	correction_file_header_t header;
+	size_t size;
+	FILE* fp;
+	int ok;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CORRECTION_FILE_MAGIC, sizeof(header.magic));
+	header.version = CORRECTION_FILE_VERSION;
+	header.length = table->length;
+	header.forward_buckets = table->forward.buckets;
+	header.inverse_buckets = table->inverse.buckets;
+	header.interpolation = table->interpolation;
+	header.forward_origin = table->forward.origin;
+	header.forward_scale = table->forward.scale;
+	header.inverse_origin = table->inverse.origin;
+	header.inverse_scale = table->inverse.scale;
+	size = correction_arrays_size(table->length, table->forward.buckets, table->inverse.buckets, table->interpolation);
+
+	if ((fp = fopen(namefile, "wb")) == NULL)
+	{
+		log_system_error(L"can't create calibration table file %hs due to ", namefile);
+		return result_error;
+	}
+	/* arrays are contiguous starting from X */
+	ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(table->X, size, 1, fp) == 1;
+	if (fclose(fp) != 0 || !ok)
+	{
+		log_system_error(L"can't write calibration table file %hs due to ", namefile);
+		return result_error;
+	}
+	return result_ok;
+}
+
+/*
+ * Shared loader
+ */
+
+/* FNV-1a */
+static uint64_t correction_hash(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (size--)
+		hash = (hash ^ *p++) * 0x100000001b3ULL;
+	return hash;
+}
+
+/* Finds and retains a table loaded from an equal file, must be called under the metadata lock */
+static correction_table_t* correction_find_shared(const void* data, size_t size, uint64_t hash)
+{
+	correction_table_t* table;
+
+	for (table = shared_tables; table != NULL; table = table->next_shared)
+	{
+		if (table->source_size == size && table->source_hash == hash && memcmp(table->source, data, size) == 0)
+		{
+			++table->refcount;
+			return table;
+		}
+	}
+	return NULL;
+}
+
+correction_table_t* correction_table_load(const char* namefile)
+{
+	correction_table_t *table, *shared;
+	file_mapping_t* mapping;
+	const void* mapped;
+	void* data;
+	size_t size;
+	uint64_t hash;
+
+	if ((mapping = map_file(namefile, &mapped, &size)) == NULL)
+	{
+		log_error(L"error opening calibration table file");
+		return NULL;
+	}
+	/* the file may be rewritten while the table is in use, so it is not used through the mapping */
+	data = malloc(size);
+	if (data != NULL)
+		memcpy(data, mapped, size);
+	unmap_file(mapping);
+	if (data == NULL)
+		return NULL;
+
+	/* a rack of equal stages loads equal files, parse only the first one */
+	hash = correction_hash(data, size);
+	lock_metadata();
+	shared = correction_find_shared(data, size, hash);
+	unlock_metadata();
+	if (shared != NULL)
+	{
+		free(data);
+		return shared;
+	}
+
+	if (size >= sizeof(CORRECTION_FILE_MAGIC) - 1 && memcmp(data, CORRECTION_FILE_MAGIC, sizeof(CORRECTION_FILE_MAGIC) - 1) == 0)
+		table = correction_table_from_binary(data, size);
+	else
+		table = correction_table_parse_text((const char*)data, (const char*)data + size);
+	if (table == NULL)
+	{
+		free(data);
+		return NULL;
+	}
+
+	/* the copy is kept for comparison with other files */
+	table->source = data;
+	table->source_size = size;
+	table->source_hash = hash;
+	lock_metadata();
+	/* another thread may have loaded the same file meanwhile */
+	if ((shared = correction_find_shared(data, size, hash)) == NULL)
+	{
+		table->next_shared = shared_tables;
+		shared_tables = table;
+	}
+	unlock_metadata();
+	if (shared != NULL)
+	{
+		correction_table_release(table);
+		return shared;
+	}
+	return table;
+}
+
+// vim: syntax=c tabstop=4 shiftwidth=4
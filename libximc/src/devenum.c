@@ -184,14 +184,6 @@ void check_device_thread (void* arg)
 	ts->status = check_device_by_ximc_information( ts->name, ts->info, &ts->serial, ts->controller_name, ts->stage_name ) ? 1 : 0;
 }
 
-/* Network enumeration thread function */
-void network_enumerate_thread(void* arg)
-{
-	netthread_state_t* ts = (netthread_state_t*)arg;
-	ts->devices_found = enumerate_device_by_ximc_information(ts->addr, ts->adapter_addr, ts->pbuf);
-	ts->status = ts->devices_found ? 1 : 0;
-}
-
 /*
  * Launch device check threads
  * Remove non-passed device names from devenum
@@ -228,6 +220,7 @@ void launch_check_threads(device_enumeration_opaque_t* devenum)
 		if (tstates[i].status)
 		{
 			devenum->names[k] = tstates[i].name;
+			devenum->raw_names[k] = devenum->raw_names[i];
 			devenum->serials[k] = tstates[i].serial;
 			if (&devenum->infos[k] != tstates[i].info)
 				memcpy( &devenum->infos[k], tstates[i].info, sizeof(device_information_t) );
@@ -243,45 +236,260 @@ void launch_check_threads(device_enumeration_opaque_t* devenum)
 }
 
 /*
-* Launch network enumerate threads
-*/
-XIMC_RETTYPE XIMC_CALLCONV launch_network_enumerate_threads(void* arg)
+ * Enumeration storage
+ */
+
+// initial capacity of an enumeration
+#define DEVENUM_INITIAL_COUNT 40
+
+// minimal size of a string arena chunk
+#define DEVENUM_ARENA_CHUNK_SIZE 4096
+
+// initial size of the interned strings hash set, a power of two
+#define DEVENUM_INTERNED_INITIAL_SIZE 128
+
+#define DEVENUM_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+/* Lays out per-device arrays for 'count' devices from 'base' and returns their total size.
+ * With NULL base only the size is computed. */
+size_t devenum_carve_arrays(device_enumeration_opaque_t* devenum, byte* base, int count)
 {
-	net_enum_t* net_enum = (net_enum_t*)arg;
-	/* Check all servers in threads */
-	netthread_state_t* tstates;
-	int i;
+	size_t offset = 0;
+#define DEVENUM_CARVE(field, type) \
+	if (base) devenum->field = (type*)(base + offset); \
+	offset = DEVENUM_ALIGN(offset + count*sizeof(type))
+
+	DEVENUM_CARVE(names, char*);
+	DEVENUM_CARVE(raw_names, char*);
+	DEVENUM_CARVE(dev_net_infos, device_network_information_t);
+	DEVENUM_CARVE(infos, device_information_t);
+	DEVENUM_CARVE(controller_names, controller_name_t);
+	DEVENUM_CARVE(stage_names, stage_name_t);
+	DEVENUM_CARVE(serials, uint32_t);
+#undef DEVENUM_CARVE
+	return offset;
+}
 
-	log_debug(L"asked to enum %d servers, launching check threads", net_enum->server_count);
+/* Copies 'count' entries of every per-device array */
+void devenum_copy_arrays(device_enumeration_opaque_t* dst, const device_enumeration_opaque_t* src, int count)
+{
+	memcpy( dst->names, src->names, count*sizeof(char*) );
+	memcpy( dst->raw_names, src->raw_names, count*sizeof(char*) );
+	memcpy( dst->dev_net_infos, src->dev_net_infos, count*sizeof(device_network_information_t) );
+	memcpy( dst->infos, src->infos, count*sizeof(device_information_t) );
+	memcpy( dst->controller_names, src->controller_names, count*sizeof(controller_name_t) );
+	memcpy( dst->stage_names, src->stage_names, count*sizeof(stage_name_t) );
+	memcpy( dst->serials, src->serials, count*sizeof(uint32_t) );
+}
 
-	tstates = (netthread_state_t*)malloc(net_enum->server_count * sizeof(netthread_state_t));
+/* Allocates or grows per-device arrays up to 'allocated_count' entries with one allocation */
+result_t devenum_grow(device_enumeration_opaque_t* devenum, int allocated_count)
+{
+	device_enumeration_opaque_t grown;
+	size_t size = devenum_carve_arrays( &grown, NULL, allocated_count );
+	byte* block = (byte*)malloc( size );
 
-	for (i = 0; i < net_enum->server_count; ++i)
+	if (!block)
+		return result_error;
+	memset( block, 0, size );
+	devenum_carve_arrays( &grown, block, allocated_count );
+	if (devenum->names)
 	{
-		log_info(L"launch thread %d to enumerate address %hs", i, net_enum->addrs[i]);
-		tstates[i].addr = net_enum->addrs[i];
-		tstates[i].adapter_addr = net_enum->adapter_addr;
-		tstates[i].pbuf = net_enum->pbufs[i];
-		tstates[i].status = 0;
-		tstates[i].devices_found = 0;
+		devenum_copy_arrays( &grown, devenum, devenum->count );
+		free( devenum->names );
 	}
+	devenum_carve_arrays( devenum, block, allocated_count );
+	devenum->allocated_count = allocated_count;
+	return result_ok;
+}
 
-	fork_join_with_timeout(network_enumerate_thread, net_enum->server_count, tstates, sizeof(netthread_state_t), DEFAULT_TIMEOUT_TIME, net_enum);
-	free(tstates);
-	return (XIMC_RETTYPE)0;
+/* Allocates an empty enumeration */
+device_enumeration_opaque_t* devenum_create(int flags)
+{
+	device_enumeration_opaque_t* devenum = (device_enumeration_opaque_t*)malloc( sizeof(device_enumeration_opaque_t) );
+	if (!devenum)
+		return NULL;
+	memset( devenum, 0, sizeof(device_enumeration_opaque_t) );
+	devenum->flags = flags;
+	if (devenum_grow( devenum, DEVENUM_INITIAL_COUNT ) != result_ok)
+	{
+		free( devenum );
+		return NULL;
+	}
+	return devenum;
+}
+
+/* Frees an enumeration which is not packed yet */
+void devenum_free_unpacked(device_enumeration_opaque_t* devenum)
+{
+	devenum_arena_chunk_t* chunk;
+	while ((chunk = devenum->arena) != NULL)
+	{
+		devenum->arena = chunk->next;
+		free( chunk );
+	}
+	free( devenum->interned );
+	free( devenum->servers );
+	free( devenum->names );
+	free( devenum );
+}
+
+/* FNV-1a hash of a string */
+static size_t devenum_hash(const char* str)
+{
+	uint32_t hash = 2166136261u;
+	while (*str)
+		hash = (hash ^ (uint8_t)*str++) * 16777619u;
+	return hash;
+}
+
+/* Slot of 'str' in the interned set, it is either empty or holds an equal string */
+static char** devenum_interned_slot(char** interned, size_t size, const char* str)
+{
+	size_t i = devenum_hash( str ) & (size - 1);
+	while (interned[i] && strcmp( interned[i], str ) != 0)
+		i = (i + 1) & (size - 1);
+	return &interned[i];
+}
+
+/* Keeps the interned set at most half full */
+static result_t devenum_interned_grow(device_enumeration_opaque_t* devenum)
+{
+	size_t size = devenum->interned_size ? devenum->interned_size * 2 : DEVENUM_INTERNED_INITIAL_SIZE;
+	char** interned;
+	size_t i;
+
+	if (devenum->interned && (devenum->interned_count + 1) * 2 <= devenum->interned_size)
+		return result_ok;
+	if ((interned = (char**)malloc( size * sizeof(char*) )) == NULL)
+		return result_error;
+	memset( interned, 0, size * sizeof(char*) );
+	for (i = 0; i < devenum->interned_size; ++i)
+		if (devenum->interned[i])
+			*devenum_interned_slot( interned, size, devenum->interned[i] ) = devenum->interned[i];
+	free( devenum->interned );
+	devenum->interned = interned;
+	devenum->interned_size = size;
+	return result_ok;
+}
+
+/* Returns a copy of 'str' from the arena, reusing an equal string already stored */
+char* devenum_intern(device_enumeration_opaque_t* devenum, const char* str)
+{
+	devenum_arena_chunk_t* chunk;
+	size_t len = strlen( str ) + 1;
+	char** slot;
+	char* copy;
+
+	if (devenum_interned_grow( devenum ) != result_ok)
+		return NULL;
+	slot = devenum_interned_slot( devenum->interned, devenum->interned_size, str );
+	if (*slot)
+		return *slot;
+
+	chunk = devenum->arena;
+	if (!chunk || chunk->size - chunk->used < len)
+	{
+		size_t size = len > DEVENUM_ARENA_CHUNK_SIZE ? len : DEVENUM_ARENA_CHUNK_SIZE;
+		chunk = (devenum_arena_chunk_t*)malloc( sizeof(devenum_arena_chunk_t) + size );
+		if (!chunk)
+			return NULL;
+		chunk->next = devenum->arena;
+		chunk->size = size;
+		chunk->used = 0;
+		devenum->arena = chunk;
+	}
+	copy = (char*)(chunk + 1) + chunk->used;
+	memcpy( copy, str, len );
+	chunk->used += len;
+	*slot = copy;
+	devenum->interned_count++;
+	return copy;
+}
+
+/* Appends a device, returns its index or -1 on allocation failure */
+int devenum_append(device_enumeration_opaque_t* devenum, const char* name, const char* raw_name)
+{
+	int index;
+
+	if (devenum->count >= devenum->allocated_count &&
+			devenum_grow( devenum, devenum->allocated_count + devenum->allocated_count/2 ) != result_ok)
+		return -1;
+	index = devenum->count;
+	if ((devenum->names[index] = devenum_intern( devenum, name )) == NULL)
+		return -1;
+	devenum->raw_names[index] = raw_name ? devenum_intern( devenum, raw_name ) : NULL;
+	++devenum->count;
+	return index;
+}
+
+/* Moves an interned string pointer to its copy in the packed block */
+static char* devenum_relocate(const device_enumeration_opaque_t* devenum, char** moved, char* str)
+{
+	return str ? moved[devenum_interned_slot( devenum->interned, devenum->interned_size, str ) - devenum->interned] : NULL;
 }
 
-void single_thread_wrapper_function(void* arg)
+/* Packs header, arrays and strings of an enumeration into one block.
+ * Interned strings stay shared. Frees the unpacked enumeration. */
+device_enumeration_opaque_t* devenum_pack(device_enumeration_opaque_t* devenum)
 {
-	net_enum_t* net_enum = (net_enum_t*)arg;
-	net_enum->mutex = mutex_init(0); // the nonce is unused on windows only
-	mutex_t *mutex = net_enum->mutex;
+	device_enumeration_opaque_t* packed;
+	size_t header_size, arrays_size, servers_size, strings_size = 0, len, s;
+	char** moved = NULL;
+	char* dst;
+	int i;
 
-	mutex_lock(mutex);
-	single_thread_launcher(launch_network_enumerate_threads, (void*)net_enum);
-	mutex_lock(mutex); // blocks this thread until enumerate controller thread unlocks the mutex after a timeout
-	mutex_unlock(mutex);
-	mutex_close(mutex);
+	/* every string is in the interned set once */
+	for (s = 0; s < devenum->interned_size; ++s)
+		if (devenum->interned[s])
+			strings_size += strlen( devenum->interned[s] ) + 1;
+
+	header_size = DEVENUM_ALIGN(sizeof(device_enumeration_opaque_t));
+	arrays_size = devenum_carve_arrays( devenum, NULL, devenum->count );
+	servers_size = DEVENUM_ALIGN(devenum->server_count * sizeof(devenum_server_t));
+	packed = (device_enumeration_opaque_t*)malloc( header_size + arrays_size + servers_size + strings_size );
+	if (devenum->interned_size)
+		moved = (char**)malloc( devenum->interned_size * sizeof(char*) );
+	if (!packed || (devenum->interned_size && !moved))
+	{
+		free( packed );
+		free( moved );
+		devenum_free_unpacked( devenum );
+		return NULL;
+	}
+	*packed = *devenum;
+	packed->allocated_count = packed->count;
+	packed->arena = NULL;
+	packed->interned = NULL;
+	packed->interned_size = packed->interned_count = 0;
+	devenum_carve_arrays( packed, (byte*)packed + header_size, packed->count );
+	devenum_copy_arrays( packed, devenum, packed->count );
+	packed->servers = (devenum_server_t*)((byte*)packed + header_size + arrays_size);
+	if (packed->server_count)
+		memcpy( packed->servers, devenum->servers, packed->server_count * sizeof(devenum_server_t) );
+
+	/* copy each string once, then redirect its users through its slot in the interned set */
+	dst = (char*)packed + header_size + arrays_size + servers_size;
+	for (s = 0; s < devenum->interned_size; ++s)
+	{
+		if (!devenum->interned[s])
+			continue;
+		len = strlen( devenum->interned[s] ) + 1;
+		memcpy( dst, devenum->interned[s], len );
+		moved[s] = dst;
+		dst += len;
+	}
+	for (i = 0; i < packed->count; ++i)
+	{
+		packed->names[i] = devenum_relocate( devenum, moved, packed->names[i] );
+		packed->raw_names[i] = devenum_relocate( devenum, moved, packed->raw_names[i] );
+	}
+	for (i = 0; i < packed->server_count; ++i)
+		packed->servers[i].addr = devenum_relocate( devenum, moved, packed->servers[i].addr );
+
+	free( moved );
+	devenum_free_unpacked( devenum );
+	return packed;
 }
 
 /* Concrete callback function that saves provided device name into enumerator */
@@ -289,8 +497,8 @@ void store_device_name (char* name, void* arg)
 {
 	device_enumeration_opaque_t* devenum = (device_enumeration_opaque_t*)arg;
 	int i;
-	size_t max_name_len = 4096;
-	char *encoded_name;
+	size_t uri_len;
+	char *encoded_name, *uri;
 
 	for (i = 0; i < devenum->count; ++i)
 	{
@@ -303,46 +511,32 @@ void store_device_name (char* name, void* arg)
 
 	log_debug( L"Storing port %hs", name );
 
-	if (devenum->count >= devenum->allocated_count)
-	{
-		devenum->allocated_count = (int)(devenum->allocated_count * 1.5);
-		devenum->names = (char**)realloc( devenum->names, devenum->allocated_count*sizeof(char*) );
-		devenum->raw_names = (char**)realloc( devenum->raw_names, devenum->allocated_count*sizeof(char*) );
-		devenum->serials = (uint32_t*)realloc( devenum->serials, devenum->allocated_count*sizeof(uint32_t) );
-		devenum->infos = (device_information_t*)realloc( devenum->infos, devenum->allocated_count*sizeof(device_information_t) );
-		devenum->controller_names = (controller_name_t*)realloc( devenum->controller_names, devenum->allocated_count*sizeof(controller_name_t) );
-		devenum->stage_names = (stage_name_t*)realloc( devenum->stage_names, devenum->allocated_count*sizeof(stage_name_t) );
-		devenum->dev_net_infos = (device_network_information_t*)realloc( devenum->dev_net_infos, devenum->allocated_count*sizeof(device_network_information_t) );
-	}
-
 	encoded_name = uri_copy(name);
-
-	devenum->names[devenum->count] = (char*)malloc(max_name_len);
-    if (*encoded_name && *encoded_name == '/')
+	uri_len = strlen(encoded_name) + sizeof("xi-com://");
+	uri = (char*)malloc(uri_len);
+	if (*encoded_name && *encoded_name == '/')
 	{
 		/* absolute path - make file:// uri, like xi-com:///dev/tty */
 		/* skip first slash for absolute pathes */
-		portable_snprintf(devenum->names[devenum->count], max_name_len-1, "xi-com://%s", encoded_name);
+		portable_snprintf(uri, uri_len, "xi-com://%s", encoded_name);
 	}
 	else
 	{
 		/* simple name - make uri with empty host and path component, like xi-com:///COM42
 		 * use instead more clear URI without hier path, like xi-com:COM42, xi-com:%5C%5C.%5CCOM42 */
-		portable_snprintf(devenum->names[devenum->count], max_name_len-1, "xi-com:%s", encoded_name);
+		portable_snprintf(uri, uri_len, "xi-com:%s", encoded_name);
 	}
-	devenum->names[devenum->count][max_name_len-1] = '\0';
-	devenum->raw_names[devenum->count] = portable_strdup( name );
+	if (devenum_append( devenum, uri, name ) == -1)
+		log_error( L"Cannot store port %hs", name );
+	free(uri);
 	free(encoded_name);
-	++devenum->count;
 }
 
-
 /* Concrete callback function that saves provided device name with some xi-prefix into enumerator */
 void store_device_name_with_xi_prefix(char* name, void* arg)
 {
 	device_enumeration_opaque_t* devenum = (device_enumeration_opaque_t*)arg;
 	int i;
-	size_t max_name_len = 4096;
 	char *encoded_name;
 
 	for (i = 0; i < devenum->count; ++i)
@@ -356,27 +550,10 @@ void store_device_name_with_xi_prefix(char* name, void* arg)
 
 	log_debug(L"Storing device uri %hs", name);
 
-	if (devenum->count >= devenum->allocated_count)
-	{
-		devenum->allocated_count = (int)(devenum->allocated_count * 1.5);
-		devenum->names = (char**)realloc(devenum->names, devenum->allocated_count*sizeof(char*));
-		devenum->raw_names = (char**)realloc(devenum->raw_names, devenum->allocated_count*sizeof(char*));
-		devenum->serials = (uint32_t*)realloc(devenum->serials, devenum->allocated_count*sizeof(uint32_t));
-		devenum->infos = (device_information_t*)realloc(devenum->infos, devenum->allocated_count*sizeof(device_information_t));
-		devenum->controller_names = (controller_name_t*)realloc(devenum->controller_names, devenum->allocated_count*sizeof(controller_name_t));
-		devenum->stage_names = (stage_name_t*)realloc(devenum->stage_names, devenum->allocated_count*sizeof(stage_name_t));
-		devenum->dev_net_infos = (device_network_information_t*)realloc(devenum->dev_net_infos, devenum->allocated_count*sizeof(device_network_information_t));
-	}
-
 	encoded_name = uri_copy(name);
-
-	devenum->names[devenum->count] = (char*)malloc(max_name_len);
-	portable_snprintf(devenum->names[devenum->count], max_name_len - 1, "%s", encoded_name);
-	
-	devenum->names[devenum->count][max_name_len - 1] = '\0';
-	devenum->raw_names[devenum->count] = portable_strdup(name);
+	if (devenum_append(devenum, encoded_name, name) == -1)
+		log_error(L"Cannot store device uri %hs", name);
 	free(encoded_name);
-	++devenum->count;
 }
 
 #ifdef HAVE_XIWRAPPER
@@ -506,6 +683,12 @@ result_t discover_ssdp_add_as_tcp(
 #ifdef _WIN32
     WSADATA wsaData;
 #endif
+    /* served from the listener cache without network roundtrip */
+    if (ssdp_listener_enumerate(callback, devenum) == result_ok)
+    {
+        return result_ok;
+    }
+
     strcpy(discover_ip, "xi-tcp://");
    
 #ifdef _WIN32
@@ -584,15 +767,260 @@ result_t enumerate_tcp_devices(
     return result_ok;
 }
 
+
+/*
+ * Network (bindy) enumeration.
+ * Every server is queried by its own detached thread because bindy queries are blocking.
+ * The caller waits until all servers have answered or the deadline has passed, whichever comes first.
+ * Threads that are late keep the shared state alive by reference count, the last owner frees it.
+ */
+
+typedef struct net_enum_t net_enum_t;
+
+typedef struct net_enum_server_t
+{
+	net_enum_t* net_enum;
+	char* addr;
+	uint8_t** pbuf;		// pointer to bindy buffer with device descriptions
+	int device_count;
+	int done;
+	uint64_t latency_us;
+} net_enum_server_t;
+
+struct net_enum_t
+{
+	mutex_t* mutex;
+	int refcount;
+	int pending;
+	uint64_t started_us;
+	char* adapter_addr;	// network adapter address (optional)
+	int server_count;
+	net_enum_server_t* servers;
+};
+
+/* Parses "addr" and "adapter_addr" hints. Returns NULL if there is nothing to query. */
+net_enum_t* net_enum_create(const char* hints)
+{
+	net_enum_t* net_enum;
+	char *addr, *ptr, *new_ptr;
+	int i, hint_length;
+
+	if (hints == NULL)
+	{
+		log_error(L"addr hints string is null");
+		return NULL; // null hints is fine too
+	}
+	get_addresses_from_hints_by_type(hints, "", &addr);
+	if (addr == NULL)
+	{
+		log_error(L"no \"addr\" substring in hints");
+		return NULL; // empty hints string is not a critical error
+	}
+
+	net_enum = (net_enum_t*)malloc(sizeof(net_enum_t));
+	memset(net_enum, 0, sizeof(net_enum_t));
+	if ((net_enum->mutex = mutex_init(0)) == NULL) // the nonce is unused on windows only
+	{
+		free(addr);
+		free(net_enum);
+		return NULL;
+	}
+
+	hint_length = (int)strlen(hints);
+	net_enum->adapter_addr = (char*)malloc(hint_length + 1);
+	memset(net_enum->adapter_addr, 0, hint_length + 1);
+	find_key(hints, "adapter_addr", net_enum->adapter_addr, hint_length);
+
+	/* empty addr list means broadcast enumerate and it is one server too */
+	net_enum->server_count = 1;
+	for (ptr = addr; (ptr = strchr(ptr, ',')) != NULL; ++ptr)
+		net_enum->server_count++;
+	net_enum->servers = (net_enum_server_t*)malloc(net_enum->server_count * sizeof(net_enum_server_t));
+	memset(net_enum->servers, 0, net_enum->server_count * sizeof(net_enum_server_t));
+
+	for (i = 0, ptr = addr; i < net_enum->server_count; ++i, ptr = new_ptr + 1)
+	{
+		if ((new_ptr = strchr(ptr, ',')) != NULL)
+			*new_ptr = 0;
+		net_enum->servers[i].net_enum = net_enum;
+		net_enum->servers[i].addr = portable_strdup(ptr);
+		net_enum->servers[i].pbuf = (uint8_t**)malloc(sizeof(uint8_t*));  // allocation for pointer to buffer, not the buffer itself
+		*(net_enum->servers[i].pbuf) = NULL;
+		if (new_ptr == NULL)
+			break;
+	}
+	free(addr);
+
+	/* the caller holds one reference */
+	net_enum->refcount = 1;
+	return net_enum;
+}
+
+/* Drops one reference to the shared state and frees it with the last one */
+void net_enum_release(net_enum_t* net_enum)
+{
+	int i, refcount;
+
+	mutex_lock(net_enum->mutex);
+	refcount = --net_enum->refcount;
+	mutex_unlock(net_enum->mutex);
+	if (refcount > 0)
+		return;
+
+	for (i = 0; i < net_enum->server_count; ++i)
+	{
+		if (net_enum->servers[i].pbuf != NULL)
+			bindy_free(net_enum->servers[i].pbuf); // free the buffer allocations
+		free(net_enum->servers[i].addr);
+	}
+	free(net_enum->servers);
+	free(net_enum->adapter_addr);
+	mutex_close(net_enum->mutex);
+	free(net_enum);
+}
+
+/* Network enumeration thread function */
+XIMC_RETTYPE XIMC_CALLCONV network_enumerate_thread(void* arg)
+{
+	net_enum_server_t* server = (net_enum_server_t*)arg;
+	net_enum_t* net_enum = server->net_enum;
+	uint8_t* buf = NULL;
+	int devices_found;
+	uint64_t now;
+
+	devices_found = enumerate_device_by_ximc_information(server->addr, net_enum->adapter_addr, &buf);
+	get_wallclock_us(&now);
+
+	mutex_lock(net_enum->mutex);
+	*(server->pbuf) = buf;
+	server->device_count = devices_found > 0 ? devices_found : 0;
+	server->latency_us = now - net_enum->started_us;
+	server->done = 1;
+	net_enum->pending--;
+	mutex_unlock(net_enum->mutex);
+
+	net_enum_release(net_enum);
+	return (XIMC_RETTYPE)0;
+}
+
+/* Sends all queries at once, does not wait for answers */
+void net_enum_launch(net_enum_t* net_enum)
+{
+	int i;
+
+	log_debug(L"asked to enum %d servers", net_enum->server_count);
+	get_wallclock_us(&net_enum->started_us);
+	for (i = 0; i < net_enum->server_count; ++i)
+	{
+		log_info(L"launch thread %d to enumerate address %hs", i, net_enum->servers[i].addr);
+		mutex_lock(net_enum->mutex);
+		net_enum->refcount++;
+		net_enum->pending++;
+		mutex_unlock(net_enum->mutex);
+		if (single_thread_launcher(network_enumerate_thread, &net_enum->servers[i]) != result_ok)
+		{
+			mutex_lock(net_enum->mutex);
+			net_enum->refcount--;
+			net_enum->pending--;
+			mutex_unlock(net_enum->mutex);
+		}
+	}
+}
+
+/* Waits until every server answers or the timeout passes since launch */
+void net_enum_wait(net_enum_t* net_enum, int timeout_ms)
+{
+	uint64_t now, deadline;
+	int pending;
+
+	deadline = net_enum->started_us + (uint64_t)timeout_ms * 1000;
+	for (;;)
+	{
+		mutex_lock(net_enum->mutex);
+		pending = net_enum->pending;
+		mutex_unlock(net_enum->mutex);
+		get_wallclock_us(&now);
+		if (pending == 0 || now >= deadline)
+			break;
+		msec_sleep(SLEEP_WAIT_TIME);
+	}
+	if (pending)
+		log_info(L"Timed out waiting for %d of %d network servers", pending, net_enum->server_count);
+}
+
+/* Moves descriptions of devices from servers answered in time into devenum */
+void net_enum_collect(net_enum_t* net_enum, device_enumeration_opaque_t* devenum)
+{
+	device_description desc;
+	net_enum_server_t* server;
+	char name[64];
+	uint8_t *ip_bytes;
+	int i, s, index;
+
+	/* answers of the servers are kept for get_enumerate_server_latency */
+	devenum->servers = (devenum_server_t*)malloc(net_enum->server_count * sizeof(devenum_server_t));
+	mutex_lock(net_enum->mutex);
+	for (s = 0; s < net_enum->server_count; ++s)
+	{
+		server = &net_enum->servers[s];
+		if (devenum->servers && (devenum->servers[devenum->server_count].addr = devenum_intern(devenum, server->addr)) != NULL)
+		{
+			devenum->servers[devenum->server_count].answered = server->done;
+			devenum->servers[devenum->server_count].latency_us = server->done ? (uint32_t)server->latency_us : 0;
+			devenum->server_count++;
+		}
+		if (!server->done)
+		{
+			log_info(L"server %hs did not answer in time", server->addr);
+			continue;
+		}
+		log_info(L"server %hs answered in %d ms with %d devices", server->addr,
+			(int)(server->latency_us / 1000), server->device_count);
+		for (i = 0; i < server->device_count; ++i)
+		{
+			desc = *(((device_description*)*(server->pbuf)) + i);
+
+			/* compose name from IPv4 passed in host byte order */
+			ip_bytes = (uint8_t*)&desc.ipv4;
+			portable_snprintf(name, sizeof(name), "xi-net://%d.%d.%d.%d/%08X",
+				ip_bytes[0], ip_bytes[1], ip_bytes[2], ip_bytes[3], desc.serial);
+			if ((index = devenum_append(devenum, name, NULL)) == -1)
+				break;
+
+			devenum->serials[index] = desc.serial;
+
+			memcpy(devenum->infos[index].Manufacturer, &desc.my_device_information.Manufacturer, sizeof (desc.my_device_information.Manufacturer));
+			memcpy(devenum->infos[index].ManufacturerId, &desc.my_device_information.ManufacturerId, sizeof (desc.my_device_information.ManufacturerId));
+			memcpy(devenum->infos[index].ProductDescription, &desc.my_device_information.ProductDescription, sizeof (desc.my_device_information.ProductDescription));
+			devenum->infos[index].Major = desc.my_device_information.Major;
+			devenum->infos[index].Minor = desc.my_device_information.Minor;
+			devenum->infos[index].Release = desc.my_device_information.Release;
+
+			memcpy(devenum->controller_names[index].ControllerName, &desc.my_cname.ControllerName, sizeof (desc.my_cname.ControllerName));
+			devenum->controller_names[index].CtrlFlags = desc.my_cname.CtrlFlags;
+
+			memcpy(devenum->stage_names[index].PositionerName, &desc.my_sname.PositionerName, sizeof (desc.my_sname.PositionerName));
+
+			/* fill dev_net_info from passed structure */
+			memcpy(&devenum->dev_net_infos[index].ipv4, &desc.ipv4, sizeof(desc.ipv4));
+			memcpy(&devenum->dev_net_infos[index].nodename, &desc.nodename, sizeof(desc.nodename) - 1);
+			memcpy(&devenum->dev_net_infos[index].axis_state, &desc.axis_state, sizeof(desc.axis_state));
+			memcpy(&devenum->dev_net_infos[index].locker_username, &desc.locker_username, sizeof(desc.locker_username) - 1);
+			memcpy(&devenum->dev_net_infos[index].locker_nodename, &desc.locker_nodename, sizeof(desc.locker_nodename) - 1);
+			memcpy(&devenum->dev_net_infos[index].locked_time, &desc.locked_time, sizeof(desc.locked_time));
+		}
+	}
+	mutex_unlock(net_enum->mutex);
+}
+
 #endif 
 
-void enumerate_ssdp_launch_probe_thread(void *arg)
+/* Discovers devices by SSDP and probes all found devices if asked to */
+void enumerate_ssdp_and_probe(device_enumeration_opaque_t *devenum)
 {
-    device_enumeration_opaque_t *devenum;
     int enumerate_flags;
     int enumresult;
        
-    devenum = (device_enumeration_opaque_t *)arg;
     enumerate_flags = devenum->flags;
     if ((enumerate_flags & ENUMERATE_NETWORK) != 0)
     {
@@ -609,55 +1037,31 @@ void enumerate_ssdp_launch_probe_thread(void *arg)
 }
 
 
-void launch_ssdp_enum_netenum_threads(device_enumeration_opaque_t* devenum, net_enum_t * netenum)
-{
-    int enumerate_flags;
-    enumerate_flags = devenum->flags;
-
-    fork_join_2_threads(enumerate_ssdp_launch_probe_thread, devenum, 1,
-        single_thread_wrapper_function, netenum, (enumerate_flags & ENUMERATE_NETWORK) != 0
-        );
-
-}
-
 /* Enumerate devices main function */
 result_t enumerate_devices_impl(device_enumeration_opaque_t** device_enumeration, int enumerate_flags, const char *hints)
 {
 	device_enumeration_opaque_t* devenum;
-	device_description desc;
 	result_t enumresult;
-	char * addr;
-	size_t max_name_len = 4096;
-    net_enum_t net_enum;
+#ifdef HAVE_XIWRAPPER
+	net_enum_t* net_enum = NULL;
+#endif
 
 	/* ensure one-thread mutex init */
 	lock_metadata();
 	unlock_metadata();
 
 	/* alloc mem */
-	*device_enumeration = (device_enumeration_opaque_t*)malloc(sizeof(device_enumeration_opaque_t));
-	devenum = *device_enumeration;
-	devenum->flags = enumerate_flags;
-	devenum->count = 0;
-	devenum->allocated_count = 40;
-	devenum->names = (char**)malloc( devenum->allocated_count * sizeof(char*) );
-	devenum->raw_names = (char**)malloc( devenum->allocated_count * sizeof(char*) );
-	devenum->serials = (uint32_t*)malloc( devenum->allocated_count * sizeof(uint32_t) );
-	devenum->infos = (device_information_t*)malloc( devenum->allocated_count * sizeof(device_information_t) );
-	devenum->controller_names = (controller_name_t*)malloc( devenum->allocated_count * sizeof(controller_name_t) );
-	devenum->stage_names = (stage_name_t*)malloc( devenum->allocated_count * sizeof(stage_name_t) );
-	devenum->dev_net_infos = (device_network_information_t*)malloc( devenum->allocated_count * sizeof(device_network_information_t) );
-	memset( devenum->infos, 0, devenum->allocated_count * sizeof(device_information_t) );
-	memset( devenum->controller_names, 0, devenum->allocated_count * sizeof(controller_name_t) );
-	memset( devenum->stage_names, 0, devenum->allocated_count * sizeof(stage_name_t) );
-	memset( devenum->dev_net_infos, 0, devenum->allocated_count * sizeof(device_network_information_t) );
+	*device_enumeration = NULL;
+	devenum = devenum_create( enumerate_flags );
+	if (!devenum)
+		return result_error;
 
 	/* Call implementation-specific directory enumerator */
 	if (enumerate_devices_directory( store_device_name, devenum,
 				enumerate_flags ) != result_ok)
 	{
 		log_debug( L"enumerate_devices_directory failed" );
-		devenum->count = 0;
+		devenum_free_unpacked( devenum );
 		return result_error;
 	}
 
@@ -677,138 +1081,42 @@ result_t enumerate_devices_impl(device_enumeration_opaque_t** device_enumeration
         
 	}
 
-	
-    // prepare some data for network enumerate
-    if (enumerate_flags & ENUMERATE_NETWORK) {
+	/* send network queries first, they are answered while we do the rest */
+	if (enumerate_flags & ENUMERATE_NETWORK)
+	{
 #ifdef HAVE_XIWRAPPER
-        if (!bindy_init()) {
-            log_error(L"network layer init failed");
-            return result_error;
-        }
-
-        char* adapter_addr;
-        if (hints == NULL) {
-            log_error(L"addr hints string is null");
-            return result_ok; // null hints is fine too
-        }
-        else
-        {
-            get_addresses_from_hints_by_type(hints, "", &addr);
-            if (addr == NULL) {
-                log_error(L"no \"addr\" substring in hints");
-                return result_ok; // empty hints string is not a critical error
-            }
-            int hint_length = (int)strlen(hints);
-            adapter_addr = malloc(hint_length + 1);
-            memset(adapter_addr, 0, hint_length + 1);
-            find_key(hints, "adapter_addr", adapter_addr, hint_length);
-        }
-
-        const char* delim = ",";
-        int items = 0;
-        if (strlen(addr) == 0)
-        { // broadcast enumerate
-            items = 1;
-        }
-        else
-        {
-            char *ptr = addr;
-            while (ptr != NULL) { // exit when no new item is found in strchr() function
-                items++;
-                ptr = strchr(ptr, ','); // Find location of the next comma or get NULL instead
-                if (ptr != NULL) { // NULL means there is no commas left and we must quit
-                    ptr++; // Continue with string after the comma
-                }
-            }
-        }
-
-        net_enum.server_count = items;
-        net_enum.device_count = (int*)malloc(sizeof (int)* items);
-        net_enum.addrs = (char**)malloc(sizeof (char*)* items);
-        net_enum.pbufs = (uint8_t***)malloc(sizeof(uint8_t**)* items);
-        net_enum.adapter_addr = adapter_addr;
-
-        if (strlen(addr) == 0) { // broadcast enumerate
-            net_enum.addrs[0] = addr;
-            net_enum.pbufs[0] = (uint8_t**)malloc(sizeof(uint8_t*));  // allocation for pointer to buffer, not the buffer itself
-            *(net_enum.pbufs[0]) = NULL;
-            net_enum.device_count[0] = 0;
-        }
-        else {
-            char* token = strtok(addr, delim);
-            int i = 0;
-            while (i < items) {
-                net_enum.addrs[i] = token;
-                net_enum.pbufs[i] = (uint8_t**)malloc(sizeof(uint8_t*));  // allocation for pointer to buffer, not the buffer itself
-                *(net_enum.pbufs[i]) = NULL;
-                net_enum.device_count[i] = 0;
-                i++;
-                token = strtok(NULL, delim);
-            }
-        }
-    }
-    
-    launch_ssdp_enum_netenum_threads(devenum, &net_enum);
-
-    if (enumerate_flags & ENUMERATE_NETWORK) {
-        //log_info( L"libximc found %d network devices", devices );
-        int server;
-        for (server = 0; server < net_enum.server_count; server++) {
-            if (net_enum.device_count[server] > 0) {
-                int i;
-                for (i = 0; i < net_enum.device_count[server]; ++i) {
-                    if (devenum->count < devenum->allocated_count) {
-                        desc = *(((device_description*)*(net_enum.pbufs[server])) + i);
-                        devenum->serials[devenum->count] = desc.serial;
-
-                        memcpy(devenum->infos[devenum->count].Manufacturer, &desc.my_device_information.Manufacturer, sizeof (desc.my_device_information.Manufacturer));
-                        memcpy(devenum->infos[devenum->count].ManufacturerId, &desc.my_device_information.ManufacturerId, sizeof (desc.my_device_information.ManufacturerId));
-                        memcpy(devenum->infos[devenum->count].ProductDescription, &desc.my_device_information.ProductDescription, sizeof (desc.my_device_information.ProductDescription));
-                        devenum->infos[devenum->count].Major = desc.my_device_information.Major;
-                        devenum->infos[devenum->count].Minor = desc.my_device_information.Minor;
-                        devenum->infos[devenum->count].Release = desc.my_device_information.Release;
-
-                        /* compose name from IPv4 passed in host byte order */
-                        devenum->names[devenum->count] = (char*)malloc(max_name_len);
-                        devenum->raw_names[devenum->count] = NULL;
-                        uint8_t *ip_bytes = (uint8_t*)&desc.ipv4;
-                        portable_snprintf(devenum->names[devenum->count], max_name_len - 1, "xi-net://%d.%d.%d.%d/%08X",
-                            ip_bytes[0], ip_bytes[1], ip_bytes[2], ip_bytes[3], desc.serial);
-                        devenum->names[devenum->count][max_name_len - 1] = '\0';
-
-                        memcpy(devenum->controller_names[devenum->count].ControllerName, &desc.my_cname.ControllerName, sizeof (desc.my_cname.ControllerName));
-                        devenum->controller_names[devenum->count].CtrlFlags = desc.my_cname.CtrlFlags;
-
-                        memcpy(devenum->stage_names[devenum->count].PositionerName, &desc.my_sname.PositionerName, sizeof (desc.my_sname.PositionerName));
-
-                        /* fill dev_net_info from passed structure */
-                        memcpy(&devenum->dev_net_infos[devenum->count].ipv4, &desc.ipv4, sizeof(desc.ipv4));
-                        memcpy(&devenum->dev_net_infos[devenum->count].nodename, &desc.nodename, sizeof(desc.nodename) - 1);
-                        memcpy(&devenum->dev_net_infos[devenum->count].axis_state, &desc.axis_state, sizeof(desc.axis_state));
-                        memcpy(&devenum->dev_net_infos[devenum->count].locker_username, &desc.locker_username, sizeof(desc.locker_username) - 1);
-                        memcpy(&devenum->dev_net_infos[devenum->count].locker_nodename, &desc.locker_nodename, sizeof(desc.locker_nodename) - 1);
-                        memcpy(&devenum->dev_net_infos[devenum->count].locked_time, &desc.locked_time, sizeof(desc.locked_time));
-
-                        devenum->count++;
-                    } 
-                }
-            }
-            bindy_free(net_enum.pbufs[server]); // free the buffer allocations
-        }
-        free(addr); // free after last use of net_enum.addrs, because we use ptrs into this string
-        // also free the net_enum
-        free(net_enum.device_count);
-        free(net_enum.addrs);
-        free(net_enum.pbufs);
+		if (!bindy_init())
+		{
+			log_error(L"network layer init failed");
+			devenum_free_unpacked(devenum);
+			return result_error;
+		}
+		net_enum = net_enum_create(hints);
+		if (net_enum != NULL)
+		{
+			net_enum_launch(net_enum);
+		}
 #else
-        return result_error;
+		devenum_free_unpacked(devenum);
+		return result_error;
 #endif
-    }
+	}
+
+	enumerate_ssdp_and_probe(devenum);
 
+#ifdef HAVE_XIWRAPPER
+	if (net_enum != NULL)
+	{
+		net_enum_wait(net_enum, DEFAULT_TIMEOUT_TIME);
+		net_enum_collect(net_enum, devenum);
+		net_enum_release(net_enum);
+	}
+#endif
 
 	log_debug(L"found %d devices", devenum->count);
 
-	return result_ok;
+	*device_enumeration = devenum_pack(devenum);
+	return *device_enumeration ? result_ok : result_error;
 }
 
 
@@ -861,45 +1169,9 @@ device_enumeration_t XIMC_API enumerate_devices(int enumerate_flags, const char
 result_t XIMC_API free_enumerate_devices(device_enumeration_t device_enumeration)
 {
 	device_enumeration_opaque_t* de = (device_enumeration_opaque_t*)device_enumeration;
-	int i;
 	lock_global();
-	if (de)
-	{
-		if (de->names)
-		{
-			for (i = 0; i < de->count; ++i)
-				if (de->names[i])
-					free( de->names[i] );
-			free(de->names);
-		}
-		if (de->raw_names)
-		{
-			for (i = 0; i < de->count; ++i)
-				if (de->raw_names[i])
-					free( de->raw_names[i] );
-			free(de->raw_names);
-		}
-		if (de->serials)
-			free( de->serials );
-		if (de->infos)
-			free( de->infos );
-		if (de->controller_names)
-			free( de->controller_names );
-		if (de->stage_names)
-			free( de->stage_names );
-		if (de->dev_net_infos)
-			free( de->dev_net_infos );
-		/* just to be sure */
-		de->names = NULL;
-		de->raw_names = NULL;
-		de->serials = NULL;
-		de->infos = NULL;
-		de->controller_names = NULL;
-		de->stage_names = NULL;
-		de->dev_net_infos = NULL;
-		de->count = 0;
-		free(de);
-	}
+	/* packed enumeration, arrays and strings are in the same block */
+	free(de);
 	unlock_global();
 	return result_ok;
 }
@@ -1001,6 +1273,44 @@ result_t XIMC_API get_enumerate_device_network_information(device_enumeration_t
 	return unlocker_global(result);
 }
 
+int XIMC_API get_enumerate_server_count(device_enumeration_t device_enumeration)
+{
+	device_enumeration_opaque_t* de = (device_enumeration_opaque_t*)device_enumeration;
+	if (!de)
+		return result_error;
+	lock_global();
+	return unlocker_global( de->server_count );
+}
+
+pchar XIMC_API get_enumerate_server_address(device_enumeration_t device_enumeration, int server_index)
+{
+	device_enumeration_opaque_t* de = (device_enumeration_opaque_t*)device_enumeration;
+	char* addr = NULL;
+	if (!de)
+		return NULL;
+	lock_global();
+	if (server_index >= 0 && server_index < de->server_count)
+		addr = de->servers[server_index].addr;
+	unlock_global();
+	return addr;
+}
+
+result_t XIMC_API get_enumerate_server_latency(device_enumeration_t device_enumeration, int server_index, uint32_t* latency_us)
+{
+	device_enumeration_opaque_t* de = (device_enumeration_opaque_t*)device_enumeration;
+	result_t result = result_ok;
+	if (!de || !latency_us)
+		return result_error;
+	lock_global();
+	if (server_index < 0 || server_index >= de->server_count)
+		result = result_value_error;
+	else if (!de->servers[server_index].answered)
+		result = result_nodevice;
+	else
+		*latency_us = de->servers[server_index].latency_us;
+	return unlocker_global(result);
+}
+
 result_t XIMC_API probe_device (const char* uri)
 {
 	result_t result;
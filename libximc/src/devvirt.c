@@ -597,11 +597,21 @@ ssize_t write_port_virtual (device_metadata_t *metadata, const void *buf, size_t
 {
 	AllParamsStr* allParams = (AllParamsStr*)metadata->virtual_state;
 	size_t in_data_size = GetReadDataSize(*((uint32_t*)buf));
+	size_t unread = metadata->virtual_packet_size - metadata->virtual_packet_actual;
+
+	/* An answer not read yet stays in front of the new one, a stop written out of turn
+	 * comes while the previous answer is in the scratchpad */
+	if (unread + PACKET_SIZE > VIRTUAL_SCRATCHPAD_SIZE)
+	{
+		log_error( L"Scratchpad overflow, %d unread bytes are dropped", unread );
+		unread = 0;
+	}
+	memmove( metadata->virtual_scratchpad, metadata->virtual_scratchpad + metadata->virtual_packet_actual, unread );
 
 	/* Process data and save response in scratchpad */
 	metadata->virtual_packet_actual = 0;
-	metadata->virtual_packet_size = GetData(buf, in_data_size,
-			metadata->virtual_scratchpad, allParams);
+	metadata->virtual_packet_size = unread + GetData(buf, in_data_size,
+			metadata->virtual_scratchpad + unread, allParams);
 	if (metadata->virtual_packet_size > VIRTUAL_SCRATCHPAD_SIZE)
 	{
 		log_error( L"Scratchpad overflow" );
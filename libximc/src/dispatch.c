@@ -0,0 +1,580 @@
+#include "common.h"
+
+#include "ximc.h"
+#include "util.h"
+#include "metadata.h"
+#include "platform.h"
+#include "protosup.h"
+
+/*
+ * Coordinated dispatch of one command to several devices.
+ *
+ * Packets are serialized in advance. Every device gets a thread which takes the device lock
+ * and waits at a start gate, a thread started apart from them opens the gate when all of them
+ * are ready, so a device thread which fails to start can't leave the others at a closed gate.
+ * After the gate a thread only sends its packet and waits for the echo, so devices start
+ * within thread wake-up time of each other instead of one round trip apart.
+ */
+
+/* Longest packet sent by group dispatch */
+#define DISPATCH_PACKET_MAX 64
+
+/* Size of the move command packet */
+#define MOVE_PACKET_SIZE PREPARED_PACKET_SIZE
+
+typedef struct dispatch_group_t
+{
+	/* start gate, locked until all device threads are ready */
+	mutex_t* gate;
+	/* device threads ready to send, guarded by the metadata lock */
+	int ready;
+	int count;
+	/* device threads are joined and the gate is opened, guarded by the metadata lock */
+	int joined;
+	int opened;
+} dispatch_group_t;
+
+typedef struct dispatch_thread_state_t
+{
+	dispatch_group_t* group;
+	device_t id;
+	const byte* command;
+	size_t command_len;
+	uint64_t sent_us;
+	result_t result;
+} dispatch_thread_state_t;
+
+/* One thread per device, a device lock can't be taken twice */
+static result_t check_device_list(const device_t* ids, int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; ++i)
+	{
+		for (j = 0; j < i && ids[i] != ids[j]; ++j)
+			;
+		if (j < i || ids[i] == device_undefined)
+		{
+			log_error( L"device %d is undefined or repeated in the device list", ids[i] );
+			return result_value_error;
+		}
+	}
+	return result_ok;
+}
+
+#ifdef HAVE_LOCKS
+static XIMC_RETTYPE XIMC_CALLCONV dispatch_gate_thread(void* arg)
+{
+	dispatch_group_t* group = (dispatch_group_t*)arg;
+	uint64_t now, deadline;
+	int ready, joined;
+
+	/* a device thread which failed to start must not hold the others forever */
+	get_wallclock_us( &now );
+	deadline = now + (uint64_t)DISPATCH_READY_TIMEOUT * 1000;
+	for (;;)
+	{
+		lock_metadata();
+		ready = group->ready;
+		joined = group->joined;
+		unlock_metadata();
+		if (ready == group->count || joined)
+			break;
+		get_wallclock_us( &now );
+		if (now >= deadline)
+		{
+			log_warning( L"dispatch_group: %d of %d devices are not ready, starting anyway", group->count - ready, group->count );
+			break;
+		}
+		msec_sleep( SLEEP_WAIT_TIME );
+	}
+	mutex_unlock( group->gate );
+	lock_metadata();
+	group->opened = 1;
+	unlock_metadata();
+	return (XIMC_RETTYPE)0;
+}
+#endif
+
+static void dispatch_thread(void* arg)
+{
+	dispatch_thread_state_t* ts = (dispatch_thread_state_t*)arg;
+	dispatch_group_t* group = ts->group;
+
+	lock( ts->id );
+	lock_metadata();
+	++group->ready;
+	unlock_metadata();
+#ifdef HAVE_LOCKS
+	/* pass the gate on to the next waiting thread */
+	if (group->gate)
+	{
+		mutex_lock( group->gate );
+		mutex_unlock( group->gate );
+	}
+#endif
+	get_wallclock_us( &ts->sent_us );
+	ts->result = unlocker( ts->id, command_checked_echo( ts->id, ts->command, ts->command_len ) );
+}
+
+result_t dispatch_group (const device_t* ids, const byte* commands, size_t command_len, int count,
+		result_t* results, unsigned int* skew_us)
+{
+	dispatch_group_t group;
+	dispatch_thread_state_t* tstates;
+	uint64_t first = 0, last = 0;
+	result_t result;
+	int i;
+
+	if (ids == NULL || commands == NULL || count < 0 || command_len > DISPATCH_PACKET_MAX)
+		return result_value_error;
+	if ((result = check_device_list( ids, count )) != result_ok)
+		return result;
+	if (skew_us)
+		*skew_us = 0;
+	if (count == 0)
+		return result_ok;
+
+	tstates = (dispatch_thread_state_t*)malloc( count*sizeof(dispatch_thread_state_t) );
+	if (!tstates)
+		return result_error;
+	group.gate = NULL;
+	group.ready = 0;
+	group.count = count;
+	group.joined = 0;
+	group.opened = 0;
+#ifdef HAVE_LOCKS
+	if ((group.gate = mutex_init( (unsigned int)ids[0] )) != NULL)
+	{
+		mutex_lock( group.gate );
+		/* the gate is opened before any device thread is created */
+		if (single_thread_launcher( dispatch_gate_thread, &group ) != result_ok)
+		{
+			mutex_unlock( group.gate );
+			mutex_close( group.gate );
+			group.gate = NULL;
+		}
+	}
+	if (!group.gate)
+		log_warning( L"dispatch_group: no start gate, devices start unsynchronized" );
+#endif
+	for (i = 0; i < count; ++i)
+	{
+		tstates[i].group = &group;
+		tstates[i].id = ids[i];
+		tstates[i].command = commands + i*command_len;
+		tstates[i].command_len = command_len;
+		tstates[i].sent_us = 0;
+		tstates[i].result = result_error;
+	}
+
+	if (fork_join( dispatch_thread, count, tstates, sizeof(dispatch_thread_state_t) ) != result_ok)
+	{
+		log_error( L"fork/join engine failed" );
+		result = result_error;
+	}
+#ifdef HAVE_LOCKS
+	if (group.gate)
+	{
+		int opened;
+
+		/* the gate thread uses the group, it is not waited for ready devices any more */
+		lock_metadata();
+		group.joined = 1;
+		unlock_metadata();
+		do
+		{
+			lock_metadata();
+			opened = group.opened;
+			unlock_metadata();
+			if (!opened)
+				msec_sleep( SLEEP_WAIT_TIME );
+		} while (!opened);
+		mutex_close( group.gate );
+	}
+#endif
+
+	for (i = 0; i < count; ++i)
+	{
+		if (results)
+			results[i] = tstates[i].result;
+		if (tstates[i].result != result_ok && result == result_ok)
+			result = tstates[i].result;
+		if (tstates[i].sent_us == 0)
+			continue;
+		if (first == 0 || tstates[i].sent_us < first)
+			first = tstates[i].sent_us;
+		if (tstates[i].sent_us > last)
+			last = tstates[i].sent_us;
+	}
+	if (skew_us)
+		*skew_us = (unsigned int)(last - first);
+	free( tstates );
+	return result;
+}
+
+/*
+ * Emergency stop fan-out. There is no start gate, every thread sends its stop as soon as it runs.
+ * A device held by another call gets the frame out of turn between the frames of the holder, the
+ * echo is collected by the holder's exchange or by the thread once the device is free.
+ */
+
+typedef struct stop_thread_state_t
+{
+	device_t id;
+	uint64_t start_us;
+	/* the acknowledgement is waited for until then */
+	uint64_t deadline_us;
+	unsigned int latency_us;
+	result_t result;
+} stop_thread_state_t;
+
+/* Limits the logical timeout of a device by the deadline, returns the previous timeout */
+static int stop_clamp_timeout(device_metadata_t* dm, uint64_t deadline_us)
+{
+	uint64_t now;
+	int timeout = dm->timeout;
+
+	get_wallclock_us( &now );
+	if (deadline_us <= now)
+		dm->timeout = 1;
+	else if ((deadline_us - now) / 1000 < (uint64_t)timeout)
+		dm->timeout = (int)((deadline_us - now) / 1000) + 1;
+	return timeout;
+}
+
+/* Sends the stop out of turn and waits for its echo, the device is held by another call */
+static result_t stop_busy_device(stop_thread_state_t* ts)
+{
+	device_metadata_t* dm;
+	unsigned int received;
+	uint64_t now;
+	result_t result = result_error;
+	int timeout;
+
+	if ((dm = acquire_port( ts->id )) == NULL)
+	{
+		log_error( L"command_stop_all: device %d is closed", ts->id );
+		return result_error;
+	}
+	if (command_port_send_stop( dm, &received ) != result_serial_ok)
+	{
+		log_error( L"command_stop_all: can't write stop to device %d", ts->id );
+		release_port( dm );
+		return result_nodevice;
+	}
+	log_warning( L"command_stop_all: device %d is busy, stop is sent out of turn", ts->id );
+	for (;;)
+	{
+		if (stop_echo_received( dm, received ))
+		{
+			result = result_ok;
+			break;
+		}
+		get_wallclock_us( &now );
+		if (now >= ts->deadline_us)
+			break;
+		if (try_lock( ts->id ))
+		{
+			/* a late echo is detected by the next call which synchronizes the port then */
+			timeout = stop_clamp_timeout( dm, ts->deadline_us );
+			result = receive_stop_echo( dm );
+			dm->timeout = timeout;
+			unlock( ts->id );
+			if (result == result_ok && !stop_echo_received( dm, received ))
+				result = result_error;
+			break;
+		}
+		msec_sleep( SLEEP_WAIT_TIME );
+	}
+	release_port( dm );
+	return result;
+}
+
+static void stop_thread(void* arg)
+{
+	stop_thread_state_t* ts = (stop_thread_state_t*)arg;
+	device_metadata_t* dm;
+	uint64_t now;
+	int timeout;
+
+	if (!try_lock( ts->id ))
+		ts->result = stop_busy_device( ts );
+	else if ((dm = get_metadata( ts->id )) == NULL)
+	{
+		log_error( L"could not extract metadata for device" );
+		ts->result = unlocker( ts->id, result_error );
+	}
+	else
+	{
+		/* the acknowledgement is waited for until the deadline only */
+		timeout = stop_clamp_timeout( dm, ts->deadline_us );
+		ts->result = command_checked_echo_str_unsynced( ts->id, "stop" );
+		dm->timeout = timeout;
+		unlock( ts->id );
+	}
+	if (ts->result != result_ok)
+	{
+		log_error( L"command_stop_all: device %d did not acknowledge stop in time", ts->id );
+		return;
+	}
+	get_wallclock_us( &now );
+	ts->latency_us = (unsigned int)(now - ts->start_us);
+}
+
+static result_t stop_devices(const device_t* ids, int count, unsigned int deadline_ms,
+		result_t* results, unsigned int* latency_us)
+{
+	stop_thread_state_t* tstates;
+	uint64_t start;
+	result_t result = result_ok;
+	int i;
+
+	if (count == 0)
+		return result_ok;
+	if ((tstates = (stop_thread_state_t*)malloc( count*sizeof(stop_thread_state_t) )) == NULL)
+		return result_error;
+	get_wallclock_us( &start );
+	for (i = 0; i < count; ++i)
+	{
+		tstates[i].id = ids[i];
+		tstates[i].start_us = start;
+		tstates[i].deadline_us = start + (uint64_t)deadline_ms * 1000;
+		tstates[i].latency_us = 0;
+		tstates[i].result = result_error;
+	}
+	if (fork_join( stop_thread, count, tstates, sizeof(stop_thread_state_t) ) != result_ok)
+	{
+		log_error( L"fork/join engine failed" );
+		result = result_error;
+	}
+	for (i = 0; i < count; ++i)
+	{
+		if (results)
+			results[i] = tstates[i].result;
+		if (latency_us)
+			latency_us[i] = tstates[i].latency_us;
+		if (tstates[i].result != result_ok && result == result_ok)
+			result = tstates[i].result;
+	}
+	free( tstates );
+	return result;
+}
+
+/*
+ * Multi-device readers. A thread per device runs the ordinary reader, which takes the device lock,
+ * so every port has one request in flight and all ports are waited for at the same time.
+ */
+
+typedef struct get_thread_state_t
+{
+	device_t id;
+	dispatch_getter_t getter;
+	void* out;
+	result_t result;
+} get_thread_state_t;
+
+static void get_thread(void* arg)
+{
+	get_thread_state_t* ts = (get_thread_state_t*)arg;
+
+	ts->result = ts->getter( ts->id, ts->out );
+}
+
+result_t dispatch_get (const device_t* ids, int count, void* out, size_t out_size, dispatch_getter_t getter,
+		result_t* results)
+{
+	get_thread_state_t* tstates;
+	result_t result;
+	int i;
+
+	if (ids == NULL || out == NULL || getter == NULL || count < 0)
+		return result_value_error;
+	if ((result = check_device_list( ids, count )) != result_ok)
+		return result;
+	if (count == 0)
+		return result_ok;
+	if ((tstates = (get_thread_state_t*)malloc( count*sizeof(get_thread_state_t) )) == NULL)
+		return result_error;
+	for (i = 0; i < count; ++i)
+	{
+		tstates[i].id = ids[i];
+		tstates[i].getter = getter;
+		tstates[i].out = (byte*)out + i*out_size;
+		tstates[i].result = result_error;
+	}
+	/* one device needs no thread */
+	if (count == 1)
+		get_thread( tstates );
+	else if (fork_join( get_thread, count, tstates, sizeof(get_thread_state_t) ) != result_ok)
+	{
+		log_error( L"fork/join engine failed" );
+		result = result_error;
+	}
+	for (i = 0; i < count; ++i)
+	{
+		if (results)
+			results[i] = tstates[i].result;
+		if (tstates[i].result != result_ok && result == result_ok)
+			result = tstates[i].result;
+	}
+	free( tstates );
+	return result;
+}
+
+/* Serializes position command, code is "move" or "movr" which have the same layout */
+static void prepared_serialize(byte* packet, const char* command, int Position, int uPosition)
+{
+	byte* p = packet;
+
+	push_str( &p, command );
+	push_int32( &p, Position );
+	push_int16( &p, uPosition );
+	push_garbage( &p, 6 );
+	push_crc( &p, packet, p - packet );
+}
+
+/* CRC of a message with only one non-zero byte at offset, it is the same for any initial value */
+static void prepared_build_crc_delta(uint16_t* delta, size_t offset, size_t size)
+{
+	byte message[PREPARED_PACKET_SIZE];
+	uint16_t zero;
+	int value;
+
+	memset( message, 0, size );
+	zero = get_crc( message, size );
+	for (value = 0; value < 256; ++value)
+	{
+		message[offset] = (byte)value;
+		delta[value] = get_crc( message, size ) ^ zero;
+	}
+}
+
+/*
+ * Exported functions
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+result_t XIMC_API command_move_group (const device_t* ids, const move_target_t* targets, int count,
+		result_t* results, unsigned int* skew_us)
+{
+	byte* commands;
+	result_t result;
+	int i;
+
+	if (ids == NULL || targets == NULL || count < 0)
+		return result_value_error;
+	if ((commands = (byte*)malloc( count*MOVE_PACKET_SIZE + 1 )) == NULL)
+		return result_error;
+	/* same packet as command_move */
+	for (i = 0; i < count; ++i)
+		prepared_serialize( commands + i*MOVE_PACKET_SIZE, "move", targets[i].Position, targets[i].uPosition );
+	result = dispatch_group( ids, commands, MOVE_PACKET_SIZE, count, results, skew_us );
+	free( commands );
+	return result;
+}
+
+result_t XIMC_API command_stop_all (const device_t* ids, int count, unsigned int deadline_ms,
+		result_t* results, unsigned int* latency_us)
+{
+	result_t result;
+
+	if (ids == NULL || count < 0)
+		return result_value_error;
+	if ((result = check_device_list( ids, count )) != result_ok)
+		return result;
+	return stop_devices( ids, count, deadline_ms, results, latency_us );
+}
+
+result_t XIMC_API command_stop_all_open (unsigned int deadline_ms)
+{
+	device_t* ids;
+	result_t result;
+	int count, open;
+
+	/* devices may be opened in between, retry with the new count */
+	for (count = get_open_devices( NULL, 0 ); ; count = open)
+	{
+		if ((ids = (device_t*)malloc( (count+1)*sizeof(device_t) )) == NULL)
+			return result_error;
+		if ((open = get_open_devices( ids, count )) <= count)
+			break;
+		free( ids );
+	}
+	result = stop_devices( ids, open, deadline_ms, NULL, NULL );
+	free( ids );
+	return result;
+}
+
+result_t XIMC_API prepare_command (device_t id, const char* command, int Position, int uPosition,
+		prepared_command_t** prepared)
+{
+	prepared_command_t* pc;
+	size_t i, crc_size = PREPARED_PACKET_SIZE - 4 - 2;
+
+	if (prepared == NULL)
+		return result_value_error;
+	*prepared = NULL;
+	if (command == NULL || (strcmp( command, "move" ) != 0 && strcmp( command, "movr" ) != 0))
+	{
+		log_error( L"prepare_command: only move and movr commands may be prepared" );
+		return result_value_error;
+	}
+	if ((pc = (prepared_command_t*)malloc( sizeof(prepared_command_t) )) == NULL)
+		return result_error;
+	pc->id = id;
+	prepared_serialize( pc->packet, command, Position, uPosition );
+	/* CRC covers the packet without the command code and the CRC itself */
+	for (i = 0; i < PREPARED_PATCH_SIZE; ++i)
+		prepared_build_crc_delta( pc->crc_delta[i], PREPARED_PATCH_OFFSET - 4 + i, crc_size );
+	*prepared = pc;
+	return result_ok;
+}
+
+result_t XIMC_API patch_prepared (prepared_command_t* prepared, int Position, int uPosition)
+{
+	byte position[PREPARED_PATCH_SIZE], *p = position, *packet;
+	uint16_t crc;
+	byte change;
+	int i;
+
+	if (prepared == NULL)
+		return result_value_error;
+	push_int32( &p, Position );
+	push_int16( &p, uPosition );
+	packet = prepared->packet + PREPARED_PATCH_OFFSET;
+	memcpy( &crc, prepared->packet + PREPARED_PACKET_SIZE - 2, 2 );
+	for (i = 0; i < PREPARED_PATCH_SIZE; ++i)
+	{
+		if ((change = packet[i] ^ position[i]) != 0)
+		{
+			crc ^= prepared->crc_delta[i][change];
+			packet[i] = position[i];
+		}
+	}
+	memcpy( prepared->packet + PREPARED_PACKET_SIZE - 2, &crc, 2 );
+	return result_ok;
+}
+
+result_t XIMC_API fire_prepared (prepared_command_t* prepared)
+{
+	if (prepared == NULL)
+		return result_value_error;
+	lock( prepared->id );
+	return unlocker( prepared->id, command_checked_echo( prepared->id, prepared->packet, PREPARED_PACKET_SIZE ) );
+}
+
+result_t XIMC_API free_prepared (prepared_command_t* prepared)
+{
+	free( prepared );
+	return result_ok;
+}
+
+#if defined(__cplusplus)
+};
+#endif
+
+// vim: syntax=c tabstop=4 shiftwidth=4
@@ -365,6 +365,17 @@ result_t XIMC_API get_device_information (device_t id, device_information_t* dev
 	return unlocker( id, get_device_information_impl( id, device_information ) );
 }
 
+static result_t get_device_information_multi_one (device_t id, void* device_information)
+{
+	return get_device_information( id, (device_information_t*)device_information );
+}
+
+result_t XIMC_API get_device_information_multi (const device_t* ids, int count, device_information_t* device_information,
+		result_t* results)
+{
+	return dispatch_get( ids, count, device_information, sizeof(device_information_t), get_device_information_multi_one, results );
+}
+
 result_t XIMC_API command_wait_for_stop(device_t id, uint32_t refresh_interval_ms)
 {
 	status_t status;
@@ -9,17 +9,56 @@ typedef enum { dtUnknown, dtSerial, dtVirtual, dtNet, dtUdp, dtTcp } device_type
 
 struct mutex_t;
 
-typedef struct device_corr_table_t
+/* Uniform bucket index over one axis of a correction table. */
+typedef struct correction_axis_t
 {
+	/* The first value of the axis. */
+	double origin;
+	/* Buckets per unit of the axis. */
+	double scale;
+	uint32_t buckets;
+	/* Segment containing the start of each bucket, the segments of bucket b end at index[b + 1]. */
+	uint32_t* index;
+} correction_axis_t;
+
+/* Interpolation of a correction table between the grid points. */
+typedef enum
+{
+	correction_interpolation_linear = 0,
+	/* Monotone piecewise cubic Hermite spline. */
+	correction_interpolation_cubic = 1
+} correction_interpolation_t;
+
+typedef struct correction_table_t
+{
+	/* Owners of the table: devices and calibration contexts. */
+	int refcount;
 	/* The length of the adjustment table. */
-	uint32_t len_table;
+	uint32_t length;
 	/* Coordinate of the grid. */
-	float* X;
+	double* X;
 	/* Deviation. */
-	float* dX;
-} device_corr_table_t;
+	double* dX;
+	/* Corrected coordinate X + dX. */
+	double* Y;
+	/* Slope of dX over X and of X over Y in each segment. */
+	double* forward_slope;
+	double* inverse_slope;
+	correction_interpolation_t interpolation;
+	/* Cubic coefficients of Y over X - X[i] in each segment, NULL for linear tables. */
+	double* cubic;
+	correction_axis_t forward;
+	correction_axis_t inverse;
+	/* Copy of the source file, a binary table holds the arrays in it, or NULL. */
+	void* source;
+	/* Size and hash of the source file, tables loaded from equal files are shared. */
+	size_t source_size;
+	uint64_t source_hash;
+	struct correction_table_t* next_shared;
+} correction_table_t;
 
-#define VIRTUAL_SCRATCHPAD_SIZE 256
+/* Room for an answer not read yet in front of a new one, as in a port buffer */
+#define VIRTUAL_SCRATCHPAD_SIZE 512
 
 typedef struct device_metadata_t
 {
@@ -32,12 +71,26 @@ typedef struct device_metadata_t
 	/* logical timeout */
 	int timeout;
 	struct mutex_t* device_mutex;
+	/* Serializes frames written to the port, a stop is written through it out of turn, see command_stop_all */
+	struct mutex_t* port_mutex;
+	/* Out-of-turn writers using the port and the close request they delay, guarded by the metadata lock */
+	int port_users;
+	int closing;
+	/* Echoes of stops written out of turn which are expected and which are received, guarded by port_mutex */
+	int stop_echoes_pending;
+	unsigned int stop_echoes_received;
 	/* bindy serial */
 	uint32_t serial;
 	/* bindy id */
 	uint32_t conn_id;
-	/* Corrective table. */
-	device_corr_table_t table;
+	/* Corrective table, NULL if not loaded. */
+	correction_table_t* table;
+	/* Settings writes recorded for a profile, NULL if not recording. */
+	byte* profile_recording;
+	/* Universal settings known to be in the device, NULL if caching is off. */
+	byte* settings_cache;
+	/* Set functions send values without checking protocol ranges, see enable_value_checks. */
+	int no_value_checks;
 
 	/* virtual devices metadata*/
 	/* in-memory device state */
@@ -54,5 +107,19 @@ typedef struct device_metadata_t
 
 device_metadata_t* get_metadata(device_t device);
 void remove_metadata(device_t device);
+/* Writes raw bytes to the device port, returns result_serial_* code */
+int command_port_send (device_metadata_t *metadata, const byte* command, size_t len);
+/* The port of an open device for a writer without the device lock, NULL if the device is closed or closing.
+ * close_device waits until the port is released. */
+device_metadata_t* acquire_port(device_t device);
+void release_port(device_metadata_t* dm);
+/* Writes a stop out of turn, *received is set to compare with stop_echo_received */
+int command_port_send_stop (device_metadata_t *metadata, unsigned int* received);
+/* Nonzero if the echo of a stop sent after *received was counted is received */
+int stop_echo_received (device_metadata_t *metadata, unsigned int received);
+/* Receives the echo of a stop written out of turn if it is still expected, the device lock must be held */
+result_t receive_stop_echo (device_metadata_t *metadata);
+/* Stores up to max identifiers of open devices, returns the number of open devices */
+int get_open_devices(device_t* ids, int max);
 
 #endif
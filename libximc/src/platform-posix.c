@@ -7,6 +7,7 @@
 #include <sys/ioctl.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <dirent.h>
@@ -178,8 +179,6 @@ typedef struct fork_join_carry_t
 {
 	fork_join_thread_function_t function;
 	void* arg;
-	pthread_cond_t condition;
-	pthread_mutex_t mutex;
 } fork_join_carry_t;
 
 /* posix wrapper thread function */
@@ -190,17 +189,6 @@ void* check_thread_wrapper_posix (void *arg)
 	return NULL;
 }
 
-/* posix wrapper thread function with mutex */
-void* check_thread_wrapper_posix_with_mutex(void *arg)
-{
-	fork_join_carry_t* carry = (fork_join_carry_t*)arg;
-	carry->function(carry->arg);
-	pthread_mutex_lock(&carry->mutex);
-	pthread_cond_signal(&carry->condition);
-	pthread_mutex_unlock(&carry->mutex);
-	return NULL;
-}
-
 /* posix implementation of fork/join */
 result_t fork_join (fork_join_thread_function_t function, int count, void* args, size_t arg_element_size)
 {
@@ -242,7 +230,7 @@ result_t fork_join (fork_join_thread_function_t function, int count, void* args,
 	return result;
 }
 
-void single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg)
+result_t single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg)
 {
 	pthread_attr_t thread_attr;
 	pthread_attr_init(&thread_attr);
@@ -251,152 +239,11 @@ void single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg)
 
 	if (pthread_create(&tid , &thread_attr, func, arg) != 0) {
 		log_system_error(L"Failed to create a pthread due to: ");
+		return result_error;
 	}
+	return result_ok;
 }
 
-/* posix implementation of fork/join with timeout */
-// TODO: fix net_enum abstraction leak
-void fork_join_with_timeout(fork_join_thread_function_t function, int count, void* args, size_t arg_element_size, int timeout_ms, net_enum_t* net_enum)
-{
-	pthread_t* tids;
-	pthread_attr_t thread_attr;
-	int i;
-	fork_join_carry_t* carry;
-
-	pthread_attr_init(&thread_attr);
-	pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_JOINABLE);
-
-	tids = (pthread_t*)malloc(count*sizeof(pthread_t));
-	carry = (fork_join_carry_t*)malloc(count*sizeof(fork_join_carry_t));
-
-	/* launch and join */
-	for (i = 0; i < count; ++i)
-	{
-		pthread_cond_init(&carry[i].condition, NULL);
-		pthread_mutex_init(&carry[i].mutex, NULL);
-		carry[i].function = function;
-		carry[i].arg = (byte*)args + i*arg_element_size;
-		if (pthread_create(&tids[i], &thread_attr, &check_thread_wrapper_posix_with_mutex, &carry[i]))
-		{
-			log_system_error(L"Failed to create a pthread due to: ");
-		}
-	}
-
-	/* Wait for timeout and get data from those who returned */
-	struct timespec abstime;
-	#ifdef __APPLE__
-	clock_serv_t cclock;
-	mach_timespec_t mts;
-	host_get_clock_service(mach_host_self(), CALENDAR_CLOCK, &cclock);
-	clock_get_time(cclock, &mts);
-	mach_port_deallocate(mach_task_self(), cclock);
-	abstime.tv_sec = mts.tv_sec;
-	abstime.tv_nsec = mts.tv_nsec;
-	#else
-	clock_gettime(CLOCK_REALTIME, &abstime);
-	#endif
-
-	time_t sec = (time_t)(timeout_ms / 1000);
-	long nsec = (timeout_ms - 1000 * sec) * 1000 * 1000;
-	abstime.tv_sec += sec;
-	abstime.tv_nsec += nsec;
-	long billion = 1000 * 1000 * 1000;
-	if (abstime.tv_nsec > billion) {
-		abstime.tv_sec += 1;
-		abstime.tv_nsec -= billion;
-	}
-
-	for (i = 0; i < count; ++i)
-	{
-		pthread_mutex_lock(&carry[i].mutex);
-		int result;
-		do {
-			result = pthread_cond_timedwait(&carry[i].condition, &carry[i].mutex, &abstime);
-		} while (result != ETIMEDOUT && result != 0);
-		pthread_mutex_unlock(&carry[i].mutex);
-	}
-
-	// Lock each personal mutex and copy thread data
-	for (i = 0; i < count; ++i)
-	{
-		pthread_mutex_lock(&carry[i].mutex);
-		netthread_state_t state = *(netthread_state_t*)(carry[i].arg);
-		if (state.status) {
-			net_enum->pbufs[i] = state.pbuf;
-			net_enum->device_count[i] = state.devices_found;
-		}
-		pthread_mutex_unlock(&carry[i].mutex);
-	}
-
-	// Unlock the external mutex
-	mutex_unlock(net_enum->mutex);
-	// After this we can't touch our parameter pointers (net_enum), since they might be already invalid
-
-	/* Wait for infinity to clean up after remaining threads */
-	for (i = 0; i < count; ++i)
-	{
-		if (pthread_join(tids[i], NULL))
-		{
-			log_system_error(L"Failed to join a pthread due to: ");
-		}
-	}
-
-	for (i = 0; i < count; ++i) {
-		pthread_cond_destroy(&carry[i].condition);
-		pthread_mutex_destroy(&carry[i].mutex);
-	}
-	
-	free(tids);
-	free(carry);
-}
-
-void fork_join_2_threads(fork_join_thread_function_t function1, void* args1, int condition1, fork_join_thread_function_t function2, void* args2, int condition2)
-{
-    
-    pthread_t tids[2];
-    pthread_attr_t thread_attr;
-    int i, count_launched;
-    fork_join_carry_t* carry;
-
-    pthread_attr_init(&thread_attr);
-    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_JOINABLE);
-    count_launched = 0;
-    carry = (fork_join_carry_t*)malloc(2*sizeof(fork_join_carry_t));
-    if (condition1)
-    {
-        carry[0].function = function1;
-        carry[0].arg = (byte*)args1;
-        if (pthread_create(&tids[0], &thread_attr, &check_thread_wrapper_posix, &carry[0]))
-        {
-            log_system_error(L"Failed to create a pthread due to: ");
-        }
-        else
-            count_launched++;
-    }
-    if (condition2)
-    {
-        carry[count_launched].function = function2;
-        carry[count_launched].arg = (byte*)args2;
-        if (pthread_create(&tids[count_launched], &thread_attr, &check_thread_wrapper_posix, &carry[count_launched]))
-        {
-            log_system_error(L"Failed to create a pthread due to: ");
-        }
-        else
-            count_launched++;
-
-    }
-
-    for (i = 0; i < count_launched; ++i)
-    {
-        if (pthread_join(tids[i], NULL))
-        {
-            log_system_error(L"Failed to join a pthread due to: ");
-        }
-    }
-    free(carry);
-}
-
-
 unsigned long long get_thread_id()
 {
 	return (unsigned long long)(uintptr_t)pthread_self();
@@ -820,6 +667,62 @@ int set_default_bindy_key()
 #endif
 }
 
+/*
+ * Read-only file mapping
+ */
+
+struct file_mapping_t
+{
+	void* data;
+	size_t size;
+};
+
+file_mapping_t* map_file(const char* name, const void** data, size_t* size)
+{
+	struct stat stat_buf;
+	file_mapping_t* mapping;
+	int fd;
+
+	if ((fd = open( name, O_RDONLY )) == -1)
+	{
+		log_system_error( L"can't open file %hs due to ", name );
+		return NULL;
+	}
+	if (fstat( fd, &stat_buf ) == -1 || stat_buf.st_size <= 0)
+	{
+		log_error( L"can't map empty file %hs", name );
+		close( fd );
+		return NULL;
+	}
+	if ((mapping = malloc( sizeof(file_mapping_t) )) == NULL)
+	{
+		close( fd );
+		return NULL;
+	}
+	mapping->size = (size_t)stat_buf.st_size;
+	mapping->data = mmap( NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	/* mapping stays valid after close */
+	close( fd );
+	if (mapping->data == MAP_FAILED)
+	{
+		log_system_error( L"can't map file %hs due to ", name );
+		free( mapping );
+		return NULL;
+	}
+	*data = mapping->data;
+	*size = mapping->size;
+	return mapping;
+}
+
+void unmap_file(file_mapping_t* mapping)
+{
+	if (mapping)
+	{
+		munmap( mapping->data, mapping->size );
+		free( mapping );
+	}
+}
+
 /*
  * Lock support
  */
@@ -901,6 +804,20 @@ void mutex_unlock(mutex_t* mutex)
 		log_system_error( L"can't post on semaphore %p due to ", mutex->impl );
 }
 
+int mutex_trylock(mutex_t* mutex)
+{
+	if (!mutex || mutex->impl == SEM_FAILED)
+	{
+		log_error( L"no semaphore specified" );
+		return 0;
+	}
+	if (sem_trywait( mutex->impl ) == 0)
+		return 1;
+	if (errno != EAGAIN)
+		log_system_error( L"can't try semaphore %p due to ", mutex->impl );
+	return 0;
+}
+
 #endif
 
 // vim: syntax=c tabstop=4 shiftwidth=4
@@ -196,145 +196,19 @@ result_t fork_join (fork_join_thread_function_t function, int count, void* args,
 	return result;
 }
 
-void single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg)
+result_t single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg)
 {
-	if (_beginthreadex(NULL, 0, func, arg, 0, NULL) == 0)
-		log_system_error(L"Failed to create a crt thread due to: ");
-}
-
-/* win32 implementation of fork/join with timeout */
-void fork_join_with_timeout(fork_join_thread_function_t function, int count, void* args, size_t arg_element_size, int timeout_ms, net_enum_t* net_enum)
-{
-	HANDLE* tids;
-	int i;
-	fork_join_carry_t* carry;
-	mutex_t **mutexes;
-
-	tids = (HANDLE*)malloc(count*sizeof(HANDLE));
-	carry = (fork_join_carry_t*)malloc(count*sizeof(fork_join_carry_t));
-	mutexes = (mutex_t**)malloc(count*sizeof(mutex_t*));
-
-	/* launch and join */
-	for (i = 0; i < count; ++i)
-	{
-		carry[i].function = function;
-		carry[i].arg = (byte*)args + i*arg_element_size;
-		mutexes[i] = mutex_init(i); // the nonce is unused on windows only
-		tids[i] = (HANDLE)_beginthreadex(NULL, 0, check_thread_wrapper_win32, &carry[i], 0, NULL);
-		if (tids[i] == 0)
-		{
-			log_system_error(L"Failed to create a crt thread due to: ");
-		}
-	}
-	/* Wait for timeout and get data from those who returned */
-	switch (WaitForMultipleObjects(count, tids, TRUE, timeout_ms))
+	HANDLE handle = (HANDLE)_beginthreadex(NULL, 0, func, arg, 0, NULL);
+	if (handle == 0)
 	{
-	case WAIT_TIMEOUT:
-		log_info(L"Timed out waiting for all network enumeration threads to complete");
-		break;
-	case WAIT_OBJECT_0:
-		break;
-	case WAIT_FAILED:
-		log_system_error(L"Failed to wait for threads termination due to: ");
-		break;
-	default:
-		log_error(L"Failed to wait for threads termination due to strange reason");
-	}
-
-	// Lock each personal mutex and copy thread data
-	for (i = 0; i < count; ++i)
-	{
-		mutex_lock(mutexes[i]);
-		netthread_state_t state = *(netthread_state_t*)(carry[i].arg);
-		if (state.status) {
-			net_enum->pbufs[i] = state.pbuf;
-			net_enum->device_count[i] = state.devices_found;
-		}
-		mutex_unlock(mutexes[i]);
-	}
-
-	// Unlock the external mutex
-	mutex_unlock(net_enum->mutex);
-	// After this we can't touch our parameter pointers (net_enum), since they might be already invalid
-
-	/* Wait for infinity to clean up after remaining threads */
-	switch (WaitForMultipleObjects(count, tids, TRUE, INFINITE))
-	{
-	case WAIT_OBJECT_0:
-		break;
-	case WAIT_FAILED:
-		log_system_error(L"Failed to wait for threads termination due to: ");
-		break;
-	default:
-		log_error(L"Failed to wait for threads termination due to strange reason");
-	}
-
-	for (i = 0; i < count; ++i) {
-		CloseHandle(tids[i]);
-		mutex_close(mutexes[i]);
+		log_system_error(L"Failed to create a crt thread due to: ");
+		return result_error;
 	}
-
-	free(tids);
-	free(carry);
-	free(mutexes);
-}
-
-void fork_join_2_threads(fork_join_thread_function_t function1, void* args1, int condition1, fork_join_thread_function_t function2, void* args2, int condition2)
-{
-    HANDLE handles[2];
-    int i, count_launched;
-    fork_join_carry_t* carry;
-    
-    count_launched = 0;
-    carry = (fork_join_carry_t*)malloc(2*sizeof(fork_join_carry_t));
-    if (condition1)
-    {
-        carry[0].function = function1;
-        carry[0].arg = (byte*)args1;
-        handles[0] = (HANDLE)_beginthreadex(NULL, 0, check_thread_wrapper_win32, &carry[0], 0, NULL);
-        if (handles[0] == 0)
-        {
-            log_system_error(L"Failed to create a luanch_sheck_threads thread due to: ");
-        }
-        else
-            count_launched++;
-
-    }
-    if (condition2)
-    {
-        carry[count_launched].function = function2;
-        carry[count_launched].arg = (byte*)args2;
-        handles[count_launched] = (HANDLE)_beginthreadex(NULL, 0, check_thread_wrapper_win32, &carry[count_launched], 0, NULL);
-        if (handles[count_launched] == 0)
-        {
-             log_system_error(L"Failed to create a single_wrapper thread due to: ");
-        }
-        else
-            count_launched++;
-    }
-
-    /* Join threads or say there are no devices at all */
-    if (count_launched)
-    {
-
-        switch (WaitForMultipleObjects(count_launched, handles, TRUE, INFINITE))
-        {
-        case WAIT_OBJECT_0:
-            break;
-        case WAIT_FAILED:
-            log_system_error(L"Failed to wait for threads termination due to: ");
-            break;
-        default:
-            log_error(L"Failed to wait for threads termination due to strange reason");
-        }
-    }
-
-    for (i = 0; i < count_launched; ++i)
-        CloseHandle(handles[i]);
-    free(carry);
+	/* detached, nobody joins it */
+	CloseHandle(handle);
+	return result_ok;
 }
 
-
 unsigned long long get_thread_id()
 {
 	return (unsigned long long)GetCurrentThreadId();
@@ -611,6 +485,68 @@ int set_default_bindy_key()
 #endif
 }
 
+/*
+ * Read-only file mapping
+ */
+
+struct file_mapping_t
+{
+	LPVOID view;
+};
+
+file_mapping_t* map_file(const char* name, const void** data, size_t* size)
+{
+	HANDLE file, section;
+	LARGE_INTEGER file_size;
+	file_mapping_t* mapping;
+
+	file = CreateFileA( name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		log_system_error( L"can't open file %hs due to ", name );
+		return NULL;
+	}
+	if (!GetFileSizeEx( file, &file_size ) || file_size.QuadPart <= 0 || (uint64_t)file_size.QuadPart > (size_t)-1)
+	{
+		log_error( L"can't map empty or too large file %hs", name );
+		CloseHandle( file );
+		return NULL;
+	}
+	section = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if (!section)
+	{
+		log_system_error( L"can't map file %hs due to ", name );
+		return NULL;
+	}
+	if ((mapping = malloc( sizeof(file_mapping_t) )) == NULL)
+	{
+		CloseHandle( section );
+		return NULL;
+	}
+	/* view holds the section open */
+	mapping->view = MapViewOfFile( section, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( section );
+	if (!mapping->view)
+	{
+		log_system_error( L"can't map file %hs due to ", name );
+		free( mapping );
+		return NULL;
+	}
+	*data = mapping->view;
+	*size = (size_t)file_size.QuadPart;
+	return mapping;
+}
+
+void unmap_file(file_mapping_t* mapping)
+{
+	if (mapping)
+	{
+		UnmapViewOfFile( mapping->view );
+		free( mapping );
+	}
+}
+
 /*
  * Lock support
  */
@@ -686,6 +622,25 @@ void mutex_unlock(mutex_t* mutex)
 		log_system_error( L"can't post on semaphore %ld due to ", mutex->impl );
 }
 
+int mutex_trylock(mutex_t* mutex)
+{
+	if (!mutex || !mutex->impl)
+	{
+		log_error( L"no semaphore specified" );
+		return 0;
+	}
+	switch (WaitForSingleObject( mutex->impl, 0 ))
+	{
+		case WAIT_OBJECT_0:
+			return 1;
+		case WAIT_TIMEOUT:
+			return 0;
+		default:
+			log_system_error( L"can't try semaphore %ld due to ", mutex->impl );
+			return 0;
+	}
+}
+
 #endif
 
 // vim: syntax=c tabstop=4 shiftwidth=4
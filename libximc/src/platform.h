@@ -100,8 +100,6 @@ typedef void (*fork_join_thread_function_t)(void *arg);
 /* Platform-specific fork/join function */
 result_t fork_join (fork_join_thread_function_t function, int count, void* args, size_t arg_element_size);
 
-void single_thread_wrapper_function(void *arg);
-
 unsigned long long get_thread_id();
 
 /*
@@ -116,6 +114,16 @@ result_t enumerate_devices_directory (enumerate_devices_directory_callback_t cal
 
 bool is_same_device (const char* name1, const char* name2);
 
+/*
+ * Persistent SSDP listener (ssdp.c)
+ */
+
+/* Returns nonzero if the listener is running and its cache may be used */
+int ssdp_listener_is_running();
+
+/* Calls callback for each cached xi-tcp device, returns result_error if the listener is not running */
+result_t ssdp_listener_enumerate(enumerate_devices_directory_callback_t callback, void* arg);
+
 /*
  * Error handling
  */
@@ -142,6 +150,15 @@ void get_wallclock_us(uint64_t* us);
 /* Converts path to absolute (add leading slash on posix) */
 void uri_path_to_absolute(const char *uri_path, char *abs_path, size_t len);
 
+/*
+ * Read-only file mapping
+ */
+typedef struct file_mapping_t file_mapping_t;
+
+/* Maps the whole file into memory, returns NULL on error or if the file is empty */
+file_mapping_t* map_file(const char* name, const void** data, size_t* size);
+void unmap_file(file_mapping_t* mapping);
+
 /*
  * Mutex
  */
@@ -151,33 +168,10 @@ mutex_t* mutex_init(unsigned int nonce);
 void mutex_close(mutex_t* mutex);
 void mutex_lock(mutex_t* mutex);
 void mutex_unlock(mutex_t* mutex);
+/* Returns non-zero if the mutex is taken without waiting */
+int mutex_trylock(mutex_t* mutex);
 
-typedef struct net_enum_t
-{
-	mutex_t * mutex;	// mutex
-	int server_count;	// server count
-	int* device_count;	// array of number of found devices on each server
-	char** addrs;		// array of strings with address of each server
-	uint8_t*** pbufs;	// array of pointers to buffer for each server
-	char* adapter_addr; // network adapter address (optional)
-} net_enum_t;
-
-typedef struct netthread_state_t
-{
-	const char* addr;
-	const char* adapter_addr;
-	uint8_t** pbuf;
-	int status;
-	unsigned int devices_found;
-} netthread_state_t;
-
-/* Platform-specific thread launcher */
-void single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg);
-
-/* Platform-specific fork/join function with timeout*/
-void fork_join_with_timeout(fork_join_thread_function_t function, int count, void* args, size_t arg_element_size, int timeout_ms, net_enum_t *net_enum);
-
-/* Platform-specific fork/join function for 2 fucntions launched on a specified condition*/
-void fork_join_2_threads(fork_join_thread_function_t function1, void* args1, int condition1, fork_join_thread_function_t function2, void* args2, int condition2);
+/* Platform-specific launcher of a detached thread */
+result_t single_thread_launcher(XIMC_RETTYPE(XIMC_CALLCONV *func)(void*), void *arg);
 
 #endif
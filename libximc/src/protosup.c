@@ -11,7 +11,6 @@
 #endif
 
 #include "sglib.h"
-#include <locale.h>
 
 #ifdef _MSC_VER
 #pragma warning( disable : 4311 ) // because we may cast 64-bit handle ptrs to uint32_t to use as pseudo-ids
@@ -23,8 +22,6 @@
 
 int command_port_send (device_metadata_t *metadata, const byte* command, size_t len);
 int command_port_receive (device_metadata_t *metadata, byte* response, size_t len);
-void remov_table(float** X, float** dX);
-void creat_table(float** X, float** dX);
 
 result_t open_port_virtual (device_metadata_t *metadata, const char* virtual_path, const char* serial);
 result_t close_port_virtual (device_metadata_t *metadata);
@@ -73,10 +70,49 @@ void remove_metadata(device_t device)
 	unlock_metadata();
 }
 
-device_t allocate_metadata(device_metadata_t **metadata)
+int get_open_devices(device_t* ids, int max)
+{
+	int count = 0;
+	lock_metadata();
+	SGLIB_LIST_MAP_ON_ELEMENTS(device_metadata_node_t, g_devices_metadata, out, next_ptr,{
+			if (out->data.type != dtUnknown)
+			{
+				if (count < max)
+					ids[count] = out->id;
+				++count;
+			}
+	});
+	unlock_metadata();
+	return count;
+}
+
+device_metadata_t* acquire_port(device_t device)
+{
+	device_metadata_t *result = NULL;
+	device_metadata_node_t marker, *out = NULL;
+	lock_metadata();
+	marker.id = device;
+	SGLIB_LIST_FIND_MEMBER(device_metadata_node_t, g_devices_metadata, &marker, DEVICE_METADATA_COMPARATOR, next_ptr, out);
+	if (out && !out->data.closing && out->data.type != dtUnknown)
+	{
+		result = &(out->data);
+		++result->port_users;
+	}
+	unlock_metadata();
+	return result;
+}
+
+void release_port(device_metadata_t* dm)
+{
+	lock_metadata();
+	--dm->port_users;
+	unlock_metadata();
+}
+
+/* Adds a node of an opened device to the list under a new id */
+static device_t insert_metadata(device_metadata_node_t *new_dm)
 {
 	device_t device = 0;
-	device_metadata_node_t *new_dm;
 	lock_metadata();
 	/* Determine next device id */
 	SGLIB_LIST_MAP_ON_ELEMENTS(device_metadata_node_t, g_devices_metadata, out, next_ptr,{
@@ -84,10 +120,8 @@ device_t allocate_metadata(device_metadata_t **metadata)
 				device = out->id;
 	});
 	device = device + 1;
- 
-	new_dm = (device_metadata_node_t*)malloc( sizeof(device_metadata_node_t) );
+
 	new_dm->id = device;
-	*metadata = &(new_dm->data);
 	SGLIB_LIST_ADD(device_metadata_node_t, g_devices_metadata, new_dm, next_ptr);
 	unlock_metadata();
 	return device;
@@ -111,7 +145,31 @@ result_t device_flush(device_metadata_t *metadata)
 	}
 }
 
-int command_port_send (device_metadata_t *metadata, const byte* command, size_t command_len)
+#ifdef HAVE_LOCKS
+static void port_lock(device_metadata_t *metadata)
+{
+	if (metadata->port_mutex)
+		mutex_lock( metadata->port_mutex );
+}
+
+static void port_unlock(device_metadata_t *metadata)
+{
+	if (metadata->port_mutex)
+		mutex_unlock( metadata->port_mutex );
+}
+#else
+static void port_lock(device_metadata_t *metadata)
+{
+	XIMC_UNUSED(metadata);
+}
+
+static void port_unlock(device_metadata_t *metadata)
+{
+	XIMC_UNUSED(metadata);
+}
+#endif
+
+static int command_port_write (device_metadata_t *metadata, const byte* command, size_t command_len)
 {
 	ssize_t n;
 	unsigned int errcode;
@@ -199,6 +257,63 @@ int command_port_send (device_metadata_t *metadata, const byte* command, size_t
 	return result_serial_ok;
 }
 
+/* A frame is written as a whole, so a stop written out of turn goes between frames of the device lock holder */
+int command_port_send (device_metadata_t *metadata, const byte* command, size_t command_len)
+{
+	int result;
+
+	port_lock( metadata );
+	result = command_port_write( metadata, command, command_len );
+	port_unlock( metadata );
+	return result;
+}
+
+int command_port_send_stop (device_metadata_t *metadata, unsigned int* received)
+{
+	int result;
+
+	port_lock( metadata );
+	*received = metadata->stop_echoes_received;
+	if ((result = command_port_write( metadata, (const byte*)"stop", 4 )) == result_serial_ok)
+		++metadata->stop_echoes_pending;
+	port_unlock( metadata );
+	return result;
+}
+
+int stop_echo_received (device_metadata_t *metadata, unsigned int received)
+{
+	int result;
+
+	port_lock( metadata );
+	result = metadata->stop_echoes_received != received;
+	port_unlock( metadata );
+	return result;
+}
+
+/* Counts an echo of a stop written out of turn, returns 0 if no such echo is expected */
+static int collect_stop_echo (device_metadata_t *metadata)
+{
+	int collected = 0;
+
+	port_lock( metadata );
+	if (metadata->stop_echoes_pending > 0)
+	{
+		--metadata->stop_echoes_pending;
+		++metadata->stop_echoes_received;
+		collected = 1;
+	}
+	port_unlock( metadata );
+	return collected;
+}
+
+/* Forgets stop echoes written out of turn, the port is synchronized and they are lost */
+static void drop_stop_echoes (device_metadata_t *metadata)
+{
+	port_lock( metadata );
+	metadata->stop_echoes_pending = 0;
+	port_unlock( metadata );
+}
+
 int command_port_receive (device_metadata_t *metadata, byte* response, size_t response_len)
 {
 	ssize_t n;
@@ -240,7 +355,10 @@ int command_port_receive (device_metadata_t *metadata, byte* response, size_t re
 		else if (metadata->type == dtVirtual)
 		{
 			// Call reader function (that analyzes a buffer with response)
+			// The scratchpad is also written by a stop out of turn
+			port_lock( metadata );
 			n = read_port_virtual( metadata, response+k, amount );
+			port_unlock( metadata );
 			failed = n < 0;
 		}
 		else if (metadata->type == dtSerial)
@@ -355,6 +473,7 @@ result_t synchronize (device_metadata_t *metadata)
 
 	log_info( L"synchronize: started" );
 
+	drop_stop_echoes( metadata );
 	for (; retry_counter > 0; --retry_counter)
 	{
 		if (send_synchronization_zeroes( metadata ) == 0)
@@ -445,33 +564,36 @@ result_t receive_synchronized (device_metadata_t *metadata, byte* response, size
 	return result;
 }
 
-result_t command_checked_impl (device_t id, const void* command, size_t command_len, byte* response, size_t response_len, int need_sync)
+result_t receive_stop_echo (device_metadata_t *metadata)
 {
+	byte response[4];
 	result_t result;
-	int res;
-	byte errv[4] = { 'e', 'r', 'r', 'v' };
-	byte errd[4] = { 'e', 'r', 'r', 'd' };
-	device_metadata_t* dm;
-
-	if (command_len < 4)
-		return result_error;
+	int pending;
 
-	dm = get_metadata( id );
-	if (!dm)
-	{
-		log_error( L"command_checked_impl cannot get metadata" );
-		return result_error;
-	}
-	if (dm->type == dtUnknown)
+	port_lock( metadata );
+	pending = metadata->stop_echoes_pending;
+	port_unlock( metadata );
+	if (!pending)
+		return result_ok;
+	if ((result = receive_synchronized( metadata, response, 4, 0 )) != result_ok)
+		return result;
+	if (memcmp( "stop", response, (size_t)4 ) != 0 || !collect_stop_echo( metadata ))
 	{
-		log_error( L"command_checked_impl got metadata with fake device" );
+		log_error( L"receive_stop_echo: unexpected answer instead of the stop echo" );
+		device_flush( metadata );
+		drop_stop_echoes( metadata );
 		return result_error;
 	}
+	return result_ok;
+}
 
-	if (response_len && !response)
-	{
-		log_error( L"command_checked can't read to empty buffer" );
-	}
+/* Sends a command and receives the answer */
+static result_t command_exchange (device_metadata_t* dm, const void* command, size_t command_len, byte* response, size_t response_len, int need_sync)
+{
+	result_t result;
+	int res;
+	byte errv[4] = { 'e', 'r', 'r', 'v' };
+	byte errd[4] = { 'e', 'r', 'r', 'd' };
 
 	// send command
 	res = command_port_send( dm, command, command_len );
@@ -490,16 +612,21 @@ result_t command_checked_impl (device_t id, const void* command, size_t command_
 
 	if (response)
 	{
-		// read first byte until it's non-zero
 		do
 		{
-			if ((result = receive_synchronized( dm, response, 1, need_sync )) != result_ok)
-				return result;
-		} while (response[0] == 0);
+			// read first byte until it's non-zero
+			do
+			{
+				if ((result = receive_synchronized( dm, response, 1, need_sync )) != result_ok)
+					return result;
+			} while (response[0] == 0);
 
-		// read three bytes
-		if ((result = receive_synchronized( dm, response+1, 3, need_sync )) != result_ok)
-			return result;
+			// read three bytes
+			if ((result = receive_synchronized( dm, response+1, 3, need_sync )) != result_ok)
+				return result;
+			// skip an echo of a stop written out of turn by command_stop_all
+		} while (memcmp( "stop", response, (size_t)4 ) == 0 && memcmp( command, "stop", (size_t)4 ) != 0 &&
+				collect_stop_echo( dm ));
 
 		// check is it an errv answer
 		if (memcmp( errv, response, (size_t)4 ) == 0)
@@ -536,6 +663,42 @@ result_t command_checked_impl (device_t id, const void* command, size_t command_
 	return result_ok;
 }
 
+result_t command_checked_impl (device_t id, const void* command, size_t command_len, byte* response, size_t response_len, int need_sync)
+{
+	result_t result;
+	device_metadata_t* dm;
+
+	if (command_len < 4)
+		return result_error;
+
+	dm = get_metadata( id );
+	if (!dm)
+	{
+		log_error( L"command_checked_impl cannot get metadata" );
+		return result_error;
+	}
+	if (dm->type == dtUnknown)
+	{
+		log_error( L"command_checked_impl got metadata with fake device" );
+		return result_error;
+	}
+
+	if (response_len && !response)
+	{
+		log_error( L"command_checked can't read to empty buffer" );
+	}
+
+	if (dm->profile_recording)
+		settings_record( dm->profile_recording, command, command_len );
+
+	if (dm->settings_cache && settings_cache_get( dm->settings_cache, command, command_len, response, response_len ))
+		return result_ok;
+	result = command_exchange( dm, command, command_len, response, response_len, need_sync );
+	if (dm->settings_cache)
+		settings_cache_update( dm->settings_cache, command, command_len, response, response_len, result );
+	return result;
+}
+
 /*
  * High-level I/O library accessors
  */
@@ -668,6 +831,19 @@ result_t check_out_atleast_overrun (size_t data_count, size_t buf_size)
 	return result_ok;
 }
 
+int value_checks_enabled (device_t id)
+{
+	device_metadata_t* dm = get_metadata( id );
+	/* an unknown device fails later with its usual error */
+	return dm && !dm->no_value_checks;
+}
+
+result_t value_check_failed (const char* function, const char* field)
+{
+	log_error( L"%hs: value of %hs is out of range, nothing is sent", function, field );
+	return result_value_error;
+}
+
 /*
  * Data accessors
  */
@@ -830,7 +1006,7 @@ void filelog_data(const char* direction, device_type_t type,
 		fp = fopen(filename, "a");
 		if (fp)
 		{
-			fprintf(fp, "TIME\tDIR\tTYPE\tID\tCOMMAND\n");
+			fprintf(fp, "TIME\tDIR\tTYPE\tID\tCOMMAND\tDATA\n");
 		}
 	}
 	if (fp == NULL) { // If we failed to open file then we can't log
@@ -864,6 +1040,13 @@ void filelog_data(const char* direction, device_type_t type,
 		else
 			fprintf(fp, "%c", '.');
 	}
+	/* raw bytes of packets for trace analysis, see xilog */
+	if (*direction != '-')
+	{
+		fprintf(fp, "\t");
+		for (i=0; i<length; i++)
+			fprintf(fp, "%02x", (unsigned char)*(ptr+i));
+	}
 	fprintf(fp, "\n");
 }
 
@@ -929,6 +1112,12 @@ void unlock(device_t id)
 		mutex_unlock( m );
 }
 
+int try_lock(device_t id)
+{
+	mutex_t* m = mutex_by_device_id(id);
+	return m ? mutex_trylock( m ) : 1;
+}
+
 result_t unlocker (device_t id, result_t res)
 {
 	mutex_t* m = mutex_by_device_id(id);
@@ -975,6 +1164,12 @@ void unlock(device_t id)
 	XIMC_UNUSED(id);
 }
 
+int try_lock(device_t id)
+{
+	XIMC_UNUSED(id);
+	return 1;
+}
+
 result_t unlocker (device_t id, result_t res)
 {
 	XIMC_UNUSED(id);
@@ -1156,39 +1351,55 @@ result_t close_port (device_metadata_t *metadata)
  * Opening device
  */
 
-device_t open_device_impl (const char* name, int timeout)
+/* Opens the port of a device into a node which is not in the device list yet, NULL on failure */
+static device_metadata_node_t* open_device_node (const char* name, int timeout)
 {
-	device_t device;
-	result_t result;
+	device_metadata_node_t* node;
 	device_metadata_t* dm;
 
-	device = allocate_metadata(&dm);
-	memset(dm, 0, sizeof(device_metadata_t));
+	node = (device_metadata_node_t*)malloc( sizeof(device_metadata_node_t) );
+	if (!node)
+		return NULL;
+	memset(node, 0, sizeof(device_metadata_node_t));
+	dm = &node->data;
 	/* Port timeout must be set before device open */
 	dm->port_timeout = PORT_TIMEOUT_TIME;
 	/* Logical library timeout */
 	dm->timeout = timeout;
 
 #ifdef HAVE_LOCKS
-	dm->device_mutex = mutex_init( (unsigned int)device );
+	/* the id is not known yet, the nonce only has to differ between open devices */
+	dm->device_mutex = mutex_init( (unsigned int)(size_t)node );
 	if (!dm->device_mutex)
 	{
-		remove_metadata(device);
-		return device_undefined;
+		free(node);
+		return NULL;
+	}
+	dm->port_mutex = mutex_init( (unsigned int)(size_t)&dm->port_mutex );
+	if (!dm->port_mutex)
+	{
+		mutex_close( dm->device_mutex );
+		free(node);
+		return NULL;
 	}
 #endif
 
-	result = open_port( dm, name );
-	if (result != result_ok)
+	if (open_port( dm, name ) != result_ok)
 	{
 #ifdef HAVE_LOCKS
+		mutex_close( dm->port_mutex );
 		mutex_close( dm->device_mutex );
 #endif
-		remove_metadata(device);
-		return device_undefined;
+		free(node);
+		return NULL;
 	}
+	return node;
+}
 
-	return device;
+device_t open_device_impl (const char* name, int timeout)
+{
+	device_metadata_node_t* node = open_device_node( name, timeout );
+	return node ? insert_metadata( node ) : device_undefined;
 }
 
 result_t close_device_impl (device_t* id)
@@ -1207,12 +1418,27 @@ result_t close_device_impl (device_t* id)
 		*id = device_undefined;
 		return result_error;
 	}
+	/* out-of-turn writers finish before the port and the locks are closed */
+	lock_metadata();
+	dm->closing = 1;
+	while (dm->port_users > 0)
+	{
+		unlock_metadata();
+		msec_sleep( SLEEP_WAIT_TIME );
+		lock_metadata();
+	}
+	unlock_metadata();
 #ifdef HAVE_LOCKS
 	if (dm->device_mutex)
 		mutex_close( dm->device_mutex );
+	if (dm->port_mutex)
+		mutex_close( dm->port_mutex );
 #endif
 
 	result = close_port( dm ) == 0 ? result_ok : result_error;
+	correction_table_release( dm->table );
+	free( dm->profile_recording );
+	free( dm->settings_cache );
 	remove_metadata( *id );
 
 	*id = device_undefined;
@@ -1221,144 +1447,44 @@ result_t close_device_impl (device_t* id)
 
 /*The transformation of coordinates from the user to the controller.*/
 result_t normal_correction(device_t* id, float* newPosition)
-{	
-	float curr_pos = 0;
-	unsigned int ind;
-	float cPosition;
-	uint32_t indL, indR, indCur;
+{
 	device_metadata_t* dm;
-	device_corr_table_t* correction;
-	// FILE* fl1;
 
-	cPosition = *newPosition;
-	dm = get_metadata(*id);
-	correction = &(dm->table);	
-	
-	if ((dm->table.X == NULL) || (dm->table.dX == NULL))
-	{
-		return 1;
-	}	
-	
-	if ((correction->len_table > 1) && (correction->len_table < 100))
-	{
-		/*Sets the value to the left of the extreme position.*/
-		if (cPosition <= *(correction->X+0))
-		{
-			curr_pos = cPosition + *(correction->dX+0);
-			*newPosition = curr_pos;
-			return 1;
-		}
-
-		/*Sets the value to the right of the extreme position.*/
-		ind = (unsigned int) (correction->len_table - 1);
-		if (cPosition >= *(correction->X+ind))
-		{
-			curr_pos = cPosition + *(correction->dX+ind);
-			*newPosition = curr_pos;
-			return 1;
-		}
-
-		// fl1 = fopen("report.txt", "w");
-		/*Brute force search*/
-		indL = 0;
-		indR = correction->len_table - 1;
-		do
-		{
-			indCur = indL + ((indR - indL)>>1);
-			// fprintf(fl1, "\n %d %d %d", indL, indR, indCur);
-			if (cPosition >= *(correction->X + indCur)) indL = indCur;
-			else indR = indCur;			
-			if (indR - indL <= 1)
-			{
-				// fprintf(fl1, "\n %d %d", indL, indR);
-				curr_pos = cPosition + (*(correction->dX + indL + 1) - *(correction->dX + indL)) / 
-					(*(correction->X + indL + 1) - *(correction->X + indL))*
-					(cPosition - *(correction->X + indL + 1)) + *(correction->dX + indL + 1);
-				*newPosition = curr_pos;
-				// fprintf(fl1, "\n %f", curr_pos);
-				return 1;
-			}
-		} while (true); 
-		// fclose(fl1);
-	}
-	return 0;
+	if ((dm = get_metadata(*id)) == NULL)
+		return 0;
+	if (dm->table != NULL)
+		*newPosition = (float)correction_forward(dm->table, *newPosition);
+	return 1;
 }
 
 /*The transformation of coordinates from the controller to the user.*/
 result_t rewers_correction(device_t* id, float* newPosition)
 {
-	float curr_pos = 0, pos1, pos2;
-	unsigned int ind;
-	float cPosition;
-	uint32_t indL, indR, indCur;
 	device_metadata_t* dm;
-	device_corr_table_t* correction;
-
-	cPosition = *newPosition;
-	dm = get_metadata(*id);
-	correction = &(dm->table);
 
-	if ((dm->table.X == NULL) || (dm->table.dX == NULL))
-	{
-		return 1;
-	}
-	
-	if ((correction->len_table > 1) && (correction->len_table < 100))
-	{
-		if (cPosition <= (*(correction->X + 0) + *(correction->dX + 0)))
-		{
-			curr_pos = cPosition - *(correction->dX + 0);
-			*newPosition = curr_pos;
-			return 1;
-		}
-		ind = (unsigned int)(correction->len_table - 1);
-		if (cPosition >= (*(correction->X + ind) + *(correction->dX + ind)))
-		{
-			curr_pos = cPosition - *(correction->dX + ind);
-			*newPosition = curr_pos;
-			return 1;
-		}
-
-		/*Brute force search*/
-		indL = 0;
-		indR = correction->len_table - 1;
-		do
-		{
-			indCur = indL + ((indR - indL) >> 1);
-			if (cPosition >= *(correction->X + indCur)) indL = indCur;
-			else indR = indCur;
-
-			if (indR - indL <= 1)
-			{
-				pos1 = *(correction->X + indL) + *(correction->dX + indL);
-				pos2 = *(correction->X + indL + 1) + *(correction->dX + indL + 1);
-
-				curr_pos = cPosition + (*(correction->dX + indL) - *(correction->dX + indL + 1)) /
-					(pos2 - pos1)*(cPosition - pos2) - *(correction->dX + indL + 1);
-				*newPosition = curr_pos;
-				return 1;
-			}
-		} while (true);
-	}
-	return 0;
+	if ((dm = get_metadata(*id)) == NULL)
+		return 0;
+	if (dm->table != NULL)
+		*newPosition = (float)correction_inverse(dm->table, *newPosition);
+	return 1;
 }
 
-/* X Coordinate of the grid. */
-/* dX Deviation. */
-void remov_table(float** X, float** dX)
+/* Replaces device correction table with a table from file, NULL file name clears the table */
+static result_t set_correction_table_impl(device_metadata_t* dm, const char* namefile)
 {
-	free(*X);
-	*X = NULL;
-	free(*dX);
-	*dX = NULL;
-}
+	correction_table_t *table = NULL, *old_table;
+	result_t result = result_ok;
 
-void creat_table(float** X, float** dX)
-{	
-	*X = (float *)malloc(100 * sizeof(float));
-	//memset(X, 0, 100 * sizeof(float));
-	*dX = (float *)malloc(100 * sizeof(float));
-	//memset(dX, 0, 100 * sizeof(float));
+	/* failed load leaves device without a table as before */
+	if (namefile != NULL && (table = correction_table_load(namefile)) == NULL)
+		result = result_error;
+	/* calibration contexts may still hold the old table */
+	lock_metadata();
+	old_table = dm->table;
+	dm->table = table;
+	unlock_metadata();
+	correction_table_release(old_table);
+	return result;
 }
 
 /*
@@ -1371,10 +1497,7 @@ extern "C" {
 
 result_t XIMC_API load_correction_table(device_t* id, const char* namefile)
 {
-	setlocale(LC_NUMERIC, "C");
-	
 	device_metadata_t* dm;
-	FILE * fp = NULL;
 
 	if (*id == device_undefined)
 	{
@@ -1388,92 +1511,12 @@ result_t XIMC_API load_correction_table(device_t* id, const char* namefile)
 		*id = device_undefined;
 		return result_error;
 	}
-
-	if (namefile == NULL)
-	{
-		if (dm->table.X != NULL)
-		{
-			CLEAR_TABLE;
-		}
-		return result_ok;
-	}
-	if (dm->table.X != NULL)
-	{
-		CLEAR_TABLE;
-	}
-
-	fp = fopen(namefile, "r");
-	if (fp == NULL)
-	{
-		log_error(L"error opening calibration table file");
-		return result_error;
-	}
-	dm->table.X = (float *)malloc(100 * sizeof(float));
-	dm->table.dX = (float *)malloc(100 * sizeof(float));
-
-	char c1[100], c2[100];
-	uint32_t i = 0;
-	float f1, f2;
-	int err;
-
-	if (fscanf(fp, "%s%s", c1, c2) != 2)
-	{
-		CLEAR_TABLE_CLOSE_FILE;
-		log_error(L"data error in calibration table file");
-		return result_error;
-	};
-
-	while (true) 
-	{
-		err = fscanf(fp, "%f%f", &f1, &f2);
-		if (err == EOF)
-		{
-			if (i >= 2)
-			{
-				dm->table.len_table = i;
-				fclose(fp);
-				return result_ok;
-			}
-			else
-			{
-				CLEAR_TABLE_CLOSE_FILE;
-				log_error(L"error little data");
-				return result_error;
-			}
-		}
-		if (err != 2)
-		{
-			CLEAR_TABLE_CLOSE_FILE;
-			log_error(L"data error in calibration table file");
-			return result_error;
-		}
-		
-		*(dm->table.X + i) = f1;
-		*(dm->table.dX + i) = f2;
-		if (i >= 1) 
-			if ( (f1 - *(dm->table.X + i - 1) <= 0) || ((f1 + f2) - (*(dm->table.X + i - 1) + *(dm->table.dX + i - 1)) <= 0))
-		{
-				CLEAR_TABLE_CLOSE_FILE;
-				log_error(L"error the data in the table is not monotonous.");
-				return result_error;
-		}
-
-		i++;
-		if (i > 99)
-		{
-			CLEAR_TABLE_CLOSE_FILE;
-			log_error(L"error file contains more than 100 rows of data.");
-			return result_error;
-		}
-	}
+	return set_correction_table_impl(dm, namefile);
 }
 
 result_t XIMC_API set_correction_table(device_t id, const char* namefile)
 {
-	setlocale(LC_NUMERIC, "C");
-	
 	device_metadata_t* dm;
-	FILE * fp = NULL;
 
 	if (id == device_undefined)
 	{
@@ -1484,87 +1527,23 @@ result_t XIMC_API set_correction_table(device_t id, const char* namefile)
 	if (!dm)
 	{
 		log_error(L"could not extract metadata for device");
-		id = device_undefined;
 		return result_error;
 	}
+	return set_correction_table_impl(dm, namefile);
+}
 
-	if (namefile == NULL)
-	{
-		if (dm->table.X != NULL)
-		{
-			CLEAR_TABLE;
-		}
-		return result_ok;
-	}
-	if (dm->table.X != NULL)
-	{
-		CLEAR_TABLE;
-	}
-
-	fp = fopen(namefile, "r");
-	if (fp == NULL)
-	{
-		log_error(L"error opening calibration table file");
-		return result_error;
-	}
-	dm->table.X = (float *)malloc(100 * sizeof(float));
-	dm->table.dX = (float *)malloc(100 * sizeof(float));
-
-	char c1[100], c2[100];
-	uint32_t i = 0;
-	float f1, f2;
-	int err;
+result_t XIMC_API convert_correction_table(const char* source, const char* destination)
+{
+	correction_table_t* table;
+	result_t result;
 
-	if (fscanf(fp, "%s%s", c1, c2) != 2)
-	{
-		CLEAR_TABLE_CLOSE_FILE;
-		log_error(L"data error in calibration table file");
+	if (source == NULL || destination == NULL)
+		return result_value_error;
+	if ((table = correction_table_load(source)) == NULL)
 		return result_error;
-	};
-
-	while (true)
-	{
-		err = fscanf(fp, "%f%f", &f1, &f2);
-		if (err == EOF)
-		{
-			if (i >= 2)
-			{
-				dm->table.len_table = i;
-				fclose(fp);
-				return result_ok;
-			}
-			else
-			{
-				CLEAR_TABLE_CLOSE_FILE;
-				log_error(L"error little data");
-				return result_error;
-			}
-		}
-		if (err != 2)
-		{
-			CLEAR_TABLE_CLOSE_FILE;
-			log_error(L"data error in calibration table file");
-			return result_error;
-		}
-
-		*(dm->table.X + i) = f1;
-		*(dm->table.dX + i) = f2;
-		if (i >= 1)
-		if ((f1 - *(dm->table.X + i - 1) <= 0) || ((f1 + f2) - (*(dm->table.X + i - 1) + *(dm->table.dX + i - 1)) <= 0))
-		{
-			CLEAR_TABLE_CLOSE_FILE;
-			log_error(L"error the data in the table is not monotonous.");
-			return result_error;
-		}
-
-		i++;
-		if (i > 99)
-		{
-			CLEAR_TABLE_CLOSE_FILE;
-			log_error(L"error file contains more than 100 rows of data.");
-			return result_error;
-		}
-	}
+	result = correction_table_save(table, destination);
+	correction_table_release(table);
+	return result;
 }
 
 
@@ -1577,6 +1556,63 @@ device_t XIMC_API open_device (const char* uri)
 	return device;
 }
 
+/* State of one device opened by open_devices */
+typedef struct open_thread_state_t
+{
+	const char* uri;
+	device_t device;
+} open_thread_state_t;
+
+void open_device_thread (void* arg)
+{
+	open_thread_state_t* ts = (open_thread_state_t*)arg;
+	device_metadata_node_t* node = open_device_node( ts->uri, DEFAULT_TIMEOUT_TIME );
+
+	/* only the insertion into the device list is serialized */
+	if (node)
+	{
+		lock_global();
+		ts->device = insert_metadata( node );
+		unlock_global();
+	}
+}
+
+result_t XIMC_API open_devices (const char** uris, int count, device_t* devices, result_t* results)
+{
+	open_thread_state_t* tstates;
+	result_t result = result_ok;
+	int i;
+
+	if (uris == NULL || devices == NULL || count < 0)
+		return result_value_error;
+	if (count == 0)
+		return result_ok;
+
+	tstates = (open_thread_state_t*)malloc( count*sizeof(open_thread_state_t) );
+	if (!tstates)
+		return result_error;
+	for (i = 0; i < count; ++i)
+	{
+		tstates[i].uri = uris[i];
+		tstates[i].device = device_undefined;
+	}
+
+	/* ports are opened concurrently, each thread serializes only its insertion into the device list */
+	if (fork_join( open_device_thread, count, tstates, sizeof(open_thread_state_t) ) != result_ok)
+		log_error( L"fork/join engine failed" );
+
+	for (i = 0; i < count; ++i)
+	{
+		devices[i] = tstates[i].device;
+		if (devices[i] == device_undefined)
+			result = result_error;
+		if (results)
+			results[i] = devices[i] == device_undefined ? result_error : result_ok;
+	}
+	free( tstates );
+	return result;
+}
+
 result_t XIMC_API close_device (device_t* id)
 {
 	result_t result;
@@ -1588,6 +1624,19 @@ result_t XIMC_API close_device (device_t* id)
 	return unlocker_global( result );
 }
 
+result_t XIMC_API enable_value_checks (device_t id, int enable)
+{
+	device_metadata_t* dm;
+
+	if ((dm = get_metadata( id )) == NULL)
+	{
+		log_error( L"could not extract metadata for device" );
+		return result_error;
+	}
+	dm->no_value_checks = !enable;
+	return result_ok;
+}
+
 result_t XIMC_API reset_locks()
 {
 	/* nop */
@@ -1613,6 +1662,22 @@ result_t XIMC_API get_status_calb (device_t id, status_calb_t* state, const cali
 	return unlocker( id, get_status_impl_calb( id, state, calibration ) );
 }
 
+result_t XIMC_API get_status_calb_ctx (device_t id, status_calb_t* state, const calibration_context_t* context)
+{
+	lock( id );
+	return unlocker( id, get_status_impl_calb_ctx( id, state, context ) );
+}
+
+static result_t get_status_multi_one (device_t id, void* state)
+{
+	return get_status( id, (status_t*)state );
+}
+
+result_t XIMC_API get_status_multi (const device_t* ids, int count, status_t* state, result_t* results)
+{
+	return dispatch_get( ids, count, state, sizeof(status_t), get_status_multi_one, results );
+}
+
 #if defined(__cplusplus)
 };
 #endif
@@ -26,11 +26,87 @@ result_t check_in_overrun_without_crc(device_t id, size_t data_count, size_t buf
 result_t check_out_overrun (size_t data_count, size_t buf_size);
 result_t check_out_atleast_overrun (size_t data_count, size_t buf_size);
 
+// host-side checks of set function values against protocol.xi ranges, see enable_value_checks
+int value_checks_enabled (device_t id);
+result_t value_check_failed (const char* function, const char* field);
+
 device_t open_device_impl (const char* name, int timeout);
 result_t close_device_impl (device_t* id);
 
 result_t normal_correction(device_t* id, float* newPosition);
 result_t rewers_correction(device_t* id, float* newPosition);
+/* the same through a calibration context, see calibration.c */
+int calibration_context_valid(const calibration_context_t* context);
+result_t normal_correction_ctx(const calibration_context_t* context, float* newPosition);
+result_t rewers_correction_ctx(const calibration_context_t* context, float* newPosition);
+
+/* Correction table engine (correction.c) */
+correction_table_t* correction_table_create(const double* X, const double* dX, uint32_t length,
+		correction_interpolation_t interpolation);
+correction_table_t* correction_table_load(const char* namefile); /* text or binary, shared by file content */
+result_t correction_table_save(const correction_table_t* table, const char* namefile); /* binary */
+/* tables are shared by devices and calibration contexts */
+correction_table_t* correction_table_retain(correction_table_t* table);
+correction_table_t* correction_table_retain_device(device_metadata_t* dm);
+void correction_table_release(correction_table_t* table);
+/* user coordinate to controller coordinate */
+double correction_forward(const correction_table_t* table, double x);
+/* controller coordinate to user coordinate */
+double correction_inverse(const correction_table_t* table, double y);
+
+/*
+ * Prepared position command, see prepare_command.
+ * Patching changes only the position bytes and updates the CRC with per-byte tables,
+ * CRC16 is linear, so the change of each byte contributes independently.
+ */
+#define PREPARED_PACKET_SIZE 18
+#define PREPARED_PATCH_OFFSET 4
+#define PREPARED_PATCH_SIZE 6
+struct prepared_command_t
+{
+	device_t id;
+	byte packet[PREPARED_PACKET_SIZE];
+	/* CRC change caused by xor of each patched byte with each value */
+	uint16_t crc_delta[PREPARED_PATCH_SIZE][256];
+};
+
+/*
+ * Universal settings commands in protocol order, generated from protocol.xi.
+ * Reader and writer of a command differ only in the first letter and carry the same payload.
+ * The table ends with a NULL name.
+ */
+typedef struct settings_command_t
+{
+	const char* name;
+	/* command code without the g/s prefix */
+	const char* code;
+	/* packet size including the 4-byte code and CRC */
+	unsigned int size;
+	/* reserved payload bytes as offset and size pairs counted after the code, ends with a zero size */
+	const unsigned int* reserved;
+} settings_command_t;
+extern const settings_command_t settings_commands[];
+
+/* Stores a universal settings write into the profile recording of a device (settings.c) */
+void settings_record (byte* recording, const void* command, size_t command_len);
+
+/* Answers a universal settings read from the settings cache of a device, returns 1 if answered (settings.c) */
+int settings_cache_get (byte* cache, const void* command, size_t command_len, byte* response, size_t response_len);
+
+/* Updates or invalidates the settings cache of a device after a command (settings.c) */
+void settings_cache_update (byte* cache, const void* command, size_t command_len, const byte* response, size_t response_len,
+		result_t result);
+
+/* Sends count packets of command_len bytes to devices at once and waits for echoes (dispatch.c) */
+result_t dispatch_group (const device_t* ids, const byte* commands, size_t command_len, int count,
+		result_t* results, unsigned int* skew_us);
+
+/* Reader of one device for dispatch_get, out points to its structure */
+typedef result_t (*dispatch_getter_t)(device_t id, void* out);
+
+/* Runs a reader on devices at once, structure i of out_size bytes is read from ids[i] (dispatch.c) */
+result_t dispatch_get (const device_t* ids, int count, void* out, size_t out_size, dispatch_getter_t getter,
+		result_t* results);
 
 void push_data(byte** where, const void* data, size_t size);
 void push_crc (byte** where, const void* data, size_t size);
@@ -65,23 +141,14 @@ void pop_data(byte** where, void* data, size_t size);
 void pop_str(byte** where, void* data, size_t size);
 void pop_garbage(byte** where, size_t size);
 
+/* Generated code copies payloads through packed structures, like push/pop it relies on a little-endian host.
+ * The size of each structure is checked against the protocol at compile time. */
+#define XI_STATIC_ASSERT(condition, name) typedef char xi_static_assert_ ## name[(condition) ? 1 : -1]
+
 int powi (int x, int n);
 
 #define MAX_ENUM_MICROSTEP_MODE MICROSTEP_MODE_FRAC_256
 
-#define CLEAR_TABLE \
-do { \
-	remov_table(&dm->table.X, &dm->table.dX); \
-	dm->table.len_table = 0; \
-} while (0)
-
-#define CLEAR_TABLE_CLOSE_FILE \
-do { \
-	remov_table(&dm->table.X, &dm->table.dX); \
-	dm->table.len_table = 0; \
-	fclose(fp); \
-} while (0)
-
 #define XI_normal_to_calibrate(fvalue, value, mvalue, coeff) \
 do { \
 	if ((coeff)->MicrostepMode == 0 || (coeff)->MicrostepMode > MAX_ENUM_MICROSTEP_MODE) \
@@ -159,6 +226,98 @@ do {\
 	(value) = (int)((fvalue1 - fvalue2) / (coeff)->A); \
 	(mvalue) = (int)(((fvalue1 - fvalue2) / ((coeff)->A) - (value)) * powi(2, (coeff)->MicrostepMode - 1)); \
 } while (0)
+
+/*
+ * Calibration context, see create_calibration_context.
+ * Conversions give the same results as the macros above; the context is validated like
+ * calibration_t there, the table is taken from the context instead of the device.
+ */
+struct calibration_context_t
+{
+	/* Units per step. */
+	double A;
+	/* Microsteps per step, 2^(MicrostepMode-1), and its reciprocal. */
+	int microstep_divisor;
+	float microstep_scale;
+	/* Correction table of the device, retained by the context, or NULL. */
+	correction_table_t* table;
+};
+
+#define XI_normal_to_calibrate_ctx(fvalue, value, mvalue, ctx) \
+do { \
+	if (!calibration_context_valid(ctx)) \
+		return result_value_error; \
+	(fvalue) = (float)((ctx)->A * ((float)(value) + (float)(mvalue) * (ctx)->microstep_scale)); \
+} while (0)
+
+#define XI_normal_to_calibrate_short_ctx(fvalue, value, ctx) \
+do { \
+	if (!calibration_context_valid(ctx)) \
+		return result_value_error; \
+	(fvalue) = (float)((ctx)->A * (float)(value)); \
+} while (0)
+
+#define XI_calibrate_to_normal_ctx(fvalue, value, mvalue, ctx) \
+do { \
+	double quotient_; \
+	if (!calibration_context_valid(ctx)) \
+		return result_value_error; \
+	quotient_ = (fvalue) / (ctx)->A; \
+	(value) = (int)quotient_; \
+	(mvalue) = (int)((quotient_ - (value)) * (ctx)->microstep_divisor); \
+} while (0)
+
+#define XI_calibrate_to_normal_short_ctx(fvalue, value, ctx) \
+do { \
+	if (!calibration_context_valid(ctx)) \
+		return result_value_error; \
+	(value) = (int)((fvalue) / (ctx)->A); \
+} while (0)
+
+#define XI_normal_to_calibrate_corr_ctx(fvalue, value, mvalue, ctx) \
+do { \
+	XI_normal_to_calibrate_ctx(fvalue, value, mvalue, ctx); \
+	if (rewers_correction_ctx(ctx, &(fvalue)) == 0) \
+		return result_value_error; \
+} while (0)
+
+#define XI_normal_to_calibrate_corr_short_ctx(fvalue, value, ctx) \
+do { \
+	XI_normal_to_calibrate_short_ctx(fvalue, value, ctx); \
+	if (rewers_correction_ctx(ctx, &(fvalue)) == 0) \
+		return result_value_error; \
+} while (0)
+
+#define XI_calibrate_to_normal_corr_ctx(fvalue, value, mvalue, ctx) \
+do { \
+	float fvalue1 = (fvalue); \
+	if (normal_correction_ctx(ctx, &fvalue1) == 0) \
+		return result_value_error; \
+	XI_calibrate_to_normal_ctx(fvalue1, value, mvalue, ctx); \
+} while (0)
+
+#define XI_calibrate_to_normal_corr_short_ctx(fvalue, value, ctx) \
+do { \
+	float fvalue1 = (fvalue); \
+	if (normal_correction_ctx(ctx, &fvalue1) == 0) \
+		return result_value_error; \
+	XI_calibrate_to_normal_short_ctx(fvalue1, value, ctx); \
+} while (0)
+
+#define XI_calibrate_to_normal_Dcorr_ctx(fvalue, value, mvalue, ctx, id) \
+do { \
+	float fvalue1, fvalue2; \
+	get_position_calb_t the_get_position_calb; \
+	if (get_position_calb_ctx(id, &(the_get_position_calb), ctx) != result_ok) \
+		return result_value_error; \
+	fvalue2 = (the_get_position_calb).Position; \
+	fvalue1 = (fvalue) + (fvalue2); \
+	if (normal_correction_ctx(ctx, &fvalue1) == 0) \
+		return result_value_error; \
+	if (normal_correction_ctx(ctx, &fvalue2) == 0) \
+		return result_value_error; \
+	XI_calibrate_to_normal_ctx(fvalue1 - fvalue2, value, mvalue, ctx); \
+} while (0)
 /*
 #define XI_normal_to_calibrate_corr(fvalue, value, mvalue, coeff, table) \
 do {\
@@ -192,6 +351,8 @@ do { \
 void lock(device_t id);
 void unlock(device_t id);
 result_t unlocker (device_t id, result_t res);
+/* Returns non-zero if the device lock is taken without waiting */
+int try_lock(device_t id);
 
 /*
  * Global lock
@@ -200,6 +361,28 @@ void lock_global();
 void unlock_global ();
 result_t unlocker_global (result_t res);
 
+/* String pool chunk of an enumeration in progress */
+typedef struct devenum_arena_chunk_t
+{
+	struct devenum_arena_chunk_t* next;
+	size_t size;
+	size_t used;
+} devenum_arena_chunk_t;
+
+/* Network server queried by an enumeration */
+typedef struct devenum_server_t
+{
+	char* addr;
+	int answered;
+	uint32_t latency_us;
+} devenum_server_t;
+
+/*
+ * Device enumeration results.
+ * Per-device arrays are carved from one allocation which starts at 'names'.
+ * While enumerating, strings live in the arena chunks; when enumeration is done
+ * header, arrays and strings are packed into one block freed with a single free().
+ */
 typedef struct device_enumeration_opaque_t
 {
 	int allocated_count;
@@ -212,6 +395,12 @@ typedef struct device_enumeration_opaque_t
 	controller_name_t* controller_names;
 	stage_name_t* stage_names;
 	device_network_information_t* dev_net_infos;
+	int server_count;
+	devenum_server_t* servers;
+	devenum_arena_chunk_t* arena;
+	char** interned;		// open addressing hash set of arena strings, NULL when packed
+	size_t interned_size;
+	size_t interned_count;
 } device_enumeration_opaque_t;
 
 uint32_t conn_id_by_device_id(device_t id);
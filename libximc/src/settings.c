@@ -0,0 +1,1071 @@
+#include "common.h"
+
+#include "ximc.h"
+#include "util.h"
+#include "metadata.h"
+#include "platform.h"
+#include "protosup.h"
+
+/*
+ * Settings snapshots.
+ *
+ * A snapshot keeps raw payloads of all universal settings commands. A reader answer and
+ * a writer command of one universal command differ only in the code letter, the payload and
+ * its CRC are the same, so payloads are stored as received and written back as they are.
+ *
+ * Layout, little-endian:
+ *   "XISS", uint32 version, uint32 entry count,
+ *   entries: 3-byte command code, uint8 flags, uint16 payload length, payload with CRC.
+ * Entries are matched by command code, so snapshots of other protocol versions can be applied:
+ * codes unknown to this protocol are skipped, a known code must have the payload length of this
+ * protocol. A command unsupported by a device is kept as an empty entry.
+ *
+ * A profile is a snapshot with only the structures it sets. It is recorded once by running
+ * a set_profile_* function from c-profiles against any device, see c-profiles/compile-profiles.sh.
+ *
+ * A profile database keeps all profiles in one file which is copied into memory, little-endian:
+ *   "XIPD", uint32 version, uint32 profile count, uint32 file size,
+ *   records sorted by stage name: uint32 offsets of stage name, vendor and part number strings,
+ *   uint32 profile offset, uint32 profile size,
+ *   uint32 record numbers sorted by part number, then strings and profiles.
+ * Names are compared ignoring ASCII case. The file is read into memory once instead of being mapped:
+ * it is small and compile-profiles.sh may rewrite it while a tool keeps the database open.
+ */
+
+#define SETTINGS_SNAPSHOT_VERSION 1
+#define SETTINGS_SNAPSHOT_HEADER_SIZE 12
+#define SETTINGS_ENTRY_HEADER_SIZE 6
+#define SETTINGS_ENTRY_PRESENT 0x01
+
+/* Longest universal command packet */
+#define SETTINGS_PACKET_MAX 256
+
+/* A profile, its layout is the same as of a snapshot. A loaded profile owns a copy of the file,
+ * a profile found in a database is a view into it and owns nothing */
+struct profile_t
+{
+	byte* copy;
+	const byte* data;
+	unsigned int size;
+};
+
+struct profile_database_t
+{
+	byte* data;
+	unsigned int size;
+	unsigned int count;
+};
+
+#define PROFILE_DATABASE_VERSION 1
+#define PROFILE_DATABASE_HEADER_SIZE 16
+#define PROFILE_RECORD_SIZE 20
+
+/* Offset of the part number in the stage_information payload */
+#define PROFILE_PART_NUMBER_OFFSET 16
+#define PROFILE_PART_NUMBER_SIZE 24
+
+typedef struct profile_record_t
+{
+	const char* stage;
+	const char* vendor;
+	const char* part;
+	unsigned int offset;
+	unsigned int size;
+} profile_record_t;
+
+typedef struct settings_entry_t
+{
+	const byte* code;
+	unsigned int flags;
+	unsigned int length;
+	const byte* payload;
+} settings_entry_t;
+
+static unsigned int settings_snapshot_max_size()
+{
+	const settings_command_t* command;
+	unsigned int size = SETTINGS_SNAPSHOT_HEADER_SIZE;
+
+	for (command = settings_commands; command->name; ++command)
+		size += SETTINGS_ENTRY_HEADER_SIZE + command->size - 4;
+	return size;
+}
+
+/* Checks the header and all entry bounds, returns entry count or -1 */
+static int settings_snapshot_check(const byte* snapshot, unsigned int size)
+{
+	byte* p = (byte*)snapshot;
+	unsigned int count, i, length, offset;
+
+	if (snapshot == NULL || size < SETTINGS_SNAPSHOT_HEADER_SIZE || memcmp( snapshot, "XISS", 4 ) != 0)
+		return -1;
+	p += 4;
+	if (pop_uint32( &p ) != SETTINGS_SNAPSHOT_VERSION)
+		return -1;
+	count = pop_uint32( &p );
+	for (i = 0, offset = SETTINGS_SNAPSHOT_HEADER_SIZE; i < count; ++i)
+	{
+		if (size - offset < SETTINGS_ENTRY_HEADER_SIZE)
+			return -1;
+		p = (byte*)snapshot + offset + 4;
+		length = pop_uint16( &p );
+		offset += SETTINGS_ENTRY_HEADER_SIZE;
+		if (size - offset < length)
+			return -1;
+		offset += length;
+	}
+	return (int)count;
+}
+
+/* Reads the entry at offset and returns the offset of the next one, the snapshot must be checked */
+static unsigned int settings_snapshot_entry(const byte* snapshot, unsigned int offset, settings_entry_t* entry)
+{
+	byte* p = (byte*)snapshot + offset;
+
+	entry->code = p;
+	p += 3;
+	entry->flags = pop_uint8( &p );
+	entry->length = pop_uint16( &p );
+	entry->payload = p;
+	return offset + SETTINGS_ENTRY_HEADER_SIZE + entry->length;
+}
+
+/* Finds a present entry with the same code in a checked snapshot */
+static int settings_snapshot_find(const byte* snapshot, int count, const byte* code, settings_entry_t* entry)
+{
+	unsigned int offset = SETTINGS_SNAPSHOT_HEADER_SIZE;
+	int i;
+
+	for (i = 0; i < count; ++i)
+	{
+		offset = settings_snapshot_entry( snapshot, offset, entry );
+		if ((entry->flags & SETTINGS_ENTRY_PRESENT) && memcmp( entry->code, code, 3 ) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static int settings_entry_changed(const settings_entry_t* entry, const byte* base, int base_count)
+{
+	settings_entry_t old;
+
+	if (base == NULL || !settings_snapshot_find( base, base_count, entry->code, &old ))
+		return 1;
+	return old.length != entry->length || memcmp( old.payload, entry->payload, entry->length ) != 0;
+}
+
+static const settings_command_t* settings_command_find(const byte* code)
+{
+	const settings_command_t* command;
+
+	for (command = settings_commands; command->name; ++command)
+		if (memcmp( command->code, code, 3 ) == 0)
+			return command;
+	return NULL;
+}
+
+static const char* settings_command_name(const byte* code)
+{
+	const settings_command_t* command = settings_command_find( code );
+	return command ? command->name : NULL;
+}
+
+/* Compares data fields of two payloads of a command, reserved bytes and the CRC are skipped */
+static int settings_payload_equal(const settings_command_t* command, const byte* a, const byte* b, unsigned int length)
+{
+	const unsigned int* reserved;
+	unsigned int offset = 0, end;
+
+	if (length < 2)
+		return 0;
+	length -= 2;
+	for (reserved = command->reserved; ; reserved += 2)
+	{
+		end = reserved[1] ? reserved[0] : length;
+		if (memcmp( a + offset, b + offset, end - offset ) != 0)
+			return 0;
+		if (!reserved[1])
+			return 1;
+		offset = reserved[0] + reserved[1];
+	}
+}
+
+/* Fills a recording with empty entries of full size, so an entry has a fixed place */
+static void settings_recording_init(byte* recording)
+{
+	const settings_command_t* command;
+	byte* p = recording;
+	unsigned int count = 0;
+
+	push_str( &p, "XISS" );
+	push_uint32( &p, SETTINGS_SNAPSHOT_VERSION );
+	push_uint32( &p, 0 );
+	for (command = settings_commands; command->name; ++command, ++count)
+	{
+		push_data( &p, (const byte*)command->code, 3 );
+		push_uint8( &p, 0 );
+		push_uint16( &p, command->size - 4 );
+		push_garbage( &p, command->size - 4 );
+	}
+	p = recording + 8;
+	push_uint32( &p, count );
+}
+
+/* Finds the entry of a packet in a recording, returns NULL if the packet is not a universal command */
+static byte* settings_recording_entry(byte* recording, const byte* packet, size_t packet_len)
+{
+	const settings_command_t* c;
+	byte* p = recording + SETTINGS_SNAPSHOT_HEADER_SIZE;
+
+	for (c = settings_commands; c->name; p += SETTINGS_ENTRY_HEADER_SIZE + c->size - 4, ++c)
+		if (c->size == packet_len && memcmp( c->code, packet + 1, 3 ) == 0)
+			return p;
+	return NULL;
+}
+
+void settings_record (byte* recording, const void* command, size_t command_len)
+{
+	const byte* packet = (const byte*)command;
+	byte* p;
+
+	if (packet[0] != 's' || (p = settings_recording_entry( recording, packet, command_len )) == NULL)
+		return;
+	/* the last write of a structure wins */
+	p[3] = SETTINGS_ENTRY_PRESENT;
+	memcpy( p + SETTINGS_ENTRY_HEADER_SIZE, packet + 4, command_len - 4 );
+}
+
+/* Drops all entries of a settings cache */
+static void settings_cache_clear(byte* cache)
+{
+	const settings_command_t* c;
+	byte* p = cache + SETTINGS_SNAPSHOT_HEADER_SIZE;
+
+	for (c = settings_commands; c->name; p += SETTINGS_ENTRY_HEADER_SIZE + c->size - 4, ++c)
+		p[3] = 0;
+}
+
+int settings_cache_get (byte* cache, const void* command, size_t command_len, byte* response, size_t response_len)
+{
+	const byte* packet = (const byte*)command;
+	byte* p;
+
+	if (command_len != 4 || packet[0] != 'g' || response == NULL ||
+			(p = settings_recording_entry( cache, packet, response_len )) == NULL || !(p[3] & SETTINGS_ENTRY_PRESENT))
+		return 0;
+	memcpy( response, packet, 4 );
+	memcpy( response + 4, p + SETTINGS_ENTRY_HEADER_SIZE, response_len - 4 );
+	return 1;
+}
+
+void settings_cache_update (byte* cache, const void* command, size_t command_len, const byte* response, size_t response_len,
+		result_t result)
+{
+	/* these commands change settings inside the controller */
+	static const char* const invalidating[] = { "read", "rers", "eerd", "rest", "clfr" };
+	const byte* packet = (const byte*)command;
+	byte* p;
+	size_t i;
+
+	for (i = 0; i < sizeof(invalidating) / sizeof(invalidating[0]); ++i)
+	{
+		if (memcmp( packet, invalidating[i], 4 ) == 0)
+		{
+			settings_cache_clear( cache );
+			return;
+		}
+	}
+	if (packet[0] == 's' && (p = settings_recording_entry( cache, packet, command_len )) != NULL)
+	{
+		/* the device state is unknown after a failed write */
+		p[3] = result == result_ok ? SETTINGS_ENTRY_PRESENT : 0;
+		memcpy( p + SETTINGS_ENTRY_HEADER_SIZE, packet + 4, command_len - 4 );
+	}
+	else if (packet[0] == 'g' && command_len == 4 && result == result_ok && response != NULL &&
+			(p = settings_recording_entry( cache, packet, response_len )) != NULL &&
+			get_crc( response + 4, response_len - 6 ) == (uint16_t)(response[response_len - 2] | response[response_len - 1] << 8))
+	{
+		p[3] = SETTINGS_ENTRY_PRESENT;
+		memcpy( p + SETTINGS_ENTRY_HEADER_SIZE, response + 4, response_len - 4 );
+	}
+}
+
+/* Copies present entries of a checked snapshot, returns the size of the copy */
+static unsigned int settings_snapshot_compact(const byte* snapshot, int entries, byte* out)
+{
+	settings_entry_t entry;
+	unsigned int offset = SETTINGS_SNAPSHOT_HEADER_SIZE, count = 0;
+	byte* p = out + SETTINGS_SNAPSHOT_HEADER_SIZE;
+	int i;
+
+	for (i = 0; i < entries; ++i)
+	{
+		offset = settings_snapshot_entry( snapshot, offset, &entry );
+		if (!(entry.flags & SETTINGS_ENTRY_PRESENT))
+			continue;
+		push_data( &p, entry.code, 3 );
+		push_uint8( &p, entry.flags );
+		push_uint16( &p, entry.length );
+		push_data( &p, entry.payload, entry.length );
+		++count;
+	}
+	memcpy( out, snapshot, 8 );
+	offset = (unsigned int)(p - out);
+	p = out + 8;
+	push_uint32( &p, count );
+	return offset;
+}
+
+/* Compares ASCII strings ignoring case */
+static int profile_name_compare(const char* a, const char* b)
+{
+	int ca, cb;
+
+	for (;; ++a, ++b)
+	{
+		ca = (*a >= 'A' && *a <= 'Z') ? *a - 'A' + 'a' : (unsigned char)*a;
+		cb = (*b >= 'A' && *b <= 'Z') ? *b - 'A' + 'a' : (unsigned char)*b;
+		if (ca != cb || !ca)
+			return ca - cb;
+	}
+}
+
+static void profile_database_record(const profile_database_t* database, unsigned int index, profile_record_t* record)
+{
+	byte* p = (byte*)database->data + PROFILE_DATABASE_HEADER_SIZE + index * PROFILE_RECORD_SIZE;
+
+	record->stage = (const char*)database->data + pop_uint32( &p );
+	record->vendor = (const char*)database->data + pop_uint32( &p );
+	record->part = (const char*)database->data + pop_uint32( &p );
+	record->offset = pop_uint32( &p );
+	record->size = pop_uint32( &p );
+}
+
+static unsigned int profile_database_part_record(const profile_database_t* database, unsigned int index)
+{
+	byte* p = (byte*)database->data + PROFILE_DATABASE_HEADER_SIZE + database->count * PROFILE_RECORD_SIZE + index * 4;
+	return pop_uint32( &p );
+}
+
+static int profile_string_valid(const byte* data, unsigned int size, unsigned int offset)
+{
+	return offset < size && memchr( data + offset, 0, size - offset ) != NULL;
+}
+
+/* Checks the header, bounds of every record and profile, returns the profile count or -1 */
+static int profile_database_check(const byte* data, unsigned int size)
+{
+	byte* p = (byte*)data;
+	unsigned int count, i, stage, vendor, part, offset, length;
+
+	if (size < PROFILE_DATABASE_HEADER_SIZE || memcmp( data, "XIPD", 4 ) != 0)
+		return -1;
+	p += 4;
+	if (pop_uint32( &p ) != PROFILE_DATABASE_VERSION)
+		return -1;
+	count = pop_uint32( &p );
+	if (pop_uint32( &p ) != size || count > (size - PROFILE_DATABASE_HEADER_SIZE) / (PROFILE_RECORD_SIZE + 4))
+		return -1;
+	for (i = 0; i < count; ++i)
+	{
+		stage = pop_uint32( &p );
+		vendor = pop_uint32( &p );
+		part = pop_uint32( &p );
+		offset = pop_uint32( &p );
+		length = pop_uint32( &p );
+		if (!profile_string_valid( data, size, stage ) || !profile_string_valid( data, size, vendor ) ||
+				!profile_string_valid( data, size, part ) || offset > size || size - offset < length ||
+				settings_snapshot_check( data + offset, length ) < 0)
+			return -1;
+	}
+	for (i = 0; i < count; ++i)
+		if (pop_uint32( &p ) >= count)
+			return -1;
+	return (int)count;
+}
+
+/* First record of the stage in the stage index or the part index, returns -1 if there is none */
+static int profile_database_lower_bound(const profile_database_t* database, const char* name, int by_part)
+{
+	profile_record_t record;
+	unsigned int low = 0, high = database->count, middle;
+
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
+		profile_database_record( database, by_part ? profile_database_part_record( database, middle ) : middle, &record );
+		if (profile_name_compare( by_part ? record.part : record.stage, name ) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/* Finds a record by stage name or part number and optionally vendor */
+static int profile_database_find(const profile_database_t* database, const char* vendor, const char* stage,
+		profile_record_t* record)
+{
+	unsigned int i;
+	int by_part;
+
+	if (*stage == '\0')
+		return 0;
+	for (by_part = 0; by_part < 2; ++by_part)
+	{
+		for (i = profile_database_lower_bound( database, stage, by_part ); i < database->count; ++i)
+		{
+			profile_database_record( database, by_part ? profile_database_part_record( database, i ) : i, record );
+			if (profile_name_compare( by_part ? record->part : record->stage, stage ) != 0)
+				break;
+			if (vendor == NULL || profile_name_compare( record->vendor, vendor ) == 0)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+typedef struct profile_source_t
+{
+	char stage[64];
+	char vendor[64];
+	char part[PROFILE_PART_NUMBER_SIZE + 1];
+	file_mapping_t* mapping;
+	const byte* data;
+	unsigned int size;
+	unsigned int offset;
+} profile_source_t;
+
+static int profile_source_compare_stage(const void* a, const void* b)
+{
+	const profile_source_t* sa = *(const profile_source_t* const*)a;
+	const profile_source_t* sb = *(const profile_source_t* const*)b;
+	int result = profile_name_compare( sa->stage, sb->stage );
+	return result ? result : profile_name_compare( sa->vendor, sb->vendor );
+}
+
+static int profile_source_compare_part(const void* a, const void* b)
+{
+	const profile_source_t* sa = *(const profile_source_t* const*)a;
+	const profile_source_t* sb = *(const profile_source_t* const*)b;
+	int result = profile_name_compare( sa->part, sb->part );
+	return result ? result : profile_source_compare_stage( a, b );
+}
+
+/* Takes stage and vendor names from a path like <vendor>/<stage>.xiprof */
+static void profile_source_names(const char* path, profile_source_t* source)
+{
+	const char *name = path, *vendor = NULL, *c, *dot = NULL;
+	size_t length;
+
+	for (c = path; *c; ++c)
+	{
+		if (*c == '/' || *c == '\\')
+		{
+			vendor = name;
+			name = c + 1;
+		}
+	}
+	for (c = name; *c; ++c)
+		if (*c == '.')
+			dot = c;
+	length = (dot ? (size_t)(dot - name) : strlen( name ));
+	if (length >= sizeof(source->stage))
+		length = sizeof(source->stage) - 1;
+	memcpy( source->stage, name, length );
+	source->stage[length] = '\0';
+	length = vendor ? (size_t)(name - 1 - vendor) : 0;
+	if (length >= sizeof(source->vendor))
+		length = sizeof(source->vendor) - 1;
+	if (length)
+		memcpy( source->vendor, vendor, length );
+	source->vendor[length] = '\0';
+}
+
+/* Reads one packet of a universal command from a locked device */
+static result_t settings_read_packet(device_t id, const byte* code, byte* response, unsigned int size)
+{
+	byte request[4];
+	result_t result;
+
+	if (size > SETTINGS_PACKET_MAX)
+		return result_error;
+	request[0] = 'g';
+	memcpy( request + 1, code, 3 );
+	if ((result = command_checked( id, request, 4, response, size )) != result_ok)
+		return result;
+	return check_in_overrun( id, size - 2, size, response );
+}
+
+/* Reads all settings into a snapshot of settings_snapshot_max_size bytes, the device must be locked */
+static result_t settings_snapshot_read(device_t id, byte* snapshot, unsigned int* snapshot_size)
+{
+	const settings_command_t* command;
+	byte response[SETTINGS_PACKET_MAX];
+	byte* p = snapshot;
+	unsigned int count = 0;
+	result_t result;
+
+	push_str( &p, "XISS" );
+	push_uint32( &p, SETTINGS_SNAPSHOT_VERSION );
+	push_uint32( &p, 0 );
+	for (command = settings_commands; command->name; ++command, ++count)
+	{
+		push_data( &p, (const byte*)command->code, 3 );
+		if ((result = settings_read_packet( id, (const byte*)command->code, response, command->size )) == result_nodevice)
+			return result;
+		if (result != result_ok)
+		{
+			/* not supported by the device, for example an absent stage EEPROM */
+			log_debug( L"settings snapshot: %hs is not read", command->name );
+			push_uint8( &p, 0 );
+			push_uint16( &p, 0 );
+			continue;
+		}
+		push_uint8( &p, SETTINGS_ENTRY_PRESENT );
+		push_uint16( &p, command->size - 4 );
+		push_data( &p, response + 4, command->size - 4 );
+	}
+	*snapshot_size = (unsigned int)(p - snapshot);
+	p = snapshot + 8;
+	push_uint32( &p, count );
+	return result_ok;
+}
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+result_t XIMC_API get_settings_snapshot(device_t id, uint8_t* snapshot, unsigned int size, unsigned int* snapshot_size)
+{
+	unsigned int need = settings_snapshot_max_size();
+
+	if (snapshot_size == NULL)
+		return result_value_error;
+	if (snapshot == NULL || size < need)
+	{
+		*snapshot_size = need;
+		return snapshot == NULL ? result_ok : result_value_error;
+	}
+	lock( id );
+	return unlocker( id, settings_snapshot_read( id, snapshot, snapshot_size ) );
+}
+
+result_t XIMC_API diff_settings_snapshots(const uint8_t* base, unsigned int base_size,
+		const uint8_t* snapshot, unsigned int size, char* changed, unsigned int changed_size, unsigned int* count)
+{
+	settings_entry_t entry;
+	unsigned int offset = SETTINGS_SNAPSHOT_HEADER_SIZE, used = 0, length;
+	int base_count, entries, i;
+	char name[8];
+	const char* entry_name;
+
+	if ((base_count = settings_snapshot_check( base, base_size )) < 0 ||
+			(entries = settings_snapshot_check( snapshot, size )) < 0)
+	{
+		log_error( L"settings snapshot is damaged or has unknown version" );
+		return result_value_error;
+	}
+	if (count)
+		*count = 0;
+	if (changed && changed_size)
+		changed[0] = '\0';
+	for (i = 0; i < entries; ++i)
+	{
+		offset = settings_snapshot_entry( snapshot, offset, &entry );
+		if (!(entry.flags & SETTINGS_ENTRY_PRESENT) || !settings_entry_changed( &entry, base, base_count ))
+			continue;
+		if (count)
+			++*count;
+		if ((entry_name = settings_command_name( entry.code )) == NULL)
+		{
+			/* a command of another protocol version */
+			memcpy( name, entry.code, 3 );
+			name[3] = '\0';
+			entry_name = name;
+		}
+		/* names are separated with commas, the list is cut before the first name which does not fit */
+		length = (unsigned int)strlen( entry_name ) + (used ? 1 : 0);
+		if (changed && used < changed_size)
+		{
+			if (used + length < changed_size)
+				portable_snprintf( changed + used, changed_size - used, used ? ",%s" : "%s", entry_name );
+			used += length;
+		}
+	}
+	return result_ok;
+}
+
+result_t XIMC_API apply_settings_snapshot(device_t id, const uint8_t* snapshot, unsigned int size,
+		const uint8_t* base, unsigned int base_size, unsigned int* written)
+{
+	const settings_command_t* known;
+	settings_entry_t entry;
+	byte command[SETTINGS_PACKET_MAX];
+	unsigned int offset = SETTINGS_SNAPSHOT_HEADER_SIZE;
+	int base_count = 0, entries, i;
+	result_t result = result_ok, write_result;
+
+	if ((entries = settings_snapshot_check( snapshot, size )) < 0 ||
+			(base != NULL && (base_count = settings_snapshot_check( base, base_size )) < 0))
+	{
+		log_error( L"settings snapshot is damaged or has unknown version" );
+		return result_value_error;
+	}
+	if (written)
+		*written = 0;
+	/* nothing is written if a structure does not match the protocol */
+	for (i = 0; i < entries; ++i)
+	{
+		offset = settings_snapshot_entry( snapshot, offset, &entry );
+		if ((entry.flags & SETTINGS_ENTRY_PRESENT) && (known = settings_command_find( entry.code )) != NULL &&
+				(entry.length + 4 != known->size || known->size > sizeof(command)))
+		{
+			log_error( L"settings snapshot: %hs has length %u instead of %u", known->name, entry.length, known->size - 4 );
+			return result_value_error;
+		}
+	}
+
+	lock( id );
+	for (i = 0, offset = SETTINGS_SNAPSHOT_HEADER_SIZE; i < entries; ++i)
+	{
+		offset = settings_snapshot_entry( snapshot, offset, &entry );
+		if (!(entry.flags & SETTINGS_ENTRY_PRESENT))
+			continue;
+		if ((known = settings_command_find( entry.code )) == NULL)
+		{
+			log_debug( L"settings snapshot: %hc%hc%hc is not a settings command of this protocol, skipped",
+					entry.code[0], entry.code[1], entry.code[2] );
+			continue;
+		}
+		if (base != NULL)
+		{
+			if (!settings_entry_changed( &entry, base, base_count ))
+				continue;
+		}
+		/* without a base each structure is compared with the device before writing, reserved
+		 * bytes are not kept by a device and are not compared */
+		else if (settings_read_packet( id, entry.code, command, entry.length + 4 ) == result_ok &&
+				settings_payload_equal( known, command + 4, entry.payload, entry.length ))
+			continue;
+		command[0] = 's';
+		memcpy( command + 1, entry.code, 3 );
+		memcpy( command + 4, entry.payload, entry.length );
+		/* a structure unsupported by the device does not stop the others */
+		if ((write_result = command_checked_echo( id, command, entry.length + 4 )) == result_ok)
+		{
+			if (written)
+				++*written;
+		}
+		else if (result == result_ok)
+			result = write_result;
+		if (write_result == result_nodevice)
+			break;
+	}
+	return unlocker( id, result );
+}
+
+result_t XIMC_API start_profile_recording(device_t id)
+{
+	device_metadata_t* dm;
+	byte* recording;
+
+	if ((dm = get_metadata( id )) == NULL)
+	{
+		log_error( L"could not extract metadata for device" );
+		return result_error;
+	}
+	if ((recording = (byte*)malloc( settings_snapshot_max_size() )) == NULL)
+		return result_error;
+	settings_recording_init( recording );
+	lock( id );
+	free( dm->profile_recording );
+	dm->profile_recording = recording;
+	unlock( id );
+	return result_ok;
+}
+
+result_t XIMC_API stop_profile_recording(device_t id, uint8_t* profile, unsigned int size, unsigned int* profile_size)
+{
+	device_metadata_t* dm;
+	byte* recording;
+	int entries;
+
+	if (profile_size == NULL)
+		return result_value_error;
+	if ((dm = get_metadata( id )) == NULL)
+	{
+		log_error( L"could not extract metadata for device" );
+		return result_error;
+	}
+	lock( id );
+	if ((recording = dm->profile_recording) == NULL)
+	{
+		log_error( L"profile is not being recorded" );
+		return unlocker( id, result_error );
+	}
+	entries = settings_snapshot_check( recording, settings_snapshot_max_size() );
+	if (profile == NULL || size < settings_snapshot_max_size())
+	{
+		/* recording goes on until a buffer of enough size is given */
+		*profile_size = settings_snapshot_max_size();
+		return unlocker( id, profile == NULL ? result_ok : result_value_error );
+	}
+	*profile_size = settings_snapshot_compact( recording, entries, profile );
+	dm->profile_recording = NULL;
+	unlock( id );
+	free( recording );
+	return result_ok;
+}
+
+result_t XIMC_API load_profile(const char* name, profile_t** profile)
+{
+	file_mapping_t* mapping;
+	profile_t* pf;
+	const void* data;
+	size_t size;
+
+	if (name == NULL || profile == NULL)
+		return result_value_error;
+	*profile = NULL;
+	if ((pf = (profile_t*)malloc( sizeof(profile_t) )) == NULL)
+		return result_error;
+	if ((mapping = map_file( name, &data, &size )) == NULL)
+	{
+		log_error( L"can't read profile %hs", name );
+		free( pf );
+		return result_error;
+	}
+	/* the file is copied, so it may be rewritten while the profile is loaded */
+	if ((pf->copy = (byte*)malloc( size ? size : 1 )) != NULL)
+		memcpy( pf->copy, data, size );
+	unmap_file( mapping );
+	if (pf->copy == NULL)
+	{
+		free( pf );
+		return result_error;
+	}
+	pf->data = pf->copy;
+	pf->size = (unsigned int)size;
+	if (size > UINT_MAX || settings_snapshot_check( pf->data, pf->size ) < 0)
+	{
+		log_error( L"profile %hs is damaged or has unknown version", name );
+		free_profile( pf );
+		return result_value_error;
+	}
+	*profile = pf;
+	return result_ok;
+}
+
+result_t XIMC_API free_profile(profile_t* profile)
+{
+	if (profile == NULL)
+		return result_ok;
+	free( profile->copy );
+	free( profile );
+	return result_ok;
+}
+
+result_t XIMC_API apply_profile(device_t id, const profile_t* profile, unsigned int* written)
+{
+	if (profile == NULL)
+		return result_value_error;
+	return apply_settings_snapshot( id, profile->data, profile->size, NULL, 0, written );
+}
+
+/* Takes the part number from the stage_information structure of a profile */
+static void profile_source_part(profile_source_t* source)
+{
+	const settings_command_t* command;
+	settings_entry_t entry;
+	int count = settings_snapshot_check( source->data, source->size );
+
+	source->part[0] = '\0';
+	for (command = settings_commands; command->name; ++command)
+		if (strcmp( command->name, "stage_information" ) == 0)
+			break;
+	if (command->name == NULL || !settings_snapshot_find( source->data, count, (const byte*)command->code, &entry ) ||
+			entry.length < PROFILE_PART_NUMBER_OFFSET + PROFILE_PART_NUMBER_SIZE)
+		return;
+	memcpy( source->part, entry.payload + PROFILE_PART_NUMBER_OFFSET, PROFILE_PART_NUMBER_SIZE );
+	source->part[PROFILE_PART_NUMBER_SIZE] = '\0';
+}
+
+static void profile_database_write_string(byte* data, unsigned int* offset, const char* string)
+{
+	size_t length = strlen( string ) + 1;
+	memcpy( data + *offset, string, length );
+	*offset += (unsigned int)length;
+}
+
+result_t XIMC_API create_profile_database(const char* database, const char* const* profiles, int count)
+{
+	profile_source_t* sources = NULL;
+	profile_source_t** order = NULL;
+	byte *data = NULL, *p;
+	unsigned int size, strings, blobs;
+	result_t result = result_error;
+	FILE* fp;
+	int i, ok;
+
+	if (database == NULL || (profiles == NULL && count > 0) || count < 0)
+		return result_value_error;
+	if ((sources = (profile_source_t*)calloc( count + 1, sizeof(profile_source_t) )) == NULL ||
+			(order = (profile_source_t**)malloc( (count + 1) * sizeof(profile_source_t*) )) == NULL)
+		goto cleanup;
+
+	size = PROFILE_DATABASE_HEADER_SIZE + count * (PROFILE_RECORD_SIZE + 4);
+	for (i = 0; i < count; ++i)
+	{
+		const void* mapped;
+		size_t mapped_size;
+
+		if ((sources[i].mapping = map_file( profiles[i], &mapped, &mapped_size )) == NULL)
+		{
+			log_error( L"can't read profile %hs", profiles[i] );
+			goto cleanup;
+		}
+		sources[i].data = (const byte*)mapped;
+		sources[i].size = (unsigned int)mapped_size;
+		if (mapped_size > UINT_MAX || settings_snapshot_check( sources[i].data, sources[i].size ) < 0)
+		{
+			log_error( L"profile %hs is damaged or has unknown version", profiles[i] );
+			result = result_value_error;
+			goto cleanup;
+		}
+		profile_source_names( profiles[i], &sources[i] );
+		profile_source_part( &sources[i] );
+		size += (unsigned int)(strlen( sources[i].stage ) + strlen( sources[i].vendor ) + strlen( sources[i].part ) + 3);
+		size += sources[i].size;
+		order[i] = &sources[i];
+	}
+	if ((data = (byte*)malloc( size )) == NULL)
+		goto cleanup;
+
+	/* strings and profiles go in the order of records, records of one stage are close then */
+	qsort( order, count, sizeof(profile_source_t*), profile_source_compare_stage );
+	strings = PROFILE_DATABASE_HEADER_SIZE + count * (PROFILE_RECORD_SIZE + 4);
+	blobs = size;
+	for (i = 0; i < count; ++i)
+		blobs -= order[i]->size;
+	p = data;
+	memcpy( p, "XIPD", 4 );
+	p += 4;
+	push_uint32( &p, PROFILE_DATABASE_VERSION );
+	push_uint32( &p, count );
+	push_uint32( &p, size );
+	for (i = 0; i < count; ++i)
+	{
+		push_uint32( &p, strings );
+		profile_database_write_string( data, &strings, order[i]->stage );
+		push_uint32( &p, strings );
+		profile_database_write_string( data, &strings, order[i]->vendor );
+		push_uint32( &p, strings );
+		profile_database_write_string( data, &strings, order[i]->part );
+		order[i]->offset = blobs;
+		push_uint32( &p, blobs );
+		push_uint32( &p, order[i]->size );
+		memcpy( data + blobs, order[i]->data, order[i]->size );
+		blobs += order[i]->size;
+	}
+	/* part number index refers to records, their numbers are kept in offsets */
+	for (i = 0; i < count; ++i)
+		order[i]->offset = i;
+	qsort( order, count, sizeof(profile_source_t*), profile_source_compare_part );
+	for (i = 0; i < count; ++i)
+		push_uint32( &p, order[i]->offset );
+
+	if ((fp = fopen( database, "wb" )) == NULL)
+	{
+		log_system_error( L"can't create profile database %hs due to ", database );
+		goto cleanup;
+	}
+	ok = fwrite( data, size, 1, fp ) == 1;
+	if (fclose( fp ) != 0 || !ok)
+	{
+		log_system_error( L"can't write profile database %hs due to ", database );
+		goto cleanup;
+	}
+	result = result_ok;
+
+cleanup:
+	if (sources)
+		for (i = 0; i < count; ++i)
+			unmap_file( sources[i].mapping );
+	free( sources );
+	free( order );
+	free( data );
+	return result;
+}
+
+result_t XIMC_API open_profile_database(const char* name, profile_database_t** database)
+{
+	file_mapping_t* mapping;
+	profile_database_t* db;
+	const void* data;
+	size_t size;
+	int count;
+
+	if (name == NULL || database == NULL)
+		return result_value_error;
+	*database = NULL;
+	if ((db = (profile_database_t*)malloc( sizeof(profile_database_t) )) == NULL)
+		return result_error;
+	if ((mapping = map_file( name, &data, &size )) == NULL)
+	{
+		log_error( L"can't read profile database %hs", name );
+		free( db );
+		return result_error;
+	}
+	/* the file is copied, so it may be rebuilt while the database is open */
+	if ((db->data = (byte*)malloc( size ? size : 1 )) != NULL)
+		memcpy( db->data, data, size );
+	unmap_file( mapping );
+	if (db->data == NULL)
+	{
+		free( db );
+		return result_error;
+	}
+	db->size = (unsigned int)size;
+	if (size > UINT_MAX || (count = profile_database_check( db->data, db->size )) < 0)
+	{
+		log_error( L"profile database %hs is damaged or has unknown version", name );
+		close_profile_database( db );
+		return result_value_error;
+	}
+	db->count = count;
+	*database = db;
+	return result_ok;
+}
+
+result_t XIMC_API close_profile_database(profile_database_t* database)
+{
+	if (database == NULL)
+		return result_ok;
+	free( database->data );
+	free( database );
+	return result_ok;
+}
+
+result_t XIMC_API find_profile(const profile_database_t* database, const char* vendor, const char* stage,
+		profile_t** profile)
+{
+	profile_record_t record;
+	profile_t* pf;
+
+	if (database == NULL || stage == NULL || profile == NULL)
+		return result_value_error;
+	*profile = NULL;
+	if (!profile_database_find( database, vendor, stage, &record ))
+		return result_error;
+	if ((pf = (profile_t*)malloc( sizeof(profile_t) )) == NULL)
+		return result_error;
+	/* the profile is a view into the database */
+	pf->copy = NULL;
+	pf->data = database->data + record.offset;
+	pf->size = record.size;
+	*profile = pf;
+	return result_ok;
+}
+
+result_t XIMC_API apply_profile_by_stage_name(device_t id, const profile_database_t* database, unsigned int* written)
+{
+	stage_name_t stage_name;
+	stage_information_t stage_information;
+	profile_record_t record;
+	profile_t profile;
+	result_t result;
+	int found = 0;
+
+	if (written)
+		*written = 0;
+	if (database == NULL)
+		return result_value_error;
+	if ((result = get_stage_name( id, &stage_name )) == result_nodevice)
+		return result;
+	if (result == result_ok)
+	{
+		stage_name.PositionerName[sizeof(stage_name.PositionerName) - 1] = '\0';
+		found = profile_database_find( database, NULL, stage_name.PositionerName, &record );
+	}
+	/* a stage name is set by the user, a part number is kept in EEPROM of the stage */
+	if (!found && (result = get_stage_information( id, &stage_information )) == result_ok)
+	{
+		stage_information.PartNumber[sizeof(stage_information.PartNumber) - 1] = '\0';
+		stage_information.Manufacturer[sizeof(stage_information.Manufacturer) - 1] = '\0';
+		found = profile_database_find( database, stage_information.Manufacturer, stage_information.PartNumber, &record ) ||
+			profile_database_find( database, NULL, stage_information.PartNumber, &record );
+	}
+	if (result == result_nodevice)
+		return result;
+	if (!found)
+	{
+		log_error( L"no profile for the stage in the database" );
+		return result_error;
+	}
+	profile.copy = NULL;
+	profile.data = database->data + record.offset;
+	profile.size = record.size;
+	return apply_profile( id, &profile, written );
+}
+
+result_t XIMC_API enable_settings_cache(device_t id, int enable)
+{
+	device_metadata_t* dm;
+	byte* cache = NULL;
+
+	if ((dm = get_metadata( id )) == NULL)
+	{
+		log_error( L"could not extract metadata for device" );
+		return result_error;
+	}
+	if (enable)
+	{
+		if ((cache = (byte*)malloc( settings_snapshot_max_size() )) == NULL)
+			return result_error;
+		settings_recording_init( cache );
+	}
+	lock( id );
+	if (enable && dm->settings_cache)
+	{
+		/* already enabled, keep the cached settings */
+		unlock( id );
+		free( cache );
+		return result_ok;
+	}
+	free( dm->settings_cache );
+	dm->settings_cache = cache;
+	unlock( id );
+	return result_ok;
+}
+
+result_t XIMC_API refresh_settings_cache(device_t id)
+{
+	const settings_command_t* command;
+	device_metadata_t* dm;
+	byte response[SETTINGS_PACKET_MAX];
+
+	if ((dm = get_metadata( id )) == NULL)
+	{
+		log_error( L"could not extract metadata for device" );
+		return result_error;
+	}
+	lock( id );
+	if (dm->settings_cache == NULL)
+	{
+		log_error( L"settings cache is not enabled" );
+		return unlocker( id, result_error );
+	}
+	settings_cache_clear( dm->settings_cache );
+	/* successful reads fill the cache, unsupported structures stay uncached */
+	for (command = settings_commands; command->name; ++command)
+		if (settings_read_packet( id, (const byte*)command->code, response, command->size ) == result_nodevice)
+			return unlocker( id, result_nodevice );
+	return unlocker( id, result_ok );
+}
+
+#if defined(__cplusplus)
+};
+#endif
+
+// vim: syntax=c tabstop=4 shiftwidth=4
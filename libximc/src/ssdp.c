@@ -0,0 +1,474 @@
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#if defined(WIN32) || defined(WIN64)
+#include <winsock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#endif
+
+#include "ximc.h"
+#include "util.h"
+#include "metadata.h"
+#include "platform.h"
+#include "protosup.h"
+
+/*
+ * Persistent SSDP listener.
+ * Joins the SSDP multicast group, collects NOTIFY announcements and M-SEARCH
+ * responses of XIMC network adapters and keeps them with their max-age.
+ * Device enumeration reads this cache instead of running a blocking discovery.
+ */
+
+#if defined(WIN32) || defined(WIN64)
+typedef SOCKET ssdp_socket_t;
+#define SSDP_INVALID_SOCKET INVALID_SOCKET
+#define ssdp_close_socket closesocket
+#else
+typedef int ssdp_socket_t;
+#define SSDP_INVALID_SOCKET (-1)
+#define ssdp_close_socket close
+#endif
+
+#define SSDP_MULTICAST_ADDR "239.255.255.250"
+#define SSDP_PORT 1900
+
+// MX value of our M-SEARCH requests, in seconds
+#define SSDP_MX 2
+
+// how often M-SEARCH is repeated to refresh the cache, in msec
+#define SSDP_SEARCH_INTERVAL_TIME 60000
+
+// max-age used when an announcement has no CACHE-CONTROL header, in sec
+#define SSDP_DEFAULT_MAX_AGE 1800
+
+// listener wakeup period to check the stop request, in msec
+#define SSDP_POLL_TIME 200
+
+#define SSDP_CACHE_SIZE 64
+#define SSDP_USN_LEN 128
+#define SSDP_URI_LEN 64
+
+typedef struct ssdp_entry_t
+{
+	char usn[SSDP_USN_LEN];
+	char uri[SSDP_URI_LEN];
+	uint64_t expire_us;
+} ssdp_entry_t;
+
+typedef struct ssdp_listener_t
+{
+	ssdp_socket_t sock;
+	volatile int running;
+	volatile int stop_request;
+	uint64_t started_us;
+	uint64_t last_search_us;
+	int count;
+	ssdp_entry_t entries[SSDP_CACHE_SIZE];
+} ssdp_listener_t;
+
+/* zero initialized, the socket is opened by start_ssdp_listener and is valid only while the listener runs */
+static ssdp_listener_t g_ssdp;
+
+#ifdef HAVE_LOCKS
+static mutex_t* g_mutex_ssdp = NULL;
+
+static void ssdp_lock()
+{
+	/* created under the global lock by start_ssdp_listener */
+	if (g_mutex_ssdp)
+		mutex_lock( g_mutex_ssdp );
+}
+
+static void ssdp_unlock()
+{
+	if (g_mutex_ssdp)
+		mutex_unlock( g_mutex_ssdp );
+}
+#else
+static void ssdp_lock()
+{
+}
+
+static void ssdp_unlock()
+{
+}
+#endif
+
+static uint64_t ssdp_now_us()
+{
+	uint64_t us;
+	get_wallclock_us( &us );
+	return us;
+}
+
+/* Copies value of header 'name' of an SSDP message into 'value'. Returns 1 if found. */
+static int ssdp_get_header(const char* msg, const char* name, char* value, size_t len)
+{
+	const char *line, *end, *p;
+	size_t name_len = strlen( name ), value_len;
+
+	for (line = msg; line && *line; line = end ? end + 1 : NULL)
+	{
+		end = strchr( line, '\n' );
+		if (portable_strncasecmp( line, name, name_len ) != 0 || line[name_len] != ':')
+			continue;
+		p = line + name_len + 1;
+		while (*p == ' ' || *p == '\t')
+			++p;
+		value_len = end ? (size_t)(end - p) : strlen( p );
+		while (value_len > 0 && (p[value_len-1] == '\r' || p[value_len-1] == ' '))
+			--value_len;
+		if (value_len >= len)
+			value_len = len - 1;
+		memcpy( value, p, value_len );
+		value[value_len] = 0;
+		return 1;
+	}
+	return 0;
+}
+
+/* Builds "xi-tcp://host:port" from the LOCATION url. Returns 1 on success. */
+static int ssdp_location_to_uri(const char* location, char* uri, size_t len)
+{
+	const char *ip_start, *ip_end;
+	size_t ip_len;
+
+	ip_start = strstr( location, "://" );
+	if (ip_start == NULL)
+		return 0;
+	ip_start += 3;
+	ip_end = strchr( ip_start, ':' );
+	if (ip_end == NULL) ip_end = strchr( ip_start, '/' );
+	if (ip_end == NULL) ip_end = strchr( ip_start, 0 );
+	ip_len = ip_end - ip_start;
+	if (ip_len == 0 || ip_len > len - 16) //"xi-tcp://" and ":port"
+		return 0;
+	portable_snprintf( uri, len, "xi-tcp://%.*s:%u", (int)ip_len, ip_start, XIMC_TCP_PORT );
+	return 1;
+}
+
+static int ssdp_find_entry(const char* usn)
+{
+	int i;
+	for (i = 0; i < g_ssdp.count; ++i)
+		if (strcmp( g_ssdp.entries[i].usn, usn ) == 0)
+			return i;
+	return -1;
+}
+
+static void ssdp_remove_entry(int index)
+{
+	g_ssdp.entries[index] = g_ssdp.entries[--g_ssdp.count];
+}
+
+/* Drops expired entries, must be called under ssdp lock */
+static void ssdp_expire(uint64_t now)
+{
+	int i = 0;
+	while (i < g_ssdp.count)
+	{
+		if (g_ssdp.entries[i].expire_us <= now)
+			ssdp_remove_entry( i );
+		else
+			++i;
+	}
+}
+
+static void ssdp_handle_message(char* msg)
+{
+	char usn[SSDP_USN_LEN], server[256], location[256], cache_control[64], nts[32];
+	char uri[SSDP_URI_LEN];
+	const char* max_age_str;
+	char* sep;
+	long max_age = SSDP_DEFAULT_MAX_AGE;
+	uint64_t now;
+	int index;
+
+	if (portable_strncasecmp( msg, "NOTIFY ", 7 ) != 0 && portable_strncasecmp( msg, "HTTP/1.1 200", 12 ) != 0)
+		return;	/* other M-SEARCH requests */
+	if (!ssdp_get_header( msg, "USN", usn, sizeof(usn) ))
+		return;
+	/* a device announces itself under several USNs sharing the uuid part */
+	if ((sep = strstr( usn, "::" )) != NULL)
+		*sep = 0;
+
+	if (ssdp_get_header( msg, "NTS", nts, sizeof(nts) ) && portable_strcasecmp( nts, "ssdp:byebye" ) == 0)
+	{
+		/* byebye usually comes without SERVER header, so match by USN */
+		ssdp_lock();
+		if ((index = ssdp_find_entry( usn )) != -1)
+		{
+			log_debug( L"ssdp: %hs is gone", g_ssdp.entries[index].uri );
+			ssdp_remove_entry( index );
+		}
+		ssdp_unlock();
+		return;
+	}
+
+	if (!ssdp_get_header( msg, "SERVER", server, sizeof(server) ) ||
+		(strstr( server, "8SMC5-USB" ) == NULL && strstr( server, "mDrive" ) == NULL))
+		return;
+	if (!ssdp_get_header( msg, "LOCATION", location, sizeof(location) ) ||
+		!ssdp_location_to_uri( location, uri, sizeof(uri) ))
+		return;
+	if (ssdp_get_header( msg, "CACHE-CONTROL", cache_control, sizeof(cache_control) ) &&
+		(max_age_str = strstr( cache_control, "max-age" )) != NULL &&
+		(max_age_str = strchr( max_age_str, '=' )) != NULL)
+	{
+		max_age = strtol( max_age_str + 1, NULL, 10 );
+		if (max_age <= 0)
+			max_age = SSDP_DEFAULT_MAX_AGE;
+	}
+
+	now = ssdp_now_us();
+	ssdp_lock();
+	ssdp_expire( now );
+	if ((index = ssdp_find_entry( usn )) == -1 && g_ssdp.count < SSDP_CACHE_SIZE)
+	{
+		index = g_ssdp.count++;
+		strcpy( g_ssdp.entries[index].usn, usn );
+		log_debug( L"ssdp: found %hs", uri );
+	}
+	if (index != -1)
+	{
+		strcpy( g_ssdp.entries[index].uri, uri );
+		g_ssdp.entries[index].expire_us = now + (uint64_t)max_age * 1000000;
+	}
+	else
+		log_warning( L"ssdp: cache is full, %hs is ignored", uri );
+	ssdp_unlock();
+}
+
+static void ssdp_send_search(ssdp_socket_t sock)
+{
+	struct sockaddr_in addr;
+	char request[256];
+	int len;
+
+	len = portable_snprintf( request, sizeof(request),
+			"M-SEARCH * HTTP/1.1\r\n"
+			"HOST: " SSDP_MULTICAST_ADDR ":%d\r\n"
+			"MAN: \"ssdp:discover\"\r\n"
+			"MX: %d\r\n"
+			"ST: upnp:rootdevice\r\n"
+			"\r\n", SSDP_PORT, SSDP_MX );
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons( SSDP_PORT );
+	addr.sin_addr.s_addr = inet_addr( SSDP_MULTICAST_ADDR );
+	if (sendto( sock, request, len, 0, (struct sockaddr*)&addr, sizeof(addr) ) != len)
+		log_system_error( L"ssdp: can't send M-SEARCH: " );
+}
+
+static XIMC_RETTYPE XIMC_CALLCONV ssdp_listener_thread(void* arg)
+{
+	char buf[2048];
+	struct timeval tv;
+	fd_set fds;
+	int received;
+	uint64_t now;
+
+	XIMC_UNUSED(arg);
+	log_debug( L"ssdp listener started" );
+	while (!g_ssdp.stop_request)
+	{
+		now = ssdp_now_us();
+		if (now - g_ssdp.last_search_us >= (uint64_t)SSDP_SEARCH_INTERVAL_TIME * 1000)
+		{
+			g_ssdp.last_search_us = now;
+			ssdp_send_search( g_ssdp.sock );
+		}
+
+		FD_ZERO( &fds );
+		FD_SET( g_ssdp.sock, &fds );
+		tv.tv_sec = 0;
+		tv.tv_usec = SSDP_POLL_TIME * 1000;
+		if (select( (int)g_ssdp.sock + 1, &fds, NULL, NULL, &tv ) <= 0)
+			continue;
+
+		received = recv( g_ssdp.sock, buf, sizeof(buf) - 1, 0 );
+		if (received <= 0)
+			continue;
+		buf[received] = 0;
+		ssdp_handle_message( buf );
+	}
+
+	ssdp_close_socket( g_ssdp.sock );
+	g_ssdp.sock = SSDP_INVALID_SOCKET;
+#if defined(WIN32) || defined(WIN64)
+	WSACleanup();
+#endif
+	log_debug( L"ssdp listener stopped" );
+	/* stop_request is cleared last, a new listener may start once it is 0 */
+	g_ssdp.running = 0;
+	g_ssdp.stop_request = 0;
+	return (XIMC_RETTYPE)0;
+}
+
+static result_t ssdp_open_socket(ssdp_socket_t* psock)
+{
+	ssdp_socket_t sock;
+	struct sockaddr_in addr;
+	struct ip_mreq mreq;
+	int reuse = 1;
+
+	sock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if (sock == SSDP_INVALID_SOCKET)
+	{
+		log_system_error( L"ssdp: can't create socket: " );
+		return result_error;
+	}
+	setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse) );
+#ifdef SO_REUSEPORT
+	setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuse, sizeof(reuse) );
+#endif
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons( SSDP_PORT );
+	addr.sin_addr.s_addr = htonl( INADDR_ANY );
+	if (bind( sock, (struct sockaddr*)&addr, sizeof(addr) ) != 0)
+	{
+		log_system_error( L"ssdp: can't bind to port 1900: " );
+		ssdp_close_socket( sock );
+		return result_error;
+	}
+
+	mreq.imr_multiaddr.s_addr = inet_addr( SSDP_MULTICAST_ADDR );
+	mreq.imr_interface.s_addr = htonl( INADDR_ANY );
+	if (setsockopt( sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof(mreq) ) != 0)
+	{
+		log_system_error( L"ssdp: can't join multicast group: " );
+		ssdp_close_socket( sock );
+		return result_error;
+	}
+
+	*psock = sock;
+	return result_ok;
+}
+
+result_t XIMC_API start_ssdp_listener()
+{
+#if defined(WIN32) || defined(WIN64)
+	WSADATA wsaData;
+#endif
+	int waited;
+
+	lock_global();
+	/* previous listener may still be closing its socket */
+	for (waited = 0; g_ssdp.stop_request && waited < 4*SSDP_POLL_TIME; waited += SLEEP_WAIT_TIME)
+		msec_sleep( SLEEP_WAIT_TIME );
+	if (g_ssdp.stop_request)
+	{
+		log_warning( L"previous ssdp listener is still stopping" );
+		return unlocker_global( result_error );
+	}
+	if (g_ssdp.running)
+		return unlocker_global( result_ok );
+
+#ifdef HAVE_LOCKS
+	if (!g_mutex_ssdp && (g_mutex_ssdp = mutex_init( UINT_MAX-2 )) == NULL)
+		return unlocker_global( result_error );
+#endif
+
+#if defined(WIN32) || defined(WIN64)
+	if (WSAStartup( MAKEWORD(2, 2), &wsaData ) != NO_ERROR)
+		return unlocker_global( result_error );
+#endif
+	if (ssdp_open_socket( &g_ssdp.sock ) != result_ok)
+	{
+#if defined(WIN32) || defined(WIN64)
+		WSACleanup();
+#endif
+		return unlocker_global( result_error );
+	}
+
+	ssdp_lock();
+	g_ssdp.count = 0;
+	ssdp_unlock();
+	g_ssdp.started_us = ssdp_now_us();
+	g_ssdp.last_search_us = 0;
+	g_ssdp.running = 1;
+	if (single_thread_launcher( ssdp_listener_thread, NULL ) != result_ok)
+	{
+		g_ssdp.running = 0;
+		ssdp_close_socket( g_ssdp.sock );
+		g_ssdp.sock = SSDP_INVALID_SOCKET;
+#if defined(WIN32) || defined(WIN64)
+		WSACleanup();
+#endif
+		return unlocker_global( result_error );
+	}
+	return unlocker_global( result_ok );
+}
+
+result_t XIMC_API stop_ssdp_listener()
+{
+	int waited;
+
+	lock_global();
+	if (!g_ssdp.running)
+		return unlocker_global( result_ok );
+
+	/* a listener which did not stop in time before is waited for again */
+	g_ssdp.stop_request = 1;
+	for (waited = 0; g_ssdp.stop_request && waited < 2*SSDP_POLL_TIME; waited += SLEEP_WAIT_TIME)
+		msec_sleep( SLEEP_WAIT_TIME );
+	if (g_ssdp.stop_request)
+	{
+		/* the thread clears stop_request when it finishes, start_ssdp_listener waits for that */
+		log_warning( L"ssdp listener did not stop in time" );
+		return unlocker_global( result_error );
+	}
+
+	ssdp_lock();
+	g_ssdp.count = 0;
+	ssdp_unlock();
+	return unlocker_global( result_ok );
+}
+
+int ssdp_listener_is_running()
+{
+	return g_ssdp.running && !g_ssdp.stop_request;
+}
+
+result_t ssdp_listener_enumerate(enumerate_devices_directory_callback_t callback, void* arg)
+{
+	char uris[SSDP_CACHE_SIZE][SSDP_URI_LEN];
+	int i, count;
+	uint64_t now, warmup_end;
+
+	if (!ssdp_listener_is_running())
+		return result_error;
+
+	/* right after start give the devices a chance to answer the first M-SEARCH */
+	warmup_end = g_ssdp.started_us + (uint64_t)SSDP_MX * 1000000;
+	while ((now = ssdp_now_us()) < warmup_end && ssdp_listener_is_running())
+		msec_sleep( (unsigned int)((warmup_end - now) / 1000) + 1 );
+
+	/* callback may take its time, do not hold the lock over it */
+	ssdp_lock();
+	ssdp_expire( now );
+	count = g_ssdp.count;
+	for (i = 0; i < count; ++i)
+		strcpy( uris[i], g_ssdp.entries[i].uri );
+	ssdp_unlock();
+
+	for (i = 0; i < count; ++i)
+		callback( uris[i], arg );
+	return result_ok;
+}
+
+// vim: syntax=c tabstop=4 shiftwidth=4
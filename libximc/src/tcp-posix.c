@@ -5,6 +5,10 @@
 #include <stdlib.h>    
 #include <unistd.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -42,7 +46,7 @@
  * Tcp support
  */
 // uses device_meatada_t virtual_XXX fields to save some tcp-connection params
-// virtual_state - allocated for socket_in data of a controller-server
+// virtual_state - allocated for sockaddr_storage data of a controller-server
 // virtual_scratchpad - all accepted data
 // virtual_packet_actual - unread data size
 
@@ -54,66 +58,157 @@
 
 #define TCP_UNREAD_LEN metadata -> virtual_packet_actual
 
-result_t open_tcp(device_metadata_t *metadata, const char* ip4_port)
+static void tcp_set_options(int sock, int timeout_ms)
 {
-
-	// check parameter ip4_port : address:port
-	char saddress[64];
+	struct timeval timeout;
 	int optval = 1; // set option == true
-	memset(saddress, 0, 64);
-	strncpy(saddress, ip4_port, strlen(ip4_port));
-	char * port_start = strchr(saddress, ':');
-	if (port_start == NULL)
+
+	timeout.tv_sec = timeout_ms / 1000;            // second part of timeout (which ordinary in milliseconds)
+	timeout.tv_usec = (timeout_ms % 1000) * 1000;  // millisecond part of timeout in microseconds
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(struct timeval)) == -1 ||
+		setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(struct timeval)) == -1 ||
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int)) == -1)
+		log_system_error(L"can't set tcp socket options: ");
+
+	/* detect a dead peer in seconds instead of hours */
+	if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(int)) == -1)
+		log_system_error(L"can't enable tcp keepalive: ");
+#if defined(TCP_KEEPIDLE)
+	optval = TCP_KEEPALIVE_IDLE_TIME;
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &optval, sizeof(int));
+#elif defined(TCP_KEEPALIVE)
+	optval = TCP_KEEPALIVE_IDLE_TIME;
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPALIVE, &optval, sizeof(int));
+#endif
+#ifdef TCP_KEEPINTVL
+	optval = TCP_KEEPALIVE_INTERVAL_TIME;
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &optval, sizeof(int));
+#endif
+#ifdef TCP_KEEPCNT
+	optval = TCP_KEEPALIVE_COUNT;
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &optval, sizeof(int));
+#endif
+}
+
+/*
+ * Starts non-blocking connects to all resolved addresses at once and keeps the first
+ * one which succeeds within timeout_ms. Returns connected blocking socket or -1.
+ */
+static int tcp_connect_any(const struct addrinfo* addrs, int timeout_ms, struct sockaddr_storage* peer)
+{
+	struct pollfd pfds[TCP_CONNECT_ATTEMPTS];
+	const struct addrinfo* ai[TCP_CONNECT_ATTEMPTS];
+	const struct addrinfo* cur;
+	int count = 0, sock = -1, i, result, error, flags;
+	socklen_t error_len;
+	uint64_t now, deadline;
+
+	for (cur = addrs; cur != NULL && count < TCP_CONNECT_ATTEMPTS && sock == -1; cur = cur->ai_next)
 	{
+		int s = socket(cur->ai_family, cur->ai_socktype, cur->ai_protocol);
+		if (s == -1)
+			continue;
+		if ((flags = fcntl(s, F_GETFL, 0)) == -1 || fcntl(s, F_SETFL, flags | O_NONBLOCK) == -1)
+		{
+			close(s);
+			continue;
+		}
+		if (connect(s, cur->ai_addr, cur->ai_addrlen) == 0)
+		{
+			sock = s;
+			memcpy(peer, cur->ai_addr, cur->ai_addrlen);
+		}
+		else if (errno == EINPROGRESS)
+		{
+			pfds[count].fd = s;
+			pfds[count].events = POLLOUT;
+			ai[count++] = cur;
+		}
+		else
+			close(s);
+	}
 
-		port_start = strchr(saddress, 0);
-		portable_snprintf(port_start, 64 - strlen(saddress), ":%u", XIMC_TCP_PORT);
+	get_wallclock_us(&now);
+	deadline = now + (uint64_t)timeout_ms * 1000;
+	while (sock == -1 && count > 0 && now < deadline)
+	{
+		result = poll(pfds, count, (int)((deadline - now) / 1000) + 1);
+		if (result == -1 && errno != EINTR)
+			break;
+		for (i = 0; result > 0 && i < count; ++i)
+		{
+			if (pfds[i].revents == 0)
+				continue;
+			error = 0;
+			error_len = sizeof(error);
+			if (sock == -1 && getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == 0 && error == 0)
+			{
+				sock = pfds[i].fd;
+				memcpy(peer, ai[i]->ai_addr, ai[i]->ai_addrlen);
+			}
+			else
+				close(pfds[i].fd);
+			/* drop finished attempt from the poll set */
+			pfds[i] = pfds[--count];
+			ai[i] = ai[count];
+			--i;
+		}
+		get_wallclock_us(&now);
 	}
-	unsigned int port;
-	if (sscanf(port_start + 1, "%u", &port) != 1) return result_error;
-	*port_start = 0;
-	in_addr_t addr = inet_addr(saddress);
-	if (addr == INADDR_NONE) return result_error;
 
-	// creating a new connection resource
+	/* lost the race or timed out */
+	for (i = 0; i < count; ++i)
+		close(pfds[i].fd);
+	if (sock == -1)
+		return -1;
 
-	metadata->handle = (uint32_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if ((int)metadata->handle == -1)
+	if ((flags = fcntl(sock, F_GETFL, 0)) == -1 || fcntl(sock, F_SETFL, flags & ~O_NONBLOCK) == -1)
 	{
-		return result_error;
+		close(sock);
+		return -1;
 	}
+	return sock;
+}
 
-	struct sockaddr_in *sa;
-
-	PTCP_SOCKET_IN = (sa = (struct sockaddr_in*)malloc(sizeof(struct sockaddr_in)));
+result_t open_tcp(device_metadata_t *metadata, const char* ip4_port)
+{
+	char host[256], port[16];
+	struct addrinfo hints, *addrs = NULL;
+	struct sockaddr_storage *peer;
+	int sock, error;
 
-	sa->sin_family = AF_INET;
-	sa->sin_port = htons((port));
-	sa->sin_addr.s_addr = addr;
+	// check parameter ip4_port : address:port, hostname:port or [ipv6]:port
+	if (split_host_port(ip4_port, host, sizeof(host), port, sizeof(port)) != result_ok)
+	{
+		log_error(L"wrong tcp address %hs", ip4_port);
+		return result_error;
+	}
 
-	int result = connect((int)metadata->handle, (const struct sockaddr *)sa, sizeof(struct sockaddr_in));
-	if (result != -1)
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	if ((error = getaddrinfo(host, port, &hints, &addrs)) != 0)
 	{
-		struct timeval timeout;
-		timeout.tv_sec = metadata->timeout / 1000;            // second part of timeout (which ordinary in milliseconds)
-        timeout.tv_usec = (metadata->timeout % 1000) * 1000;  // millisecond part of timeout in microseconds
-		result = setsockopt((int)metadata->handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(struct timeval));
-		if (result != -1)
-		{
-			result = setsockopt((int)metadata->handle, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(struct timeval));
-		}
-		if (result != -1)
-		{
-            result = setsockopt((int)metadata->handle, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
-		}
+		log_error(L"can't resolve %hs: %hs", host, gai_strerror(error));
+		return result_error;
 	}
-	if (result == -1)
+
+	// creating a new connection resource
+	peer = (struct sockaddr_storage*)malloc(sizeof(struct sockaddr_storage));
+	memset(peer, 0, sizeof(struct sockaddr_storage));
+	sock = tcp_connect_any(addrs, metadata->timeout, peer);
+	freeaddrinfo(addrs);
+	if (sock == -1)
 	{
-		close((int)metadata->handle);
-		free(PTCP_SOCKET_IN);
+		log_error(L"can't connect to %hs within %d ms", ip4_port, metadata->timeout);
+		free(peer);
 		return result_error;
 	}
+	tcp_set_options(sock, metadata->timeout);
 
+	metadata->handle = (uint32_t)sock;
+	PTCP_SOCKET_IN = peer;
 	metadata->type = dtTcp;
 	TCP_UNREAD_LEN = 0;
 	return result_ok;
@@ -131,7 +226,7 @@ result_t close_tcp(device_metadata_t *metadata)
 ssize_t write_tcp(device_metadata_t *metadata, const byte* command, size_t command_len)
 {
 	TCP_UNREAD_LEN = 0;
-	return (ssize_t)sendto((int)metadata->handle, (const char *)command, (int)command_len, 0, (struct sockaddr *)metadata->virtual_state, (socklen_t) sizeof (struct sockaddr_in));
+	return (ssize_t)send((int)metadata->handle, (const char *)command, (int)command_len, 0);
 }
 
 // assume amount is the required number of data bytes - non max buffer size
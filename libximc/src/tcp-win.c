@@ -4,6 +4,7 @@
 #include <winsock2.h>
 #include <Ws2tcpip.h>
 #include <ws2def.h>
+#include <mstcpip.h>
 
 #include "ximc.h"
 
@@ -14,7 +15,7 @@
 #include "protosup.h"
 
 // uses device_meatada_t virtual_XXX fields to save some TCP-connection params
-// virtual_state - allocated for socket_in data of a controller-server
+// virtual_state - allocated for sockaddr_storage data of a controller-server
 // virtual_scratchpad - all accepted data
 // virtual_packet_actual - unread data size
 
@@ -26,25 +27,130 @@
 
 #define TCP_UNREAD_LEN metadata -> virtual_packet_actual
 
-result_t open_tcp(device_metadata_t *metadata, const char* ip4_port)
+static void tcp_set_options(SOCKET sock, int timeout_ms)
 {
-	
-	// check parameter ip4_port : address:port
-	char saddress[64];
+	DWORD timeout = timeout_ms, bytes;
 	int optval = 1; // set option =true
-	memset(saddress, 0, 64);
-	strncpy_s(saddress, 64, ip4_port, strlen(ip4_port));
-	char * port_start = strchr(saddress, ':');
-	if (port_start == NULL)
+	struct tcp_keepalive keepalive;
+
+	if (setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout)) == SOCKET_ERROR ||
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) == SOCKET_ERROR ||
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *)&optval, sizeof(int)) == SOCKET_ERROR)
+		log_system_error(L"can't set tcp socket options: ");
+
+	/* detect a dead peer in seconds instead of hours, windows takes keepalive times in msec */
+	keepalive.onoff = 1;
+	keepalive.keepalivetime = TCP_KEEPALIVE_IDLE_TIME * 1000;
+	keepalive.keepaliveinterval = TCP_KEEPALIVE_INTERVAL_TIME * 1000;
+	if (WSAIoctl(sock, SIO_KEEPALIVE_VALS, &keepalive, sizeof(keepalive), NULL, 0, &bytes, NULL, NULL) == SOCKET_ERROR)
+		log_system_error(L"can't enable tcp keepalive: ");
+}
+
+/*
+ * Starts non-blocking connects to all resolved addresses at once and keeps the first
+ * one which succeeds within timeout_ms. Returns connected blocking socket or INVALID_SOCKET.
+ */
+static SOCKET tcp_connect_any(const ADDRINFOA* addrs, int timeout_ms, struct sockaddr_storage* peer)
+{
+	SOCKET socks[TCP_CONNECT_ATTEMPTS];
+	const ADDRINFOA* ai[TCP_CONNECT_ATTEMPTS];
+	const ADDRINFOA* cur;
+	SOCKET sock = INVALID_SOCKET;
+	u_long nonblocking = 1;
+	fd_set wfds, efds;
+	struct timeval tv;
+	int count = 0, i, result;
+	uint64_t now, deadline;
+
+	for (cur = addrs; cur != NULL && count < TCP_CONNECT_ATTEMPTS && sock == INVALID_SOCKET; cur = cur->ai_next)
+	{
+		SOCKET s = socket(cur->ai_family, cur->ai_socktype, cur->ai_protocol);
+		if (s == INVALID_SOCKET)
+			continue;
+		if (ioctlsocket(s, FIONBIO, &nonblocking) == SOCKET_ERROR)
+		{
+			closesocket(s);
+			continue;
+		}
+		if (connect(s, cur->ai_addr, (int)cur->ai_addrlen) == 0)
+		{
+			sock = s;
+			memcpy(peer, cur->ai_addr, cur->ai_addrlen);
+		}
+		else if (WSAGetLastError() == WSAEWOULDBLOCK)
+		{
+			socks[count] = s;
+			ai[count++] = cur;
+		}
+		else
+			closesocket(s);
+	}
+
+	get_wallclock_us(&now);
+	deadline = now + (uint64_t)timeout_ms * 1000;
+	while (sock == INVALID_SOCKET && count > 0 && now < deadline)
+	{
+		FD_ZERO(&wfds);
+		FD_ZERO(&efds);
+		for (i = 0; i < count; ++i)
+		{
+			FD_SET(socks[i], &wfds);
+			FD_SET(socks[i], &efds);
+		}
+		tv.tv_sec = (long)((deadline - now) / 1000000);
+		tv.tv_usec = (long)((deadline - now) % 1000000);
+		result = select(0, NULL, &wfds, &efds, &tv);
+		if (result == SOCKET_ERROR)
+			break;
+		for (i = 0; result > 0 && i < count; ++i)
+		{
+			/* failed connect is reported in the exception set on windows */
+			if (FD_ISSET(socks[i], &wfds) && sock == INVALID_SOCKET)
+			{
+				sock = socks[i];
+				memcpy(peer, ai[i]->ai_addr, ai[i]->ai_addrlen);
+			}
+			else if (FD_ISSET(socks[i], &efds) || FD_ISSET(socks[i], &wfds))
+				closesocket(socks[i]);
+			else
+				continue;
+			/* drop finished attempt from the select set */
+			socks[i] = socks[--count];
+			ai[i] = ai[count];
+			--i;
+		}
+		get_wallclock_us(&now);
+	}
+
+	/* lost the race or timed out */
+	for (i = 0; i < count; ++i)
+		closesocket(socks[i]);
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	nonblocking = 0;
+	if (ioctlsocket(sock, FIONBIO, &nonblocking) == SOCKET_ERROR)
 	{
-		port_start = strchr(saddress, 0);
-		portable_snprintf(port_start, 64 - strlen(saddress), ":%u", XIMC_TCP_PORT);
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+	return sock;
+}
+
+result_t open_tcp(device_metadata_t *metadata, const char* ip4_port)
+{
+	char host[256], port[16];
+	ADDRINFOA hints, *addrs = NULL;
+	struct sockaddr_storage *peer;
+	SOCKET sock;
+	int error;
+
+	// check parameter ip4_port : address:port, hostname:port or [ipv6]:port
+	if (split_host_port(ip4_port, host, sizeof(host), port, sizeof(port)) != result_ok)
+	{
+		log_error(L"wrong tcp address %hs", ip4_port);
+		return result_error;
 	}
-	unsigned int port;
-	if (sscanf_s(port_start + 1, "%u", &port) != 1) return result_error;
-	*port_start = 0;
-	ULONG addr = inet_addr(saddress);
-	if (addr == INADDR_NONE) return result_error;
 
 	// init actions to init some windows dll with tcp from Microsoft example  
 	unsigned short wVersionRequested;
@@ -78,43 +184,33 @@ result_t open_tcp(device_metadata_t *metadata, const char* ip4_port)
 		return result_error;
 	}
 
-	
-	// creating a new connection resource
-
-	metadata->handle = (handle_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if ((SOCKET)metadata->handle == INVALID_SOCKET)
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	if ((error = getaddrinfo(host, port, &hints, &addrs)) != 0)
 	{
+		log_error(L"can't resolve %hs: error %d", host, error);
+		WSACleanup();
 		return result_error;
 	}
-	
-	SOCKADDR_IN *sa;
-	PTCP_SOCKET_IN = (sa = (SOCKADDR_IN *)malloc(sizeof(SOCKADDR_IN)));
-	sa->sin_family = AF_INET;
-	sa->sin_port = htons((USHORT)(port));
-	sa->sin_addr.s_addr = addr;
-	
-	int result  = connect((SOCKET)metadata->handle, (const SOCKADDR *)sa, sizeof(SOCKADDR_IN));
-	if (result != SOCKET_ERROR)
-	{
-		DWORD timeout = metadata->timeout;
-		result = setsockopt((SOCKET)metadata->handle, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout));
-		if (result != SOCKET_ERROR)
-		{
-			result = setsockopt((SOCKET)metadata->handle, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
-		}
-		if (result != SOCKET_ERROR)
-		{
-			result = setsockopt((SOCKET)metadata->handle, IPPROTO_TCP, TCP_NODELAY, (char *)&optval, sizeof(int));
-		}
-	}
-	if (result == SOCKET_ERROR)
+
+	// creating a new connection resource
+	peer = (struct sockaddr_storage*)malloc(sizeof(struct sockaddr_storage));
+	memset(peer, 0, sizeof(struct sockaddr_storage));
+	sock = tcp_connect_any(addrs, metadata->timeout, peer);
+	freeaddrinfo(addrs);
+	if (sock == INVALID_SOCKET)
 	{
-		closesocket((SOCKET)metadata->handle);
-		free(PTCP_SOCKET_IN);
+		log_error(L"can't connect to %hs within %d ms", ip4_port, metadata->timeout);
+		free(peer);
 		WSACleanup();
 		return result_error;
 	}
-	
+	tcp_set_options(sock, metadata->timeout);
+
+	metadata->handle = (handle_t)sock;
+	PTCP_SOCKET_IN = peer;
 	metadata->type = dtTcp;
 	TCP_UNREAD_LEN = 0;
 	return result_ok;
@@ -406,6 +406,45 @@ int parse_uri(const char *name,
 	return 0;
 }
 
+/*
+ * Splits "host:port", "[ipv6]:port", "host" or "ipv6" into host and port strings.
+ * Default xi-tcp port is used when the port is absent.
+ */
+result_t split_host_port(const char* host_port, char* host, size_t host_len, char* port, size_t port_len)
+{
+	const char *host_start = host_port, *host_end, *port_start = NULL;
+
+	if (*host_port == '[')
+	{
+		host_start = host_port + 1;
+		if ((host_end = strchr(host_start, ']')) == NULL)
+			return result_error;
+		if (host_end[1] == ':')
+			port_start = host_end + 2;
+		else if (host_end[1] != 0)
+			return result_error;
+	}
+	else
+	{
+		host_end = strrchr(host_port, ':');
+		/* more than one colon is a bare IPv6 address */
+		if (host_end != NULL && strchr(host_port, ':') == host_end)
+			port_start = host_end + 1;
+		else
+			host_end = strchr(host_port, 0);
+	}
+
+	if (host_end == host_start || (size_t)(host_end - host_start) >= host_len)
+		return result_error;
+	memcpy(host, host_start, host_end - host_start);
+	host[host_end - host_start] = 0;
+	if (port_start != NULL && *port_start != 0)
+		portable_snprintf(port, port_len, "%s", port_start);
+	else
+		portable_snprintf(port, port_len, "%u", XIMC_TCP_PORT);
+	return result_ok;
+}
+
 
 /* Converts a hex character to its integer value */
 char from_hex(char ch) {
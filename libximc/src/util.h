@@ -20,6 +20,14 @@
 // xism board port redetection time
 #define XISM_PORT_DETECT_TIME 60000
 
+// tcp keepalive: idle time before the first probe, interval between probes (both in sec) and probes count
+#define TCP_KEEPALIVE_IDLE_TIME 5
+#define TCP_KEEPALIVE_INTERVAL_TIME 1
+#define TCP_KEEPALIVE_COUNT 3
+
+// max number of resolved addresses tried at once when connecting over tcp
+#define TCP_CONNECT_ATTEMPTS 8
+
 // amount of zeroes to send in case of an error
 #define SYNC_ZERO_COUNT 64
 
@@ -29,6 +37,9 @@
 // sleep time in milliseconds in wait loops
 #define SLEEP_WAIT_TIME 1
 
+// time to wait until all devices of a group command are ready, devices not ready by then start late, in msec
+#define DISPATCH_READY_TIMEOUT 5000
+
 // timeout after close, maybe should fix kernel race error, in msec
 #define ENUMERATE_CLOSE_TIMEOUT 100
 
@@ -66,6 +77,8 @@ int parse_uri(const char *name,
 		char *paramname, size_t paramname_len,
 		char *paramvalue, size_t paramvalue_len);
 
+result_t split_host_port(const char* host_port, char* host, size_t host_len, char* port, size_t port_len);
+
 char *uri_encode(const char *str);
 char *uri_decode(const char *str);
 char *uri_copy(const char *str);
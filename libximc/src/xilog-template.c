@@ -0,0 +1,650 @@
+/*
+ * XILOG trace analyzer.
+ * libximc writes every packet to the file named by the XILOG environment variable. This tool pairs
+ * requests with responses, decodes them with the command tables generated from protocol.xi and
+ * reports latency of every command, throughput of every device, gaps between commands and
+ * bursts of resynchronizations, error answers and retries.
+ * Usage: xilog [-d] [-b burst_ms] file...
+ *   -d  print every transaction with decoded fields
+ *   -b  events closer than this are one burst, 100 ms by default
+ * Logs written before the DATA column was added are read from the text column, payloads of such
+ * logs are not decoded because zero and non-printable bytes are lost there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* A failed command sent again within this time is a retry */
+#define XILOG_RETRY_WINDOW_US 1000000
+
+/* Largest gaps reported per device */
+#define XILOG_GAP_TOP 3
+
+#define XILOG_PACKET_MAX 512
+#define XILOG_LINE_MAX 4096
+
+typedef enum
+{
+	trace_int64u, trace_int64s, trace_int32u, trace_int32s, trace_int16u, trace_int16s,
+	trace_int8u, trace_int8s, trace_float, trace_double, trace_char
+} trace_type_t;
+
+typedef struct trace_field_t
+{
+	const char* name;
+	/* from the start of the packet including the command code */
+	unsigned int offset;
+	trace_type_t type;
+	unsigned int count;
+} trace_field_t;
+
+typedef struct trace_command_t
+{
+	/* request code, readers answer with the same code */
+	const char* code;
+	const char* function;
+	unsigned int request_size;
+	unsigned int answer_size;
+	const trace_field_t* request_fields;
+	const trace_field_t* answer_fields;
+} trace_command_t;
+
+/* @@GENERATED_CODE@@ */
+
+/* Growing array of 64-bit samples */
+typedef struct samples_t
+{
+	uint64_t* values;
+	size_t count;
+	size_t capacity;
+} samples_t;
+
+typedef struct command_stat_t
+{
+	char code[5];
+	const trace_command_t* command;
+	samples_t latency;
+	unsigned int errors;
+	unsigned int retries;
+	uint64_t bytes;
+} command_stat_t;
+
+typedef struct gap_t
+{
+	uint64_t us;
+	uint64_t at;
+	char before[5];
+	char after[5];
+} gap_t;
+
+typedef struct burst_t
+{
+	uint64_t start;
+	uint64_t end;
+	unsigned int syncs;
+	unsigned int flushes;
+	unsigned int errors;
+	unsigned int retries;
+} burst_t;
+
+typedef enum { transaction_none, transaction_request, transaction_answer, transaction_sync } transaction_state_t;
+
+typedef struct device_t
+{
+	char type[8];
+	unsigned long id;
+
+	/* transaction in progress */
+	transaction_state_t state;
+	/* index into stats, the table moves when it grows */
+	size_t stat;
+	uint64_t start;
+	uint64_t last;
+	unsigned char request[XILOG_PACKET_MAX];
+	size_t request_len;
+	size_t request_size;
+	unsigned char answer[XILOG_PACKET_MAX];
+	size_t answer_len;
+	size_t answer_size;
+
+	/* the previous transaction, for gaps and retries */
+	uint64_t end;
+	char last_code[5];
+	int last_failed;
+
+	unsigned int commands;
+	uint64_t written;
+	uint64_t read;
+	uint64_t first_seen;
+	uint64_t last_seen;
+	uint64_t busy_us;
+	samples_t gaps;
+	gap_t top_gaps[XILOG_GAP_TOP];
+
+	burst_t burst;
+	unsigned int bursts;
+} device_t;
+
+static command_stat_t* stats;
+static size_t stats_count;
+static device_t* devices;
+static size_t devices_count;
+static uint64_t trace_start;
+static uint64_t burst_us = 100000;
+static int decode;
+
+static void* xilog_realloc(void* ptr, size_t size)
+{
+	if ((ptr = realloc( ptr, size )) == NULL)
+	{
+		fprintf( stderr, "Out of memory\n" );
+		exit( 1 );
+	}
+	return ptr;
+}
+
+static void samples_add(samples_t* samples, uint64_t value)
+{
+	if (samples->count == samples->capacity)
+	{
+		samples->capacity = samples->capacity ? samples->capacity*2 : 64;
+		samples->values = (uint64_t*)xilog_realloc( samples->values, samples->capacity*sizeof(uint64_t) );
+	}
+	samples->values[samples->count++] = value;
+}
+
+static int samples_compare(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+/* Samples must be sorted */
+static uint64_t samples_percentile(const samples_t* samples, unsigned int percent)
+{
+	return samples->count ? samples->values[(samples->count-1)*percent/100] : 0;
+}
+
+static const trace_command_t* find_command(const unsigned char* code)
+{
+	const trace_command_t* command;
+
+	for (command = trace_commands; command->code; ++command)
+		if (memcmp( command->code, code, 4 ) == 0)
+			return command;
+	return NULL;
+}
+
+static size_t find_stat(const unsigned char* code)
+{
+	size_t i;
+
+	for (i = 0; i < stats_count; ++i)
+		if (memcmp( stats[i].code, code, 4 ) == 0)
+			return i;
+	stats = (command_stat_t*)xilog_realloc( stats, (stats_count+1)*sizeof(command_stat_t) );
+	memset( &stats[stats_count], 0, sizeof(command_stat_t) );
+	memcpy( stats[stats_count].code, code, 4 );
+	stats[stats_count].command = find_command( code );
+	return stats_count++;
+}
+
+static device_t* find_device(const char* type, unsigned long id)
+{
+	size_t i;
+
+	for (i = 0; i < devices_count; ++i)
+		if (devices[i].id == id && strcmp( devices[i].type, type ) == 0)
+			return &devices[i];
+	devices = (device_t*)xilog_realloc( devices, (devices_count+1)*sizeof(device_t) );
+	memset( &devices[devices_count], 0, sizeof(device_t) );
+	strncpy( devices[devices_count].type, type, sizeof(devices[0].type)-1 );
+	devices[devices_count].id = id;
+	return &devices[devices_count++];
+}
+
+/*
+ * Decoding
+ */
+
+static uint64_t get_le(const unsigned char* p, unsigned int size)
+{
+	uint64_t value = 0;
+
+	while (size--)
+		value = (value << 8) | p[size];
+	return value;
+}
+
+static unsigned int type_size(trace_type_t type)
+{
+	switch (type)
+	{
+		case trace_int64u: case trace_int64s: case trace_double: return 8;
+		case trace_int32u: case trace_int32s: case trace_float: return 4;
+		case trace_int16u: case trace_int16s: return 2;
+		default: return 1;
+	}
+}
+
+static void print_value(const unsigned char* p, trace_type_t type)
+{
+	uint64_t value = get_le( p, type_size( type ) );
+	uint32_t bits32;
+	float f;
+	double d;
+
+	switch (type)
+	{
+		case trace_int64s: printf( "%lld", (long long)(int64_t)value ); break;
+		case trace_int32s: printf( "%ld", (long)(int32_t)value ); break;
+		case trace_int16s: printf( "%d", (int)(int16_t)value ); break;
+		case trace_int8s: printf( "%d", (int)(int8_t)value ); break;
+		case trace_float:
+			bits32 = (uint32_t)value;
+			memcpy( &f, &bits32, 4 );
+			printf( "%g", f );
+			break;
+		case trace_double:
+			memcpy( &d, &value, 8 );
+			printf( "%g", d );
+			break;
+		default: printf( "%llu", (unsigned long long)value ); break;
+	}
+}
+
+static void print_fields(const trace_field_t* field, const unsigned char* packet, size_t len)
+{
+	unsigned int i, size;
+
+	for (; field && field->name; ++field)
+	{
+		size = type_size( field->type );
+		if (field->offset + size*field->count > len)
+			break;
+		printf( " %s=", field->name );
+		if (field->type == trace_char)
+			printf( "\"%.*s\"", (int)field->count, packet + field->offset );
+		else if (field->count == 1)
+			print_value( packet + field->offset, field->type );
+		else
+		{
+			printf( "[" );
+			for (i = 0; i < field->count; ++i)
+			{
+				if (i)
+					printf( "," );
+				print_value( packet + field->offset + i*size, field->type );
+			}
+			printf( "]" );
+		}
+	}
+}
+
+/*
+ * Events
+ */
+
+static void burst_event(device_t* dev, uint64_t at, unsigned int* counter)
+{
+	if (dev->burst.end == 0 || at > dev->burst.end + burst_us)
+	{
+		if (dev->burst.end)
+			++dev->bursts;
+		if (dev->burst.end && decode)
+			printf( "%+.6f %s/%lu burst: %u syncs, %u flushes, %u errors, %u retries\n",
+					(dev->burst.start - trace_start) / 1e6, dev->type, dev->id,
+					dev->burst.syncs, dev->burst.flushes, dev->burst.errors, dev->burst.retries );
+		memset( &dev->burst, 0, sizeof(burst_t) );
+		dev->burst.start = at;
+	}
+	dev->burst.end = at;
+	++*counter;
+}
+
+static void finish_transaction(device_t* dev, const char* status)
+{
+	command_stat_t* stat;
+	uint64_t latency = dev->last - dev->start;
+	int failed = strcmp( status, "ok" ) != 0;
+
+	if (dev->state == transaction_none || dev->state == transaction_sync)
+	{
+		dev->state = transaction_none;
+		return;
+	}
+	stat = &stats[dev->stat];
+	samples_add( &stat->latency, latency );
+	stat->bytes += dev->request_len + dev->answer_len;
+	dev->busy_us += latency;
+	++dev->commands;
+	if (failed)
+	{
+		++stat->errors;
+		burst_event( dev, dev->last, &dev->burst.errors );
+	}
+	if (decode)
+	{
+		printf( "%+.6f %s/%lu %s %s %llu us %s", (dev->start - trace_start) / 1e6, dev->type, dev->id,
+				stat->code, stat->command ? stat->command->function : "?", (unsigned long long)latency, status );
+		if (stat->command)
+		{
+			print_fields( stat->command->request_fields, dev->request, dev->request_len );
+			if (!failed)
+				print_fields( stat->command->answer_fields, dev->answer, dev->answer_len );
+		}
+		printf( "\n" );
+	}
+	dev->end = dev->last;
+	memcpy( dev->last_code, stat->code, 5 );
+	dev->last_failed = failed;
+	dev->state = transaction_none;
+}
+
+static void record_gap(device_t* dev, uint64_t at, const char* code)
+{
+	gap_t gap;
+	int i;
+
+	if (dev->end == 0 || at < dev->end)
+		return;
+	gap.us = at - dev->end;
+	gap.at = dev->end;
+	memcpy( gap.before, dev->last_code, 5 );
+	memcpy( gap.after, code, 5 );
+	samples_add( &dev->gaps, gap.us );
+	/* insertion into the largest gaps, largest first */
+	for (i = XILOG_GAP_TOP; i > 0 && gap.us > dev->top_gaps[i-1].us; --i)
+		if (i < XILOG_GAP_TOP)
+			dev->top_gaps[i] = dev->top_gaps[i-1];
+	if (i < XILOG_GAP_TOP)
+		dev->top_gaps[i] = gap;
+}
+
+static void on_write(device_t* dev, uint64_t at, const unsigned char* data, size_t len)
+{
+	command_stat_t* stat;
+	size_t i;
+
+	dev->written += len;
+	/* the rest of a partially written packet */
+	if (dev->state == transaction_request && dev->request_len < dev->request_size)
+	{
+		len = len < sizeof(dev->request) - dev->request_len ? len : sizeof(dev->request) - dev->request_len;
+		memcpy( dev->request + dev->request_len, data, len );
+		dev->request_len += len;
+		dev->last = at;
+		if (dev->request_len >= dev->request_size)
+		{
+			dev->state = transaction_answer;
+			if (dev->answer_size == 0)
+				finish_transaction( dev, "ok" );
+		}
+		return;
+	}
+
+	for (i = 0; i < len && data[i] == 0; ++i)
+		;
+	if (i == len)
+	{
+		/* synchronization zeroes, the device answers with zeroes too */
+		finish_transaction( dev, "resync" );
+		burst_event( dev, at, &dev->burst.syncs );
+		dev->state = transaction_sync;
+		return;
+	}
+	if (dev->state == transaction_request || dev->state == transaction_answer)
+		finish_transaction( dev, "no answer" );
+	if (len < 4)
+		return;
+
+	dev->stat = find_stat( data );
+	stat = &stats[dev->stat];
+	record_gap( dev, at, stat->code );
+	if (dev->last_failed && dev->end && at - dev->end < XILOG_RETRY_WINDOW_US &&
+			memcmp( dev->last_code, data, 4 ) == 0)
+	{
+		++stat->retries;
+		burst_event( dev, at, &dev->burst.retries );
+	}
+	dev->start = dev->last = at;
+	dev->request_len = len < sizeof(dev->request) ? len : sizeof(dev->request);
+	memcpy( dev->request, data, dev->request_len );
+	dev->request_size = stat->command ? stat->command->request_size : len;
+	dev->answer_size = stat->command ? stat->command->answer_size : 4;
+	dev->answer_len = 0;
+	dev->state = dev->request_len < dev->request_size ? transaction_request : transaction_answer;
+	if (dev->state == transaction_answer && dev->answer_size == 0)
+		finish_transaction( dev, "ok" );
+}
+
+static void on_read(device_t* dev, uint64_t at, const unsigned char* data, size_t len)
+{
+	size_t i;
+
+	dev->read += len;
+	if (dev->state != transaction_answer)
+		return;
+	dev->last = at;
+	for (i = 0; i < len; ++i)
+	{
+		/* zeroes before an answer are skipped by the library */
+		if (dev->answer_len == 0 && data[i] == 0)
+			continue;
+		if (dev->answer_len < sizeof(dev->answer))
+			dev->answer[dev->answer_len++] = data[i];
+	}
+	if (dev->answer_len < 4)
+		return;
+	if (memcmp( dev->answer, "errv", 4 ) == 0 || memcmp( dev->answer, "errd", 4 ) == 0)
+	{
+		finish_transaction( dev, memcmp( dev->answer, "errv", 4 ) == 0 ? "errv" : "errd" );
+		return;
+	}
+	if (memcmp( dev->answer, dev->request, 4 ) != 0)
+	{
+		finish_transaction( dev, "wrong answer" );
+		return;
+	}
+	if (dev->answer_len >= dev->answer_size)
+		finish_transaction( dev, "ok" );
+}
+
+static void on_text(device_t* dev, uint64_t at, const char* text)
+{
+	if (strncmp( text, "Flushing", 8 ) == 0)
+		burst_event( dev, at, &dev->burst.flushes );
+	else if (strncmp( text, "Closing", 7 ) == 0)
+		finish_transaction( dev, "closed" );
+}
+
+/*
+ * Parsing
+ */
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static void parse_line(char* line)
+{
+	char* columns[6];
+	unsigned char data[XILOG_PACKET_MAX];
+	size_t len = 0, n;
+	unsigned long long at;
+	device_t* dev;
+	int count = 0, hi, lo;
+	char* p = line;
+
+	line[strcspn( line, "\r\n" )] = 0;
+	while (count < 6)
+	{
+		columns[count++] = p;
+		if ((p = strchr( p, '\t' )) == NULL)
+			break;
+		*p++ = 0;
+	}
+	if (count < 5 || sscanf( columns[0], "%llu", &at ) != 1)
+		return;
+	if (trace_start == 0 || at < trace_start)
+		trace_start = at;
+	dev = find_device( columns[2], strtoul( columns[3], NULL, 10 ) );
+	if (dev->first_seen == 0)
+		dev->first_seen = at;
+	dev->last_seen = at;
+
+	if (columns[1][0] == '-')
+	{
+		on_text( dev, at, columns[4] );
+		return;
+	}
+	if (count == 6)
+	{
+		for (p = columns[5]; len < sizeof(data) && (hi = hex_digit( p[0] )) >= 0 && (lo = hex_digit( p[1] )) >= 0; p += 2)
+			data[len++] = (unsigned char)(hi << 4 | lo);
+	}
+	else
+	{
+		/* old logs, non-printable bytes are dots */
+		n = strlen( columns[4] );
+		for (len = 0; len < n && len < sizeof(data); ++len)
+			data[len] = columns[4][len] == '.' ? 0 : (unsigned char)columns[4][len];
+	}
+	if (columns[1][0] == 'W')
+		on_write( dev, at, data, len );
+	else if (columns[1][0] == 'R')
+		on_read( dev, at, data, len );
+}
+
+/*
+ * Reports
+ */
+
+static int stat_compare(const void* a, const void* b)
+{
+	const command_stat_t* x = (const command_stat_t*)a;
+	const command_stat_t* y = (const command_stat_t*)b;
+	uint64_t tx = 0, ty = 0;
+	size_t i;
+
+	/* the commands which take the most bus time go first */
+	for (i = 0; i < x->latency.count; ++i)
+		tx += x->latency.values[i];
+	for (i = 0; i < y->latency.count; ++i)
+		ty += y->latency.values[i];
+	return tx > ty ? -1 : tx < ty;
+}
+
+static void report(void)
+{
+	size_t i;
+	device_t* dev;
+	command_stat_t* stat;
+	uint64_t total;
+	double span;
+	char name[32];
+	int j;
+
+	printf( "\nCommands, latency in us\n" );
+	printf( "%-4s %-36s %8s %8s %8s %8s %8s %8s %10s %6s %7s\n",
+			"code", "function", "count", "min", "p50", "p90", "p99", "max", "total ms", "errors", "retries" );
+	for (i = 0; i < stats_count; ++i)
+		qsort( stats[i].latency.values, stats[i].latency.count, sizeof(uint64_t), samples_compare );
+	qsort( stats, stats_count, sizeof(command_stat_t), stat_compare );
+	for (i = 0; i < stats_count; ++i)
+	{
+		stat = &stats[i];
+		if (stat->latency.count == 0)
+			continue;
+		for (total = 0, j = 0; j < (int)stat->latency.count; ++j)
+			total += stat->latency.values[j];
+		printf( "%-4s %-36s %8lu %8llu %8llu %8llu %8llu %8llu %10.1f %6u %7u\n",
+				stat->code, stat->command ? stat->command->function : "?", (unsigned long)stat->latency.count,
+				(unsigned long long)stat->latency.values[0],
+				(unsigned long long)samples_percentile( &stat->latency, 50 ),
+				(unsigned long long)samples_percentile( &stat->latency, 90 ),
+				(unsigned long long)samples_percentile( &stat->latency, 99 ),
+				(unsigned long long)stat->latency.values[stat->latency.count-1],
+				total / 1e3, stat->errors, stat->retries );
+	}
+
+	printf( "\nDevices\n" );
+	printf( "%-20s %8s %10s %10s %10s %10s %8s %10s %10s %10s %7s\n",
+			"device", "commands", "written", "read", "span s", "cmd/s", "busy %", "gap p50", "gap p90", "gap max", "bursts" );
+	for (i = 0; i < devices_count; ++i)
+	{
+		dev = &devices[i];
+		if (dev->commands == 0)
+			continue;
+		if (dev->burst.end)
+			++dev->bursts;
+		qsort( dev->gaps.values, dev->gaps.count, sizeof(uint64_t), samples_compare );
+		span = (dev->last_seen - dev->first_seen) / 1e6;
+		sprintf( name, "%s/%lu", dev->type, dev->id );
+		printf( "%-20s %8u %10llu %10llu %10.3f %10.1f %8.1f %10llu %10llu %10llu %7u\n",
+				name, dev->commands,
+				(unsigned long long)dev->written, (unsigned long long)dev->read, span,
+				span > 0 ? dev->commands / span : 0.0, span > 0 ? dev->busy_us / (span * 1e4) : 0.0,
+				(unsigned long long)samples_percentile( &dev->gaps, 50 ),
+				(unsigned long long)samples_percentile( &dev->gaps, 90 ),
+				(unsigned long long)(dev->gaps.count ? dev->gaps.values[dev->gaps.count-1] : 0),
+				dev->bursts );
+		for (j = 0; j < XILOG_GAP_TOP && dev->top_gaps[j].us; ++j)
+			printf( "    gap %llu us at %+.6f between %s and %s\n", (unsigned long long)dev->top_gaps[j].us,
+					(dev->top_gaps[j].at - trace_start) / 1e6, dev->top_gaps[j].before, dev->top_gaps[j].after );
+		if (dev->burst.end)
+			printf( "    last burst at %+.6f: %u syncs, %u flushes, %u errors, %u retries\n",
+					(dev->burst.start - trace_start) / 1e6,
+					dev->burst.syncs, dev->burst.flushes, dev->burst.errors, dev->burst.retries );
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	char line[XILOG_LINE_MAX];
+	FILE* file;
+	size_t i;
+	int arg;
+
+	for (arg = 1; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		if (strcmp( argv[arg], "-d" ) == 0)
+			decode = 1;
+		else if (strcmp( argv[arg], "-b" ) == 0 && arg+1 < argc)
+			burst_us = (uint64_t)strtoul( argv[++arg], NULL, 10 ) * 1000;
+		else
+			break;
+	}
+	if (arg >= argc)
+	{
+		fprintf( stderr, "Usage: %s [-d] [-b burst_ms] file...\n", argv[0] );
+		return 2;
+	}
+	for (; arg < argc; ++arg)
+	{
+		if ((file = fopen( argv[arg], "r" )) == NULL)
+		{
+			fprintf( stderr, "Can't open %s\n", argv[arg] );
+			return 1;
+		}
+		while (fgets( line, sizeof(line), file ))
+			parse_line( line );
+		fclose( file );
+	}
+	for (i = 0; i < devices_count; ++i)
+		if (devices[i].state == transaction_request || devices[i].state == transaction_answer)
+			finish_transaction( &devices[i], "no answer" );
+	report();
+	return 0;
+}
+
+// vim: syntax=c tabstop=4 shiftwidth=4
@@ -0,0 +1,171 @@
+/*
+ * Serializer microbenchmark.
+ * Every command is run against a virtual device twice: through its get/set function and as a raw
+ * prebuilt packet with the same locking and CRC work. The difference is the cost of encoding
+ * or decoding the structure.
+ * Build it with make ximc_bench and run ./ximc_bench [iterations].
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ximc.h"
+#include "common.h"
+#include "metadata.h"
+#include "platform.h"
+#include "protosup.h"
+#include "util.h"
+
+#define BENCH_DEVICE "xi-emu:///tmp/ximc-bench.bin"
+
+/* the best of several rounds is taken, the virtual device round trip is much longer than serialization */
+#define BENCH_ROUNDS 7
+
+/* keeps the CRC of raw packets from being optimized out */
+static volatile uint16_t bench_sink;
+
+typedef struct bench_command_t
+{
+	const char* name;
+	const char* code;
+	result_t (*get)(device_t id);
+	result_t (*set)(device_t id);
+} bench_command_t;
+
+/* get/set pair over one static structure, so the set writes back what the get read */
+#define BENCH_SETTINGS(Name) \
+	static Name##_t bench_##Name; \
+	static result_t bench_get_##Name(device_t id) { return get_##Name( id, &bench_##Name ); } \
+	static result_t bench_set_##Name(device_t id) { return set_##Name( id, &bench_##Name ); }
+
+BENCH_SETTINGS(move_settings)
+BENCH_SETTINGS(engine_settings)
+BENCH_SETTINGS(edges_settings)
+BENCH_SETTINGS(control_settings)
+BENCH_SETTINGS(pid_settings)
+BENCH_SETTINGS(stage_settings)
+BENCH_SETTINGS(motor_settings)
+BENCH_SETTINGS(accessories_settings)
+
+static measurements_t bench_measurements;
+static result_t bench_get_measurements(device_t id) { return get_measurements( id, &bench_measurements ); }
+
+static const bench_command_t bench_commands[] =
+{
+	{ "move_settings", "mov", bench_get_move_settings, bench_set_move_settings },
+	{ "engine_settings", "eng", bench_get_engine_settings, bench_set_engine_settings },
+	{ "edges_settings", "eds", bench_get_edges_settings, bench_set_edges_settings },
+	{ "control_settings", "ctl", bench_get_control_settings, bench_set_control_settings },
+	{ "pid_settings", "pid", bench_get_pid_settings, bench_set_pid_settings },
+	{ "stage_settings", "sts", bench_get_stage_settings, bench_set_stage_settings },
+	{ "motor_settings", "mts", bench_get_motor_settings, bench_set_motor_settings },
+	{ "accessories_settings", "acc", bench_get_accessories_settings, bench_set_accessories_settings },
+	{ "measurements", "etm", bench_get_measurements, NULL },
+	{ NULL, NULL, NULL, NULL }
+};
+
+static unsigned int bench_packet_size(const char* code)
+{
+	const settings_command_t* command;
+
+	for (command = settings_commands; command->name; ++command)
+		if (memcmp( command->code, code, 3 ) == 0)
+			return command->size;
+	/* get_measurements is not a universal command */
+	return 216;
+}
+
+/* Nanoseconds per call */
+static double bench_run_once(device_t id, result_t (*call)(device_t), unsigned int iterations)
+{
+	uint64_t start, stop;
+	unsigned int i;
+
+	get_wallclock_us( &start );
+	for (i = 0; i < iterations; ++i)
+		if (call( id ) != result_ok)
+			return -1;
+	get_wallclock_us( &stop );
+	return (double)(stop - start) * 1000 / iterations;
+}
+
+static double bench_run_raw_once(device_t id, const byte* packet, size_t packet_size, size_t response_size, unsigned int iterations)
+{
+	byte response[256];
+	uint64_t start, stop;
+	unsigned int i;
+
+	get_wallclock_us( &start );
+	for (i = 0; i < iterations; ++i)
+	{
+		lock( id );
+		/* a set function computes the CRC of its packet */
+		if (packet_size > 4)
+			bench_sink = get_crc( packet + 4, packet_size - 6 );
+		if (command_checked( id, packet, packet_size, response, response_size ) != result_ok ||
+				(response_size > 4 && check_in_overrun( id, response_size - 2, response_size, response ) != result_ok))
+			return unlocker( id, -1 );
+		unlock( id );
+	}
+	get_wallclock_us( &stop );
+	return (double)(stop - start) * 1000 / iterations;
+}
+
+/* Best time of a call and of the raw packet, returns their difference */
+static double bench_compare(device_t id, result_t (*call)(device_t), const byte* packet, size_t packet_size,
+		size_t response_size, unsigned int iterations, double* full)
+{
+	double best = -1, best_raw = -1, t;
+	int round;
+
+	for (round = 0; round < BENCH_ROUNDS; ++round)
+	{
+		t = bench_run_once( id, call, iterations );
+		if (best < 0 || t < best)
+			best = t;
+		t = bench_run_raw_once( id, packet, packet_size, response_size, iterations );
+		if (best_raw < 0 || t < best_raw)
+			best_raw = t;
+	}
+	*full = best;
+	return best - best_raw;
+}
+
+int main (int argc, char* argv[])
+{
+	const bench_command_t* command;
+	unsigned int iterations = argc > 1 ? (unsigned int)atoi( argv[1] ) : 20000;
+	byte packet[256];
+	unsigned int size;
+	double full, cost;
+	device_t id;
+
+	if ((id = open_device( BENCH_DEVICE )) == device_undefined)
+	{
+		fprintf( stderr, "Can't open %s\n", BENCH_DEVICE );
+		return 1;
+	}
+	printf( "%-22s %5s %12s %12s %12s %12s\n", "command", "bytes", "get, ns", "decode, ns", "set, ns", "encode, ns" );
+	for (command = bench_commands; command->name; ++command)
+	{
+		size = bench_packet_size( command->code );
+		packet[0] = 'g';
+		memcpy( packet + 1, command->code, 3 );
+		cost = bench_compare( id, command->get, packet, 4, size, iterations, &full );
+		printf( "%-22s %5u %12.1f %12.1f", command->name, size, full, cost );
+		if (command->set)
+		{
+			/* the raw packet is the answer with the writer code, the payload and CRC are the same */
+			if (command_checked( id, packet, 4, packet, size ) != result_ok)
+				return 1;
+			packet[0] = 's';
+			cost = bench_compare( id, command->set, packet, size, 4, iterations, &full );
+			printf( " %12.1f %12.1f", full, cost );
+		}
+		printf( "\n" );
+	}
+	close_device( &id );
+	remove( "/tmp/ximc-bench.bin" );
+	return 0;
+}
+
+// vim: syntax=c tabstop=4 shiftwidth=4
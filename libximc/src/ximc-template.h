@@ -263,6 +263,15 @@ extern "C"
 		unsigned int MicrostepMode;			/**< \english is a controller setting which is determine a step division mode \endenglish \russian это настройка контроллера, определяющая режим пошагового деления \endrussian */
 	} calibration_t;
 
+	/**
+		\english
+		* Prepared calibration with the device correction table, see create_calibration_context
+		\endenglish
+		\russian
+		* Подготовленная калибровка с таблицей коррекции устройства, см. create_calibration_context
+		\endrussian	 */
+	typedef struct calibration_context_t calibration_context_t;
+
 	/**
 		\english
 		* Device network information structure.
@@ -420,6 +429,30 @@ extern "C"
 		*/
 	device_t XIMC_API open_device (const char* uri);
 
+	/**
+		* \english
+		* Open several devices at once.
+		* Devices are opened concurrently, so the call takes about as long as the slowest device instead of the sum of all.
+		* TCP connections share the same deadline.
+		* @param[in] uris - array of \a count device URIs, see \a open_device for the format.
+		* @param[in] count - number of devices.
+		* @param[out] devices - array of \a count identifiers, device_undefined for devices which failed to open.
+		* @param[out] results - optional array of \a count per-device results, may be NULL.
+		* @return result_ok if all devices were opened, result_error otherwise.
+		* \endenglish
+		* \russian
+		* Открывает несколько устройств за один вызов.
+		* Устройства открываются параллельно, поэтому вызов длится примерно столько же, сколько открытие самого медленного устройства, а не сумму времён.
+		* TCP-соединения устанавливаются с общим крайним сроком.
+		* @param[in] uris - массив из \a count URI устройств, формат описан в \a open_device.
+		* @param[in] count - количество устройств.
+		* @param[out] devices - массив из \a count идентификаторов, device_undefined для устройств, которые не удалось открыть.
+		* @param[out] results - необязательный массив из \a count результатов для каждого устройства, может быть NULL.
+		* @return result_ok если все устройства открыты, иначе result_error.
+		* \endrussian
+		*/
+	result_t XIMC_API open_devices (const char** uris, int count, device_t* devices, result_t* results);
+
 	/**
 		* \english
 		* Close specified device
@@ -450,7 +483,7 @@ extern "C"
 		* Column headers are string.
 		* Data is real, the point is a determiter.
 		* The first column is a coordinate. The second one is the deviation caused by a mechanical error.
-		* The maximum length of a table is 100 rows.
+		* The table length is not limited.
 		* \note
 		* The id parameter in this function is a C pointer, unlike most library functions that use this parameter
 		* @see command_move
@@ -477,7 +510,7 @@ extern "C"
 		* Данные действительные разделитель точка.
 		* Первый столбец координата. Второй - отклонение вызванное ошибкой механики.
 		* Между координатами отклонение расчитывается линейно. За диапазоном константа равная отклонению на границе.
-		* Максимальная длина таблицы 100 строк.		
+		* Длина таблицы не ограничена.
 		* \note
 		* Параметр id в данной функции является Си указателем, в отличие от большинства функций библиотеки использующих данный параметр
 		* @see command_move
@@ -502,8 +535,12 @@ extern "C"
 	* @param[in] namefile - the file name must be either a full path or a relative path. If the file name is set to NULL,
 	* the correction table will be cleared. File format: two tab-separated columns. Column headers are strings.
 	* Data is real, the dot is a delimiter. The first column is a coordinate. The second one is the deviation
-	* caused by a mechanical error. The maximum length of a table is 100 rows. Coordinate column must be sorted in
-	* ascending order.
+	* caused by a mechanical error. The table length is not limited. Coordinate column must be sorted in
+	* ascending order. An optional third word in the header line selects interpolation between the points:
+	* "linear" (default) or "cubic" for a monotone cubic spline which needs several times fewer points
+	* for a smooth error. The file may also be a binary table made by convert_correction_table.
+	* Devices which load equal files share one copy of the table.
+	* @see convert_correction_table
 	* @see command_move
 	* @see get_position_calb
 	* @see get_position_calb_t
@@ -525,7 +562,13 @@ extern "C"
 	* Заголовки столбцов строковые.
 	* Данные действительные, разделитель точка.
 	* Первый столбец - координата. Второй - отклонение, вызванное ошибкой механики.
-	* Максимальная длина таблицы 100 строк. Координаты должны быть отсортированы по возрастанию.
+	* Длина таблицы не ограничена. Координаты должны быть отсортированы по возрастанию.
+	* Необязательное третье слово в строке заголовков выбирает интерполяцию между точками:
+	* "linear" (по умолчанию) или "cubic" - монотонный кубический сплайн, которому для плавной ошибки
+	* нужно в несколько раз меньше точек.
+	* Файл также может быть двоичной таблицей, созданной convert_correction_table.
+	* Устройства, загрузившие одинаковые файлы, используют одну копию таблицы.
+	* @see convert_correction_table
 	* @see command_move
 	* @see command_movr
 	* @see get_position_calb
@@ -539,6 +582,130 @@ extern "C"
 	*/
 	result_t XIMC_API set_correction_table(device_t id, const char* namefile);
 
+	/**
+	* \english
+	* Converts a correction table file to the binary format.
+	* A binary table is used in place through a memory mapping and loads without parsing,
+	* it is accepted by set_correction_table and load_correction_table.
+	* The binary format depends on the library version and on the byte order of the machine,
+	* keep the text file as the source.
+	* @param[in] source - a text or binary correction table file
+	* @param[in] destination - a binary file to create
+	* @see set_correction_table
+	* \endenglish
+	* \russian
+	* Преобразует файл корректирующей таблицы в двоичный формат.
+	* Двоичная таблица используется напрямую через отображение файла в память и загружается без разбора,
+	* её принимают set_correction_table и load_correction_table.
+	* Двоичный формат зависит от версии библиотеки и порядка байт машины,
+	* храните текстовый файл как исходный.
+	* @param[in] source - текстовый или двоичный файл корректирующей таблицы
+	* @param[in] destination - создаваемый двоичный файл
+	* @see set_correction_table
+	* \endrussian
+	*/
+	result_t XIMC_API convert_correction_table(const char* source, const char* destination);
+
+	/**
+	* \english
+	* Converts an array of positions or speeds from steps and microsteps to user units.
+	* The result is the same as the one of _calb functions, but the whole array is converted at once.
+	* @param id an identifier of the device whose correction table is applied.
+	* Pass device_undefined for values which are not corrected, such as speeds and accelerations.
+	* @param[in] steps - array of \a count whole steps
+	* @param[in] usteps - array of \a count microsteps, NULL if the values have no microstep part
+	* @param[out] values - array of \a count values in user units
+	* @param count - length of the arrays
+	* @param[in] calibration - user unit settings
+	* @see calb_to_normal_array
+	* @see set_correction_table
+	* \endenglish
+	* \russian
+	* Переводит массив позиций или скоростей из шагов и микрошагов в пользовательские единицы.
+	* Результат совпадает с результатом функций _calb, но весь массив переводится за один вызов.
+	* @param id - идентификатор устройства, таблица коррекции которого применяется.
+	* Для величин, к которым коррекция не применяется, например скоростей и ускорений, передайте device_undefined.
+	* @param[in] steps - массив из \a count целых шагов
+	* @param[in] usteps - массив из \a count микрошагов, NULL если у величин нет микрошаговой части
+	* @param[out] values - массив из \a count значений в пользовательских единицах
+	* @param count - длина массивов
+	* @param[in] calibration - настройки пользовательских единиц
+	* @see calb_to_normal_array
+	* @see set_correction_table
+	* \endrussian
+	*/
+	result_t XIMC_API normal_to_calb_array(device_t id, const int* steps, const int* usteps, float* values, int count,
+			const calibration_t* calibration);
+
+	/**
+	* \english
+	* Converts an array of positions or speeds from user units to steps and microsteps.
+	* The result is the same as the one of _calb functions, but the whole array is converted at once.
+	* @param id an identifier of the device whose correction table is applied.
+	* Pass device_undefined for values which are not corrected, such as speeds and accelerations.
+	* @param[in] values - array of \a count values in user units
+	* @param[out] steps - array of \a count whole steps
+	* @param[out] usteps - array of \a count microsteps, NULL if the microstep part is not needed
+	* @param count - length of the arrays
+	* @param[in] calibration - user unit settings
+	* @see normal_to_calb_array
+	* @see set_correction_table
+	* \endenglish
+	* \russian
+	* Переводит массив позиций или скоростей из пользовательских единиц в шаги и микрошаги.
+	* Результат совпадает с результатом функций _calb, но весь массив переводится за один вызов.
+	* @param id - идентификатор устройства, таблица коррекции которого применяется.
+	* Для величин, к которым коррекция не применяется, например скоростей и ускорений, передайте device_undefined.
+	* @param[in] values - массив из \a count значений в пользовательских единицах
+	* @param[out] steps - массив из \a count целых шагов
+	* @param[out] usteps - массив из \a count микрошагов, NULL если микрошаговая часть не нужна
+	* @param count - длина массивов
+	* @param[in] calibration - настройки пользовательских единиц
+	* @see normal_to_calb_array
+	* @see set_correction_table
+	* \endrussian
+	*/
+	result_t XIMC_API calb_to_normal_array(device_t id, const float* values, int* steps, int* usteps, int count,
+			const calibration_t* calibration);
+
+	/**
+	* \english
+	* Creates a calibration context for the _calb_ctx functions.
+	* The context keeps user unit settings checked and prepared and holds the correction table
+	* the device has at the moment of the call, so conversions do not look them up again.
+	* Create a new context after calibration or the correction table is changed.
+	* @param id an identifier of the device whose correction table is used, or device_undefined for no correction
+	* @param[in] calibration - user unit settings
+	* @param[out] context - the created context
+	* @return result_value_error if calibration is invalid, result_error if the device is unknown
+	* @see free_calibration_context
+	* \endenglish
+	* \russian
+	* Создает контекст калибровки для функций _calb_ctx.
+	* Контекст хранит проверенные и подготовленные настройки пользовательских единиц и таблицу коррекции,
+	* загруженную в устройство на момент вызова, поэтому преобразования не ищут их заново.
+	* После изменения калибровки или таблицы коррекции создайте новый контекст.
+	* @param id - идентификатор устройства, таблица коррекции которого используется, или device_undefined без коррекции
+	* @param[in] calibration - настройки пользовательских единиц
+	* @param[out] context - созданный контекст
+	* @return result_value_error, если калибровка некорректна, result_error, если устройство неизвестно
+	* @see free_calibration_context
+	* \endrussian
+	*/
+	result_t XIMC_API create_calibration_context(device_t id, const calibration_t* calibration, calibration_context_t** context);
+
+	/**
+	* \english
+	* Frees a calibration context. The context may outlive its device.
+	* @param context - a context created by create_calibration_context, may be NULL
+	* \endenglish
+	* \russian
+	* Освобождает контекст калибровки. Контекст можно освободить и после закрытия устройства.
+	* @param context - контекст, созданный create_calibration_context, может быть NULL
+	* \endrussian
+	*/
+	result_t XIMC_API free_calibration_context(calibration_context_t* context);
+
 	/**
 		* \english
 		* Check if a device with OS uri \a uri is XIMC device.
@@ -604,6 +771,36 @@ extern "C"
 	 */
 	result_t XIMC_API free_enumerate_devices(device_enumeration_t device_enumeration);
 
+	/**
+		* \english
+		* Start background SSDP listener.
+		* The listener joins the SSDP multicast group and caches announcements of network adapters
+		* until \a stop_ssdp_listener is called.
+		* While it is running, \a enumerate_devices with ENUMERATE_NETWORK flag takes SSDP devices from the cache
+		* instead of waiting for a discovery round.
+		* Calling it again while the listener is running does nothing.
+		* \endenglish
+		* \russian
+		* Запускает фоновый SSDP-приёмник.
+		* Приёмник подключается к multicast-группе SSDP и запоминает объявления сетевых адаптеров
+		* до вызова \a stop_ssdp_listener.
+		* Пока он работает, \a enumerate_devices с флагом ENUMERATE_NETWORK берёт SSDP-устройства из кэша
+		* вместо ожидания ответов на поисковый запрос.
+		* Повторный вызов при работающем приёмнике ничего не делает.
+		* \endrussian
+	 */
+	result_t XIMC_API start_ssdp_listener();
+
+	/**
+		* \english
+		* Stop background SSDP listener started by \a start_ssdp_listener and drop its cache.
+		* \endenglish
+		* \russian
+		* Останавливает фоновый SSDP-приёмник, запущенный \a start_ssdp_listener, и очищает его кэш.
+		* \endrussian
+	 */
+	result_t XIMC_API stop_ssdp_listener();
+
 	/**
 		* \english
 		* Get device count.
@@ -733,6 +930,54 @@ extern "C"
 	 */
 	result_t XIMC_API get_enumerate_device_network_information(device_enumeration_t device_enumeration, int device_index, device_network_information_t* device_network_information);
 
+	/**
+		* \english
+		* Get the number of network servers queried by the enumeration.
+		* These are the servers of the "addr" hint, an empty list of addresses is one broadcast query.
+		* @param[in] device_enumeration opaque pointer to an enumeration device data
+		* \endenglish
+		* \russian
+		* Возвращает количество сетевых серверов, опрошенных при перечислении.
+		* Это серверы из подсказки "addr", пустой список адресов - это один широковещательный запрос.
+		* @param[in] device_enumeration закрытый указатель на данные о перечисленных устойствах
+		* \endrussian
+	 */
+	int XIMC_API get_enumerate_server_count(device_enumeration_t device_enumeration);
+
+	/**
+		* \english
+		* Get the address of a network server queried by the enumeration.
+		* The string is owned by the enumeration.
+		* @param[in] device_enumeration opaque pointer to an enumeration device data
+		* @param[in] server_index server index
+		* \endenglish
+		* \russian
+		* Возвращает адрес сетевого сервера, опрошенного при перечислении.
+		* Строка принадлежит перечислению.
+		* @param[in] device_enumeration закрытый указатель на данные о перечисленных устойствах
+		* @param[in] server_index номер сервера
+		* \endrussian
+	 */
+	pchar XIMC_API get_enumerate_server_address(device_enumeration_t device_enumeration, int server_index);
+
+	/**
+		* \english
+		* Get the time a network server took to answer the enumeration query.
+		* Returns result_nodevice if the server did not answer in time.
+		* @param[in] device_enumeration opaque pointer to an enumeration device data
+		* @param[in] server_index server index
+		* @param[out] latency_us time from the start of the queries to the answer, in microseconds
+		* \endenglish
+		* \russian
+		* Возвращает время, за которое сетевой сервер ответил на запрос перечисления.
+		* Возвращает result_nodevice, если сервер не ответил вовремя.
+		* @param[in] device_enumeration закрытый указатель на данные о перечисленных устойствах
+		* @param[in] server_index номер сервера
+		* @param[out] latency_us время от начала запросов до ответа, в микросекундах
+		* \endrussian
+	 */
+	result_t XIMC_API get_enumerate_server_latency(device_enumeration_t device_enumeration, int server_index, uint32_t* latency_us);
+
 	/** \english
 		* Resets the error of incorrect data transmission.
 		* \endenglish
@@ -891,6 +1136,46 @@ extern "C"
 	*/
 	result_t XIMC_API get_status_calb (device_t id, status_calb_t* status, const calibration_t* calibration);
 
+	/**
+	* \english
+	* The same as get_status_calb, but takes a calibration context instead of calibration_t.
+	* @see create_calibration_context
+	* \endenglish
+	* \russian
+	* То же, что get_status_calb, но принимает контекст калибровки вместо calibration_t.
+	* @see create_calibration_context
+	* \endrussian
+	*/
+	result_t XIMC_API get_status_calb_ctx (device_t id, status_calb_t* status, const calibration_context_t* context);
+
+	/**
+	* \english
+	* Reads the state of several devices at once, for example of all axes of a machine.
+	* Every device is read by its own thread, so each port has one request in flight and
+	* the call takes about one round trip instead of one per device.
+	* Every reader of a settings or data structure has the same _multi variant, for example get_position_multi.
+	* @param ids identifiers of devices, each device may appear only once
+	* @param count number of devices
+	* @param[out] status array of count structures, status[i] is read from ids[i]
+	* @param[out] results result of get_status for each device, may be NULL
+	* @return result_ok if all devices were read, otherwise the first failed result
+	* @see get_status
+	* \endenglish
+	* \russian
+	* Читает состояние нескольких устройств одновременно, например всех осей станка.
+	* Каждое устройство читается своим потоком, поэтому в каждом порту находится один запрос,
+	* и вызов занимает примерно один обмен вместо одного на каждое устройство.
+	* У каждой функции чтения структуры настроек или данных есть такой же вариант _multi, например get_position_multi.
+	* @param ids идентификаторы устройств, каждое устройство может встречаться только один раз
+	* @param count количество устройств
+	* @param[out] status массив из count структур, status[i] читается из ids[i]
+	* @param[out] results результат get_status для каждого устройства, может быть NULL
+	* @return result_ok, если все устройства прочитаны, иначе первый неуспешный результат
+	* @see get_status
+	* \endrussian
+	*/
+	result_t XIMC_API get_status_multi (const device_t* ids, int count, status_t* status, result_t* results);
+
 /**
 	* \english
 	* Return device information.
@@ -918,6 +1203,19 @@ extern "C"
 	*/
 	result_t XIMC_API get_device_information (device_t id, device_information_t* device_information);
 
+	/**
+	* \english
+	* Runs get_device_information on several devices at once, device_information[i] is read from ids[i].
+	* @see get_status_multi
+	* \endenglish
+	* \russian
+	* Выполняет get_device_information для нескольких устройств одновременно, device_information[i] читается из ids[i].
+	* @see get_status_multi
+	* \endrussian
+	*/
+	result_t XIMC_API get_device_information_multi (const device_t* ids, int count, device_information_t* device_information,
+		result_t* results);
+
 /**
 	* \english
 	* Wait for stop
@@ -951,6 +1249,524 @@ extern "C"
 	* \endrussian
 	*/
 	result_t XIMC_API command_homezero(device_t id);
+
+	/**
+	* \english
+	* Target of one device for command_move_group.
+	* \endenglish
+	* \russian
+	* Цель одного устройства для command_move_group.
+	* \endrussian
+	*/
+	typedef struct move_target_t
+	{
+		int Position;	/**< \english Desired position (whole steps). \endenglish \russian Желаемая позиция (целые шаги). \endrussian */
+		int uPosition;	/**< \english The fractional part of a position in microsteps. \endenglish \russian Дробная часть позиции в микрошагах. \endrussian */
+	} move_target_t;
+
+	/**
+	* \english
+	* Starts move commands on several devices at once, for example on the axes of one XY(Z) stage.
+	* All packets are prepared in advance and sent from one thread per device after every
+	* device is ready, so the start skew is much smaller than for consecutive command_move calls.
+	* @param ids identifiers of devices, each device may appear only once
+	* @param targets targets of the devices in the same order
+	* @param count number of devices
+	* @param[out] results result of command_move for each device, may be NULL
+	* @param[out] skew_us measured time between the first and the last send on the host in microseconds, may be NULL
+	* @return result_ok if all devices accepted the command, otherwise the first failed result
+	* @see command_move
+	* \endenglish
+	* \russian
+	* Запускает движение нескольких устройств одновременно, например осей одного XY(Z) стола.
+	* Все пакеты готовятся заранее и отправляются из отдельного потока для каждого устройства после того,
+	* как все устройства готовы, поэтому разброс моментов старта намного меньше, чем при последовательных вызовах command_move.
+	* @param ids идентификаторы устройств, каждое устройство может встречаться только один раз
+	* @param targets цели устройств в том же порядке
+	* @param count количество устройств
+	* @param[out] results результат command_move для каждого устройства, может быть NULL
+	* @param[out] skew_us измеренное на компьютере время между первой и последней отправкой в микросекундах, может быть NULL
+	* @return result_ok, если все устройства приняли команду, иначе первый неуспешный результат
+	* @see command_move
+	* \endrussian
+	*/
+	result_t XIMC_API command_move_group(const device_t* ids, const move_target_t* targets, int count,
+		result_t* results, unsigned int* skew_us);
+
+	/**
+	* \english
+	* Stops several devices immediately, for example on a safety event.
+	* Stop is sent to all devices in parallel, so the latency does not grow with the number of devices.
+	* If another thread is busy with a device, the stop frame is written to its port out of turn between
+	* the frames of that thread, which goes on with its call. The acknowledgement is collected by that call
+	* or after the device is released, but not later than deadline_ms after the start.
+	* @param ids identifiers of devices, each device may appear only once
+	* @param count number of devices
+	* @param deadline_ms how long a device is waited for its acknowledgement in milliseconds
+	* @param[out] results result of the stop for each device, result_error if it was not acknowledged in time, may be NULL
+	* @param[out] latency_us time from the call to the acknowledgement for each device in microseconds, zero if there was no acknowledgement, may be NULL
+	* @return result_ok if all devices acknowledged the stop, otherwise the first failed result
+	* @see command_stop
+	* \endenglish
+	* \russian
+	* Немедленно останавливает несколько устройств, например при срабатывании защиты.
+	* Команда stop отправляется всем устройствам параллельно, поэтому задержка не растет с числом устройств.
+	* Если с устройством работает другой поток, пакет stop записывается в порт вне очереди между пакетами
+	* этого потока, и его вызов продолжается. Подтверждение принимается этим вызовом или после освобождения
+	* устройства, но не позже deadline_ms после начала вызова.
+	* @param ids идентификаторы устройств, каждое устройство может встречаться только один раз
+	* @param count количество устройств
+	* @param deadline_ms сколько ждать подтверждения от устройства в миллисекундах
+	* @param[out] results результат остановки каждого устройства, result_error, если подтверждение не получено вовремя, может быть NULL
+	* @param[out] latency_us время от вызова до подтверждения для каждого устройства в микросекундах, ноль, если подтверждения нет, может быть NULL
+	* @return result_ok, если все устройства подтвердили остановку, иначе первый неуспешный результат
+	* @see command_stop
+	* \endrussian
+	*/
+	result_t XIMC_API command_stop_all(const device_t* ids, int count, unsigned int deadline_ms,
+		result_t* results, unsigned int* latency_us);
+
+	/**
+	* \english
+	* Stops all devices opened in this process, see command_stop_all.
+	* @param deadline_ms how long a device is waited for its acknowledgement in milliseconds
+	* \endenglish
+	* \russian
+	* Останавливает все устройства, открытые в этом процессе, см. command_stop_all.
+	* @param deadline_ms сколько ждать подтверждения от устройства в миллисекундах
+	* \endrussian
+	*/
+	result_t XIMC_API command_stop_all_open(unsigned int deadline_ms);
+
+	/**
+		\english
+		* Position command serialized in advance, see prepare_command
+		\endenglish
+		\russian
+		* Заранее сериализованная команда позиционирования, см. prepare_command
+		\endrussian	 */
+	typedef struct prepared_command_t prepared_command_t;
+
+	/**
+	* \english
+	* Serializes a move or movr command for repeated sending, for example in a raster scan.
+	* The packet with its checksum is built once, patch_prepared changes only the position bytes
+	* and updates the checksum incrementally, fire_prepared only sends the packet and checks the answer.
+	* @param id an identifier of device
+	* @param command "move" for command_move or "movr" for command_movr
+	* @param Position position or shift in whole steps
+	* @param uPosition the fractional part in microsteps
+	* @param[out] prepared the prepared command, free it with free_prepared
+	* @return result_value_error if the command can not be prepared
+	* \endenglish
+	* \russian
+	* Сериализует команду move или movr для многократной отправки, например при растровом сканировании.
+	* Пакет с контрольной суммой строится один раз, patch_prepared меняет только байты позиции
+	* и пересчитывает контрольную сумму инкрементально, fire_prepared только отправляет пакет и проверяет ответ.
+	* @param id идентификатор устройства
+	* @param command "move" для command_move или "movr" для command_movr
+	* @param Position позиция или смещение в целых шагах
+	* @param uPosition дробная часть в микрошагах
+	* @param[out] prepared подготовленная команда, освобождается free_prepared
+	* @return result_value_error, если команду нельзя подготовить
+	* \endrussian
+	*/
+	result_t XIMC_API prepare_command(device_t id, const char* command, int Position, int uPosition,
+		prepared_command_t** prepared);
+
+	/**
+	* \english
+	* Changes the position of a prepared command without serializing the packet again.
+	* @param prepared a command created by prepare_command
+	* @param Position position or shift in whole steps
+	* @param uPosition the fractional part in microsteps
+	* \endenglish
+	* \russian
+	* Меняет позицию подготовленной команды без повторной сериализации пакета.
+	* @param prepared команда, созданная prepare_command
+	* @param Position позиция или смещение в целых шагах
+	* @param uPosition дробная часть в микрошагах
+	* \endrussian
+	*/
+	result_t XIMC_API patch_prepared(prepared_command_t* prepared, int Position, int uPosition);
+
+	/**
+	* \english
+	* Sends a prepared command to its device, the result is the same as for command_move or command_movr.
+	* @param prepared a command created by prepare_command
+	* \endenglish
+	* \russian
+	* Отправляет подготовленную команду устройству, результат такой же, как у command_move или command_movr.
+	* @param prepared команда, созданная prepare_command
+	* \endrussian
+	*/
+	result_t XIMC_API fire_prepared(prepared_command_t* prepared);
+
+	/**
+	* \english
+	* Frees a prepared command.
+	* @param prepared a command created by prepare_command, may be NULL
+	* \endenglish
+	* \russian
+	* Освобождает подготовленную команду.
+	* @param prepared команда, созданная prepare_command, может быть NULL
+	* \endrussian
+	*/
+	result_t XIMC_API free_prepared(prepared_command_t* prepared);
+	//@}
+
+	// ------------------------------------
+
+	/**
+		\english
+		@name Settings snapshots
+		* Backup, comparison and restore of all settings of a device
+		\endenglish
+		\russian
+		@name Снимки настроек
+		* Сохранение, сравнение и восстановление всех настроек устройства
+		\endrussian
+		*/
+	//@{
+
+	/**
+	* \english
+	* Reads all settings of a device into a snapshot.
+	* A snapshot is a versioned binary block with every settings structure that has get_ and set_ functions,
+	* it may be saved to a file and applied to this or another device later.
+	* Structures not supported by the device are skipped. The device is locked for the whole read.
+	* @param id an identifier of device
+	* @param[out] snapshot buffer for the snapshot, NULL to query the size
+	* @param size size of the buffer
+	* @param[out] snapshot_size size of the snapshot, or the required buffer size if snapshot is NULL or the buffer is too small
+	* @return result_value_error if the buffer is too small
+	* \endenglish
+	* \russian
+	* Читает все настройки устройства в снимок.
+	* Снимок - это двоичный блок с версией, содержащий все структуры настроек, у которых есть функции get_ и set_.
+	* Его можно сохранить в файл и позже применить к этому или другому устройству.
+	* Структуры, которые устройство не поддерживает, пропускаются. Устройство блокируется на все время чтения.
+	* @param id идентификатор устройства
+	* @param[out] snapshot буфер для снимка, NULL для запроса размера
+	* @param size размер буфера
+	* @param[out] snapshot_size размер снимка или требуемый размер буфера, если snapshot равен NULL или буфер мал
+	* @return result_value_error, если буфер мал
+	* \endrussian
+	*/
+	result_t XIMC_API get_settings_snapshot(device_t id, uint8_t* snapshot, unsigned int size, unsigned int* snapshot_size);
+
+	/**
+	* \english
+	* Compares two snapshots structure by structure.
+	* @param base the old snapshot
+	* @param base_size size of the old snapshot
+	* @param snapshot the new snapshot
+	* @param size size of the new snapshot
+	* @param[out] changed comma separated names of structures which differ in the new snapshot, for example "move_settings,engine_settings", may be NULL
+	* @param changed_size size of the changed buffer, the list is cut at a whole name
+	* @param[out] count number of changed structures, may be NULL
+	* @return result_value_error if a snapshot is damaged
+	* \endenglish
+	* \russian
+	* Сравнивает два снимка по структурам.
+	* @param base старый снимок
+	* @param base_size размер старого снимка
+	* @param snapshot новый снимок
+	* @param size размер нового снимка
+	* @param[out] changed имена структур, отличающихся в новом снимке, через запятую, например "move_settings,engine_settings", может быть NULL
+	* @param changed_size размер буфера changed, список обрезается по целому имени
+	* @param[out] count количество изменившихся структур, может быть NULL
+	* @return result_value_error, если снимок поврежден
+	* \endrussian
+	*/
+	result_t XIMC_API diff_settings_snapshots(const uint8_t* base, unsigned int base_size,
+		const uint8_t* snapshot, unsigned int size, char* changed, unsigned int changed_size, unsigned int* count);
+
+	/**
+	* \english
+	* Writes settings from a snapshot to a device. Only structures which differ from the base are written.
+	* @param id an identifier of device
+	* @param snapshot the snapshot to apply
+	* @param size size of the snapshot
+	* @param base settings the device has now, for example a snapshot taken before, or NULL to read each structure from the device before writing it
+	* @param base_size size of the base snapshot
+	* @param[out] written number of written structures, may be NULL
+	* @return result of the first failed write, other structures are still written, result_value_error if a snapshot is damaged
+	* \endenglish
+	* \russian
+	* Записывает настройки из снимка в устройство. Записываются только структуры, отличающиеся от base.
+	* @param id идентификатор устройства
+	* @param snapshot применяемый снимок
+	* @param size размер снимка
+	* @param base текущие настройки устройства, например снятый ранее снимок, или NULL, чтобы читать каждую структуру из устройства перед записью
+	* @param base_size размер снимка base
+	* @param[out] written количество записанных структур, может быть NULL
+	* @return результат первой неудачной записи, остальные структуры все равно записываются, result_value_error, если снимок поврежден
+	* \endrussian
+	*/
+	result_t XIMC_API apply_settings_snapshot(device_t id, const uint8_t* snapshot, unsigned int size,
+		const uint8_t* base, unsigned int base_size, unsigned int* written);
+
+	/**
+		\english
+		* Stage profile loaded from a file, see load_profile
+		\endenglish
+		\russian
+		* Профиль подвижки, загруженный из файла, см. load_profile
+		\endrussian	 */
+	typedef struct profile_t profile_t;
+
+	/**
+	* \english
+	* Starts recording of settings written to a device into a profile.
+	* Every structure set while recording is stored, the last write of a structure wins.
+	* Use it to compile a set_profile_* function from c-profiles once, for example on a virtual device.
+	* @param id an identifier of device
+	* @see stop_profile_recording
+	* \endenglish
+	* \russian
+	* Начинает запись настроек, записываемых в устройство, в профиль.
+	* Сохраняется каждая структура, записанная во время записи, при повторной записи сохраняется последняя.
+	* Используйте, чтобы один раз скомпилировать функцию set_profile_* из c-profiles, например на виртуальном устройстве.
+	* @param id идентификатор устройства
+	* @see stop_profile_recording
+	* \endrussian
+	*/
+	result_t XIMC_API start_profile_recording(device_t id);
+
+	/**
+	* \english
+	* Stops recording of a profile and returns it. The profile has the format of a settings snapshot
+	* with only the recorded structures and may be saved to a file for load_profile.
+	* @param id an identifier of device
+	* @param[out] profile buffer for the profile, NULL to query the size
+	* @param size size of the buffer
+	* @param[out] profile_size size of the profile, or the required buffer size if profile is NULL or the buffer is too small, recording goes on in this case
+	* @return result_error if the profile is not being recorded
+	* \endenglish
+	* \russian
+	* Останавливает запись профиля и возвращает его. Профиль имеет формат снимка настроек
+	* только с записанными структурами и может быть сохранен в файл для load_profile.
+	* @param id идентификатор устройства
+	* @param[out] profile буфер для профиля, NULL для запроса размера
+	* @param size размер буфера
+	* @param[out] profile_size размер профиля или требуемый размер буфера, если profile равен NULL или буфер мал, в этом случае запись продолжается
+	* @return result_error, если профиль не записывается
+	* \endrussian
+	*/
+	result_t XIMC_API stop_profile_recording(device_t id, uint8_t* profile, unsigned int size, unsigned int* profile_size);
+
+	/**
+	* \english
+	* Loads a compiled profile file. The profile keeps a copy of the file, so the file may be changed after loading.
+	* @param name path to the profile file
+	* @param[out] profile the loaded profile, free it with free_profile
+	* @return result_value_error if the file is not a profile
+	* \endenglish
+	* \russian
+	* Загружает скомпилированный файл профиля. Профиль хранит копию файла, поэтому после загрузки файл можно изменять.
+	* @param name путь к файлу профиля
+	* @param[out] profile загруженный профиль, освобождается free_profile
+	* @return result_value_error, если файл не является профилем
+	* \endrussian
+	*/
+	result_t XIMC_API load_profile(const char* name, profile_t** profile);
+
+	/**
+	* \english
+	* Frees a profile.
+	* @param profile a profile created by load_profile, may be NULL
+	* \endenglish
+	* \russian
+	* Освобождает профиль.
+	* @param profile профиль, созданный load_profile, может быть NULL
+	* \endrussian
+	*/
+	result_t XIMC_API free_profile(profile_t* profile);
+
+	/**
+	* \english
+	* Writes a profile to a device. Each structure of the profile is read from the device first
+	* and written only if it differs, structures unsupported by the device do not stop the others.
+	* @param id an identifier of device
+	* @param profile a profile created by load_profile
+	* @param[out] written number of written structures, may be NULL
+	* @return result of the first failed write
+	* \endenglish
+	* \russian
+	* Записывает профиль в устройство. Каждая структура профиля сначала читается из устройства
+	* и записывается, только если отличается, структуры, не поддерживаемые устройством, не мешают записи остальных.
+	* @param id идентификатор устройства
+	* @param profile профиль, созданный load_profile
+	* @param[out] written количество записанных структур, может быть NULL
+	* @return результат первой неудачной записи
+	* \endrussian
+	*/
+	result_t XIMC_API apply_profile(device_t id, const profile_t* profile, unsigned int* written);
+
+	/**
+		\english
+		* Database of stage profiles loaded into memory, see open_profile_database
+		\endenglish
+		\russian
+		* База профилей подвижек, загруженная в память, см. open_profile_database
+		\endrussian	 */
+	typedef struct profile_database_t profile_database_t;
+
+	/**
+	* \english
+	* Creates a database file from compiled profile files. Stage and vendor names are taken from
+	* paths like <vendor>/<stage>.xiprof, a part number is taken from the stage_information structure of a profile.
+	* @param database path to the database file to create
+	* @param profiles paths to the profile files
+	* @param count number of the profile files
+	* @return result_value_error if a file is not a profile
+	* \endenglish
+	* \russian
+	* Создает файл базы из скомпилированных файлов профилей. Названия подвижки и производителя берутся из
+	* путей вида <производитель>/<подвижка>.xiprof, номер детали берется из структуры stage_information профиля.
+	* @param database путь к создаваемому файлу базы
+	* @param profiles пути к файлам профилей
+	* @param count количество файлов профилей
+	* @return result_value_error, если файл не является профилем
+	* \endrussian
+	*/
+	result_t XIMC_API create_profile_database(const char* database, const char* const* profiles, int count);
+
+	/**
+	* \english
+	* Opens a profile database. The file is copied into memory and checked once, lookups do not copy it, the file may be changed after opening.
+	* @param name path to the database file
+	* @param[out] database the opened database, close it with close_profile_database
+	* @return result_value_error if the file is not a profile database
+	* \endenglish
+	* \russian
+	* Открывает базу профилей. Файл копируется в память и проверяется один раз, поиск его не копирует, после открытия файл можно изменять.
+	* @param name путь к файлу базы
+	* @param[out] database открытая база, закрывается close_profile_database
+	* @return result_value_error, если файл не является базой профилей
+	* \endrussian
+	*/
+	result_t XIMC_API open_profile_database(const char* name, profile_database_t** database);
+
+	/**
+	* \english
+	* Closes a profile database. Profiles found in it must not be used after that.
+	* @param database a database opened by open_profile_database, may be NULL
+	* \endenglish
+	* \russian
+	* Закрывает базу профилей. Найденные в ней профили после этого использовать нельзя.
+	* @param database база, открытая open_profile_database, может быть NULL
+	* \endrussian
+	*/
+	result_t XIMC_API close_profile_database(profile_database_t* database);
+
+	/**
+	* \english
+	* Finds a profile by stage name or, if there is no such stage, by part number. Names are compared ignoring case.
+	* The profile is not copied, it refers to the memory of the database and may be used until close_profile_database.
+	* @param database an opened profile database
+	* @param vendor vendor name, NULL for any vendor
+	* @param stage stage name or part number
+	* @param[out] profile the found profile, free it with free_profile before or after closing the database
+	* @return result_error if there is no such profile
+	* \endenglish
+	* \russian
+	* Ищет профиль по названию подвижки или, если такой подвижки нет, по номеру детали. Регистр не учитывается.
+	* Профиль не копируется, он ссылается на память базы и может использоваться до close_profile_database.
+	* @param database открытая база профилей
+	* @param vendor название производителя, NULL для любого производителя
+	* @param stage название подвижки или номер детали
+	* @param[out] profile найденный профиль, освобождается free_profile до или после закрытия базы
+	* @return result_error, если такого профиля нет
+	* \endrussian
+	*/
+	result_t XIMC_API find_profile(const profile_database_t* database, const char* vendor, const char* stage,
+		profile_t** profile);
+
+	/**
+	* \english
+	* Writes the profile of the connected stage to a device. The profile is found by the stage name
+	* from get_stage_name or by the part number from get_stage_information, see apply_profile.
+	* @param id an identifier of device
+	* @param database an opened profile database
+	* @param[out] written number of written structures, may be NULL
+	* @return result_error if there is no profile for the stage
+	* \endenglish
+	* \russian
+	* Записывает в устройство профиль подключенной подвижки. Профиль ищется по названию подвижки
+	* из get_stage_name или по номеру детали из get_stage_information, см. apply_profile.
+	* @param id идентификатор устройства
+	* @param database открытая база профилей
+	* @param[out] written количество записанных структур, может быть NULL
+	* @return result_error, если профиля для подвижки нет
+	* \endrussian
+	*/
+	result_t XIMC_API apply_profile_by_stage_name(device_t id, const profile_database_t* database, unsigned int* written);
+
+	/**
+	* \english
+	* Turns caching of universal settings structures of a device on or off.
+	* While caching is on, a get function of a settings structure returns the cached value
+	* without a request to the controller. A structure is cached after it is read or successfully set,
+	* command_read_settings, command_read_robust_settings, command_eeread_settings, command_reset
+	* and command_clear_fram drop the whole cache. Settings changed by other means,
+	* for example by another program, are not noticed, use refresh_settings_cache then.
+	* Caching is off after a device is opened.
+	* @param id an identifier of device
+	* @param enable nonzero to turn caching on, zero to turn it off and drop the cache
+	* \endenglish
+	* \russian
+	* Включает или выключает кэширование универсальных структур настроек устройства.
+	* Пока кэширование включено, функция get структуры настроек возвращает значение из кэша
+	* без запроса к контроллеру. Структура кэшируется после чтения или успешной записи,
+	* command_read_settings, command_read_robust_settings, command_eeread_settings, command_reset
+	* и command_clear_fram сбрасывают весь кэш. Настройки, измененные иначе,
+	* например другой программой, не отслеживаются, в этом случае используйте refresh_settings_cache.
+	* После открытия устройства кэширование выключено.
+	* @param id идентификатор устройства
+	* @param enable ненулевое значение включает кэширование, ноль выключает его и сбрасывает кэш
+	* \endrussian
+	*/
+	result_t XIMC_API enable_settings_cache(device_t id, int enable);
+
+	/**
+	* \english
+	* Drops the settings cache of a device and reads all settings structures into it again.
+	* @param id an identifier of device
+	* @return result_error if caching is off
+	* \endenglish
+	* \russian
+	* Сбрасывает кэш настроек устройства и заново читает в него все структуры настроек.
+	* @param id идентификатор устройства
+	* @return result_error, если кэширование выключено
+	* \endrussian
+	*/
+	result_t XIMC_API refresh_settings_cache(device_t id);
+
+	/**
+	* \english
+	* Turns host-side checks of set function values on or off.
+	* Fields of settings structures with a valid range in the protocol are checked before a set function
+	* sends anything. An out of range value makes the function return result_value_error at once,
+	* and the controller settings stay unchanged. The controller corrects such a value itself
+	* and answers with a value error, so turn checks off only to let it do so.
+	* Checks are on after a device is opened.
+	* @param id an identifier of device
+	* @param enable nonzero to turn checks on, zero to turn them off
+	* \endenglish
+	* \russian
+	* Включает или выключает проверку значений функций set на стороне компьютера.
+	* Поля структур настроек, для которых в протоколе задан допустимый диапазон, проверяются
+	* до того, как функция set что-либо отправит. При значении вне диапазона функция сразу возвращает
+	* result_value_error, и настройки контроллера не меняются. Контроллер сам исправляет такое значение
+	* и отвечает ошибкой значения, поэтому выключайте проверку, только если это и нужно.
+	* После открытия устройства проверка включена.
+	* @param id идентификатор устройства
+	* @param enable ненулевое значение включает проверку, ноль выключает её
+	* \endrussian
+	*/
+	result_t XIMC_API enable_value_checks(device_t id, int enable);
 	//@}
 
 #if defined(__cplusplus)
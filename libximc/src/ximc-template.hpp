@@ -0,0 +1,140 @@
+#ifndef INC_XIMC_HPP
+#define INC_XIMC_HPP
+
+/** @file ximc.hpp
+	* \english
+	*		@brief Header-only C++17 interface of libximc
+	*		Every public command has a descriptor in ximc::commands with its code, packet sizes and flags
+	*		known at compile time. The read, write and execute templates call the libximc function of the
+	*		descriptor directly, so the call costs the same as the C call and a command used in a wrong way
+	*		does not compile.
+	*		@code
+	*		move_settings_t move;
+	*		if (ximc::read<ximc::commands::get_move_settings>( id, move ) == result_ok)
+	*			ximc::write<ximc::commands::set_move_settings>( id, move );
+	*		ximc::execute<ximc::commands::command_move>( id, 1000, 0 );
+	*		@endcode
+	* \endenglish
+	* \russian
+	*		@brief Заголовочный интерфейс libximc для C++17
+	*		У каждой публичной команды есть описатель в ximc::commands с её кодом, размерами пакетов и флагами,
+	*		известными во время компиляции. Шаблоны read, write и execute вызывают функцию libximc описателя
+	*		напрямую, поэтому вызов стоит столько же, сколько вызов из C, а неправильное использование команды
+	*		не компилируется.
+	* \endrussian
+	*/
+
+#if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#error ximc.hpp needs C++17
+#endif
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#if defined(__APPLE__) && !defined(NOFRAMEWORK)
+#include <libximc/ximc.h>
+#else
+#include "ximc.h"
+#endif
+
+namespace ximc
+{
+
+	/** Flags of a command descriptor, they are the features of the command in protocol.xi */
+	enum command_flags : unsigned int
+	{
+		flag_lock = 0x01,		/**< the device is locked for the call */
+		flag_crc = 0x02,		/**< packets carry CRC */
+		flag_answer = 0x04,		/**< the device answers a writer command with its echo */
+		flag_dualsync = 0x08,	/**< there is a variant of the command which does not lock the device */
+		flag_calb = 0x10		/**< there is a variant of the command in user units */
+	};
+
+	/** Direction of a command */
+	enum class command_kind
+	{
+		reader,		/**< reads a structure or values from the device */
+		writer,		/**< writes a structure or values to the device */
+		exchange	/**< writes a request and reads a result */
+	};
+
+	namespace detail
+	{
+		template <class Command, class = void>
+		struct has_value_type : std::false_type { };
+
+		template <class Command>
+		struct has_value_type<Command, std::void_t<typename Command::value_type> > : std::true_type { };
+
+		template <class Command, class = void>
+		struct has_multi_function : std::false_type { };
+
+		template <class Command>
+		struct has_multi_function<Command, std::void_t<decltype(Command::multi_function)> > : std::true_type { };
+	}
+
+	/**
+		* Reads the structure of a reader command, for example
+		* ximc::read<ximc::commands::get_position>( id, position ).
+		*/
+	template <class Command>
+	inline result_t read (device_t id, typename Command::value_type& value)
+	{
+		static_assert(Command::kind == command_kind::reader, "ximc::read needs a reader command");
+		static_assert(std::is_trivially_copyable<typename Command::value_type>::value, "structures are copied as is");
+		return Command::function( id, &value );
+	}
+
+	/**
+		* Writes the structure of a writer command, for example
+		* ximc::write<ximc::commands::set_move_settings>( id, move ).
+		*/
+	template <class Command>
+	inline result_t write (device_t id, const typename Command::value_type& value)
+	{
+		static_assert(Command::kind == command_kind::writer, "ximc::write needs a writer command");
+		static_assert(std::is_trivially_copyable<typename Command::value_type>::value, "structures are copied as is");
+		return Command::function( id, &value );
+	}
+
+	/**
+		* Runs a command without a structure, arguments are the ones of its libximc function, for example
+		* ximc::execute<ximc::commands::command_stop>( id ) or ximc::execute<ximc::commands::command_move>( id, 1000, 0 ).
+		*/
+	template <class Command, class... Args>
+	inline result_t execute (device_t id, Args&&... args)
+	{
+		static_assert(!detail::has_value_type<Command>::value, "ximc::execute is for commands without a structure, use read or write");
+		return Command::function( id, std::forward<Args>(args)... );
+	}
+
+	/**
+		* Reads the structure of a reader command from several devices at once, see get_status_multi.
+		* values[i] is read from ids[i], results may be NULL.
+		*/
+	template <class Command, class Value>
+	inline result_t read_multi (const device_t* ids, int count, Value* values, result_t* results)
+	{
+		static_assert(Command::kind == command_kind::reader, "ximc::read_multi needs a reader command");
+		static_assert(detail::has_multi_function<Command>::value,
+			"ximc::read_multi needs a command with a _multi function, readers of a whole structure have one");
+		if constexpr (detail::has_multi_function<Command>::value)
+			return Command::multi_function( ids, count, values, results );
+		else
+			return result_error;
+	}
+
+	/** Descriptors of the protocol commands, named after their libximc functions */
+	namespace commands
+	{
+
+/* @@GENERATED_CODE@@ */
+
+	}
+
+}
+
+#endif
+
+// vim: ts=4 shiftwidth=4
@@ -3,6 +3,9 @@
 #include "common.h"
 #include "metadata.h"
 #include "protosup.h"
+#include "platform.h"
+#include "loader.h"
+#include "ximc-gen.h"
 #include "util.h"
 
 START_TEST(test_pre)
@@ -140,6 +143,1020 @@ START_TEST(test_powi)
 }
 END_TEST
 
+START_TEST(test_correction_table)
+{
+	enum { N = 5000 };
+	static double X[N], dX[N];
+	correction_table_t* table;
+	double x, y, expected;
+	int i, j;
+
+	/* non-uniform grid */
+	for (i = 0; i < N; ++i)
+	{
+		X[i] = i + 0.3 * (i % 3);
+		dX[i] = 0.01 * ((i * 7) % 13);
+	}
+	X[0] = -1;
+
+	ck_assert_ptr_eq(correction_table_create(X, dX, 1, correction_interpolation_linear), NULL);
+	table = correction_table_create(X, dX, N, correction_interpolation_linear);
+	ck_assert_ptr_ne(table, NULL);
+
+	/* constant deviation beyond the ends */
+	ck_assert(correction_forward(table, -10) == -10 + dX[0]);
+	ck_assert(correction_forward(table, 1e6) == 1e6 + dX[N - 1]);
+
+	for (x = -2; x < N + 1; x += 0.37)
+	{
+		/* compare with linear search */
+		for (j = 0; j < N - 2 && X[j + 1] <= x; ++j);
+		if (x <= X[0])
+			expected = x + dX[0];
+		else if (x >= X[N - 1])
+			expected = x + dX[N - 1];
+		else
+			expected = x + dX[j] + (dX[j + 1] - dX[j]) * (x - X[j]) / (X[j + 1] - X[j]);
+		y = correction_forward(table, x);
+		ck_assert(y - expected < 1e-9 && expected - y < 1e-9);
+		expected = correction_inverse(table, y);
+		ck_assert(expected - x < 1e-9 && x - expected < 1e-9);
+	}
+	correction_table_release(table);
+
+	/* not monotonous */
+	X[10] = X[9];
+	ck_assert_ptr_eq(correction_table_create(X, dX, N, correction_interpolation_linear), NULL);
+}
+END_TEST
+
+START_TEST(test_correction_table_clustered)
+{
+	enum { N = 1001 };
+	static double X[N], dX[N];
+	correction_table_t* table;
+	double x, y, expected;
+	int i, j;
+
+	/* dense points and one far point, a bucket holds hundreds of segments */
+	for (i = 0; i < N - 1; ++i)
+	{
+		X[i] = i * 0.001;
+		dX[i] = 0.0001 * ((i * 7) % 5);
+	}
+	X[N - 1] = 1e6;
+	dX[N - 1] = 0;
+	table = correction_table_create(X, dX, N, correction_interpolation_linear);
+	ck_assert_ptr_ne(table, NULL);
+	ck_assert(table->forward.buckets < N * 8);
+
+	for (x = -0.01; x < 1.01; x += 0.000137)
+	{
+		for (j = 0; j < N - 2 && X[j + 1] <= x; ++j);
+		if (x <= X[0])
+			expected = x + dX[0];
+		else
+			expected = x + dX[j] + (dX[j + 1] - dX[j]) * (x - X[j]) / (X[j + 1] - X[j]);
+		y = correction_forward(table, x);
+		ck_assert(y - expected < 1e-9 && expected - y < 1e-9);
+		expected = correction_inverse(table, y);
+		ck_assert(expected - x < 1e-9 && x - expected < 1e-9);
+	}
+	for (x = 1; x < 1e6; x += 9999.7)
+	{
+		y = correction_forward(table, x);
+		ck_assert(correction_inverse(table, y) - x < 1e-6 && x - correction_inverse(table, y) < 1e-6);
+	}
+	correction_table_release(table);
+}
+END_TEST
+
+/* smooth lead screw error for the interpolation tests */
+static double screw_error(double x)
+{
+	double t = x / 50 - 1;
+	return 0.02 * t * (1 - t * t) * (2 - t);
+}
+
+START_TEST(test_correction_table_cubic)
+{
+	enum { N = 11, DENSE = 101 };
+	double X[DENSE], dX[DENSE];
+	correction_table_t *cubic, *linear, *dense;
+	double x, y, cubic_error = 0, linear_error = 0, dense_error = 0, prev = -1e9;
+	int i;
+
+	for (i = 0; i < N; ++i)
+	{
+		X[i] = 10.0 * i;
+		dX[i] = screw_error(X[i]);
+	}
+	cubic = correction_table_create(X, dX, N, correction_interpolation_cubic);
+	linear = correction_table_create(X, dX, N, correction_interpolation_linear);
+	for (i = 0; i < DENSE; ++i)
+	{
+		X[i] = 1.0 * i;
+		dX[i] = screw_error(X[i]);
+	}
+	dense = correction_table_create(X, dX, DENSE, correction_interpolation_linear);
+	ck_assert_ptr_ne(cubic, NULL);
+	ck_assert_ptr_ne(linear, NULL);
+	ck_assert_ptr_ne(dense, NULL);
+
+#define MAX_ERROR(error, table) \
+	if ((y = correction_forward(table, x) - x - screw_error(x)) > error || -y > error) \
+		error = y > 0 ? y : -y
+	for (x = -5; x <= 105; x += 0.0137)
+	{
+		/* deviation is constant beyond the ends */
+		if (x >= 0 && x <= 100)
+		{
+			MAX_ERROR(cubic_error, cubic);
+			MAX_ERROR(linear_error, linear);
+			MAX_ERROR(dense_error, dense);
+		}
+
+		y = correction_forward(cubic, x);
+		ck_assert(y > prev);
+		prev = y;
+		y = correction_inverse(cubic, y) - x;
+		ck_assert(y < 1e-9 && -y < 1e-9);
+	}
+#undef MAX_ERROR
+	/* 10 times fewer points are as accurate as a dense linear table */
+	ck_assert(cubic_error < linear_error / 10);
+	ck_assert(cubic_error < dense_error * 2);
+
+	correction_table_release(dense);
+	correction_table_release(linear);
+	correction_table_release(cubic);
+}
+END_TEST
+
+START_TEST(test_correction_table_file)
+{
+	static const char* text_name = "ximc-ut-correction.txt";
+	static const char* binary_name = "ximc-ut-correction.bin";
+	static const char* values[] = { "-1.5", "0", "2e-3", "0.1", "1E1", "-0.25",
+		"12.345678901234567890123", "1e-30", "100.", "3.14159265358979", "1000", "-7" };
+	correction_table_t *table, *shared, *binary;
+	FILE* fp;
+	double x, y;
+	int i;
+
+	fp = fopen(text_name, "w");
+	ck_assert_ptr_ne(fp, NULL);
+	fprintf(fp, "X\tdX\r\n");
+	for (i = 0; i < 12; i += 2)
+		fprintf(fp, "%s\t%s\r\n", values[i], values[i + 1]);
+	fclose(fp);
+
+	table = correction_table_load(text_name);
+	ck_assert_ptr_ne(table, NULL);
+	ck_assert_int_eq(table->length, 6);
+	for (i = 0; i < 12; i += 2)
+	{
+		ck_assert(table->X[i / 2] == strtod(values[i], NULL));
+		ck_assert(table->dX[i / 2] == strtod(values[i + 1], NULL));
+	}
+	/* equal files share the table */
+	shared = correction_table_load(text_name);
+	ck_assert_ptr_eq(shared, table);
+	correction_table_release(shared);
+
+	ck_assert_int_eq(convert_correction_table(text_name, binary_name), result_ok);
+	binary = correction_table_load(binary_name);
+	ck_assert_ptr_ne(binary, NULL);
+	ck_assert_ptr_ne(binary, table);
+	ck_assert_int_eq(binary->length, table->length);
+	/* a loaded table does not depend on its file */
+	ck_assert_int_eq(convert_correction_table(text_name, binary_name), result_ok);
+	for (x = -3; x < 1100; x += 0.77)
+	{
+		ck_assert(correction_forward(binary, x) == correction_forward(table, x));
+		ck_assert(correction_inverse(binary, x) == correction_inverse(table, x));
+	}
+	correction_table_release(binary);
+	correction_table_release(table);
+
+	/* interpolation is selected by the word after the column names */
+	fp = fopen(text_name, "w");
+	fprintf(fp, "X dX cubic\n0 0\n1 0.1\n2 0.15\n4 0.1\n");
+	fclose(fp);
+	table = correction_table_load(text_name);
+	ck_assert_ptr_ne(table, NULL);
+	ck_assert_int_eq(table->interpolation, correction_interpolation_cubic);
+	ck_assert_int_eq(convert_correction_table(text_name, binary_name), result_ok);
+	binary = correction_table_load(binary_name);
+	ck_assert_ptr_ne(binary, NULL);
+	ck_assert_int_eq(binary->interpolation, correction_interpolation_cubic);
+	for (x = -1; x < 5; x += 0.13)
+	{
+		y = correction_inverse(binary, correction_forward(binary, x)) - x;
+		ck_assert(y < 1e-9 && -y < 1e-9);
+	}
+	correction_table_release(binary);
+	correction_table_release(table);
+
+	fp = fopen(text_name, "w");
+	fprintf(fp, "X dX quintic\n0 0\n1 0.1\n");
+	fclose(fp);
+	ck_assert_ptr_eq(correction_table_load(text_name), NULL);
+
+	/* broken row */
+	fp = fopen(text_name, "w");
+	fprintf(fp, "X dX\n1 2\n3 4x\n");
+	fclose(fp);
+	ck_assert_ptr_eq(correction_table_load(text_name), NULL);
+
+	remove(text_name);
+	remove(binary_name);
+}
+END_TEST
+
+/* single value conversions the way _calb functions do them */
+static result_t calb_one_to_normal(float fvalue, int* value, int* mvalue, const calibration_t* calibration)
+{
+	XI_calibrate_to_normal(fvalue, *value, *mvalue, calibration);
+	return result_ok;
+}
+
+static result_t normal_one_to_calb(int value, int mvalue, float* fvalue, const calibration_t* calibration)
+{
+	XI_normal_to_calibrate(*fvalue, value, mvalue, calibration);
+	return result_ok;
+}
+
+static result_t calb_ctx_one_to_normal(float fvalue, int* value, int* mvalue, const calibration_context_t* context)
+{
+	XI_calibrate_to_normal_ctx(fvalue, *value, *mvalue, context);
+	return result_ok;
+}
+
+static result_t normal_one_to_calb_ctx(int value, int mvalue, float* fvalue, const calibration_context_t* context)
+{
+	XI_normal_to_calibrate_ctx(*fvalue, value, mvalue, context);
+	return result_ok;
+}
+
+/* the same with the correction table of a device */
+static result_t calb_one_to_normal_corr(device_t id, float fvalue, int* value, int* mvalue, const calibration_t* calibration)
+{
+	XI_calibrate_to_normal_corr(fvalue, *value, *mvalue, calibration, id);
+	return result_ok;
+}
+
+static result_t normal_one_to_calb_corr(device_t id, int value, int mvalue, float* fvalue, const calibration_t* calibration)
+{
+	XI_normal_to_calibrate_corr(*fvalue, value, mvalue, calibration, id);
+	return result_ok;
+}
+
+static result_t calb_ctx_one_to_normal_corr(float fvalue, int* value, int* mvalue, const calibration_context_t* context)
+{
+	XI_calibrate_to_normal_corr_ctx(fvalue, *value, *mvalue, context);
+	return result_ok;
+}
+
+static result_t normal_one_to_calb_ctx_corr(int value, int mvalue, float* fvalue, const calibration_context_t* context)
+{
+	XI_normal_to_calibrate_corr_ctx(*fvalue, value, mvalue, context);
+	return result_ok;
+}
+
+START_TEST(test_calb_array)
+{
+	enum { N = 1003 };
+	static int steps[N], usteps[N];
+	static float values[N];
+	calibration_t calibration;
+	int i, value, mvalue;
+	float fvalue;
+
+	calibration.A = 0.0025;
+	calibration.MicrostepMode = MICROSTEP_MODE_FRAC_256;
+	for (i = 0; i < N; ++i)
+	{
+		steps[i] = (i - N / 2) * 1237;
+		usteps[i] = (i * 37) % 256 - 128;
+	}
+
+	ck_assert_int_eq(normal_to_calb_array(device_undefined, steps, usteps, values, N, &calibration), result_ok);
+	for (i = 0; i < N; ++i)
+	{
+		normal_one_to_calb(steps[i], usteps[i], &fvalue, &calibration);
+		ck_assert(values[i] == fvalue);
+	}
+
+	for (i = 0; i < N; ++i)
+		values[i] = (i - N / 2) * 0.7311f;
+	ck_assert_int_eq(calb_to_normal_array(device_undefined, values, steps, usteps, N, &calibration), result_ok);
+	for (i = 0; i < N; ++i)
+	{
+		calb_one_to_normal(values[i], &value, &mvalue, &calibration);
+		ck_assert_int_eq(steps[i], value);
+		ck_assert_int_eq(usteps[i], mvalue);
+	}
+
+	calibration.MicrostepMode = 0;
+	ck_assert_int_eq(calb_to_normal_array(device_undefined, values, steps, NULL, N, &calibration), result_value_error);
+}
+END_TEST
+
+START_TEST(test_calb_context)
+{
+	calibration_t calibration;
+	calibration_context_t* context;
+	int i, value, mvalue, cvalue, cmvalue;
+	float fvalue, cfvalue;
+
+	calibration.A = 0.0123;
+	calibration.MicrostepMode = MICROSTEP_MODE_FRAC_16;
+	ck_assert_int_eq(create_calibration_context(device_undefined, &calibration, &context), result_ok);
+	for (i = -500; i < 500; ++i)
+	{
+		normal_one_to_calb(i * 913, i % 16, &fvalue, &calibration);
+		ck_assert_int_eq(normal_one_to_calb_ctx(i * 913, i % 16, &cfvalue, context), result_ok);
+		ck_assert(fvalue == cfvalue);
+
+		fvalue = i * 0.3137f;
+		calb_one_to_normal(fvalue, &value, &mvalue, &calibration);
+		ck_assert_int_eq(calb_ctx_one_to_normal(fvalue, &cvalue, &cmvalue, context), result_ok);
+		ck_assert_int_eq(value, cvalue);
+		ck_assert_int_eq(mvalue, cmvalue);
+	}
+	ck_assert_int_eq(free_calibration_context(context), result_ok);
+
+	calibration.MicrostepMode = MAX_ENUM_MICROSTEP_MODE + 1;
+	ck_assert_int_eq(create_calibration_context(device_undefined, &calibration, &context), result_value_error);
+	ck_assert_ptr_eq(context, NULL);
+	/* conversions check the context like the calibration */
+	ck_assert_int_eq(normal_one_to_calb_ctx(1, 0, &cfvalue, NULL), result_value_error);
+	ck_assert_int_eq(calb_ctx_one_to_normal(1.0f, &cvalue, &cmvalue, NULL), result_value_error);
+}
+END_TEST
+
+START_TEST(test_calb_context_table)
+{
+	static const char* table_name = "ximc-ut-context-correction.txt";
+	calibration_t calibration;
+	calibration_context_t* context;
+	get_position_calb_t position, cposition;
+	status_calb_t status, cstatus;
+	device_t id;
+	FILE* fp;
+	int i, value, mvalue, cvalue, cmvalue;
+	float fvalue, cfvalue;
+
+	fp = fopen(table_name, "w");
+	ck_assert_ptr_ne(fp, NULL);
+	fprintf(fp, "X dX\n-100 0.5\n0 0.2\n50 -0.25\n100 1\n");
+	fclose(fp);
+	id = open_device("xi-emu:///tmp/ximc-ut-context.bin");
+	ck_assert_int_ne(id, device_undefined);
+	ck_assert_int_eq(set_correction_table(id, table_name), result_ok);
+
+	calibration.A = 0.01;
+	calibration.MicrostepMode = MICROSTEP_MODE_FRAC_256;
+	ck_assert_int_eq(create_calibration_context(id, &calibration, &context), result_ok);
+	for (i = -200; i < 200; ++i)
+	{
+		ck_assert_int_eq(normal_one_to_calb_corr(id, i * 67, i & 127, &fvalue, &calibration), result_ok);
+		ck_assert_int_eq(normal_one_to_calb_ctx_corr(i * 67, i & 127, &cfvalue, context), result_ok);
+		ck_assert(fvalue == cfvalue);
+
+		fvalue = i * 0.731f;
+		ck_assert_int_eq(calb_one_to_normal_corr(id, fvalue, &value, &mvalue, &calibration), result_ok);
+		ck_assert_int_eq(calb_ctx_one_to_normal_corr(fvalue, &cvalue, &cmvalue, context), result_ok);
+		ck_assert_int_eq(value, cvalue);
+		ck_assert_int_eq(mvalue, cmvalue);
+	}
+	/* the table is applied, the device position is 0 */
+	ck_assert_int_eq(get_position_calb(id, &position, &calibration), result_ok);
+	ck_assert_int_eq(get_position_calb_ctx(id, &cposition, context), result_ok);
+	ck_assert(position.Position == cposition.Position);
+	ck_assert(cposition.Position != 0.0f);
+	ck_assert_int_eq(get_status_calb(id, &status, &calibration), result_ok);
+	ck_assert_int_eq(get_status_calb_ctx(id, &cstatus, context), result_ok);
+	ck_assert(status.CurPosition == cstatus.CurPosition);
+	ck_assert_int_eq(get_position_calb_ctx(id, &cposition, NULL), result_value_error);
+
+	/* the context keeps the table after the device is closed */
+	close_device(&id);
+	ck_assert_int_eq(calb_one_to_normal_corr(id, 1.0f, &value, &mvalue, &calibration), result_value_error);
+	ck_assert_int_eq(calb_ctx_one_to_normal_corr(1.0f, &cvalue, &cmvalue, context), result_ok);
+	ck_assert_int_eq(free_calibration_context(context), result_ok);
+	remove("/tmp/ximc-ut-context.bin");
+	remove(table_name);
+}
+END_TEST
+
+START_TEST(test_open_devices)
+{
+	static const char* uris[] = { "xi-emu:///tmp/ximc-ut-open-a.bin", "xi-emu:///tmp/ximc-ut-open-b.bin",
+		"xi-emu:///tmp/ximc-ut-open-c.bin", "xi-emu:///tmp/ximc-ut-open-d.bin", "xi-emu:///nonexistent/ximc-ut-open.bin" };
+	device_t ids[5];
+	result_t results[5];
+	status_t status;
+	int i, j;
+
+	ck_assert_int_eq(open_devices(uris, 5, ids, results), result_error);
+	ck_assert_int_eq(ids[4], device_undefined);
+	ck_assert_int_eq(results[4], result_error);
+	for (i = 0; i < 4; ++i)
+	{
+		ck_assert_int_eq(results[i], result_ok);
+		ck_assert_int_ne(ids[i], device_undefined);
+		for (j = 0; j < i; ++j)
+			ck_assert_int_ne(ids[i], ids[j]);
+		ck_assert_int_eq(get_status(ids[i], &status), result_ok);
+	}
+	/* each handle addresses its own device */
+	ck_assert_int_eq(command_move(ids[2], 1000, 0), result_ok);
+	for (i = 0; i < 4; ++i)
+	{
+		ck_assert_int_eq(get_status(ids[i], &status), result_ok);
+		ck_assert_int_eq(status.MvCmdSts & MVCMD_NAME_BITS, i == 2 ? MVCMD_MOVE : 0);
+	}
+
+	for (i = 0; i < 4; ++i)
+		close_device(&ids[i]);
+	remove("/tmp/ximc-ut-open-a.bin");
+	remove("/tmp/ximc-ut-open-b.bin");
+	remove("/tmp/ximc-ut-open-c.bin");
+	remove("/tmp/ximc-ut-open-d.bin");
+}
+END_TEST
+
+START_TEST(test_move_group)
+{
+	static const char* uris[] = { "xi-emu:///tmp/ximc-ut-group-x.bin", "xi-emu:///tmp/ximc-ut-group-y.bin" };
+	device_t ids[2], twice[2];
+	move_target_t targets[2];
+	result_t results[2];
+	status_t status;
+	unsigned int skew;
+	int i;
+
+	ck_assert_int_eq(open_devices(uris, 2, ids, NULL), result_ok);
+	targets[0].Position = 1000;
+	targets[0].uPosition = 0;
+	targets[1].Position = -500;
+	targets[1].uPosition = 100;
+	ck_assert_int_eq(command_move_group(ids, targets, 2, results, &skew), result_ok);
+	for (i = 0; i < 2; ++i)
+	{
+		ck_assert_int_eq(results[i], result_ok);
+		ck_assert_int_eq(get_status(ids[i], &status), result_ok);
+		ck_assert_int_eq(status.MvCmdSts & MVCMD_NAME_BITS, MVCMD_MOVE);
+	}
+
+	/* a device can't be in a group twice */
+	twice[0] = twice[1] = ids[0];
+	ck_assert_int_eq(command_move_group(twice, targets, 2, NULL, NULL), result_value_error);
+
+	for (i = 0; i < 2; ++i)
+		close_device(&ids[i]);
+	remove("/tmp/ximc-ut-group-x.bin");
+	remove("/tmp/ximc-ut-group-y.bin");
+}
+END_TEST
+
+START_TEST(test_prepared_command)
+{
+	static const int positions[] = { 0, 1, -1, 255, 256, 65535, -65536, 1000000, -2147483647, 2147483647 };
+	prepared_command_t* prepared;
+	byte packet[PREPARED_PACKET_SIZE], *p;
+	status_t status;
+	device_t id;
+	int i, j;
+
+	ck_assert_int_eq(prepare_command(device_undefined, "movr", 10, 0, &prepared), result_ok);
+	/* patched packet must be the same as serialized from scratch */
+	for (i = 0; i < (int)(sizeof(positions)/sizeof(positions[0])); ++i)
+	{
+		for (j = -255; j <= 255; j += 17)
+		{
+			ck_assert_int_eq(patch_prepared(prepared, positions[i], j), result_ok);
+			p = packet;
+			push_str(&p, "movr");
+			push_int32(&p, positions[i]);
+			push_int16(&p, j);
+			push_garbage(&p, 6);
+			push_crc(&p, packet, p - packet);
+			ck_assert(memcmp(prepared->packet, packet, PREPARED_PACKET_SIZE) == 0);
+		}
+	}
+	ck_assert_int_eq(free_prepared(prepared), result_ok);
+
+	ck_assert_int_eq(prepare_command(device_undefined, "sstp", 0, 0, &prepared), result_value_error);
+	ck_assert_ptr_eq(prepared, NULL);
+
+	id = open_device("xi-emu:///tmp/ximc-ut-prepared.bin");
+	ck_assert_int_ne(id, device_undefined);
+	ck_assert_int_eq(prepare_command(id, "movr", 0, 0, &prepared), result_ok);
+	ck_assert_int_eq(patch_prepared(prepared, 100, 0), result_ok);
+	ck_assert_int_eq(fire_prepared(prepared), result_ok);
+	ck_assert_int_eq(get_status(id, &status), result_ok);
+	ck_assert_int_eq(status.MvCmdSts & MVCMD_NAME_BITS, MVCMD_MOVR);
+	free_prepared(prepared);
+	close_device(&id);
+	remove("/tmp/ximc-ut-prepared.bin");
+}
+END_TEST
+
+/* Holds a device and keeps reading its status, as a long call of another thread does */
+typedef struct busy_device_t
+{
+	device_t id;
+	unsigned int hold_ms;
+	volatile int held;
+	volatile int done;
+	status_t status;
+} busy_device_t;
+
+static XIMC_RETTYPE XIMC_CALLCONV busy_device_thread(void* arg)
+{
+	busy_device_t* busy = (busy_device_t*)arg;
+	uint64_t start, now;
+
+	lock(busy->id);
+	busy->held = 1;
+	get_wallclock_us(&start);
+	do
+	{
+		get_status_impl(busy->id, &busy->status);
+		msec_sleep(5);
+		get_wallclock_us(&now);
+	} while (now - start < (uint64_t)busy->hold_ms * 1000);
+	unlock(busy->id);
+	busy->done = 1;
+	return (XIMC_RETTYPE)0;
+}
+
+START_TEST(test_stop_all)
+{
+	busy_device_t busy;
+	uint64_t start, now;
+	static const char* uris[] = { "xi-emu:///tmp/ximc-ut-stop-x.bin", "xi-emu:///tmp/ximc-ut-stop-y.bin" };
+	device_t ids[2];
+	result_t results[2];
+	unsigned int latency[2];
+	status_t status;
+	int i;
+
+	ck_assert_int_eq(open_devices(uris, 2, ids, NULL), result_ok);
+	for (i = 0; i < 2; ++i)
+		ck_assert_int_eq(command_move(ids[i], 1000, 0), result_ok);
+	ck_assert_int_eq(command_stop_all(ids, 2, 100, results, latency), result_ok);
+	for (i = 0; i < 2; ++i)
+	{
+		ck_assert_int_eq(results[i], result_ok);
+		ck_assert_int_eq(get_status(ids[i], &status), result_ok);
+		ck_assert_int_eq(status.MvCmdSts & MVCMD_NAME_BITS, MVCMD_STOP);
+	}
+
+	/* a device held by a call of another thread is stopped out of turn before the deadline,
+	 * the holder collects the echo and goes on */
+	ck_assert_int_eq(command_move(ids[0], 1000, 0), result_ok);
+	memset(&busy, 0, sizeof(busy));
+	busy.id = ids[0];
+	busy.hold_ms = 500;
+	ck_assert_int_eq(single_thread_launcher(busy_device_thread, &busy), result_ok);
+	while (!busy.held)
+		msec_sleep(1);
+	get_wallclock_us(&start);
+	ck_assert_int_eq(command_stop_all(ids, 2, 200, results, latency), result_ok);
+	get_wallclock_us(&now);
+	ck_assert(now - start < 400000);
+	ck_assert(!busy.done);
+	ck_assert_int_eq(results[0], result_ok);
+	ck_assert(latency[0] > 0 && latency[0] < 200000);
+	ck_assert_int_eq(results[1], result_ok);
+	while (!busy.done)
+		msec_sleep(1);
+	ck_assert_int_eq(busy.status.MvCmdSts & MVCMD_NAME_BITS, MVCMD_STOP);
+
+	/* a device held without I/O gets the frame but can't acknowledge it in time,
+	 * the echo is collected by the next call */
+	ck_assert_int_eq(command_move(ids[0], 1000, 0), result_ok);
+	lock(ids[0]);
+	ck_assert_int_eq(command_stop_all(ids, 2, 50, results, latency), result_error);
+	unlock(ids[0]);
+	ck_assert_int_eq(results[0], result_error);
+	ck_assert_int_eq(latency[0], 0);
+	ck_assert_int_eq(results[1], result_ok);
+	ck_assert_int_eq(get_status(ids[0], &status), result_ok);
+	ck_assert_int_eq(status.MvCmdSts & MVCMD_NAME_BITS, MVCMD_STOP);
+	ck_assert_int_eq(get_status(ids[0], &status), result_ok);
+
+	ck_assert_int_eq(command_stop_all_open(100), result_ok);
+
+	for (i = 0; i < 2; ++i)
+		close_device(&ids[i]);
+	remove("/tmp/ximc-ut-stop-x.bin");
+	remove("/tmp/ximc-ut-stop-y.bin");
+}
+END_TEST
+
+START_TEST(test_multi_reader)
+{
+	static const char* uris[] = { "xi-emu:///tmp/ximc-ut-multi-x.bin", "xi-emu:///tmp/ximc-ut-multi-y.bin" };
+	device_t ids[2], twice[2];
+	result_t results[2];
+	move_settings_t move[2];
+	status_t status[2];
+	get_position_t position[2];
+	device_information_t information[2], expected;
+	int i;
+
+	ck_assert_int_eq(open_devices(uris, 2, ids, NULL), result_ok);
+	for (i = 0; i < 2; ++i)
+	{
+		ck_assert_int_eq(get_move_settings(ids[i], &move[i]), result_ok);
+		move[i].Speed = 100 + 50*i;
+		ck_assert_int_eq(set_move_settings(ids[i], &move[i]), result_ok);
+		ck_assert_int_eq(command_move(ids[i], 1000*(i+1), 0), result_ok);
+	}
+	memset(move, 0, sizeof(move));
+	ck_assert_int_eq(get_move_settings_multi(ids, 2, move, results), result_ok);
+	ck_assert_int_eq(get_status_multi(ids, 2, status, NULL), result_ok);
+	ck_assert_int_eq(get_position_multi(ids, 2, position, NULL), result_ok);
+	/* hand-written readers of public structures have a multi-device variant too */
+	ck_assert_int_eq(get_device_information_multi(ids, 2, information, results), result_ok);
+	for (i = 0; i < 2; ++i)
+	{
+		ck_assert_int_eq(results[i], result_ok);
+		ck_assert_int_eq(get_device_information(ids[i], &expected), result_ok);
+		ck_assert_str_eq(information[i].Manufacturer, expected.Manufacturer);
+		ck_assert_str_eq(information[i].ProductDescription, expected.ProductDescription);
+		ck_assert_uint_eq(information[i].Major, expected.Major);
+	}
+	ck_assert_int_eq(get_move_settings_multi(ids, 2, move, results), result_ok);
+	for (i = 0; i < 2; ++i)
+	{
+		ck_assert_int_eq(results[i], result_ok);
+		ck_assert_uint_eq(move[i].Speed, 100 + 50*i);
+		ck_assert_int_eq(status[i].MvCmdSts & MVCMD_NAME_BITS, MVCMD_MOVE);
+	}
+
+	/* a device can't be read twice at once */
+	twice[0] = twice[1] = ids[0];
+	ck_assert_int_eq(get_status_multi(twice, 2, status, NULL), result_value_error);
+	ck_assert_int_eq(get_status_multi(ids, 0, status, NULL), result_ok);
+
+	for (i = 0; i < 2; ++i)
+		close_device(&ids[i]);
+	remove("/tmp/ximc-ut-multi-x.bin");
+	remove("/tmp/ximc-ut-multi-y.bin");
+}
+END_TEST
+
+/* Payload of an entry of a settings snapshot */
+static uint8_t* snapshot_payload(uint8_t* snapshot, const char* code, unsigned int* length)
+{
+	uint8_t* p = snapshot + 12;
+	unsigned int i, count = snapshot[8] | snapshot[9] << 8;
+
+	for (i = 0; i < count; ++i, p += 6 + *length)
+	{
+		*length = p[4] | p[5] << 8;
+		if (memcmp(p, code, 3) == 0)
+			return p + 6;
+	}
+	return NULL;
+}
+
+START_TEST(test_settings_snapshot)
+{
+	uint8_t foreign[] = { 'X', 'I', 'S', 'S', 1, 0, 0, 0, 1, 0, 0, 0, 'z', 'z', 'z', 1, 4, 0, 1, 2, 3, 4 };
+	uint8_t *base, *changed, *payload;
+	unsigned int size, base_size, changed_size, count, written, length;
+	move_settings_t move, restored;
+	char names[64];
+	device_t id;
+
+	id = open_device("xi-emu:///tmp/ximc-ut-snapshot.bin");
+	ck_assert_int_ne(id, device_undefined);
+	ck_assert_int_eq(get_settings_snapshot(id, NULL, 0, &size), result_ok);
+	base = (uint8_t*)malloc(size);
+	changed = (uint8_t*)malloc(size);
+	ck_assert_int_eq(get_settings_snapshot(id, base, size - 1, &base_size), result_value_error);
+	ck_assert_int_eq(get_settings_snapshot(id, base, size, &base_size), result_ok);
+	ck_assert(base_size <= size);
+
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	restored = move;
+	move.Speed += 100;
+	ck_assert_int_eq(set_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(get_settings_snapshot(id, changed, size, &changed_size), result_ok);
+	ck_assert_int_eq(diff_settings_snapshots(base, base_size, changed, changed_size, names, sizeof(names), &count), result_ok);
+	ck_assert_int_eq(count, 1);
+	ck_assert_str_eq(names, "move_settings");
+	/* a name which does not fit is not cut */
+	ck_assert_int_eq(diff_settings_snapshots(base, base_size, changed, changed_size, names, 5, &count), result_ok);
+	ck_assert_str_eq(names, "");
+	ck_assert_int_eq(diff_settings_snapshots(base, base_size, base, base_size, NULL, 0, &count), result_ok);
+	ck_assert_int_eq(count, 0);
+
+	/* only the changed structure is written back */
+	ck_assert_int_eq(apply_settings_snapshot(id, base, base_size, changed, changed_size, &written), result_ok);
+	ck_assert_int_eq(written, 1);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(move.Speed, restored.Speed);
+	ck_assert_int_eq(apply_settings_snapshot(id, base, base_size, NULL, 0, &written), result_ok);
+	ck_assert_int_eq(written, 0);
+
+	/* reserved bytes and the CRC are not compared with the device */
+	payload = snapshot_payload(changed, "mov", &length);
+	ck_assert_ptr_ne(payload, NULL);
+	memcpy(payload, snapshot_payload(base, "mov", &length), length);
+	payload[length - 3] ^= 0xFF;
+	payload[length - 1] ^= 0xFF;
+	ck_assert_int_eq(apply_settings_snapshot(id, changed, changed_size, NULL, 0, &written), result_ok);
+	ck_assert_int_eq(written, 0);
+
+	/* a code unknown to the protocol is skipped, a known code must have the protocol length */
+	ck_assert_int_eq(apply_settings_snapshot(id, foreign, sizeof(foreign), NULL, 0, &written), result_ok);
+	ck_assert_int_eq(written, 0);
+	memcpy(foreign + 12, "mov", 3);
+	ck_assert_int_eq(apply_settings_snapshot(id, foreign, sizeof(foreign), NULL, 0, &written), result_value_error);
+
+	base[4] = 2;
+	ck_assert_int_eq(apply_settings_snapshot(id, base, base_size, NULL, 0, &written), result_value_error);
+	base[4] = 1;
+	ck_assert_int_eq(diff_settings_snapshots(base, base_size - 1, changed, changed_size, NULL, 0, NULL), result_value_error);
+
+	free(base);
+	free(changed);
+	close_device(&id);
+	remove("/tmp/ximc-ut-snapshot.bin");
+}
+END_TEST
+
+START_TEST(test_profile)
+{
+	static const char* uris[] = { "xi-emu:///tmp/ximc-ut-profile-a.bin", "xi-emu:///tmp/ximc-ut-profile-b.bin" };
+	device_t ids[2];
+	move_settings_t move;
+	engine_settings_t engine;
+	uint8_t* recorded;
+	unsigned int size, written;
+	profile_t* profile;
+	FILE* file;
+
+	ck_assert_int_eq(open_devices(uris, 2, ids, NULL), result_ok);
+	ck_assert_int_eq(stop_profile_recording(ids[0], NULL, 0, &size), result_error);
+	ck_assert_int_eq(start_profile_recording(ids[0]), result_ok);
+	ck_assert_int_eq(get_move_settings(ids[0], &move), result_ok);
+	move.Speed = 1234;
+	ck_assert_int_eq(set_move_settings(ids[0], &move), result_ok);
+	move.Speed = 2345;
+	ck_assert_int_eq(set_move_settings(ids[0], &move), result_ok);
+	ck_assert_int_eq(get_engine_settings(ids[0], &engine), result_ok);
+	engine.NomCurrent = 321;
+	ck_assert_int_eq(set_engine_settings(ids[0], &engine), result_ok);
+	ck_assert_int_eq(stop_profile_recording(ids[0], NULL, 0, &size), result_ok);
+	recorded = (uint8_t*)malloc(size);
+	ck_assert_int_eq(stop_profile_recording(ids[0], recorded, size, &size), result_ok);
+	ck_assert_int_eq(stop_profile_recording(ids[0], NULL, 0, &size), result_error);
+
+	file = fopen("/tmp/ximc-ut-profile.xiprof", "wb");
+	ck_assert_ptr_ne(file, NULL);
+	ck_assert_int_eq(fwrite(recorded, 1, size, file), size);
+	fclose(file);
+	free(recorded);
+
+	/* both structures differ on the other device, the last recorded write wins */
+	ck_assert_int_eq(load_profile("/tmp/ximc-ut-profile.xiprof", &profile), result_ok);
+	/* a loaded profile does not depend on the file */
+	file = fopen("/tmp/ximc-ut-profile.xiprof", "wb");
+	ck_assert_ptr_ne(file, NULL);
+	fclose(file);
+	ck_assert_int_eq(apply_profile(ids[1], profile, &written), result_ok);
+	ck_assert_int_eq(written, 2);
+	ck_assert_int_eq(get_move_settings(ids[1], &move), result_ok);
+	ck_assert_int_eq(move.Speed, 2345);
+	ck_assert_int_eq(get_engine_settings(ids[1], &engine), result_ok);
+	ck_assert_int_eq(engine.NomCurrent, 321);
+	ck_assert_int_eq(apply_profile(ids[1], profile, &written), result_ok);
+	ck_assert_int_eq(written, 0);
+	ck_assert_int_eq(free_profile(profile), result_ok);
+
+	ck_assert_int_eq(load_profile("/tmp/ximc-ut-snapshot-missing.xiprof", &profile), result_error);
+	ck_assert_ptr_eq(profile, NULL);
+
+	close_device(&ids[0]);
+	close_device(&ids[1]);
+	remove("/tmp/ximc-ut-profile.xiprof");
+	remove("/tmp/ximc-ut-profile-a.bin");
+	remove("/tmp/ximc-ut-profile-b.bin");
+}
+END_TEST
+
+/* Records a profile which sets the speed and optionally the part number */
+static void record_profile(device_t id, const char* name, unsigned int speed, const char* part)
+{
+	move_settings_t move;
+	stage_information_t information;
+	uint8_t* recorded;
+	unsigned int size;
+	FILE* file;
+
+	ck_assert_int_eq(start_profile_recording(id), result_ok);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	move.Speed = speed;
+	ck_assert_int_eq(set_move_settings(id, &move), result_ok);
+	if (part)
+	{
+		memset(&information, 0, sizeof(information));
+		strcpy(information.Manufacturer, "Vendor");
+		strcpy(information.PartNumber, part);
+		set_stage_information(id, &information);
+	}
+	ck_assert_int_eq(stop_profile_recording(id, NULL, 0, &size), result_ok);
+	recorded = (uint8_t*)malloc(size);
+	ck_assert_int_eq(stop_profile_recording(id, recorded, size, &size), result_ok);
+	file = fopen(name, "wb");
+	ck_assert_ptr_ne(file, NULL);
+	ck_assert_int_eq(fwrite(recorded, 1, size, file), size);
+	fclose(file);
+	free(recorded);
+}
+
+START_TEST(test_profile_database)
+{
+	static const char* profiles[] = { "/tmp/ximc-ut-stage-b.xiprof", "/tmp/ximc-ut-stage-a.xiprof" };
+	device_t ids[2];
+	static const char* uris[] = { "xi-emu:///tmp/ximc-ut-database-a.bin", "xi-emu:///tmp/ximc-ut-database-b.bin" };
+	profile_database_t* database;
+	profile_t* profile;
+	stage_name_t stage_name;
+	move_settings_t move;
+	unsigned int written;
+	FILE* file;
+
+	ck_assert_int_eq(open_devices(uris, 2, ids, NULL), result_ok);
+	record_profile(ids[0], profiles[0], 2222, NULL);
+	record_profile(ids[0], profiles[1], 1111, "8MT-UT");
+	ck_assert_int_eq(create_profile_database("/tmp/ximc-ut-profiles.xipd", profiles, 2), result_ok);
+	ck_assert_int_eq(open_profile_database("/tmp/ximc-ut-profiles.xipd", &database), result_ok);
+	/* an open database does not depend on the file */
+	file = fopen("/tmp/ximc-ut-profiles.xipd", "wb");
+	ck_assert_ptr_ne(file, NULL);
+	fclose(file);
+
+	/* stage names come from file names, vendor from the directory */
+	ck_assert_int_eq(find_profile(database, NULL, "XIMC-UT-STAGE-A", &profile), result_ok);
+	ck_assert_int_eq(free_profile(profile), result_ok);
+	ck_assert_int_eq(find_profile(database, "tmp", "ximc-ut-stage-b", &profile), result_ok);
+	ck_assert_int_eq(free_profile(profile), result_ok);
+	ck_assert_int_eq(find_profile(database, "other", "ximc-ut-stage-b", &profile), result_error);
+	ck_assert_ptr_eq(profile, NULL);
+	ck_assert_int_eq(find_profile(database, NULL, "8mt-ut", &profile), result_ok);
+	ck_assert_int_eq(free_profile(profile), result_ok);
+	ck_assert_int_eq(find_profile(database, NULL, "", &profile), result_error);
+
+	memset(&stage_name, 0, sizeof(stage_name));
+	strcpy(stage_name.PositionerName, "ximc-ut-stage-b");
+	ck_assert_int_eq(set_stage_name(ids[1], &stage_name), result_ok);
+	ck_assert_int_eq(apply_profile_by_stage_name(ids[1], database, &written), result_ok);
+	ck_assert_int_eq(get_move_settings(ids[1], &move), result_ok);
+	ck_assert_int_eq(move.Speed, 2222);
+
+	/* without a known stage name the part number of the stage is used */
+	strcpy(stage_name.PositionerName, "unknown");
+	ck_assert_int_eq(set_stage_name(ids[1], &stage_name), result_ok);
+	ck_assert_int_eq(apply_profile_by_stage_name(ids[1], database, &written), result_error);
+	ck_assert_int_eq(find_profile(database, NULL, "ximc-ut-stage-a", &profile), result_ok);
+	ck_assert_int_eq(apply_profile(ids[1], profile, &written), result_ok);
+	ck_assert_int_eq(free_profile(profile), result_ok);
+	ck_assert_int_eq(get_move_settings(ids[1], &move), result_ok);
+	ck_assert_int_eq(move.Speed, 1111);
+	move.Speed = 3333;
+	ck_assert_int_eq(set_move_settings(ids[1], &move), result_ok);
+	ck_assert_int_eq(apply_profile_by_stage_name(ids[1], database, &written), result_ok);
+	ck_assert_int_eq(written, 1);
+	ck_assert_int_eq(get_move_settings(ids[1], &move), result_ok);
+	ck_assert_int_eq(move.Speed, 1111);
+	ck_assert_int_eq(close_profile_database(database), result_ok);
+
+	ck_assert_int_eq(open_profile_database(profiles[0], &database), result_value_error);
+	ck_assert_ptr_eq(database, NULL);
+
+	close_device(&ids[0]);
+	close_device(&ids[1]);
+	remove(profiles[0]);
+	remove(profiles[1]);
+	remove("/tmp/ximc-ut-profiles.xipd");
+	remove("/tmp/ximc-ut-database-a.bin");
+	remove("/tmp/ximc-ut-database-b.bin");
+}
+END_TEST
+
+/* Counts packets written to virtual devices */
+static void XIMC_CALLCONV count_virtual_writes(int loglevel, const wchar_t* message, void* user_data)
+{
+	(void)loglevel;
+	if (wcsstr(message, L"Write virtual port"))
+		++*(int*)user_data;
+}
+
+START_TEST(test_settings_cache)
+{
+	device_t id;
+	move_settings_t move;
+	engine_settings_t engine;
+	int writes = 0;
+
+	id = open_device("xi-emu:///tmp/ximc-ut-cache.bin");
+	ck_assert_int_ne(id, device_undefined);
+	ck_assert_int_eq(refresh_settings_cache(id), result_error);
+	ck_assert_int_eq(enable_settings_cache(id, 1), result_ok);
+	set_logging_callback(count_virtual_writes, &writes);
+
+	/* the first read goes to the device, the next ones are answered from the cache */
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 1);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 1);
+
+	/* a successful write goes through and updates the cache */
+	move.Speed = 4321;
+	ck_assert_int_eq(set_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 2);
+	move.Speed = 0;
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(move.Speed, 4321);
+	ck_assert_int_eq(writes, 2);
+
+	/* reading settings from flash drops the cache */
+	ck_assert_int_eq(command_read_settings(id), result_ok);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 4);
+
+	writes = 0;
+	ck_assert_int_eq(refresh_settings_cache(id), result_ok);
+	ck_assert(writes > 1);
+	writes = 0;
+	ck_assert_int_eq(get_engine_settings(id, &engine), result_ok);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 0);
+
+	ck_assert_int_eq(enable_settings_cache(id, 0), result_ok);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 1);
+
+	set_logging_callback(NULL, NULL);
+	close_device(&id);
+	remove("/tmp/ximc-ut-cache.bin");
+}
+END_TEST
+
+START_TEST(test_value_checks)
+{
+	device_t id;
+	move_settings_t move;
+	engine_settings_t engine;
+	int writes = 0;
+
+	id = open_device("xi-emu:///tmp/ximc-ut-checks.bin");
+	ck_assert_int_ne(id, device_undefined);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(get_engine_settings(id, &engine), result_ok);
+	set_logging_callback(count_virtual_writes, &writes);
+
+	/* out of range values fail without a request to the device */
+	move.Speed = 100001;
+	ck_assert_int_eq(set_move_settings(id, &move), result_value_error);
+	/* the bound of the wire type is checked since the struct member is wider */
+	move.Speed = 100000;
+	move.Accel = 70000;
+	ck_assert_int_eq(set_move_settings(id, &move), result_value_error);
+	move.Accel = 65535;
+	engine.MicrostepMode = 0;
+	ck_assert_int_eq(set_engine_settings(id, &engine), result_value_error);
+	ck_assert_int_eq(writes, 0);
+
+	/* range bounds are valid */
+	move.Speed = 100000;
+	ck_assert_int_eq(set_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 1);
+
+	/* without checks the device gets the value as is */
+	ck_assert_int_eq(enable_value_checks(id, 0), result_ok);
+	move.Speed = 100001;
+	ck_assert_int_eq(set_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(writes, 2);
+	ck_assert_int_eq(get_move_settings(id, &move), result_ok);
+	ck_assert_int_eq(move.Speed, 100001);
+
+	set_logging_callback(NULL, NULL);
+	close_device(&id);
+	remove("/tmp/ximc-ut-checks.bin");
+}
+END_TEST
+
 int main(void)
 {
     SRunner *sr;
@@ -151,6 +1168,23 @@ int main(void)
     tcase_add_test(tc_core, test_uri);
     tcase_add_test(tc_core, test_powi);
     tcase_add_test(tc_core, test_uri_encode);
+    tcase_add_test(tc_core, test_correction_table);
+    tcase_add_test(tc_core, test_correction_table_clustered);
+    tcase_add_test(tc_core, test_correction_table_file);
+    tcase_add_test(tc_core, test_correction_table_cubic);
+    tcase_add_test(tc_core, test_calb_array);
+    tcase_add_test(tc_core, test_calb_context);
+    tcase_add_test(tc_core, test_calb_context_table);
+    tcase_add_test(tc_core, test_open_devices);
+    tcase_add_test(tc_core, test_move_group);
+    tcase_add_test(tc_core, test_prepared_command);
+    tcase_add_test(tc_core, test_stop_all);
+    tcase_add_test(tc_core, test_multi_reader);
+    tcase_add_test(tc_core, test_settings_snapshot);
+    tcase_add_test(tc_core, test_profile);
+    tcase_add_test(tc_core, test_profile_database);
+    tcase_add_test(tc_core, test_settings_cache);
+    tcase_add_test(tc_core, test_value_checks);
     suite_add_tcase(s, tc_core);
 
     sr = srunner_create(s);
@@ -0,0 +1,624 @@
+/*
+ * libximc._native, an optional compiled accelerator of libximc.highlevel.Axis.
+ *
+ * The hot Axis calls (status, position, moves, stops) are made here instead of through ctypes:
+ * arguments are parsed and the result objects are filled without the per-field validation of the
+ * Python structure setters, and the GIL is released while libximc talks to the device, so axes
+ * driven from several Python threads do their I/O in parallel. The recorders sample get_status or
+ * get_measurements into NumPy arrays in a loop that does not touch the interpreter at all.
+ *
+ * The module does not link against libximc. libximc.highlevel passes it the addresses of the
+ * functions of the library it has loaded through ctypes, so both paths use the same device table.
+ * Build it with native/setup.py, see README.md. Without it Axis works through ctypes as before.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "ximc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef result_t (XIMC_API *get_status_fn)(device_t id, status_t* status);
+typedef result_t (XIMC_API *get_status_calb_fn)(device_t id, status_calb_t* status, const calibration_t* calibration);
+typedef result_t (XIMC_API *get_position_fn)(device_t id, get_position_t* position);
+typedef result_t (XIMC_API *get_position_calb_fn)(device_t id, get_position_calb_t* position, const calibration_t* calibration);
+typedef result_t (XIMC_API *command_move_fn)(device_t id, int position, int uposition);
+typedef result_t (XIMC_API *command_move_calb_fn)(device_t id, float position, const calibration_t* calibration);
+typedef result_t (XIMC_API *command_fn)(device_t id);
+typedef result_t (XIMC_API *command_wait_for_stop_fn)(device_t id, uint32_t refresh_interval_ms);
+typedef result_t (XIMC_API *get_measurements_fn)(device_t id, measurements_t* measurements);
+
+static struct
+{
+	get_status_fn get_status;
+	get_status_calb_fn get_status_calb;
+	get_position_fn get_position;
+	get_position_calb_fn get_position_calb;
+	command_move_fn command_move;
+	command_move_calb_fn command_move_calb;
+	command_move_fn command_movr;
+	command_move_calb_fn command_movr_calb;
+	command_fn command_stop;
+	command_fn command_sstp;
+	command_wait_for_stop_fn command_wait_for_stop;
+	get_measurements_fn get_measurements;
+} native_lib;
+
+/* Names of native_lib members, in order, they are the keys of the dict passed to bind() */
+static const char* const native_function_names[] =
+{
+	"get_status", "get_status_calb", "get_position", "get_position_calb",
+	"command_move", "command_move_calb", "command_movr", "command_movr_calb",
+	"command_stop", "command_sstp", "command_wait_for_stop", "get_measurements",
+	NULL
+};
+
+/* _check_result of libximc.highlevel, it raises the exception of a result code */
+static PyObject* native_check_result;
+
+/* Structure classes of libximc.highlevel */
+static PyObject* native_status_t;
+static PyObject* native_status_calb_t;
+static PyObject* native_get_position_t;
+static PyObject* native_get_position_calb_t;
+
+/* Flag enumerations of status fields */
+static PyObject* native_MoveState;
+static PyObject* native_MvcmdStatus;
+static PyObject* native_PowerState;
+static PyObject* native_EncodeStatus;
+static PyObject* native_WindStatus;
+static PyObject* native_StateFlags;
+static PyObject* native_GPIOFlags;
+
+static PyObject* native_empty_tuple;
+
+/* Interned names of the attributes behind the properties of the structure classes */
+enum
+{
+	key_MoveSts, key_MvCmdSts, key_PWRSts, key_EncSts, key_WindSts,
+	key_CurPosition, key_uCurPosition, key_EncPosition, key_CurSpeed, key_uCurSpeed,
+	key_Ipwr, key_Upwr, key_Iusb, key_Uusb, key_CurT, key_Flags, key_GPIOFlags, key_CmdBufFreeSpace,
+	key_Position, key_uPosition,
+	key_count
+};
+
+static const char* const native_key_names[key_count] =
+{
+	"_MoveSts", "_MvCmdSts", "_PWRSts", "_EncSts", "_WindSts",
+	"_CurPosition", "_uCurPosition", "_EncPosition", "_CurSpeed", "_uCurSpeed",
+	"_Ipwr", "_Upwr", "_Iusb", "_Uusb", "_CurT", "_Flags", "_GPIOFlags", "_CmdBufFreeSpace",
+	"_Position", "_uPosition"
+};
+
+static PyObject* native_keys[key_count];
+
+static int native_check_bound(void)
+{
+	if (native_check_result)
+		return 0;
+	PyErr_SetString( PyExc_RuntimeError, "libximc._native is not bound to libximc, it is used through libximc.highlevel" );
+	return -1;
+}
+
+/* Raises the exception of a result code, returns -1 if it was raised */
+static int native_result(result_t result)
+{
+	PyObject* ret;
+
+	if (result == result_ok)
+		return 0;
+	ret = PyObject_CallFunction( native_check_result, "i", (int)result );
+	if (!ret)
+		return -1;
+	Py_DECREF( ret );
+	return 0;
+}
+
+/* An instance of a structure class, it is filled directly instead of through its __init__ */
+static PyObject* native_new(PyObject* cls)
+{
+	return ((PyTypeObject*)cls)->tp_new( (PyTypeObject*)cls, native_empty_tuple, NULL );
+}
+
+/* Sets an attribute and drops the reference to its value, a NULL value is an error already raised */
+static int native_set(PyObject* obj, int key, PyObject* value)
+{
+	int ret;
+
+	if (!value)
+		return -1;
+	ret = PyObject_SetAttr( obj, native_keys[key], value );
+	Py_DECREF( value );
+	return ret;
+}
+
+static int native_set_flags(PyObject* obj, int key, PyObject* enumeration, unsigned int value)
+{
+	PyObject* number = PyLong_FromUnsignedLong( value );
+	PyObject* flags;
+
+	if (!number)
+		return -1;
+	flags = PyObject_CallFunctionObjArgs( enumeration, number, NULL );
+	Py_DECREF( number );
+	return native_set( obj, key, flags );
+}
+
+#define SET_INT(obj, key, value) native_set( obj, key, PyLong_FromLongLong( (long long)(value) ) )
+#define SET_FLOAT(obj, key, value) native_set( obj, key, PyFloat_FromDouble( (double)(value) ) )
+
+/* Flags fields are the same in status_t and status_calb_t, attributes are set in the order of the fields */
+#define SET_STATUS_STATES(obj, status) ( \
+	native_set_flags( obj, key_MoveSts, native_MoveState, (status).MoveSts ) || \
+	native_set_flags( obj, key_MvCmdSts, native_MvcmdStatus, (status).MvCmdSts ) || \
+	native_set_flags( obj, key_PWRSts, native_PowerState, (status).PWRSts ) || \
+	native_set_flags( obj, key_EncSts, native_EncodeStatus, (status).EncSts ) || \
+	native_set_flags( obj, key_WindSts, native_WindStatus, (status).WindSts ) )
+#define SET_STATUS_FLAGS(obj, status) ( \
+	native_set_flags( obj, key_Flags, native_StateFlags, (status).Flags ) || \
+	native_set_flags( obj, key_GPIOFlags, native_GPIOFlags, (status).GPIOFlags ) )
+
+/*
+ * A calibration is the ctypes calibration_t of an Axis, its memory is read through the buffer protocol.
+ * ctypes structures of libximc.lowlevel are packed, so the fields are copied one by one.
+ */
+#define CALIBRATION_PACKED_SIZE (sizeof(double) + sizeof(unsigned int))
+
+static int native_get_calibration(PyObject* object, calibration_t* calibration)
+{
+	Py_buffer view;
+
+	if (PyObject_GetBuffer( object, &view, PyBUF_SIMPLE ) < 0)
+		return -1;
+	if (view.len != (Py_ssize_t)CALIBRATION_PACKED_SIZE)
+	{
+		PyBuffer_Release( &view );
+		PyErr_SetString( PyExc_TypeError, "calibration must be a libximc.lowlevel.calibration_t" );
+		return -1;
+	}
+	memcpy( &calibration->A, view.buf, sizeof(double) );
+	memcpy( &calibration->MicrostepMode, (const char*)view.buf + sizeof(double), sizeof(unsigned int) );
+	PyBuffer_Release( &view );
+	return 0;
+}
+
+static PyObject* native_get_status(PyObject* self, PyObject* args)
+{
+	status_t status;
+	result_t result;
+	PyObject* obj;
+	int id;
+
+	(void)self;
+	if (native_check_bound() || !PyArg_ParseTuple( args, "i:get_status", &id ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = native_lib.get_status( id, &status );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ) || !(obj = native_new( native_status_t )))
+		return NULL;
+	if (SET_STATUS_STATES( obj, status ) ||
+			SET_INT( obj, key_CurPosition, status.CurPosition ) ||
+			SET_INT( obj, key_uCurPosition, status.uCurPosition ) ||
+			SET_INT( obj, key_EncPosition, status.EncPosition ) ||
+			SET_INT( obj, key_CurSpeed, status.CurSpeed ) ||
+			SET_INT( obj, key_uCurSpeed, status.uCurSpeed ) ||
+			SET_INT( obj, key_Ipwr, status.Ipwr ) ||
+			SET_INT( obj, key_Upwr, status.Upwr ) ||
+			SET_INT( obj, key_Iusb, status.Iusb ) ||
+			SET_INT( obj, key_Uusb, status.Uusb ) ||
+			SET_INT( obj, key_CurT, status.CurT ) ||
+			SET_STATUS_FLAGS( obj, status ) ||
+			SET_INT( obj, key_CmdBufFreeSpace, status.CmdBufFreeSpace ))
+	{
+		Py_DECREF( obj );
+		return NULL;
+	}
+	return obj;
+}
+
+static PyObject* native_get_status_calb(PyObject* self, PyObject* args)
+{
+	status_calb_t status;
+	result_t result;
+	calibration_t calibration;
+	PyObject* calibration_object;
+	PyObject* obj;
+	int id;
+
+	(void)self;
+	if (native_check_bound() || !PyArg_ParseTuple( args, "iO:get_status_calb", &id, &calibration_object ) ||
+			native_get_calibration( calibration_object, &calibration ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = native_lib.get_status_calb( id, &status, &calibration );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ) || !(obj = native_new( native_status_calb_t )))
+		return NULL;
+	if (SET_STATUS_STATES( obj, status ) ||
+			SET_FLOAT( obj, key_CurPosition, status.CurPosition ) ||
+			SET_INT( obj, key_EncPosition, status.EncPosition ) ||
+			SET_FLOAT( obj, key_CurSpeed, status.CurSpeed ) ||
+			SET_INT( obj, key_Ipwr, status.Ipwr ) ||
+			SET_INT( obj, key_Upwr, status.Upwr ) ||
+			SET_INT( obj, key_Iusb, status.Iusb ) ||
+			SET_INT( obj, key_Uusb, status.Uusb ) ||
+			SET_INT( obj, key_CurT, status.CurT ) ||
+			SET_STATUS_FLAGS( obj, status ) ||
+			SET_INT( obj, key_CmdBufFreeSpace, status.CmdBufFreeSpace ))
+	{
+		Py_DECREF( obj );
+		return NULL;
+	}
+	return obj;
+}
+
+static PyObject* native_get_position(PyObject* self, PyObject* args)
+{
+	get_position_t position;
+	result_t result;
+	PyObject* obj;
+	int id;
+
+	(void)self;
+	if (native_check_bound() || !PyArg_ParseTuple( args, "i:get_position", &id ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = native_lib.get_position( id, &position );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ) || !(obj = native_new( native_get_position_t )))
+		return NULL;
+	if (SET_INT( obj, key_Position, position.Position ) ||
+			SET_INT( obj, key_uPosition, position.uPosition ) ||
+			SET_INT( obj, key_EncPosition, position.EncPosition ))
+	{
+		Py_DECREF( obj );
+		return NULL;
+	}
+	return obj;
+}
+
+static PyObject* native_get_position_calb(PyObject* self, PyObject* args)
+{
+	get_position_calb_t position;
+	result_t result;
+	calibration_t calibration;
+	PyObject* calibration_object;
+	PyObject* obj;
+	int id;
+
+	(void)self;
+	if (native_check_bound() || !PyArg_ParseTuple( args, "iO:get_position_calb", &id, &calibration_object ) ||
+			native_get_calibration( calibration_object, &calibration ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = native_lib.get_position_calb( id, &position, &calibration );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ) || !(obj = native_new( native_get_position_calb_t )))
+		return NULL;
+	if (SET_FLOAT( obj, key_Position, position.Position ) ||
+			SET_INT( obj, key_EncPosition, position.EncPosition ))
+	{
+		Py_DECREF( obj );
+		return NULL;
+	}
+	return obj;
+}
+
+static PyObject* native_move(command_move_fn function, PyObject* args, const char* format)
+{
+	result_t result;
+	int id, position, uposition;
+
+	if (native_check_bound() || !PyArg_ParseTuple( args, format, &id, &position, &uposition ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = function( id, position, uposition );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ))
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject* native_move_calb(command_move_calb_fn function, PyObject* args, const char* format)
+{
+	result_t result;
+	calibration_t calibration;
+	PyObject* calibration_object;
+	float position;
+	int id;
+
+	if (native_check_bound() || !PyArg_ParseTuple( args, format, &id, &position, &calibration_object ) ||
+			native_get_calibration( calibration_object, &calibration ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = function( id, position, &calibration );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ))
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject* native_command(command_fn function, PyObject* args, const char* format)
+{
+	result_t result;
+	int id;
+
+	if (native_check_bound() || !PyArg_ParseTuple( args, format, &id ))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	result = function( id );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ))
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject* native_command_move(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_move( native_lib.command_move, args, "iii:command_move" );
+}
+
+static PyObject* native_command_movr(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_move( native_lib.command_movr, args, "iii:command_movr" );
+}
+
+static PyObject* native_command_move_calb(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_move_calb( native_lib.command_move_calb, args, "ifO:command_move_calb" );
+}
+
+static PyObject* native_command_movr_calb(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_move_calb( native_lib.command_movr_calb, args, "ifO:command_movr_calb" );
+}
+
+static PyObject* native_command_stop(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_command( native_lib.command_stop, args, "i:command_stop" );
+}
+
+static PyObject* native_command_sstp(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_command( native_lib.command_sstp, args, "i:command_sstp" );
+}
+
+static PyObject* native_command_wait_for_stop(PyObject* self, PyObject* args)
+{
+	result_t result;
+	unsigned int refresh_interval_ms;
+	int id;
+
+	(void)self;
+	if (native_check_bound() || !PyArg_ParseTuple( args, "iI:command_wait_for_stop", &id, &refresh_interval_ms ))
+		return NULL;
+	/* the wait is the longest call of all, other threads run meanwhile */
+	Py_BEGIN_ALLOW_THREADS
+	result = native_lib.command_wait_for_stop( id, refresh_interval_ms );
+	Py_END_ALLOW_THREADS
+	if (native_result( result ))
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+/* Seconds of a monotonic clock */
+static double native_clock(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+static void native_sleep_until(double deadline)
+{
+	double delay = deadline - native_clock();
+
+	if (delay <= 0)
+		return;
+#ifdef _WIN32
+	Sleep( (DWORD)(delay * 1000) );
+#else
+	{
+		struct timespec ts;
+		ts.tv_sec = (time_t)delay;
+		ts.tv_nsec = (long)((delay - (double)ts.tv_sec) * 1e9);
+		nanosleep( &ts, NULL );
+	}
+#endif
+}
+
+/*
+ * Fills the records of a writable buffer, a NumPy structured array, one call of a reader per record.
+ * Calls start every interval_ms from the first one, or back to back when it is 0. The GIL is released
+ * for the whole loop. On an error the records read before it stay in the buffer.
+ */
+static PyObject* native_record(result_t (XIMC_API *reader)(device_t, void*), size_t record_size, PyObject* args, const char* format)
+{
+	Py_buffer view;
+	PyObject* records;
+	result_t result = result_ok;
+	double interval_ms, start;
+	size_t count, i;
+	int id;
+
+	if (native_check_bound() || !PyArg_ParseTuple( args, format, &id, &records, &interval_ms ) ||
+			PyObject_GetBuffer( records, &view, PyBUF_WRITABLE ) < 0)
+		return NULL;
+	if (view.len % (Py_ssize_t)record_size != 0)
+	{
+		PyBuffer_Release( &view );
+		PyErr_SetString( PyExc_ValueError, "records have a wrong size, use the dtype of libximc.highlevel" );
+		return NULL;
+	}
+	count = (size_t)view.len / record_size;
+	Py_BEGIN_ALLOW_THREADS
+	start = native_clock();
+	for (i = 0; i < count && result == result_ok; ++i)
+	{
+		if (interval_ms > 0)
+			native_sleep_until( start + (double)i * interval_ms * 1e-3 );
+		result = reader( id, (char*)view.buf + i * record_size );
+	}
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release( &view );
+	if (native_result( result ))
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject* native_record_status(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_record( (result_t (XIMC_API *)(device_t, void*))native_lib.get_status, sizeof(status_t),
+		args, "iOd:record_status" );
+}
+
+static PyObject* native_record_measurements(PyObject* self, PyObject* args)
+{
+	(void)self;
+	return native_record( (result_t (XIMC_API *)(device_t, void*))native_lib.get_measurements, sizeof(measurements_t),
+		args, "iOd:record_measurements" );
+}
+
+static PyObject* native_import(PyObject* module_name, const char* name)
+{
+	PyObject* module = PyImport_Import( module_name );
+	PyObject* attribute;
+
+	if (!module)
+		return NULL;
+	attribute = PyObject_GetAttrString( module, name );
+	Py_DECREF( module );
+	return attribute;
+}
+
+static PyObject* native_bind(PyObject* self, PyObject* args)
+{
+	PyObject* functions;
+	PyObject* check_result;
+	PyObject* address;
+	PyObject* structures;
+	PyObject* flags;
+	void** slot = (void**)&native_lib;
+	int i;
+
+	(void)self;
+	if (!PyArg_ParseTuple( args, "O!O:bind", &PyDict_Type, &functions, &check_result ))
+		return NULL;
+	for (i = 0; native_function_names[i]; ++i)
+	{
+		if (!(address = PyDict_GetItemString( functions, native_function_names[i] )))
+			return PyErr_Format( PyExc_KeyError, "no address of %s", native_function_names[i] );
+		if (!(slot[i] = PyLong_AsVoidPtr( address )) && PyErr_Occurred())
+			return NULL;
+	}
+
+	structures = PyUnicode_FromString( "libximc.highlevel._structure_types" );
+	flags = PyUnicode_FromString( "libximc.highlevel._flag_enumerations" );
+	if (!structures || !flags ||
+			!(native_status_t = native_import( structures, "status_t" )) ||
+			!(native_status_calb_t = native_import( structures, "status_calb_t" )) ||
+			!(native_get_position_t = native_import( structures, "get_position_t" )) ||
+			!(native_get_position_calb_t = native_import( structures, "get_position_calb_t" )) ||
+			!(native_MoveState = native_import( flags, "MoveState" )) ||
+			!(native_MvcmdStatus = native_import( flags, "MvcmdStatus" )) ||
+			!(native_PowerState = native_import( flags, "PowerState" )) ||
+			!(native_EncodeStatus = native_import( flags, "EncodeStatus" )) ||
+			!(native_WindStatus = native_import( flags, "WindStatus" )) ||
+			!(native_StateFlags = native_import( flags, "StateFlags" )) ||
+			!(native_GPIOFlags = native_import( flags, "GPIOFlags" )))
+	{
+		Py_XDECREF( structures );
+		Py_XDECREF( flags );
+		return NULL;
+	}
+	Py_DECREF( structures );
+	Py_DECREF( flags );
+
+	Py_INCREF( check_result );
+	Py_XSETREF( native_check_result, check_result );
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef native_methods[] =
+{
+	{ "bind", native_bind, METH_VARARGS,
+		"bind(functions, check_result)\n\nTakes the addresses of libximc functions by name and the result checker of libximc.highlevel." },
+	{ "get_status", native_get_status, METH_VARARGS, "get_status(id) -> status_t" },
+	{ "get_status_calb", native_get_status_calb, METH_VARARGS, "get_status_calb(id, calibration) -> status_calb_t" },
+	{ "get_position", native_get_position, METH_VARARGS, "get_position(id) -> get_position_t" },
+	{ "get_position_calb", native_get_position_calb, METH_VARARGS, "get_position_calb(id, calibration) -> get_position_calb_t" },
+	{ "command_move", native_command_move, METH_VARARGS, "command_move(id, position, uposition)" },
+	{ "command_move_calb", native_command_move_calb, METH_VARARGS, "command_move_calb(id, position, calibration)" },
+	{ "command_movr", native_command_movr, METH_VARARGS, "command_movr(id, delta_position, udelta_position)" },
+	{ "command_movr_calb", native_command_movr_calb, METH_VARARGS, "command_movr_calb(id, delta_position, calibration)" },
+	{ "command_stop", native_command_stop, METH_VARARGS, "command_stop(id)" },
+	{ "command_sstp", native_command_sstp, METH_VARARGS, "command_sstp(id)" },
+	{ "command_wait_for_stop", native_command_wait_for_stop, METH_VARARGS, "command_wait_for_stop(id, refresh_interval_ms)" },
+	{ "record_status", native_record_status, METH_VARARGS, "record_status(id, records, interval_ms)" },
+	{ "record_measurements", native_record_measurements, METH_VARARGS, "record_measurements(id, records, interval_ms)" },
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef native_module =
+{
+	PyModuleDef_HEAD_INIT,
+	"libximc._native",
+	"Compiled accelerator of libximc.highlevel.Axis, the GIL is released during device I/O",
+	-1,
+	native_methods,
+	NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit__native(void)
+{
+	PyObject* module;
+	PyObject* names;
+	int i;
+
+	if (!(native_empty_tuple = PyTuple_New( 0 )))
+		return NULL;
+	for (i = 0; i < key_count; ++i)
+		if (!(native_keys[i] = PyUnicode_InternFromString( native_key_names[i] )))
+			return NULL;
+	if (!(module = PyModule_Create( &native_module )))
+		return NULL;
+	/* the names of the functions bind() needs */
+	if (!(names = PyTuple_New( sizeof(native_function_names) / sizeof(native_function_names[0]) - 1 )))
+	{
+		Py_DECREF( module );
+		return NULL;
+	}
+	for (i = 0; native_function_names[i]; ++i)
+		PyTuple_SET_ITEM( names, i, PyUnicode_FromString( native_function_names[i] ) );
+	if (PyModule_AddObject( module, "FUNCTIONS", names ) < 0)
+	{
+		Py_DECREF( names );
+		Py_DECREF( module );
+		return NULL;
+	}
+	return module;
+}
+
+// vim: syntax=c tabstop=4 shiftwidth=4
@@ -0,0 +1,21 @@
+""" Build of libximc._native, the optional compiled accelerator of libximc.highlevel.Axis
+=======================================================================================================================
+
+The module is built in place next to the Python sources of the package:
+
+    python setup.py build_ext --inplace --include-dirs <directory with ximc.h>
+
+It does not link against libximc, the addresses of the functions are taken from the library loaded by
+libximc.lowlevel. When the module is not built, Axis works through ctypes only.
+"""
+import os
+from setuptools import setup, Extension
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+setup(
+    name="libximc-native",
+    packages=[],
+    package_dir={"libximc": os.path.join(here, "..", "src", "libximc")},
+    ext_modules=[Extension("libximc._native", [os.path.join(here, "_native.c")])],
+)
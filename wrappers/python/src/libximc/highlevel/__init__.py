@@ -2,7 +2,12 @@
 from libximc.highlevel._highlevel import (Axis,
                                           enumerate_devices,
                                           reset_locks,
-                                          ximc_version)
+                                          ximc_version,
+                                          status_dtype,
+                                          measurements_dtype)
+# Import asyncio interface
+from libximc.highlevel._async import (AsyncAxis,
+                                      enumerate_devices_async)
 # Import flag structures
 from libximc.highlevel._flag_enumerations import (EnumerateFlags,
                                                   MoveState,
@@ -81,10 +86,14 @@ from libximc.highlevel._structure_types import (feedback_settings_t,
 __all__ = [
     # Classes
     Axis,
+    AsyncAxis,
     # General functions
     enumerate_devices,
     reset_locks,
     ximc_version,
+    status_dtype,
+    measurements_dtype,
+    enumerate_devices_async,
     # Flag structures
     EnumerateFlags,
     MoveState,
@@ -0,0 +1,110 @@
+""" Python binding for libximc
+=======================================================================================================================
+
+file: _async.py
+
+Description: This file contains definition of AsyncAxis class and enumerate_devices_async function, the asyncio
+interface of the highlevel API.
+"""
+import asyncio
+import functools
+from concurrent.futures import ThreadPoolExecutor
+
+from libximc.highlevel._highlevel import Axis, enumerate_devices
+from libximc.highlevel import _flag_enumerations as flag_enumerations
+
+
+# =================== #
+# Supporting routines #
+# =================== #
+# libximc has no asynchronous calls, they are made by a pool of workers. Each call holds a worker while it waits for
+# the device, so the pool is larger than the default executor of a loop. With the compiled accelerator (see
+# libximc._native) the workers run without the GIL during I/O.
+_DEFAULT_WORKERS = 64
+_default_executor = None
+
+
+def _get_default_executor() -> ThreadPoolExecutor:
+    global _default_executor
+    if _default_executor is None:
+        _default_executor = ThreadPoolExecutor(max_workers=_DEFAULT_WORKERS, thread_name_prefix="libximc")
+    return _default_executor
+
+
+async def _run(executor, function, *args, **kwargs):
+    loop = asyncio.get_running_loop()
+    return await loop.run_in_executor(executor, functools.partial(function, *args, **kwargs))
+
+
+# =============== #
+# AsyncAxis class #
+# =============== #
+class AsyncAxis:
+    """asyncio counterpart of Axis
+
+    Every method of Axis is a coroutine here with the same arguments and result, for example
+    ``status = await axis.get_status()``. Calls run in a pool of worker threads, so one event loop drives many axes at
+    once. Calls to one axis are executed by the device in turn, as with Axis.
+
+    :param uri: a device uri, see Axis.
+    :type uri: str
+    :param executor: executor for the calls, a shared pool of libximc workers is used if it is None.
+    :type executor: concurrent.futures.Executor
+    """
+    def __init__(self, uri: str, executor=None) -> None:
+        self._axis = Axis(uri)
+        self._executor = executor if executor is not None else _get_default_executor()
+
+    @property
+    def axis(self) -> Axis:
+        """Blocking Axis the calls are made through."""
+        return self._axis
+
+    def __getattr__(self, name):
+        attribute = getattr(self._axis, name)
+        if name.startswith("_") or not callable(attribute):
+            return attribute
+
+        @functools.wraps(attribute)
+        async def call(*args, **kwargs):
+            return await _run(self._executor, attribute, *args, **kwargs)
+        return call
+
+    async def command_wait_for_stop(self, refresh_interval_ms: int) -> None:
+        """Wait for stop.
+
+        Unlike Axis.command_wait_for_stop, the state is polled by the event loop, so the wait does not hold a worker.
+
+        :param refresh_interval_ms: status refresh interval in milliseconds, see Axis.command_wait_for_stop.
+        :type refresh_interval_ms: int
+        """
+        if not isinstance(refresh_interval_ms, int):
+            raise TypeError("refresh_interval_ms must be of integer type. {} was got.".format(type(refresh_interval_ms)))
+        while True:
+            status = await _run(self._executor, self._axis.get_status)
+            if not status.MvCmdSts & flag_enumerations.MvcmdStatus.MVCMD_RUNNING:
+                return
+            await asyncio.sleep(refresh_interval_ms / 1000)
+
+    async def command_homezero(self) -> None:
+        """Make home command, wait until it is finished and make zero command.
+
+        The wait is the one of AsyncAxis.command_wait_for_stop, see Axis.command_homezero.
+        """
+        await _run(self._executor, self._axis.command_home)
+        await self.command_wait_for_stop(10)
+        await _run(self._executor, self._axis.command_zero)
+
+
+# ================= #
+# General functions #
+# ================= #
+async def enumerate_devices_async(enumerate_flags: flag_enumerations.EnumerateFlags, hints: str = "addr=",
+                                  executor=None) -> 'list[dict]':
+    """asyncio counterpart of enumerate_devices, the arguments and the result are the same.
+
+    :param executor: executor for the call, the shared pool of libximc workers is used if it is None.
+    :type executor: concurrent.futures.Executor
+    """
+    return await _run(executor if executor is not None else _get_default_executor(),
+                      enumerate_devices, enumerate_flags, hints)
@@ -5,8 +5,10 @@ file: highlevel.py
 
 Description: This file contains definition of Axis class and general functions such as enumerate_device.
 """
+import time
+
 # Necessary ctypes imports
-from ctypes import cast, byref, POINTER
+from ctypes import cast, byref, POINTER, c_void_p
 from ctypes import c_int, c_uint, c_uint32, c_float, c_double, c_char_p
 
 # ========================================= #
@@ -80,7 +82,7 @@ def _check_result(result: int) -> None:
         )
     if result == flag_enumerations.Result.ValueError:
         raise ValueError(
-            "The input was rejected by the device. Some parameters may have incorrect values."
+            "The input was rejected by libximc or by the device. Some parameters may have incorrect values."
             "Check documentation: https://libximc.xisupport.com/doc-en/ximc_8h.html"
         )
     if result == flag_enumerations.Result.NoDevice:
@@ -90,6 +92,16 @@ def _check_result(result: int) -> None:
         )
 
 
+# Optional compiled accelerator of the hot Axis calls, see wrappers/python/native. It calls the functions of the
+# library loaded above, so devices opened through ctypes are the same devices there.
+try:
+    from libximc import _native
+except ImportError:
+    _native = None
+else:
+    _native.bind({name: cast(getattr(lib, name), c_void_p).value for name in _native.FUNCTIONS}, _check_result)
+
+
 def _check_fullness(structure_object) -> None:
     for key_value_pair in structure_object.__dict__.items():
         if key_value_pair[1] is NOT_INITIALIZED:
@@ -99,6 +111,38 @@ def _check_fullness(structure_object) -> None:
             raise ValueError("{}.{} must be set!".format(structure_object.__class__.__name__, attribute_name))
 
 
+# NumPy is needed by the recorders only, so it is imported on their first use
+_record_dtypes = {}
+
+
+def _record_dtype(name: str):
+    if name not in _record_dtypes:
+        try:
+            import numpy
+        except ImportError:
+            raise ImportError("Axis.record_status() and Axis.record_measurements() need NumPy")
+        # Aligned like C structures of ximc.h, so libximc writes the records as they are
+        fields = {"status_t": [("MoveSts", "u4"), ("MvCmdSts", "u4"), ("PWRSts", "u4"), ("EncSts", "u4"),
+                               ("WindSts", "u4"), ("CurPosition", "i4"), ("uCurPosition", "i4"),
+                               ("EncPosition", "i8"), ("CurSpeed", "i4"), ("uCurSpeed", "i4"), ("Ipwr", "i4"),
+                               ("Upwr", "i4"), ("Iusb", "i4"), ("Uusb", "i4"), ("CurT", "i4"), ("Flags", "u4"),
+                               ("GPIOFlags", "u4"), ("CmdBufFreeSpace", "u4")],
+                  "measurements_t": [("Speed", "i4", (25,)), ("Error", "i4", (25,)), ("Length", "u4")]}
+        _record_dtypes[name] = numpy.dtype(fields[name], align=True)
+    return _record_dtypes[name]
+
+
+def _record_buffer(dtype, count: int, out):
+    import numpy
+    if out is None:
+        return numpy.empty(count, dtype)
+    if not isinstance(out, numpy.ndarray) or out.dtype != dtype or out.ndim != 1 or not out.flags.c_contiguous:
+        raise TypeError("out must be a one-dimensional contiguous numpy array of {}".format(dtype))
+    if count > len(out):
+        raise ValueError("out has {} records, {} are requested".format(len(out), count))
+    return out[:count]
+
+
 # ========== #
 # Axis class #
 # ========== #
@@ -1240,6 +1284,8 @@ class Axis:
             c_float(position)
         except Exception:
             raise TypeError("position must be of type float. {} was got.".format(type(position)))
+        if _native is not None:
+            return _native.command_move_calb(self._device_id, position, self._calib)
         _check_result(lib.command_move_calb(self._device_id, c_float(position), byref(self._calib)))
 
     def command_movr(self, delta_position: int, udelta_position: int) -> None:
@@ -1266,6 +1312,8 @@ class Axis:
             c_int(udelta_position)
         except Exception:
             raise TypeError("udelta_position must be of integer type. {} was got.".format(type(udelta_position)))
+        if _native is not None:
+            return _native.command_movr(self._device_id, delta_position, udelta_position)
         _check_result(lib.command_movr(self._device_id, delta_position, udelta_position))
 
     def command_movr_calb(self, delta_position: float) -> None:
@@ -1283,6 +1331,8 @@ class Axis:
             c_float(delta_position)
         except Exception:
             raise TypeError("delta_position must be of floating point type. {} was got.".format(type(delta_position)))
+        if _native is not None:
+            return _native.command_movr_calb(self._device_id, delta_position, self._calib)
         _check_result(lib.command_movr_calb(self._device_id, c_float(delta_position), byref(self._calib)))
 
     def command_home(self) -> None:
@@ -1327,6 +1377,8 @@ class Axis:
     def command_sstp(self) -> None:
         """Soft stop the engine. The motor is slowing down with the deceleration specified in move_settings."""
         self._check_device_opened()
+        if _native is not None:
+            return _native.command_sstp(self._device_id)
         _check_result(lib.command_sstp(self._device_id))
 
     def get_position_calb(self) -> get_position_calb_t:
@@ -1336,6 +1388,8 @@ class Axis:
         :rtype: get_position_calb_t
         """
         self._check_device_opened()
+        if _native is not None:
+            return _native.get_position_calb(self._device_id, self._calib)
         position = ll.get_position_calb_t()
         _check_result(lib.get_position_calb(self._device_id, byref(position), byref(self._calib)))
         return get_position_calb_t(position.Position, position.EncPosition)
@@ -1417,6 +1471,66 @@ class Axis:
         _check_result(lib.get_measurements(self._device_id, byref(measurements)))
         return measurements_t(list(measurements.Speed), list(measurements.Error), measurements.Length)
 
+    def _record(self, function_name: str, records, interval_ms: float) -> None:
+        self._check_device_opened()
+        try:
+            interval_ms = float(interval_ms)
+        except Exception:
+            raise TypeError("interval_ms must be of floating point type. {} was got.".format(type(interval_ms)))
+        if _native is not None:
+            return getattr(_native, "record_" + function_name[4:])(self._device_id, records, interval_ms)
+        function = getattr(lib, function_name)
+        address = records.ctypes.data
+        start = time.perf_counter()
+        for i in range(len(records)):
+            if interval_ms > 0:
+                delay = start + i * interval_ms / 1000 - time.perf_counter()
+                if delay > 0:
+                    time.sleep(delay)
+            _check_result(function(self._device_id, c_void_p(address + i * records.itemsize)))
+
+    def record_status(self, count: int, interval_ms: float = 0, out=None) -> 'numpy.ndarray':
+        """Record device state into a NumPy structured array.
+
+        get_status is called count times, every interval_ms milliseconds or back to back if it is 0. The records are
+        written to the array as they are read, no Python objects are made per record. With the compiled accelerator
+        the loop runs without the GIL. See status_dtype() for the fields.
+
+        :param count: number of records.
+        :type count: int
+        :param interval_ms: period of the calls in milliseconds, 0 to read as fast as possible.
+        :type interval_ms: float
+        :param out: preallocated array of status_dtype() with at least count records to reuse, a new array is made if
+            it is None. If a call fails, the records read before it stay in the array.
+        :type out: numpy.ndarray
+        :return: view of the first count records.
+        :rtype: numpy.ndarray
+        """
+        records = _record_buffer(_record_dtype("status_t"), count, out)
+        self._record("get_status", records, interval_ms)
+        return records
+
+    def record_measurements(self, count: int, interval_ms: float = 0, out=None) -> 'numpy.ndarray':
+        """Record speed and error buffers into a NumPy structured array.
+
+        get_measurements is called count times, every interval_ms milliseconds or back to back if it is 0. Each record
+        holds up to 25 points, Length of them are valid. See get_measurements for the recommended period and
+        measurements_dtype() for the fields.
+
+        :param count: number of records.
+        :type count: int
+        :param interval_ms: period of the calls in milliseconds, 0 to read as fast as possible.
+        :type interval_ms: float
+        :param out: preallocated array of measurements_dtype() with at least count records to reuse, a new array is
+            made if it is None.
+        :type out: numpy.ndarray
+        :return: view of the first count records.
+        :rtype: numpy.ndarray
+        """
+        records = _record_buffer(_record_dtype("measurements_t"), count, out)
+        self._record("get_measurements", records, interval_ms)
+        return records
+
     def get_chart_data(self) -> chart_data_t:
         """Return device electrical parameters, useful for charts.
 
@@ -1514,7 +1628,7 @@ class Axis:
         :param namefile: the file name must be either a full path or a relative path. If the file name is set to None,
             the correction table will be cleared. File format: two tab-separated columns. Column headers are strings.
             Data is real, the dot is a delimiter. The first column is a coordinate. The second one is the deviation
-            caused by a mechanical error. The maximum length of a table is 100 rows. Coordinate column must be sorted
+            caused by a mechanical error. The table length is not limited. Coordinate column must be sorted
             in ascending order.
         :type namefile: str
         """
@@ -1523,6 +1637,38 @@ class Axis:
             raise TypeError("namefile must be of type str. {} was got.".format(type(namefile)))
         _check_result(lib.set_correction_table(self._device_id, namefile.encode() if namefile is not None else None))
 
+    def enable_settings_cache(self, enable: bool) -> None:
+        """Turn caching of settings structures on or off.
+
+        While caching is on, get_*_settings methods return cached values without a request to the controller. A
+        structure is cached after it is read or successfully set. command_read_settings, command_read_robust_settings,
+        command_eeread_settings, command_reset and command_clear_fram drop the cache. Settings changed by another
+        program are not noticed, use refresh_settings_cache then.
+
+        :param enable: True to turn caching on, False to turn it off and drop the cache
+        :type enable: bool
+        """
+        self._check_device_opened()
+        _check_result(lib.enable_settings_cache(self._device_id, 1 if enable else 0))
+
+    def refresh_settings_cache(self) -> None:
+        """Drop the settings cache and read all settings structures into it again."""
+        self._check_device_opened()
+        _check_result(lib.refresh_settings_cache(self._device_id))
+
+    def enable_value_checks(self, enable: bool) -> None:
+        """Turn checks of set_*_settings values against protocol ranges on or off.
+
+        An out of range value makes a set method raise ValueError at once, and nothing is sent to the controller.
+        Without checks the controller corrects the value itself and answers with a value error. Checks are on after
+        the device is opened.
+
+        :param enable: True to turn checks on, False to turn them off
+        :type enable: bool
+        """
+        self._check_device_opened()
+        _check_result(lib.enable_value_checks(self._device_id, 1 if enable else 0))
+
     def get_status(self) -> status_t:
         """Return device state.
 
@@ -1533,6 +1679,8 @@ class Axis:
         :rtype: status_t
         """
         self._check_device_opened()
+        if _native is not None:
+            return _native.get_status(self._device_id)
         status = ll.status_t()
         _check_result(lib.get_status(self._device_id, byref(status)))
         return status_t(status.MoveSts,
@@ -1577,6 +1725,8 @@ class Axis:
         :rtype: status_calb_t
         """
         self._check_device_opened()
+        if _native is not None:
+            return _native.get_status_calb(self._device_id, self._calib)
         status = ll.status_calb_t()
         _check_result(lib.get_status_calb(self._device_id, byref(status), byref(self._calib)))
         return status_calb_t(status.MoveSts,
@@ -1611,6 +1761,8 @@ class Axis:
         except Exception:
             raise TypeError("refresh_interval_ms must be of integer type. {} was got."
                             .format(type(refresh_interval_ms)))
+        if _native is not None:
+            return _native.command_wait_for_stop(self._device_id, refresh_interval_ms)
         _check_result(lib.command_wait_for_stop(self._device_id, c_uint32(refresh_interval_ms)))
 
     def command_homezero(self) -> None:
@@ -1661,6 +1813,8 @@ class Axis:
         :rtype: get_position_t
         """
         self._check_device_opened()
+        if _native is not None:
+            return _native.get_position(self._device_id)
         position = ll.get_position_t()
         _check_result(lib.get_position(self._device_id, byref(position)))
         return get_position_t(position.Position, position.uPosition, position.EncPosition)
@@ -1688,6 +1842,8 @@ class Axis:
             c_int(uposition)
         except Exception:
             raise TypeError("uposition must be of integer type. {} was got.".format(type(uposition)))
+        if _native is not None:
+            return _native.command_move(self._device_id, position, uposition)
         _check_result(lib.command_move(self._device_id, position, uposition))
 
     def command_stop(self) -> None:
@@ -1698,6 +1854,8 @@ class Axis:
         When this command is called, the ALARM flag is reset.
         """
         self._check_device_opened()
+        if _native is not None:
+            return _native.command_stop(self._device_id)
         _check_result(lib.command_stop(self._device_id))
 
     def command_power_off(self) -> None:
@@ -1822,3 +1980,21 @@ def ximc_version() -> str:
     c_res_str = c_char_p(res_str.encode())
     lib.ximc_version(c_res_str)
     return c_res_str.value.decode()
+
+
+def status_dtype() -> 'numpy.dtype':
+    """Returns NumPy dtype of the records of Axis.record_status(), its fields are the ones of status_t.
+
+    :return: structured dtype with the layout of status_t in ximc.h
+    :rtype: numpy.dtype
+    """
+    return _record_dtype("status_t")
+
+
+def measurements_dtype() -> 'numpy.dtype':
+    """Returns NumPy dtype of the records of Axis.record_measurements(), its fields are the ones of measurements_t.
+
+    :return: structured dtype with the layout of measurements_t in ximc.h
+    :rtype: numpy.dtype
+    """
+    return _record_dtype("measurements_t")
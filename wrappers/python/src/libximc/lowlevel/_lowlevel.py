@@ -121,6 +121,7 @@ class device_network_information_t(LittleEndianStructure):
 # Clarify function types
 lib.enumerate_devices.restype = POINTER(device_enumeration_t)
 lib.get_device_name.restype = c_char_p
+lib.get_enumerate_server_address.restype = c_char_p
 
 
 
@@ -7,6 +7,7 @@
 #include <ostream>
 #include <iomanip>
 #include <iterator>
+#include <limits>
 #include <stdexcept>
 #include <vector>
 #include <map>
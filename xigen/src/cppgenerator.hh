@@ -0,0 +1,111 @@
+#ifndef CPPGENERATOR_HH
+#define CPPGENERATOR_HH
+
+#include "common.hh"
+#include "visitor.hh"
+#include "basegenerator.hh"
+#include "generatorhelper.hh"
+
+namespace xigen
+{
+
+	// compile-time command descriptors for ximc.hpp, see ximc-template.hpp
+	class CppGenerator : protected DefaultVisitor, public Noncopyable, public BaseGenerator
+	{
+		protected:
+			virtual bool visitCommand (Command& command, size_t cookie)
+			{
+				if (cookie >= 1)
+					return false;
+				visitCommandImpl( command );
+				return true;
+			}
+
+			void visitCommandImpl (Command& command)
+			{
+				// status and device information structs are public through hand-written functions
+				if (command.unsynced || !(command.is("public") || command.is("publicstruct")))
+					return;
+
+				const Communicator* request;
+				const Communicator* response;
+				std::string kind;
+				switch (command.communicable())
+				{
+					case Communicable::reader:
+						kind = "reader";
+						request = NULL;
+						response = command.communicatorReader;
+						break;
+					case Communicable::writer:
+						kind = "writer";
+						request = command.communicatorWriter;
+						response = NULL;
+						break;
+					case Communicable::both:
+						kind = "exchange";
+						request = command.communicatorWriter ? command.communicatorWriter : command.communicatorUniversal;
+						response = command.communicatorReader ? command.communicatorReader : command.communicatorUniversal;
+						break;
+					default:
+						throw ast_error("Wrong communicator", &command);
+				}
+
+				std::string function = helpers::getCommandName( command, false, true );
+				std::string flags;
+				// hand-written public functions lock the device themselves
+				if (command.is("lock") || !command.is("public"))
+					flags += " | flag_lock";
+				if (command.is("crc"))
+					flags += " | flag_crc";
+				if (command.is("answer"))
+					flags += " | flag_answer";
+				if (command.is("dualsync"))
+					flags += " | flag_dualsync";
+				if (command.calb)
+					flags += " | flag_calb";
+
+				stream() << "\tstruct " << function << "\n"
+					<< "\t{\n"
+					<< "\t\tstatic constexpr char code[] = \"" << (request ? request : response)->name << "\";\n"
+					<< "\t\tstatic constexpr command_kind kind = command_kind::" << kind << ";\n"
+					<< "\t\tstatic constexpr std::size_t request_size = " << (request ? request->size : 4) << ";\n"
+					<< "\t\tstatic constexpr std::size_t response_size = "
+						<< (response ? response->size : (command.is("answer") ? 4 : 0)) << ";\n"
+					<< "\t\tstatic constexpr unsigned int flags = " << (flags.empty() ? "0" : flags.substr( 3 )) << ";\n";
+				if (!command.is("inline") && command.withAnyFields())
+					stream() << "\t\ttypedef " << command.structName() << "_t value_type;\n";
+				stream() << "\t\tstatic constexpr auto function = &::" << function << ";\n";
+				if (helpers::withMultiReader( command ) || helpers::withHandWrittenMultiReader( command ))
+					stream() << "\t\tstatic constexpr auto multi_function = &::" << function << "_multi;\n";
+				stream() << "\t};\n\n";
+			}
+
+		private:
+
+			std::ostream* m_os;
+
+			std::ostream& stream()
+			{
+				return *m_os;
+			}
+
+			void doGenerate (Protocol* protocol, std::ostream* os)
+			{
+				m_os = os;
+				protocol->accept( *this );
+			}
+
+		public:
+
+			explicit CppGenerator ()
+				: m_os(NULL)
+			{
+			}
+	};
+
+}
+
+#endif
+
+/* vim: set ts=2 sw=2: */
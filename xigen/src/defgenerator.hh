@@ -31,7 +31,12 @@ namespace xigen
 				{
 					stream() << "\t" << command.functionName() << " @" << (++m_counter) << "\n";
 					if (command.calb)
+					{
 						stream() << "\t" << command.functionCalbName() << " @" << (++m_counter) << "\n";
+						m_ctxNames.push_back( command.functionCalbName() + "_ctx" );
+					}
+					if (helpers::withMultiReader( command ))
+						m_multiNames.push_back( command.functionName() + "_multi" );
 				}
 			}
 
@@ -39,6 +44,9 @@ namespace xigen
 
 			std::ostream* m_os;
 			int m_counter;
+			// calibration context variants go after all other functions
+			std::vector<std::string> m_ctxNames;
+			std::vector<std::string> m_multiNames;
 
 			std::ostream& stream()
 			{
@@ -48,7 +56,13 @@ namespace xigen
 			void doGenerate (Protocol* protocol, std::ostream* os)
 			{
 				m_os = os;
+				m_ctxNames.clear();
+				m_multiNames.clear();
 				protocol->accept( *this );
+				for (std::vector<std::string>::const_iterator it = m_ctxNames.begin(); it != m_ctxNames.end(); ++it)
+					stream() << "\t" << *it << " @" << (++m_counter) << "\n";
+				for (std::vector<std::string>::const_iterator it = m_multiNames.begin(); it != m_multiNames.end(); ++it)
+					stream() << "\t" << *it << " @" << (++m_counter) << "\n";
 			}
 
 		public:
@@ -10,6 +10,8 @@
 #include "javagenerator.hh"
 #include "jnigenerator.hh"
 #include "pythongenerator.hh"
+#include "cppgenerator.hh"
+#include "tracegenerator.hh"
 #include "fwheadergenerator.hh"
 #include "fwlibgenerator.hh"
 #include "wikigenerator.hh"
@@ -97,6 +99,12 @@ namespace xigen
 			case genPython:
 				return new PythonGenerator();
 
+			case genCpp:
+				return new CppGenerator();
+
+			case genTrace:
+				return new TraceGenerator();
+
 			case genWiki:
 				return new WikiGenerator();
 
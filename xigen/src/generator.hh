@@ -10,7 +10,7 @@ namespace xigen
 		genCode, genPascal, genCSharp, genJava, genJNI, genPython, genDef, genWiki,
 		genQsdefine, genQtscriptToscript, genQtscriptFromscript, genQtscriptToscriptCalb,
 		genQtscriptFromscriptCalb, genQtscriptGetsetfunc, genQtscriptGetsethead,
-		genQtscriptRegistermt, genQtscriptHighlights, genQtscriptComparison
+		genQtscriptRegistermt, genQtscriptHighlights, genQtscriptComparison, genCpp, genTrace
 	} GenType;
 
 	class Protocol;
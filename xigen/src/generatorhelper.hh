@@ -52,12 +52,34 @@ namespace xigen
 			return commandName;
 		}
 
+		// public readers of a whole structure also get a multi-device variant, see dispatch_get in libximc
+		inline bool withMultiReader (Command& command)
+		{
+			return command.communicable() == Communicable::reader && command.is("public") &&
+				!command.is("inline") && !command.unsynced && command.withAnyFields();
+		}
+
+		// readers of a public structure with a hand-written function also have a hand-written multi-device
+		// variant in libximc, for example get_status_multi
+		inline bool withHandWrittenMultiReader (Command& command)
+		{
+			return command.communicable() == Communicable::reader && !command.is("public") && command.is("publicstruct") &&
+				!command.is("inline") && !command.unsynced && command.withAnyFields();
+		}
+
+		inline std::string emitMultiReaderHead (Command& command)
+		{
+			return "result_t XIMC_API " + command.functionName() + "_multi (const device_t* ids, int count, " +
+				command.structName() + "_t* " + command.structParameterName() + ", result_t* results)";
+		}
+
 		inline std::string emitFunctionHead (Command& command, bool reader,
-				bool withExportMacro, bool isCalibrated, bool isStripImpl)
+				bool withExportMacro, bool isCalibrated, bool isStripImpl,
+				const std::string& nameSuffix = "")
 		{
 			std::string result = std::string("result_t ")  +
 				(withExportMacro ? "XIMC_API " : "") +
-				getCommandName(command, isCalibrated, isStripImpl) +
+				getCommandName(command, isCalibrated, isStripImpl) + nameSuffix +
 				" (device_t id";
 
 			if (!command.is("inline") && command.withAnyFields())
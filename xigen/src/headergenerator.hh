@@ -32,6 +32,8 @@ namespace xigen
 			virtual void startFuncs()
 			{
 				emitFunctionHead( *m_current );
+				if (m_mode == modeGenReader && helpers::withMultiReader( *m_current ))
+					emitMultiReaderHead( *m_current );
 			}
 
 			virtual void visitCommandPost (Command& command)
@@ -47,7 +49,10 @@ namespace xigen
 						break;
 					case modeGenReaderCalb:
 					case modeGenWriterCalb:
-						stream() << ", const calibration_t* calibration);\n" << std::endl;
+						if (m_ctx)
+							stream() << ", const calibration_context_t* context);\n" << std::endl;
+						else
+							stream() << ", const calibration_t* calibration);\n" << std::endl;
 						break;
 					case modeGenStruct:
 						stream() << "\t} " << command.structName() << "_t;\n";
@@ -196,6 +201,7 @@ namespace xigen
 			std::ostringstream m_osStructs;
 			std::ostringstream m_osMetalen;
 			std::ostringstream m_osFunctions;
+			std::ostringstream m_osMultiReaders;
 
 			std::ostream& stream()
 			{
@@ -218,6 +224,25 @@ namespace xigen
 					stream() << command.doxyComments[type].getComment() << "\n";
 			}
 
+			void emitMultiReaderHead (Command& command)
+			{
+				std::string name = command.functionName();
+				if (m_enableComments)
+					m_osMultiReaders << "\t/**\n"
+						<< "\t\t* \\english\n"
+						<< "\t\t* Runs " << name << " on several devices at once, " << command.structParameterName()
+							<< "[i] is read from ids[i].\n"
+						<< "\t\t* @see get_status_multi\n"
+						<< "\t\t* \\endenglish\n"
+						<< "\t\t* \\russian\n"
+						<< "\t\t* Выполняет " << name << " для нескольких устройств одновременно, " << command.structParameterName()
+							<< "[i] читается из ids[i].\n"
+						<< "\t\t* @see get_status_multi\n"
+						<< "\t\t* \\endrussian\n"
+						<< "\t\t*/\n";
+				m_osMultiReaders << "\t" << helpers::emitMultiReaderHead( command ) << ";\n\n";
+			}
+
 			void emitFunctionHead (Command& command)
 			{
 				if (m_mode == modeGenReader || m_mode == modeGenWriter)
@@ -231,16 +256,32 @@ namespace xigen
 						m_mode == modeGenReader ? Comment::doxyRead : Comment::doxyWrite );
 				}
 
-				if (m_mode == modeGenReaderCalb || m_mode == modeGenWriterCalb)
+				if ((m_mode == modeGenReaderCalb || m_mode == modeGenWriterCalb) && !m_ctx)
 				{
 					printOptionalDoxyComment( command,
 						m_mode == modeGenReaderCalb ? Comment::doxyReadCalb : Comment::doxyWriteCalb );
 				}
 
+				if (m_ctx && m_enableComments)
+				{
+					std::string calbName = helpers::getCommandName( command, true, false );
+					stream() << "\t/**\n"
+						<< "\t\t* \\english\n"
+						<< "\t\t* The same as " << calbName << ", but takes a calibration context instead of calibration_t.\n"
+						<< "\t\t* @see create_calibration_context\n"
+						<< "\t\t* \\endenglish\n"
+						<< "\t\t* \\russian\n"
+						<< "\t\t* То же, что " << calbName << ", но принимает контекст калибровки вместо calibration_t.\n"
+						<< "\t\t* @see create_calibration_context\n"
+						<< "\t\t* \\endrussian\n"
+						<< "\t\t*/\n";
+				}
+
 				stream() << "\t" << helpers::emitFunctionHead( command, m_mode == modeGenReader || m_mode == modeGenReaderCalb,
 						command.is("public"),
 						command.calb && (m_mode == modeGenReaderCalb || m_mode == modeGenWriterCalb),
-						false );
+						false,
+						m_ctx ? "_ctx" : "" );
 			}
 
 			virtual bool acceptMode(Mode mode)
@@ -248,6 +289,11 @@ namespace xigen
 				return true;
 			}
 
+			virtual bool acceptContextModes()
+			{
+				return true;
+			}
+
 			virtual void output (std::ostream* os)
 			{
 				if (shouldGeneratePublicHeader())
@@ -280,6 +326,12 @@ namespace xigen
 				echoBanner( "BEGIN OF GENERATED function declarations", os );
 				*os << m_osFunctions.str();
 
+				if (!m_osMultiReaders.str().empty())
+				{
+					echoBanner( "BEGIN OF GENERATED multi-device reader declarations", os );
+					*os << m_osMultiReaders.str();
+				}
+
 				echoBanner( "END OF GENERATED CODE", os );
 			}
 
@@ -14,10 +14,23 @@ namespace xigen
 		protected:
 			virtual bool visitCommand (Command& command, size_t cookie)
 			{
-				if (cookie >= (size_t)modeNULL)
+				// calibrated modes run once more to emit _ctx variants
+				if (cookie >= (size_t)modeNULL + modeNULL - modeGenWriterCalb)
 					return false;
-				m_mode = (Mode)cookie;
+				m_ctx = cookie >= (size_t)modeNULL;
+				m_mode = (Mode)(m_ctx ? cookie - modeNULL + modeGenWriterCalb : cookie);
 				clear();
+				if (!cookie)
+				{
+					CheckIsWireCommand check;
+					command.accept( check );
+					m_wire = check.isWire();
+				}
+				// reader half of a universal command describes the settings struct
+				if (!cookie && command.paired && command.master && !command.unsynced && command.communicatorReader)
+					m_settings.push_back( &command );
+				if (!cookie && helpers::withMultiReader( command ))
+					m_multiReaders.push_back( &command );
 				/*if (!cookie) ; // clear first time */
 				visitCommandImpl( command );
 				return true;
@@ -188,7 +201,7 @@ namespace xigen
 				if (shouldWriteHeader( &command ))
 				{
 					if (m_mode == modeGenReaderCalb || m_mode == modeGenWriterCalb)
-						stream() << ", const calibration_t* calibration";
+						stream() << (m_ctx ? ", const calibration_context_t* context" : ", const calibration_t* calibration");
 
 					stream()
 						<< ")\n"
@@ -219,6 +232,11 @@ namespace xigen
 								<< (writeCommand ? "" : ", *p  = response" ) << ";\n";
 						if (writeCommand && writeResponse)
 							stream() << "\tbyte* p = command;\n";
+						// packed images are filled in writer and reader bodies, see emitWireField
+						if (m_wire && writeCommand && command.withFields())
+							stream() << "\t" << wireStructName( command, true ) << " request_wire;\n";
+						if (m_wire && writeResponse && command.communicable() != Communicable::writer)
+							stream() << "\t" << wireStructName( command, false ) << " answer_wire;\n";
 					}
 					else if (command.is("inline"))
 					{
@@ -239,6 +257,15 @@ namespace xigen
 					if (m_withIndexVariable)
 						stream() << "\tunsigned int i;\n";
 
+					// out of range values fail before any I/O instead of an errv answer
+					if (m_mode == modeGenWriter && !m_valueChecks.empty())
+					{
+						emitValueCheck( command );
+						stream() << "\n\tif (value_checks_enabled( id ) && (result = check_" << command.functionName()
+							<< "( " << command.structParameterName() << " )) != result_ok)\n"
+							<< "\t\treturn result;\n";
+					}
+
 					if (!optLock.empty())
 						stream() << "\n" << optLock;
 				}
@@ -283,6 +310,11 @@ namespace xigen
 
 					case modeGenWriterBody:
 						{
+							if (!m_wireFields.empty())
+								stream()
+									<< "\tmemcpy( p, &request_wire, sizeof(request_wire) );\n"
+									<< "\tp += sizeof(request_wire);\n";
+							emitWireStruct( command, true );
 							if (command.withFields())
 								stream()
 									<< "\tpush_crc( &p, command, p-command );\n";
@@ -320,6 +352,7 @@ namespace xigen
 
 					case modeGenReaderBody:
 					{
+						emitWireStruct( command, false );
 						if (command.withAnswer())
 						{
 							// commands without answer do not need output buffer check at all
@@ -456,7 +489,12 @@ namespace xigen
 						if (m_location == locationAnswer &&
 								(!m_current->calb || helpers::reducedCalibrationType( field ) != CalibrationEnum::calb))
                         {
-							if (!(m_withSresultResult || m_withSresultAnswer))
+							if (m_wire)
+							{
+								emitWireField( mapToWireType( field.type() ) + " " + field.name(), field.getSize() );
+								stream() << "\t" << emitFieldPointer( field, false ) << " = answer_wire." << field.name() << ";\n";
+							}
+							else if (!(m_withSresultResult || m_withSresultAnswer))
 							stream() << "\t" << emitFieldPointer( field, helpers::fieldPurpose( field ) == DataField::Purpose::result )
 								<< " = pop_" << mapToProtoSerializer( field.type() ) << "( &p );\n";
 							else
@@ -469,9 +507,18 @@ namespace xigen
 					case modeGenWriterBody:
 						if (m_location == locationRequest &&
 								(!m_current->calb || helpers::reducedCalibrationType( field ) != CalibrationEnum::calb))
-							stream()
-								<< "\tpush_" << mapToProtoSerializer( field.type() ) << "( &p, "
-								<< emitFieldPointer( field, m_current->is("inline") ) << " );\n";
+						{
+							if (m_wire)
+							{
+								emitWireField( mapToWireType( field.type() ) + " " + field.name(), field.getSize() );
+								stream() << "\trequest_wire." << field.name() << " = "
+									<< emitFieldPointer( field, m_current->is("inline") ) << ";\n";
+							}
+							else
+								stream()
+									<< "\tpush_" << mapToProtoSerializer( field.type() ) << "( &p, "
+									<< emitFieldPointer( field, m_current->is("inline") ) << " );\n";
+						}
 						break;
 
 					case modeGenReaderCalbBody:
@@ -482,13 +529,7 @@ namespace xigen
 								if (helpers::reducedCalibrationType(field) == CalibrationEnum::calb)
 								{
 									const FieldNest* nest = m_current->findNestByField( &field );
-									stream() << "\tXI_normal_to_calibrate" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-											 << (nest->fieldMicro ? "" : "_short") << "("
-											 << helpers::prefixedCalbName( *(nest->fieldCalb) ) << ", "
-											 << nest->fieldNormal->name() << ", ";
-									if (nest->fieldMicro)
-											stream() << nest->fieldMicro->name() << ", ";
-									stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id" : "") << " );\n";
+									stream() << "\t" << emitCalbMacro( nest, false, helpers::prefixedCalbName( *(nest->fieldCalb) ), "", "" );
 								}
 							}
 							else
@@ -498,13 +539,7 @@ namespace xigen
 									case CalibrationEnum::calb:
 									{
 										const FieldNest* nest = m_current->findNestByField( &field );
-										stream() << "\tXI_normal_to_calibrate" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-												 << (nest->fieldMicro ? "" : "_short") << "("
-												 << m_current->structParameterCalbName() << "->" << nest->fieldCalb->name() << ", "
-												 << "inner." << nest->fieldNormal->name() << ", ";
-										if (nest->fieldMicro)
-												 stream() << "inner." << nest->fieldMicro->name() << ", ";
-										stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id" : "") << " );\n";
+										stream() << "\t" << emitCalbMacro( nest, false, m_current->structParameterCalbName() + "->" + nest->fieldCalb->name(), "inner.", "" );
 										break;
 									}
 									case CalibrationEnum::none:
@@ -525,16 +560,7 @@ namespace xigen
 								if (helpers::reducedCalibrationType(field) == CalibrationEnum::calb)
 								{
 										const FieldNest* nest = m_current->findNestByField( &field );
-										stream() << "\tXI_calibrate_to_normal" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-												 << ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? "_Dcorr" : "")
-												 << (nest->fieldMicro ? "" : "_short") << "("
-											 	 << helpers::prefixedCalbName( *(nest->fieldCalb) ) << ", "
-												 << nest->fieldNormal->name() << ", ";
-										if (nest->fieldMicro)
-												 stream() << nest->fieldMicro->name() << ", ";
-										stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id " : "") 
-												 << ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? " , id " : "")
-												 << " );\n";
+										stream() << "\t" << emitCalbMacro( nest, true, helpers::prefixedCalbName( *(nest->fieldCalb) ), "", "" );
 								}
 							}
 							else
@@ -544,16 +570,7 @@ namespace xigen
 									case CalibrationEnum::calb:
 									{
 										const FieldNest* nest = m_current->findNestByField( &field );
-										stream() << "\tXI_calibrate_to_normal" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-											<< ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? "_Dcorr" : "")
-											<< (nest->fieldMicro ? "" : "_short") << "("
-											 << m_current->structParameterCalbName() << "->" << nest->fieldCalb->name() << ", "
-											 << "inner." << nest->fieldNormal->name() << ", ";
-										if (nest->fieldMicro)
-											stream() << "inner." << nest->fieldMicro->name() << ", ";
-										stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id" : "") 
-											<< ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? " , id " : "")
-											<< " );\n";
+										stream() << "\t" << emitCalbMacro( nest, true, m_current->structParameterCalbName() + "->" + nest->fieldCalb->name(), "inner.", "" );
 										break;
 									}
 									case CalibrationEnum::none:
@@ -568,8 +585,52 @@ namespace xigen
 				}
 			}
 
+			// conditions of values out of protocol ranges, see 'range' and 'oneof' in protocol.xi
+			void collectValueCheck (const TypeableField& field, const ArrayField* array)
+			{
+				if (!m_current || m_mode != modeGenWriter || m_location != locationRequest || m_current->is("inline"))
+					return;
+				std::string value = m_current->structParameterName() + "->" + field.name() + (array ? "[i]" : "");
+				std::string check;
+				const FlagField* flag = dynamic_cast<const FlagField*>( &field );
+				if (flag && flag->isOneOf())
+				{
+					const Flags& flags = findFlagset( flag->flagset() )->flags();
+					check = "\tswitch (" + value + ")\n\t{\n";
+					for (Flags::const_iterator it = flags.begin(); it != flags.end(); ++it)
+						check += "\t\tcase " + (*it)->name() + ":\n";
+					check += "\t\t\tbreak;\n\t\tdefault:\n"
+						"\t\t\treturn value_check_failed( \"" + m_current->functionName() + "\", \"" + field.name() + "\" );\n\t}\n";
+				}
+				else if (field.withRange())
+				{
+					long long min, max;
+					std::vector<std::string> conditions;
+					// a bound is dropped only if the native type of the struct member cannot exceed it,
+					// members are wider than the wire, see mapToNativeType
+					typeLimits( remapBindingType( field.type() ), min, max );
+					if (field.rangeMin() > min)
+						conditions.push_back( value + " < " + toString( field.rangeMin() ) );
+					if (field.rangeMax() < max)
+						conditions.push_back( value + " > " + toString( field.rangeMax() ) );
+					if (conditions.empty())
+						return;
+					std::string indent = array ? "\t\t" : "\t";
+					if (array)
+						check = "\tfor (i = 0; i < " + array->dimExpression() + "; ++i)\n";
+					check += indent + "if (" + join( conditions, " || " ) + ")\n"
+						+ indent + "\treturn value_check_failed( \"" + m_current->functionName() + "\", \"" + field.name() + "\" );\n";
+				}
+				else
+					return;
+				m_valueChecks.push_back( check );
+				m_valueChecksIndex = m_valueChecksIndex || array;
+			}
+
 			virtual void visitDataField (DataField& field)
 			{
+				if (field.calibrationType() != CalibrationEnum::calb)
+					collectValueCheck( field, NULL );
 				if (anyCalbMode() && m_current)
 				{
 					switch (field.calibrationType())
@@ -599,10 +660,14 @@ namespace xigen
 				if (!m_current)
 					return;
 
-				m_withIndexVariable = m_withIndexVariable || field.type() != VariableEnum::Char;
+				// packed images copy arrays of the same element size at once
+				m_withIndexVariable = m_withIndexVariable || (field.type() != VariableEnum::Char &&
+						(anyCalbMode() || !m_wire || !isWireArrayCompatible( field.type() )));
 				m_withDynamicArray = m_withDynamicArray || field.isDynamic();
 
 				m_inlineCalbProxyArgs.push_back( field.name() );
+				if (field.calibrationType() != CalibrationEnum::calb)
+					collectValueCheck( field, &field );
 
 				// old weird comment: write function header only for writer if both available
 				switch (m_mode)
@@ -633,6 +698,23 @@ namespace xigen
 
 					case modeGenReaderBody:
 						if (m_location == locationAnswer &&
+								(!m_current->calb || helpers::reducedCalibrationType( field ) != CalibrationEnum::calb) && m_wire)
+						{
+							const std::string wireField = "answer_wire." + field.name();
+							emitWireField( mapToWireType( field.type() ) + " " + field.name() + "[" + field.dimExpression() + "]", field.getSize() );
+							if (field.type() == VariableEnum::Char)
+								stream()
+									<< "\tmemcpy( " << emitFieldPointer( field, false ) << ", " << wireField << ", " << field.dimExpression() << " );\n"
+									<< "\t" << emitFieldPointer( field, false ) << "[" << field.dimExpression() << "] = '\\0';\n";
+							else if (isWireArrayCompatible( field.type() ))
+								stream()
+									<< "\tmemcpy( " << emitFieldPointer( field, false ) << ", " << wireField << ", sizeof(" << wireField << ") );\n";
+							else
+								stream()
+									<< "\tfor (i = 0; i < " << field.dimExpression() << "; ++i)\n"
+									<< "\t\t" << emitFieldPointer( field, false ) << "[i] = " << wireField << "[i];\n";
+						}
+						else if (m_location == locationAnswer &&
 								(!m_current->calb || helpers::reducedCalibrationType( field ) != CalibrationEnum::calb))
 						{
 							if (field.type() == VariableEnum::Char)
@@ -649,6 +731,22 @@ namespace xigen
 
 					case modeGenWriterBody:
 						if (m_location == locationRequest &&
+								(!m_current->calb || helpers::reducedCalibrationType( field ) != CalibrationEnum::calb) && m_wire)
+						{
+							const std::string wireField = "request_wire." + field.name();
+							emitWireField( mapToWireType( field.type() ) + " " + field.name() + "[" + field.dimExpression() + "]", field.getSize() );
+							if (field.type() == VariableEnum::Char)
+								stream()
+									<< "\tmemcpy( " << wireField << ", " << emitFieldPointer( field, true ) << ", " << field.dimExpression() << " );\n";
+							else if (isWireArrayCompatible( field.type() ))
+								stream()
+									<< "\tmemcpy( " << wireField << ", " << emitFieldPointer( field, true ) << ", sizeof(" << wireField << ") );\n";
+							else
+								stream()
+									<< "\tfor (i = 0; i < " << field.dimExpression() << "; ++i)\n"
+									<< "\t\t" << wireField << "[i] = " << emitFieldPointer( field, true ) << "[i];\n";
+						}
+						else if (m_location == locationRequest &&
 								(!m_current->calb || helpers::reducedCalibrationType( field ) != CalibrationEnum::calb))
 						{
 							if (field.type() == VariableEnum::Char)
@@ -672,13 +770,7 @@ namespace xigen
 								{
 									const FieldNest* nest = m_current->findNestByField( &field );
 									stream() << "\tfor (i = 0; i < " << field.dimExpression() << "; ++i)\n\t{\n";
-									stream() << "\t\tXI_normal_to_calibrate" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "") 
-											 << (nest->fieldMicro ? "" : "_short") << "("
-											 << helpers::prefixedCalbName( *(nest->fieldCalb) ) << "[i], "
-											 << nest->fieldNormal->name() << "[i], ";
-									if (nest->fieldMicro)
-											stream() << nest->fieldMicro->name() << "[i], ";
-									stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id" : "") << " );\n";
+									stream() << "\t\t" << emitCalbMacro( nest, false, helpers::prefixedCalbName( *(nest->fieldCalb) ) + "[i]", "", "[i]" );
 									stream() << "\t};\n";
 								}
 							}
@@ -690,13 +782,7 @@ namespace xigen
 									{
 										const FieldNest* nest = m_current->findNestByField( &field );
 										stream() << "\tfor (i = 0; i < " << field.dimExpression() << "; ++i)\n\t{\n";
-										stream() << "\t\tXI_normal_to_calibrate" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-												 << (nest->fieldMicro ? "" : "_short") << "("
-												 << m_current->structParameterCalbName() << "->" << nest->fieldCalb->name() << "[i], "
-												 << "inner." << nest->fieldNormal->name() << "[i], ";
-										if (nest->fieldMicro)
-												 stream() << "inner." << nest->fieldMicro->name() << "[i], ";
-										stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id" : "") << " );\n";
+										stream() << "\t\t" << emitCalbMacro( nest, false, m_current->structParameterCalbName() + "->" + nest->fieldCalb->name() + "[i]", "inner.", "[i]" );
 										stream() << "\t};\n";
 										break;
 									}
@@ -720,16 +806,7 @@ namespace xigen
 								{
 										const FieldNest* nest = m_current->findNestByField( &field );
 										stream() << "\tfor (i = 0; i < " << field.dimExpression() << "; ++i)\n\t{\n";
-										stream() << "\t\tXI_calibrate_to_normal" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-												 << ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? "_Dcorr" : "")
-												 << (nest->fieldMicro ? "" : "_short") << "("
-											 	 << helpers::prefixedCalbName( *(nest->fieldCalb) ) << "[i], "
-												 << nest->fieldNormal->name() << "[i], ";
-										if (nest->fieldMicro)
-												 stream() << nest->fieldMicro->name() << "[i], ";
-										stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id " : "") 
-												 << ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? " , id " : "")
-												 << " );\n";
+										stream() << "\t\t" << emitCalbMacro( nest, true, helpers::prefixedCalbName( *(nest->fieldCalb) ) + "[i]", "", "[i]" );
 										stream() << "\t};\n";
 								}
 							}
@@ -741,16 +818,7 @@ namespace xigen
 									{
 										const FieldNest* nest = m_current->findNestByField( &field );
 										stream() << "\tfor (i = 0; i < " << field.dimExpression() << "; ++i)\n\t{\n";
-										stream() << "\t\tXI_calibrate_to_normal" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? "_corr" : "")
-											 << ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? "_Dcorr" : "")
-											 << (nest->fieldMicro ? "" : "_short") << "("
-											 << m_current->structParameterCalbName() << "->" << nest->fieldCalb->name() << "[i], "
-											 << "inner." << nest->fieldNormal->name() << "[i], ";
-										if (nest->fieldMicro)
-											stream() << "inner." << nest->fieldMicro->name() << "[i], ";
-										stream() << "calibration" << ((nest->fieldCalb->type() == VariableEnum::CFloat) ? " , id " : "") 
-											<< ((nest->fieldCalb->type() == VariableEnum::CDFloat) ? " , id " : "")
-											<< " );\n";
+										stream() << "\t\t" << emitCalbMacro( nest, true, m_current->structParameterCalbName() + "->" + nest->fieldCalb->name() + "[i]", "inner.", "[i]" );
 										stream() << "\t};\n";
 										break;
 									}
@@ -768,6 +836,7 @@ namespace xigen
 
 			virtual void visitFlagField (FlagField& field)
 			{
+				collectValueCheck( field, NULL );
 				emitGenericDataField( field );
 			}
 
@@ -779,12 +848,21 @@ namespace xigen
 				switch (m_mode)
 				{
 					case modeGenReaderBody:
-						if (m_location == locationAnswer)
+						if (m_location == locationAnswer && m_wire)
+							emitWireField( "uint8_t reserved" + toString( m_wireFields.size() ) + "[" + toString( field.getSize() ) + "]", field.getSize() );
+						else if (m_location == locationAnswer)
 							stream() << "\tpop_garbage( &p, " << field.getSize() << " );\n";
 						break;
 
 					case modeGenWriterBody:
-						if (m_location == locationRequest)
+						if (m_location == locationRequest && m_wire)
+						{
+							const std::string reserved = "reserved" + toString( m_wireFields.size() );
+							emitWireField( "uint8_t " + reserved + "[" + toString( field.getSize() ) + "]", field.getSize() );
+							// the same filler as push_garbage
+							stream() << "\tmemset( request_wire." << reserved << ", 0xCC, " << field.getSize() << " );\n";
+						}
+						else if (m_location == locationRequest)
 							stream() << "\tpush_garbage( &p, " << field.getSize() << " );\n";
 						break;
 				}
@@ -812,8 +890,24 @@ namespace xigen
 			bool m_withSresultResult;
 			bool m_withDynamicArray;
 			bool m_enableComments;
+			// emitting calibration context variants of calibrated functions
+			bool m_ctx;
+			// current command is serialized through packed wire structures
+			bool m_wire;
 
 			std::vector<std::string> m_inlineCalbProxyArgs;
+			// universal commands in protocol order
+			std::vector<Command*> m_settings;
+			std::vector<Command*> m_multiReaders;
+			// fields of the packed structure being emitted and its wire size
+			std::vector<std::string> m_wireFields;
+			size_t m_wireSize;
+			std::ostringstream m_wireStructs;
+			// value checks of the request being emitted and check functions of all set functions
+			std::vector<std::string> m_valueChecks;
+			bool m_valueChecksIndex;
+			std::ostringstream m_valueCheckFunctions;
+			std::map<std::string, const Flagset*> m_flagsets;
 
 			std::ostream& stream()
 			{
@@ -833,6 +927,63 @@ namespace xigen
 				m_withSresultResult = false;
 				m_withDynamicArray = false;
 				m_inlineCalbProxyArgs.clear();
+				m_wireFields.clear();
+				m_wireSize = 0;
+				m_valueChecks.clear();
+				m_valueChecksIndex = false;
+			}
+
+			const Flagset* findFlagset (const std::string& name) const
+			{
+				std::map<std::string, const Flagset*>::const_iterator it = m_flagsets.find( name );
+				if (it == m_flagsets.end())
+					throw ast_error( "Unknown flagset " + name, m_current );
+				return it->second;
+			}
+
+			// static check of a set function argument, called before the device is locked
+			void emitValueCheck (const Command& command)
+			{
+				m_valueCheckFunctions << "static result_t check_" << command.functionName()
+					<< " (const " << command.structName() << "_t* " << command.structParameterName() << ")\n"
+					<< "{\n";
+				if (m_valueChecksIndex)
+					m_valueCheckFunctions << "\tunsigned int i;\n\n";
+				for (std::vector<std::string>::const_iterator it = m_valueChecks.begin(); it != m_valueChecks.end(); ++it)
+					m_valueCheckFunctions << *it;
+				m_valueCheckFunctions << "\treturn result_ok;\n}\n\n";
+			}
+
+			std::string wireStructName (const Command& command, bool request) const
+			{
+				return command.functionName() + (request ? "_request_t" : "_answer_t");
+			}
+
+			// adds a field to the packed structure, the whole answer image is copied before its first field
+			void emitWireField (const std::string& declaration, size_t size)
+			{
+				if (m_wireFields.empty() && m_mode == modeGenReaderBody)
+					stream()
+						<< "\tmemcpy( &answer_wire, p, sizeof(answer_wire) );\n"
+						<< "\tp += sizeof(answer_wire);\n";
+				m_wireFields.push_back( declaration );
+				m_wireSize += size;
+			}
+
+			// packed structure of a command payload, its size is checked against the protocol at compile time
+			void emitWireStruct (const Command& command, bool request)
+			{
+				if (m_wireFields.empty())
+					return;
+				std::string name = wireStructName( command, request );
+				m_wireStructs << "typedef struct\n{\n";
+				for (std::vector<std::string>::const_iterator it = m_wireFields.begin(); it != m_wireFields.end(); ++it)
+					m_wireStructs << "\t" << *it << ";\n";
+				m_wireStructs << "} " << name << ";\n"
+					<< "XI_STATIC_ASSERT(sizeof(" << name << ") == " << m_wireSize << ", "
+						<< name.substr( 0, name.size() - 2 ) << ");\n\n";
+				m_wireFields.clear();
+				m_wireSize = 0;
 			}
 
 			void emitFunctionHead (Command& command)
@@ -841,24 +992,118 @@ namespace xigen
 						m_mode == modeGenReader || m_mode == modeGenReaderCalb,
 						command.is("public"),
 						m_mode == modeGenReaderCalb || m_mode == modeGenWriterCalb,
-						false
+						false,
+						m_ctx ? "_ctx" : ""
 				);
 			}
 
+			// conversion macro call for a calibrated field, see XI_* macros in protosup.h
+			std::string emitCalbMacro (const FieldNest* nest, bool writer, const std::string& calbValue,
+					const std::string& prefix, const std::string& suffix)
+			{
+				bool corr = nest->fieldCalb->type() == VariableEnum::CFloat;
+				bool dcorr = writer && nest->fieldCalb->type() == VariableEnum::CDFloat;
+				std::string result = writer ? "XI_calibrate_to_normal" : "XI_normal_to_calibrate";
+				if (corr)
+					result += "_corr";
+				if (dcorr)
+					result += "_Dcorr";
+				if (!nest->fieldMicro)
+					result += "_short";
+				if (m_ctx)
+					result += "_ctx";
+				result += "(" + calbValue + ", " + prefix + nest->fieldNormal->name() + suffix + ", ";
+				if (nest->fieldMicro)
+					result += prefix + nest->fieldMicro->name() + suffix + ", ";
+				if (m_ctx)
+					result += dcorr ? "context, id" : "context";
+				else
+					result += corr || dcorr ? "calibration, id" : "calibration";
+				return result + " );\n";
+			}
+
 			void doGenerate (Protocol* protocol, std::ostream* os)
 			{
 				m_mode = (Mode)0;
 				m_current = NULL;
+				m_ctx = false;
+				m_settings.clear();
+				m_multiReaders.clear();
+				m_wireStructs.str( "" );
+				m_valueCheckFunctions.str( "" );
+				m_flagsets.clear();
+				for (Flagsets::const_iterator it = protocol->flagsets.begin(); it != protocol->flagsets.end(); ++it)
+					m_flagsets[(*it)->name()] = *it;
 
 				protocol->accept( *this );
 
+				echoBanner( "BEGIN OF GENERATED wire structures", os );
+
+				*os << "#pragma pack(push, 1)\n\n" << m_wireStructs.str() << "#pragma pack(pop)\n\n";
+
+				if (!m_valueCheckFunctions.str().empty())
+				{
+					echoBanner( "BEGIN OF GENERATED value checks", os );
+					*os << m_valueCheckFunctions.str();
+				}
+
 				echoBanner( "BEGIN OF GENERATED function definitions", os );
 
 				*os << m_os.str();
 
+				emitMultiReaders( os );
+
+				emitSettingsTable( os );
+
 				echoBanner( "END OF GENERATED CODE", os );
 			}
 
+			// readers of several devices at once run the ordinary reader through dispatch_get
+			void emitMultiReaders (std::ostream* os)
+			{
+				for (std::vector<Command*>::const_iterator it = m_multiReaders.begin(); it != m_multiReaders.end(); ++it)
+				{
+					Command& command = **it;
+					std::string structType = command.structName() + "_t";
+					*os << "static result_t " << command.functionName() << "_multi_one (device_t id, void* out)\n"
+						<< "{\n"
+						<< "\treturn " << command.functionName() << "( id, (" << structType << "*)out );\n"
+						<< "}\n\n"
+						<< helpers::emitMultiReaderHead( command ) << "\n"
+						<< "{\n"
+						<< "\treturn dispatch_get( ids, count, " << command.structParameterName() << ", sizeof(" << structType << "), "
+						<< command.functionName() << "_multi_one, results );\n"
+						<< "}\n\n\n";
+				}
+			}
+
+			// table of universal commands for settings snapshots, see settings_command_t in protosup.h
+			void emitSettingsTable (std::ostream* os)
+			{
+				// reserved payload bytes are not settings, they are skipped when payloads are compared
+				for (std::vector<Command*>::const_iterator it = m_settings.begin(); it != m_settings.end(); ++it)
+				{
+					CollectReservedRanges reserved;
+					(*it)->accept( reserved );
+					if (reserved.size() + 6 != (*it)->communicatorReader->size)
+						throw ast_error( "Answer fields do not fill the packet", *it );
+					*os << "static const unsigned int settings_reserved_" << (*it)->structName() << "[] = { ";
+					for (size_t i = 0; i < reserved.ranges().size(); ++i)
+						*os << reserved.ranges()[i].first << ", " << reserved.ranges()[i].second << ", ";
+					*os << "0, 0 };\n";
+				}
+				if (!m_settings.empty())
+					*os << "\n";
+				*os << "const settings_command_t settings_commands[] =\n{\n";
+				for (std::vector<Command*>::const_iterator it = m_settings.begin(); it != m_settings.end(); ++it)
+				{
+					const Communicator* communicator = (*it)->communicatorReader;
+					*os << "\t{ \"" << (*it)->structName() << "\", \"" << communicator->name.substr( 1 )
+						<< "\", " << communicator->size << ", settings_reserved_" << (*it)->structName() << " },\n";
+				}
+				*os << "\t{ NULL, NULL, 0, NULL }\n};\n\n";
+			}
+
 			void echoBanner (std::string bannerText, std::ostream* os)
 			{
 				if (m_enableComments)
@@ -877,7 +1122,7 @@ namespace xigen
 		public:
 
 			LibGenerator ()
-				: m_current(NULL), m_enableComments(true)
+				: m_current(NULL), m_enableComments(true), m_ctx(false), m_wire(false), m_wireSize(0), m_valueChecksIndex(false)
 			{
 			}
 
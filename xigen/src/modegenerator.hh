@@ -14,7 +14,7 @@ namespace xigen
 			ModeGenerator (bool isGeneratePublicHeader = true)
 				: m_shouldGeneratePublicHeader(isGeneratePublicHeader),
 					m_mode((Mode)0), m_current(NULL), m_enableComments(false),
-					m_lineTerminator(";")
+					m_lineTerminator(";"), m_ctx(false)
 			{
 			}
 
@@ -87,6 +87,7 @@ namespace xigen
 
 			virtual bool visitCommand (Command& command, size_t cookie)
 			{
+				m_ctx = false;
 				for (; cookie < (size_t)modeNULL; ++cookie)
 				{
 					if (acceptMode( (Mode)cookie ))
@@ -97,6 +98,15 @@ namespace xigen
 						return true;
 					}
 				}
+				// calibrated function modes once more for calibration context variants
+				if (acceptContextModes() && cookie < (size_t)modeNULL + 2)
+				{
+					m_ctx = true;
+					m_mode = cookie == (size_t)modeNULL ? modeGenWriterCalb : modeGenReaderCalb;
+					clear();
+					visitCommandImplOneRun( command );
+					return true;
+				}
 				return false;
 			}
 
@@ -313,6 +323,8 @@ namespace xigen
 
 			bool m_enableComments;
 			std::string m_lineTerminator;
+			// calibrated function modes are emitting _ctx variants
+			bool m_ctx;
 
 		protected:
 
@@ -320,6 +332,7 @@ namespace xigen
 			// additionally, visitFlagset is also useful
 
 			virtual bool acceptMode(Mode mode) = 0;
+			virtual bool acceptContextModes() { return false; }
 			virtual void clear() { };
 			virtual void output (std::ostream* os) = 0;
 			virtual void startStructs() = 0;
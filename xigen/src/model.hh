@@ -99,6 +99,43 @@ namespace xigen
 		}
 	}
 
+	inline std::string mapToWireType(const VariableEnum::Type& type)
+	{
+		switch (type)
+		{
+			case VariableEnum::Int64u:	return "uint64_t";
+			case VariableEnum::Int64s:	return "int64_t";
+			case VariableEnum::Int32u:	return "uint32_t";
+			case VariableEnum::Int32s:	return "int32_t";
+			case VariableEnum::Int16u:	return "uint16_t";
+			case VariableEnum::Int16s:	return "int16_t";
+			case VariableEnum::Int8u:		return "uint8_t";
+			case VariableEnum::Int8s:		return "int8_t";
+			case VariableEnum::Float:		return "float";
+			case VariableEnum::Double:	return "double";
+			case VariableEnum::Char:		return "char";
+			case VariableEnum::Byte:		return "uint8_t";
+			case VariableEnum::CFloat:		return "float";
+			case VariableEnum::CDFloat:		return "float";
+			default:										throw std::runtime_error( "unserializable type" );
+		}
+	}
+
+	/* Native arrays widen 8 and 16-bit elements to int, others keep the wire element size */
+	inline bool isWireArrayCompatible(const VariableEnum::Type& type)
+	{
+		switch (type)
+		{
+			case VariableEnum::Int16u:
+			case VariableEnum::Int16s:
+			case VariableEnum::Int8u:
+			case VariableEnum::Int8s:
+				return false;
+			default:
+				return true;
+		}
+	}
+
 	inline std::string mapToNativeCSharpType(const VariableEnum::Type& type, bool trueArray)
 	{
 		switch (type)
@@ -343,6 +380,23 @@ namespace xigen
 		}
 	}
 
+	// limits of an integer type, 64-bit types are limited by long long
+	inline bool typeLimits(const VariableEnum::Type& type, long long& min, long long& max)
+	{
+		switch (type)
+		{
+			case VariableEnum::Int64u:	min = 0; max = std::numeric_limits<long long>::max(); return true;
+			case VariableEnum::Int64s:	min = std::numeric_limits<long long>::min(); max = std::numeric_limits<long long>::max(); return true;
+			case VariableEnum::Int32u:	min = 0; max = 4294967295LL; return true;
+			case VariableEnum::Int32s:	min = -2147483648LL; max = 2147483647LL; return true;
+			case VariableEnum::Int16u:	min = 0; max = 65535; return true;
+			case VariableEnum::Int16s:	min = -32768; max = 32767; return true;
+			case VariableEnum::Int8u:		min = 0; max = 255; return true;
+			case VariableEnum::Int8s:		min = -128; max = 127; return true;
+			default:										return false;
+		}
+	}
+
 	// AST types are mapped to native types in a ximc.h
 	// Bindings must use exact native types and not the AST types
 	// For example, int16u maps to int and it is int in c# not short
@@ -479,7 +533,7 @@ namespace xigen
 	{
 	public:
 		TypeableField(VariableEnum::Type atype, std::string aname)
-			: m_name(aname), m_type(atype)
+			: m_name(aname), m_type(atype), m_withRange(false), m_rangeMin(0), m_rangeMax(0)
 		{
 		}
 
@@ -487,9 +541,24 @@ namespace xigen
 		VariableEnum::Type type() const { return m_type; }
 
 		virtual std::string declaration() const { return m_name; }
+
+		// valid values for host-side checks of set functions, see 'range' in protocol.xi
+		void setRange (long long amin, long long amax)
+		{
+			m_withRange = true;
+			m_rangeMin = amin;
+			m_rangeMax = amax;
+		}
+		bool withRange() const { return m_withRange; }
+		long long rangeMin() const { return m_rangeMin; }
+		long long rangeMax() const { return m_rangeMax; }
 	protected:
 		const std::string m_name;
 		const VariableEnum::Type m_type;
+	private:
+		bool m_withRange;
+		long long m_rangeMin;
+		long long m_rangeMax;
 	};
 
 	class CalibrableTypeableField : public TypeableField
@@ -659,12 +728,12 @@ namespace xigen
 	{
 		public:
 			FlagField(VariableEnum::Type atype, std::string aname)
-				: TypeableField(atype, aname)
+				: TypeableField(atype, aname), m_oneof(false)
 			{
 			}
 
-			FlagField(VariableEnum::Type atype, std::string aname, std::string aflagset)
-				: TypeableField(atype, aname), m_flagset(aflagset)
+			FlagField(VariableEnum::Type atype, std::string aname, std::string aflagset, bool aoneof = false)
+				: TypeableField(atype, aname), m_flagset(aflagset), m_oneof(aoneof)
 			{
 			}
 
@@ -675,7 +744,7 @@ namespace xigen
 					<< " type=" << m_type
 					<< " name=" << m_name;
 				if (!m_flagset.empty())
-					os << " flagset=" << m_flagset;
+					os << (m_oneof ? " oneof=" : " flagset=") << m_flagset;
 				os << "]";
 				return os.str();
 			}
@@ -691,9 +760,12 @@ namespace xigen
 			}
 
 			std::string flagset() const { return m_flagset; }
+			// the value is one of the flagset values, not a combination of them
+			bool isOneOf() const { return m_oneof; }
 
 		private:
 			const std::string m_flagset;
+			const bool m_oneof;
 	};
 
 	class ReservedField : public Field
@@ -892,6 +964,44 @@ namespace xigen
 		bool isCalb() const { return m_calb; }
 	};
 
+	/* A command has a fixed wire layout without service results and can be copied as a packed structure */
+	class CheckIsWireCommand : public DefaultVisitor
+	{
+		bool m_wire;
+	public:
+		CheckIsWireCommand() : m_wire(true) { }
+		virtual void visitDataField (DataField& field)   { m_wire = m_wire && field.purpose() == DataField::Purpose::normal; }
+		virtual void visitArrayField (ArrayField& field) { m_wire = m_wire && !field.isDynamic(); }
+		virtual void visitConstantField (ConstantField& ) { m_wire = false; }
+		bool isWire() const { return m_wire; }
+	};
+
+	/* Payload ranges of the reserved fields of an answer, offsets are counted from the end of the command code */
+	class CollectReservedRanges : public DefaultVisitor
+	{
+		bool m_answer;
+		size_t m_offset;
+		std::vector< std::pair<size_t, size_t> > m_ranges;
+		void skip (const Field& field) { if (m_answer) m_offset += field.getSize(); }
+	public:
+		CollectReservedRanges() : m_answer(false), m_offset(0) { }
+		virtual void visitRequest () { m_answer = false; }
+		virtual void visitAnswer () { m_answer = true; }
+		/* calibrated fields are not on the wire */
+		virtual void visitDataField (DataField& field) { if (field.calibrationType() != CalibrationEnum::calb) skip( field ); }
+		virtual void visitConstantField (ConstantField& field) { skip( field ); }
+		virtual void visitArrayField (ArrayField& field) { if (field.calibrationType() != CalibrationEnum::calb) skip( field ); }
+		virtual void visitFlagField (FlagField& field) { skip( field ); }
+		virtual void visitReservedField (ReservedField& field)
+		{
+			if (m_answer)
+				m_ranges.push_back( std::make_pair( m_offset, field.getSize() ) );
+			skip( field );
+		}
+		const std::vector< std::pair<size_t, size_t> >& ranges() const { return m_ranges; }
+		size_t size() const { return m_offset; }
+	};
+
 	class Command : public Printable, public IVisitable
 	{
 		public:
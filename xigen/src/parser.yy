@@ -49,6 +49,7 @@ using namespace xigen;
 
 %union {
 	unsigned int 	integerVal;
+	long long 	boundVal;
 	bool 		boolVal;
 	std::string* 	stringVal;
 	xigen::Command* 	nodeCommand;
@@ -69,8 +70,8 @@ using namespace xigen;
 %token <stringVal> 	STRING		"string"
 %token <stringVal> 	IDENTIFIER	"identifier"
 
-%token <stringVal>	ANSWER CALB COMMAND COMMENT_SECTION COMMENT_DOXYGEN CRC DEFAULTS DUALSYNC FIELDS FLAG FLAGSET INLINE IS LOCK METALEN NORMAL OF
-%token <stringVal>	PROTOCOL PUBLIC PUBLICSTRUCT READER RESERVED SERVICE SERVICEANSWER SERVICERESULT UNIVERSAL WITH WITHOUT WRITER
+%token <stringVal>	ANSWER CALB COMMAND COMMENT_SECTION COMMENT_DOXYGEN CRC DEFAULTS DUALSYNC FIELDS FLAG FLAGSET INLINE IS LOCK METALEN NORMAL OF ONEOF
+%token <stringVal>	PROTOCOL PUBLIC PUBLICSTRUCT RANGE READER RESERVED SERVICE SERVICEANSWER SERVICERESULT UNIVERSAL WITH WITHOUT WRITER
 %token <stringVal>	TYPE_INT64S TYPE_INT64U TYPE_INT32S TYPE_INT32U TYPE_INT16U TYPE_INT16S TYPE_INT8U TYPE_INT8S TYPE_BYTE TYPE_FLOAT TYPE_DOUBLE TYPE_CHAR TYPE_CFLOAT TYPE_CDFLOAT
 
 %destructor	{ delete $$; } STRING 
@@ -79,11 +80,12 @@ using namespace xigen;
 /* type declarations */
 
 %type <nodeCommand> 		command	command_header
-%type <nodeField> 		field declaration declaration_helper flag_declaration reserved_declaration variable_declaration array_declaration constant_declaration
+%type <nodeField> 		field declaration declaration_helper flag_declaration reserved_declaration variable_declaration array_declaration constant_declaration range_declaration
 %type <nodeArrayField> 		array_declaration_pure 
 %type <nodeCommunicator>	command_code	
 
 %type <integerVal>		number 
+%type <boundVal>		range_bound
 %type <stringVal>		feature_single
 %type <nodeComments>		comments
 %type <nodeComment>		comment comment_doxygen comment_section
@@ -141,6 +143,10 @@ flag_declaration	: variable_type FLAG IDENTIFIER OF IDENTIFIER
 			{
 				$$ = new FlagField($1, *$3, *$5); 
 			}
+			| variable_type FLAG IDENTIFIER ONEOF IDENTIFIER
+			{
+				$$ = new FlagField($1, *$3, *$5, true); 
+			}
 			| variable_type FLAG IDENTIFIER 
 			{
 				$$ = new FlagField($1, *$3); 
@@ -188,6 +194,21 @@ array_declaration_pure	: variable_type IDENTIFIER '[' number ']' METALEN
 				$$ = new ArrayField($1, *$2, *$5); 
 			}
 
+range_bound		: number { $$ = $1; }
+			| '-' number { $$ = -(long long)$2; }
+
+			/* valid values of a field, set functions check them before sending */
+range_declaration	: variable_declaration RANGE range_bound '.' '.' range_bound
+			{
+				static_cast<TypeableField*>($1)->setRange($3, $6);
+				$$ = $1;
+			}
+			| array_declaration RANGE range_bound '.' '.' range_bound
+			{
+				static_cast<TypeableField*>($1)->setRange($3, $6);
+				$$ = $1;
+			}
+
 reserved_declaration	: RESERVED number
 			{
 				$$ = new ReservedField($2);
@@ -304,6 +325,7 @@ declaration		: flag_declaration
 			| constant_declaration
 			| variable_declaration
 			| array_declaration
+			| range_declaration
 			| reserved_declaration
 
 declaration_helper	: declaration
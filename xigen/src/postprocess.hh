@@ -69,6 +69,7 @@ namespace xigen
 			{
 				if (!flagset.comment())
 					throw ast_error("Flagset without doxygen comment is not allowed");
+				m_flagsets.insert( flagset.name() );
 			}
 
 			virtual void visitDataField (DataField& field)
@@ -76,6 +77,7 @@ namespace xigen
 				checkFieldName( field );
 				if (field.type() == VariableEnum::Char || field.type() == VariableEnum::Byte)
 					throw ast_error( "Single char/byte is not supported yet, please use int8" );
+				checkFieldRange( field );
 				handleFieldToNest( field );
 			}
 
@@ -90,6 +92,7 @@ namespace xigen
 			virtual void visitArrayField (ArrayField& field)
 			{
 				checkFieldName( field );
+				checkFieldRange( field );
 				handleFieldToNest( field );
 			}
 
@@ -98,9 +101,31 @@ namespace xigen
 				if (field.type() == VariableEnum::Char)
 					throw ast_error("Char flags are not allowed", m_current);
 				checkFieldName( field );
+				if (field.isOneOf())
+				{
+					if (m_flagsets.find( field.flagset() ) == m_flagsets.end())
+						throw ast_error( "Unknown flagset " + field.flagset() + " of field " + field.name(), m_current );
+					if (m_current->is("inline"))
+						throw ast_error( "Checked values of inline command are not supported", m_current );
+				}
 				finishFieldNest();
 			}
 
+			// ranges are checked by set functions, so they must fit the wire type
+			template <class F>
+			void checkFieldRange (const F& field)
+			{
+				long long min, max;
+				if (!field.withRange())
+					return;
+				if (!typeLimits( field.type(), min, max ) || field.calibrationType() == CalibrationEnum::calb)
+					throw ast_error( "Range of non-integer field " + field.name(), m_current );
+				if (field.rangeMin() > field.rangeMax() || field.rangeMin() < min || field.rangeMax() > max)
+					throw ast_error( "Range of field " + field.name() + " does not fit its type", m_current );
+				if (m_current->is("inline"))
+					throw ast_error( "Checked values of inline command are not supported", m_current );
+			}
+
 			template <class F>
 			void checkFieldName (const F& field)
 			{
@@ -189,6 +214,7 @@ namespace xigen
 			const bool m_no_comments;
 
 			std::set<std::string> m_deniedNames;
+			std::set<std::string> m_flagsets;
 
 			FieldNest* m_currentNest;
 
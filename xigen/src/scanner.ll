@@ -88,9 +88,11 @@ lock			{ return token::LOCK; }
 metalen			{ return token::METALEN; }
 normal			{ return token::NORMAL; }
 of			{ return token::OF; }
+oneof			{ return token::ONEOF; }
 protocol		{ return token::PROTOCOL; }
 public			{ return token::PUBLIC; }
 publicstruct		{ return token::PUBLICSTRUCT; }
+range			{ return token::RANGE; }
 reader			{ return token::READER; }
 reserved		{ return token::RESERVED; }
 service			{ return token::SERVICE; }
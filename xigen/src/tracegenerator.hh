@@ -0,0 +1,164 @@
+#ifndef TRACEGENERATOR_HH
+#define TRACEGENERATOR_HH
+
+#include "common.hh"
+#include "visitor.hh"
+#include "basegenerator.hh"
+#include "generatorhelper.hh"
+
+namespace xigen
+{
+
+	// command and field tables of the XILOG trace analyzer, see xilog-template.c
+	class TraceGenerator : protected DefaultVisitor, public Noncopyable, public BaseGenerator
+	{
+		protected:
+			virtual bool visitCommand (Command& command, size_t cookie)
+			{
+				if (cookie >= 1)
+					return false;
+				// unsynced variants have the same packets
+				m_current = command.unsynced ? NULL : &command;
+				m_location = locationNone;
+				m_fields.clear();
+				return true;
+			}
+
+			virtual void visitRequest ()
+			{
+				startFields( locationRequest );
+			}
+
+			virtual void visitAnswer ()
+			{
+				finishFields();
+				startFields( locationAnswer );
+			}
+
+			virtual void visitCommandPost (Command& command)
+			{
+				if (!m_current)
+					return;
+				finishFields();
+
+				const Communicator* request = command.communicatorWriter ? command.communicatorWriter : command.communicatorUniversal;
+				const Communicator* answer = command.communicatorReader ? command.communicatorReader : command.communicatorUniversal;
+				// reader requests are bare codes, writer answers are echoes
+				size_t requestSize = request ? request->size : 4;
+				size_t answerSize = answer ? answer->size : (command.is("answer") ? 4 : 0);
+				m_osCommands << "\t{ \"" << (request ? request : answer)->name << "\", \""
+					<< helpers::getCommandName( command, false, true ) << "\", "
+					<< requestSize << ", " << answerSize << ", "
+					<< (m_requestFields.empty() ? "NULL" : m_requestFields) << ", "
+					<< (m_answerFields.empty() ? "NULL" : m_answerFields) << " },\n";
+				m_current = NULL;
+			}
+
+			virtual void visitDataField (DataField& field)
+			{
+				// calibrated values are not on the wire
+				if (field.calibrationType() != CalibrationEnum::calb)
+					addField( field.name(), field.type(), 1, field.getSize() );
+			}
+
+			virtual void visitConstantField (ConstantField& field)
+			{
+				addField( field.name(), field.type(), 1, field.getSize() );
+			}
+
+			virtual void visitFlagField (FlagField& field)
+			{
+				addField( field.name(), field.type(), 1, field.getSize() );
+			}
+
+			virtual void visitArrayField (ArrayField& field)
+			{
+				if (field.calibrationType() == CalibrationEnum::calb)
+					return;
+				// fields after a dynamic array have no fixed offset
+				if (field.isDynamic())
+					m_offset = (size_t)-1;
+				else
+					addField( field.name(), field.type(), field.getDim(), field.getSize() );
+			}
+
+			virtual void visitReservedField (ReservedField& field)
+			{
+				if (m_offset != (size_t)-1)
+					m_offset += field.getSize();
+			}
+
+		private:
+
+			typedef enum { locationNone, locationRequest, locationAnswer } Location;
+
+			std::ostream* m_os;
+			std::ostringstream m_osFields;
+			std::ostringstream m_osCommands;
+			Command* m_current;
+			Location m_location;
+			size_t m_offset;
+			std::vector<std::string> m_fields;
+			std::string m_requestFields;
+			std::string m_answerFields;
+
+			void startFields (Location location)
+			{
+				m_location = location;
+				// fields follow the 4-byte command code
+				m_offset = 4;
+				m_fields.clear();
+				if (location == locationRequest)
+					m_requestFields.clear();
+				else
+					m_answerFields.clear();
+			}
+
+			void addField (const std::string& name, VariableEnum::Type type, size_t count, size_t size)
+			{
+				if (!m_current || m_offset == (size_t)-1)
+					return;
+				m_fields.push_back( "{ \"" + name + "\", " + xigen::toString( m_offset ) + ", trace_"
+					+ toString( type ) + ", " + xigen::toString( count ) + " }" );
+				m_offset += size;
+			}
+
+			void finishFields ()
+			{
+				if (!m_current || m_location == locationNone || m_fields.empty())
+					return;
+				std::string name = "trace_" + std::string(m_location == locationRequest ? "request_" : "answer_")
+					+ helpers::getCommandName( *m_current, false, true );
+				m_osFields << "static const trace_field_t " << name << "[] =\n{\n";
+				for (std::vector<std::string>::const_iterator it = m_fields.begin(); it != m_fields.end(); ++it)
+					m_osFields << "\t" << *it << ",\n";
+				m_osFields << "\t{ NULL, 0, trace_int8u, 0 }\n};\n\n";
+				(m_location == locationRequest ? m_requestFields : m_answerFields) = name;
+				m_fields.clear();
+			}
+
+			void doGenerate (Protocol* protocol, std::ostream* os)
+			{
+				m_os = os;
+				m_osFields.str( "" );
+				m_osCommands.str( "" );
+				protocol->accept( *this );
+				*os << m_osFields.str()
+					<< "static const trace_command_t trace_commands[] =\n{\n"
+					<< m_osCommands.str()
+					<< "\t{ NULL, NULL, 0, 0, NULL, NULL }\n};\n";
+			}
+
+		public:
+
+			explicit TraceGenerator ()
+				: m_os(NULL), m_current(NULL), m_location(locationNone), m_offset(0)
+			{
+			}
+	};
+
+}
+
+#endif
+
+/* vim: set ts=2 sw=2: */
@@ -48,6 +48,8 @@ int main(int argc, char *argv[])
 		" --gen-java                  generate Java wrapper class\n"\
 		" --gen-jni                   generate Java JNI library\n"\
 		" --gen-python                generate Python stub library\n"\
+		" --gen-cpp                   generate C++17 header-only interface\n"\
+		" --gen-trace                 generate XILOG trace analyzer tables\n"\
 		" --gen-def                   generate MSVC linker index\n"\
 		" --gen-wiki                  generate wiki\n"\
 		" --gen-qsdefine              generate QTScript defines (used in Xilab)\n"\
@@ -86,6 +88,8 @@ int main(int argc, char *argv[])
 		{"gen-java",								no_argument,				(int*)&generatorType,	xigen::genJava},
 		{"gen-jni",									no_argument,				(int*)&generatorType,	xigen::genJNI},
 		{"gen-python",							no_argument,				(int*)&generatorType,	xigen::genPython},
+		{"gen-cpp",									no_argument,				(int*)&generatorType,	xigen::genCpp},
+		{"gen-trace",								no_argument,				(int*)&generatorType,	xigen::genTrace},
 		{"gen-def",									no_argument,				(int*)&generatorType,	xigen::genDef},
 		{"gen-wiki",								no_argument,				(int*)&generatorType,	xigen::genWiki},
 		{"gen-qsdefine",						no_argument,				(int*)&generatorType,	xigen::genQsdefine},